@@ -0,0 +1,153 @@
+// Encoder benchmark of the wasm build under node
+//
+// usage: node [node options] bench-wasm.js -m NAME=MODEL [-m NAME=MODEL ...] [-b BENCH ...] [-t N,...] [-r N]
+//                                          [--audio-ctx N,...] [-o FNAME]
+//
+// runs wstream-bench.js, the emscripten build of wstream-bench, with the mel and encode stages for every model and
+// reports the median encoder time. several builds are compared by passing several -b, the first one is the baseline:
+//
+//   emcmake cmake -S . -B build-simd
+//   emcmake cmake -S . -B build-relaxed -DWHISPER_WASM_RELAXED_SIMD=ON
+//   cmake --build build-simd --target wstream-bench && cmake --build build-relaxed --target wstream-bench
+//
+//   node bench-wasm.js -b build-simd/bin/wstream-bench.js -b build-relaxed/bin/wstream-bench.js \
+//       -m tiny=models/ggml-tiny-q5_0.bin -m base=models/ggml-base-q5_0.bin
+//
+// the node options are passed on to the benchmark, e.g. --experimental-wasm-relaxed-simd for the node versions that
+// do not enable relaxed-simd by default. the results are printed as JSON, one line per build, model and encoder run
+
+'use strict';
+
+const fs   = require('fs');
+const os   = require('os');
+const path = require('path');
+const { spawnSync } = require('child_process');
+
+const kStages   = 'mel,encode';
+const kThreads  = '4';
+const kReps     = 5;
+const kAudioCtx = '1500';
+
+function usage(code) {
+    console.error('usage: node bench-wasm.js -m NAME=MODEL [-m NAME=MODEL ...] [-b BENCH ...] [-t N,...] [-r N] ' +
+                  '[--audio-ctx N,...] [-o FNAME]');
+    process.exit(code);
+}
+
+function runBench(bench, model, opts) {
+    const fnameTmp = path.join(os.tmpdir(), `bench-wasm-${process.pid}.json`);
+
+    const args = [ ...process.execArgv, bench,
+        '-m', model, '-s', kStages, '-t', opts.threads, '-r', String(opts.reps), '--audio-ctx', opts.audioCtx,
+        '-o', fnameTmp ];
+
+    const t0 = Date.now();
+    const res = spawnSync(process.execPath, args, { stdio: [ 'ignore', 'ignore', 'pipe' ], encoding: 'utf8' });
+    const wallMs = Date.now() - t0;
+
+    if (res.status != 0 || !fs.existsSync(fnameTmp)) {
+        console.error(res.stderr);
+        throw new Error(`${bench} failed for ${model} with status ${res.status}`);
+    }
+
+    const out = JSON.parse(fs.readFileSync(fnameTmp, 'utf8'));
+    fs.unlinkSync(fnameTmp);
+
+    return { results: out.results, wall_ms: wallMs };
+}
+
+function main() {
+    const models  = [];
+    const benches = [];
+    const opts = { threads: kThreads, reps: kReps, audioCtx: kAudioCtx };
+    let fnameOut = null;
+
+    const args = process.argv.slice(2);
+    for (let i = 0; i < args.length; ++i) {
+        const arg = args[i];
+        if (arg == '-m' && i + 1 < args.length) {
+            const v = args[++i];
+            const k = v.indexOf('=');
+            models.push(k > 0 ? { name: v.slice(0, k), path: v.slice(k + 1) } : { name: path.basename(v), path: v });
+        } else if (arg == '-b' && i + 1 < args.length) {
+            benches.push(args[++i]);
+        } else if (arg == '-t' && i + 1 < args.length) {
+            opts.threads = args[++i];
+        } else if (arg == '-r' && i + 1 < args.length) {
+            opts.reps = Math.max(1, parseInt(args[++i]));
+        } else if (arg == '--audio-ctx' && i + 1 < args.length) {
+            opts.audioCtx = args[++i];
+        } else if (arg == '-o' && i + 1 < args.length) {
+            fnameOut = args[++i];
+        } else {
+            usage(arg == '-h' || arg == '--help' ? 0 : 1);
+        }
+    }
+
+    if (models.length == 0) {
+        usage(1);
+    }
+    if (benches.length == 0) {
+        benches.push(path.join(__dirname, 'wstream-bench.js'));
+    }
+
+    const lines = [];
+
+    // encoder medians of the first build, by model and key
+    const baseline = new Map();
+
+    for (let b = 0; b < benches.length; ++b) {
+        const bench = benches[b];
+        for (const model of models) {
+            console.error(`${bench}: ${model.name} ...`);
+
+            const { results, wall_ms } = runBench(bench, model.path, opts);
+
+            const mel = new Map();
+            for (const r of results) {
+                if (r.stage == 'mel') {
+                    mel.set(r.threads, r.median_ms);
+                }
+            }
+
+            for (const r of results) {
+                if (r.stage != 'encode') {
+                    continue;
+                }
+
+                const key = `${model.name}/${r.key}`;
+                if (b == 0) {
+                    baseline.set(key, r.median_ms);
+                }
+                const base = baseline.get(key);
+
+                const res = {
+                    bench:             bench,
+                    model:             model.name,
+                    threads:           r.threads,
+                    audio_ctx:         r.audio_ctx,
+                    encoder_median_ms: r.median_ms,
+                    encoder_p99_ms:    r.p99_ms,
+                    encoder_min_ms:    r.min_ms,
+                    mel_median_ms:     mel.has(r.threads) ? mel.get(r.threads) : null,
+                    speedup:           base ? base/r.median_ms : null,
+                    wall_ms:           wall_ms,
+                };
+                lines.push(JSON.stringify(res));
+
+                console.error(`  ${model.name.padEnd(8)} threads ${String(r.threads).padStart(2)} ` +
+                              `audio_ctx ${String(r.audio_ctx).padStart(4)}: encoder ${r.median_ms.toFixed(1).padStart(9)} ms` +
+                              (res.mel_median_ms != null ? `, mel ${res.mel_median_ms.toFixed(1)} ms` : '') +
+                              (b > 0 && base ? `, ${res.speedup.toFixed(2)}x of the first build` : ''));
+            }
+        }
+    }
+
+    if (fnameOut) {
+        fs.writeFileSync(fnameOut, lines.join('\n') + '\n');
+    } else {
+        console.log(lines.join('\n'));
+    }
+}
+
+main();
@@ -0,0 +1,511 @@
+// Stage-level benchmark of the inference pipeline
+//
+// usage: wstream-bench [options] -m model.gguf
+//
+// times each stage on its own: the mel spectrogram, the encoder at several audio_ctx values, single-token decoding,
+// batched (prompt) decoding, and the whole whisper_full path with greedy and beam search sampling.
+// every stage is repeated for each thread count and reported as JSON, one result per line:
+//
+//   wstream-bench -m model.gguf -t 1,2,4 -o base.json
+//   ... change something ...
+//   wstream-bench -m model.gguf -t 1,2,4 --compare base.json
+//
+// the compare mode prints the change of the median of every stage and exits with 1 if any stage is slower than the
+// baseline by more than the threshold. the audio is synthetic and seeded, so two runs process the same input
+//
+#define _USE_MATH_DEFINES // for M_PI
+
+#include "common-whisper.h"
+
+#include "whisper.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+struct bench_params {
+    std::string model;
+    std::string fname_inp;   // synthetic audio if empty
+    std::string fname_out;   // stdout if empty
+    std::string fname_base;  // compare mode if set
+
+    std::vector<int> threads   = { 1, std::max(1, std::min(4, (int) std::thread::hardware_concurrency())) };
+    std::vector<int> audio_ctx = { 0, 750, 375 }; // 0 = the context of the model
+
+    std::vector<std::string> stages = { "mel", "encode", "decode", "batch", "beam", "full" };
+
+    int n_reps     = 5;
+    int duration_s = 10;
+    int n_decode   = 64; // tokens of the single-token decode stage
+    int n_batch    = 64; // tokens of the batched decode stage
+    int beam_size  = 5;
+
+    float threshold = 0.10f;
+};
+
+static void print_usage(const char * argv0) {
+    const bench_params def;
+
+    fprintf(stderr, "usage: %s [options] -m model.gguf\n", argv0);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "options:\n");
+    fprintf(stderr, "  -m FNAME            model path\n");
+    fprintf(stderr, "  -f FNAME            input audio (default: %d s of seeded synthetic audio)\n", def.duration_s);
+    fprintf(stderr, "  -t N,N,...          thread counts (default: %d,%d)\n", def.threads[0], def.threads[1]);
+    fprintf(stderr, "  -r N                repetitions per stage, after one discarded run (default: %d)\n", def.n_reps);
+    fprintf(stderr, "  -s STAGE,...        stages: mel,encode,decode,batch,beam,full (default: all)\n");
+    fprintf(stderr, "  --audio-ctx N,...   encoder contexts, 0 is the model default (default: 0,750,375)\n");
+    fprintf(stderr, "  --duration N        length of the synthetic audio in seconds (default: %d)\n", def.duration_s);
+    fprintf(stderr, "  --decode N          tokens of the single-token decode stage (default: %d)\n", def.n_decode);
+    fprintf(stderr, "  --batch N           tokens of the batched decode stage (default: %d)\n", def.n_batch);
+    fprintf(stderr, "  --beam-size N       beam size of the beam stage (default: %d)\n", def.beam_size);
+    fprintf(stderr, "  -o FNAME            write the results to a file instead of stdout\n");
+    fprintf(stderr, "  --compare FNAME     compare the medians with a baseline written by -o\n");
+    fprintf(stderr, "  --threshold PCT     slowdown reported as a regression (default: %.0f)\n", 100.0f*def.threshold);
+}
+
+template <typename T>
+static std::vector<T> parse_list(const std::string & s) {
+    std::vector<T> res;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (item.empty()) {
+            continue;
+        }
+        if constexpr (std::is_same_v<T, int>) {
+            res.push_back(std::stoi(item));
+        } else {
+            res.push_back(item);
+        }
+    }
+    return res;
+}
+
+// deterministic speech-like input: a few voiced harmonics with a syllable-rate envelope over low-level noise
+static std::vector<float> synth_audio(int duration_s) {
+    std::vector<float> pcmf32((size_t) duration_s*WHISPER_SAMPLE_RATE);
+
+    std::mt19937 rng(42);
+    std::normal_distribution<float> noise(0.0f, 0.01f);
+
+    for (size_t i = 0; i < pcmf32.size(); ++i) {
+        const double t  = (double) i/WHISPER_SAMPLE_RATE;
+        const double f0 = 120.0 + 30.0*std::sin(2.0*M_PI*0.5*t);
+        const double env = 0.5 + 0.5*std::sin(2.0*M_PI*4.0*t);
+
+        double v = 0.0;
+        for (int h = 1; h <= 5; ++h) {
+            v += std::sin(2.0*M_PI*f0*h*t)/h;
+        }
+
+        pcmf32[i] = (float) (0.1*env*v) + noise(rng);
+    }
+
+    return pcmf32;
+}
+
+struct bench_result {
+    std::string stage;
+    int    threads   = 0;
+    int    audio_ctx = 0;    // encode only
+    int    n_tokens  = 0;    // decode and batch only
+    double audio_s   = 0.0;  // audio represented by one run, 0 if not applicable
+
+    std::vector<double> samples_ms;
+
+    std::string key() const {
+        std::string res = stage + "/t" + std::to_string(threads);
+        if (stage == "encode") {
+            res += "/ctx" + std::to_string(audio_ctx);
+        }
+        return res;
+    }
+};
+
+static double percentile(std::vector<double> v, double p) {
+    if (v.empty()) {
+        return 0.0;
+    }
+    std::sort(v.begin(), v.end());
+    // nearest rank
+    const size_t k = (size_t) std::ceil(p*v.size());
+    return v[std::min(v.size() - 1, k > 0 ? k - 1 : 0)];
+}
+
+static std::string result_json(const bench_result & r) {
+    const double median = percentile(r.samples_ms, 0.50);
+    const double p99    = percentile(r.samples_ms, 0.99);
+    const double min    = *std::min_element(r.samples_ms.begin(), r.samples_ms.end());
+
+    double mean = 0.0;
+    for (double v : r.samples_ms) {
+        mean += v;
+    }
+    mean /= r.samples_ms.size();
+
+    char buf[512];
+    snprintf(buf, sizeof(buf),
+            "{\"key\": \"%s\", \"stage\": \"%s\", \"threads\": %d, \"audio_ctx\": %d, \"n_tokens\": %d, \"n\": %zu, "
+            "\"median_ms\": %.3f, \"p99_ms\": %.3f, \"mean_ms\": %.3f, \"min_ms\": %.3f, \"rtf\": ",
+            r.key().c_str(), r.stage.c_str(), r.threads, r.audio_ctx, r.n_tokens, r.samples_ms.size(), median, p99, mean, min);
+
+    std::string res = buf;
+    if (r.audio_s > 0.0) {
+        snprintf(buf, sizeof(buf), "%.5f}", median/(1000.0*r.audio_s));
+        res += buf;
+    } else {
+        res += "null}";
+    }
+
+    return res;
+}
+
+// medians of a file written by -o, by key
+static bool load_baseline(const std::string & fname, std::map<std::string, double> & medians, double & audio_s) {
+    std::ifstream fin(fname);
+    if (!fin) {
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(fin, line)) {
+        if (line.rfind("\"audio_s\": ", 0) == 0) {
+            audio_s = std::stod(line.substr(11));
+            continue;
+        }
+
+        const size_t k = line.find("\"key\": \"");
+        const size_t m = line.find("\"median_ms\": ");
+        if (k == std::string::npos || m == std::string::npos) {
+            continue;
+        }
+        const size_t k0 = k + 8;
+        const size_t k1 = line.find('"', k0);
+        medians[line.substr(k0, k1 - k0)] = std::stod(line.substr(m + 13));
+    }
+
+    return true;
+}
+
+class bench_runner {
+public:
+    bench_runner(whisper_context * ctx, whisper_state * state, const bench_params & params, const std::vector<float> & pcmf32)
+        : m_ctx(ctx), m_state(state), m_params(params), m_pcmf32(pcmf32) {}
+
+    // run f once to warm up, then n_reps times
+    template <typename F>
+    bool measure(bench_result & r, F && f) {
+        for (int i = 0; i <= m_params.n_reps; ++i) {
+            const int64_t t_start_us = ggml_time_us();
+            if (!f()) {
+                fprintf(stderr, "%s: stage '%s' failed\n", __func__, r.key().c_str());
+                return false;
+            }
+            if (i > 0) {
+                r.samples_ms.push_back((ggml_time_us() - t_start_us)/1000.0);
+            }
+        }
+        return true;
+    }
+
+    bool mel(int n_threads, bench_result & r) {
+        r.audio_s = (double) m_pcmf32.size()/WHISPER_SAMPLE_RATE;
+        return measure(r, [&] {
+            return whisper_pcm_to_mel_with_state(m_ctx, m_state, m_pcmf32.data(), m_pcmf32.size(), n_threads) == 0;
+        });
+    }
+
+    // the encoder context is taken from the last whisper_full() call - select_audio_ctx() sets it
+    bool encode(int n_threads, bench_result & r) {
+        if (whisper_pcm_to_mel_with_state(m_ctx, m_state, m_pcmf32.data(), m_pcmf32.size(), n_threads) != 0) {
+            return false;
+        }
+        const int n_ctx = r.audio_ctx > 0 ? r.audio_ctx : whisper_model_n_audio_ctx(m_ctx);
+        r.audio_s = 2.0*n_ctx*WHISPER_HOP_LENGTH/WHISPER_SAMPLE_RATE;
+        return measure(r, [&] {
+            return whisper_encode_with_state(m_ctx, m_state, 0, n_threads) == 0;
+        });
+    }
+
+    // one decoder call per token, with a growing KV cache
+    bool decode(int n_threads, bench_result & r) {
+        r.n_tokens = m_params.n_decode;
+        const whisper_token token = whisper_token_sot(m_ctx);
+        return measure(r, [&] {
+            for (int i = 0; i < m_params.n_decode; ++i) {
+                if (whisper_decode_with_state(m_ctx, m_state, &token, 1, i, n_threads) != 0) {
+                    return false;
+                }
+            }
+            return true;
+        });
+    }
+
+    // a single decoder call over n_batch tokens, as for a prompt
+    bool batch(int n_threads, bench_result & r) {
+        r.n_tokens = m_params.n_batch;
+        const std::vector<whisper_token> tokens(m_params.n_batch, whisper_token_sot(m_ctx));
+        return measure(r, [&] {
+            return whisper_decode_with_state(m_ctx, m_state, tokens.data(), tokens.size(), 0, n_threads) == 0;
+        });
+    }
+
+    bool full(int n_threads, bool beam, bench_result & r) {
+        whisper_full_params wparams = full_params(n_threads, beam);
+        r.audio_s = (double) m_pcmf32.size()/WHISPER_SAMPLE_RATE;
+        return measure(r, [&] {
+            return whisper_full_with_state(m_ctx, m_state, wparams, m_pcmf32.data(), m_pcmf32.size()) == 0;
+        });
+    }
+
+    // the state keeps the audio_ctx of the last whisper_full() call - the warm-up makes one with audio_ctx
+    bool select_audio_ctx(int audio_ctx, int n_threads) {
+        whisper_full_params wparams = full_params(n_threads, false);
+        wparams.audio_ctx = audio_ctx;
+        return whisper_warmup(m_ctx, m_state, wparams) == 0;
+    }
+
+private:
+    whisper_full_params full_params(int n_threads, bool beam) const {
+        whisper_full_params wparams = whisper_full_default_params(beam ? WHISPER_SAMPLING_BEAM_SEARCH : WHISPER_SAMPLING_GREEDY);
+        wparams.n_threads        = n_threads;
+        wparams.language         = "en";
+        wparams.print_progress   = false;
+        wparams.print_realtime   = false;
+        wparams.print_timestamps = false;
+        wparams.no_context       = true;
+        // the same amount of work on every run
+        wparams.temperature_inc  = 0.0f;
+        if (beam) {
+            wparams.beam_search.beam_size = m_params.beam_size;
+        }
+        return wparams;
+    }
+
+    whisper_context * m_ctx;
+    whisper_state   * m_state;
+
+    const bench_params       & m_params;
+    const std::vector<float> & m_pcmf32;
+};
+
+int main(int argc, char ** argv) {
+    bench_params params;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+
+        if (arg == "-m" && i + 1 < argc) {
+            params.model = argv[++i];
+        } else if (arg == "-f" && i + 1 < argc) {
+            params.fname_inp = argv[++i];
+        } else if (arg == "-t" && i + 1 < argc) {
+            params.threads = parse_list<int>(argv[++i]);
+        } else if (arg == "-r" && i + 1 < argc) {
+            params.n_reps = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "-s" && i + 1 < argc) {
+            params.stages = parse_list<std::string>(argv[++i]);
+        } else if (arg == "--audio-ctx" && i + 1 < argc) {
+            params.audio_ctx = parse_list<int>(argv[++i]);
+        } else if (arg == "--duration" && i + 1 < argc) {
+            params.duration_s = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--decode" && i + 1 < argc) {
+            params.n_decode = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--batch" && i + 1 < argc) {
+            params.n_batch = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--beam-size" && i + 1 < argc) {
+            params.beam_size = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "-o" && i + 1 < argc) {
+            params.fname_out = argv[++i];
+        } else if (arg == "--compare" && i + 1 < argc) {
+            params.fname_base = argv[++i];
+        } else if (arg == "--threshold" && i + 1 < argc) {
+            params.threshold = std::stof(argv[++i])/100.0f;
+        } else if (arg == "-h" || arg == "--help") {
+            print_usage(argv[0]);
+            return 0;
+        } else {
+            fprintf(stderr, "%s: unknown argument '%s'\n", __func__, arg.c_str());
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (params.model.empty() || params.threads.empty()) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    std::map<std::string, double> baseline;
+    double baseline_audio_s = 0.0;
+    if (!params.fname_base.empty() && !load_baseline(params.fname_base, baseline, baseline_audio_s)) {
+        fprintf(stderr, "%s: failed to read the baseline '%s'\n", __func__, params.fname_base.c_str());
+        return 1;
+    }
+
+    auto has_stage = [&](const char * stage) {
+        return std::find(params.stages.begin(), params.stages.end(), stage) != params.stages.end();
+    };
+
+    std::vector<float> pcmf32;
+    if (params.fname_inp.empty()) {
+        pcmf32 = synth_audio(params.duration_s);
+    } else {
+        std::vector<std::vector<float>> pcmf32s;
+        if (!read_audio_data(params.fname_inp, pcmf32, pcmf32s, false)) {
+            fprintf(stderr, "%s: failed to read '%s'\n", __func__, params.fname_inp.c_str());
+            return 2;
+        }
+    }
+
+    whisper_context_params cparams = whisper_context_default_params();
+
+    whisper_context * ctx = whisper_init_from_file_with_params_no_state(params.model.c_str(), cparams);
+    if (!ctx) {
+        fprintf(stderr, "%s: failed to load '%s'\n", __func__, params.model.c_str());
+        return 2;
+    }
+
+    whisper_state * state = whisper_init_state(ctx);
+    if (!state) {
+        whisper_free(ctx);
+        return 2;
+    }
+
+    fprintf(stderr, "%s: %s\n", __func__, whisper_print_system_info());
+
+    bench_runner runner(ctx, state, params, pcmf32);
+
+    std::vector<bench_result> results;
+
+    bool ok = true;
+
+    auto run = [&](const char * stage, int n_threads, int audio_ctx, auto && f) {
+        if (!ok) {
+            return;
+        }
+
+        bench_result r;
+        r.stage     = stage;
+        r.threads   = n_threads;
+        r.audio_ctx = audio_ctx;
+
+        ok = f(r);
+        if (ok) {
+            fprintf(stderr, "main: %-24s median %10.3f ms\n", r.key().c_str(), percentile(r.samples_ms, 0.5));
+            results.push_back(std::move(r));
+        }
+    };
+
+    // the encoder context changes the graphs, so the stages that depend on it come first
+    for (int audio_ctx : has_stage("encode") ? params.audio_ctx : std::vector<int>()) {
+        if (!runner.select_audio_ctx(audio_ctx, params.threads[0])) {
+            ok = false;
+            break;
+        }
+        for (int n_threads : params.threads) {
+            run("encode", n_threads, audio_ctx, [&](bench_result & r) { return runner.encode(n_threads, r); });
+        }
+    }
+
+    if (ok && !runner.select_audio_ctx(0, params.threads[0])) {
+        ok = false;
+    }
+
+    for (int n_threads : params.threads) {
+        if (has_stage("mel")) {
+            run("mel", n_threads, 0, [&](bench_result & r) { return runner.mel(n_threads, r); });
+        }
+        if (has_stage("decode") || has_stage("batch")) {
+            // the decoder attends to the output of the last encoder run
+            ok = ok && whisper_pcm_to_mel_with_state(ctx, state, pcmf32.data(), pcmf32.size(), n_threads) == 0 &&
+                       whisper_encode_with_state(ctx, state, 0, n_threads) == 0;
+        }
+        if (has_stage("decode")) {
+            run("decode", n_threads, 0, [&](bench_result & r) { return runner.decode(n_threads, r); });
+        }
+        if (has_stage("batch")) {
+            run("batch", n_threads, 0, [&](bench_result & r) { return runner.batch(n_threads, r); });
+        }
+        if (has_stage("beam")) {
+            run("beam", n_threads, 0, [&](bench_result & r) { return runner.full(n_threads, true, r); });
+        }
+        if (has_stage("full")) {
+            run("full", n_threads, 0, [&](bench_result & r) { return runner.full(n_threads, false, r); });
+        }
+    }
+
+    whisper_free_state(state);
+    whisper_free(ctx);
+
+    if (!ok) {
+        return 3;
+    }
+
+    // one result per line, so the compare mode and line-based tools can read it back
+    {
+        FILE * fout = params.fname_out.empty() ? stdout : fopen(params.fname_out.c_str(), "w");
+        if (!fout) {
+            fprintf(stderr, "%s: failed to open '%s'\n", __func__, params.fname_out.c_str());
+            return 1;
+        }
+
+        fprintf(fout, "{\n");
+        fprintf(fout, "\"model\": \"%s\",\n", params.model.c_str());
+        fprintf(fout, "\"audio\": \"%s\",\n", params.fname_inp.empty() ? "synthetic" : params.fname_inp.c_str());
+        fprintf(fout, "\"audio_s\": %.3f,\n", (double) pcmf32.size()/WHISPER_SAMPLE_RATE);
+        fprintf(fout, "\"n_reps\": %d,\n", params.n_reps);
+        fprintf(fout, "\"results\": [\n");
+        for (size_t i = 0; i < results.size(); ++i) {
+            fprintf(fout, "%s%s\n", result_json(results[i]).c_str(), i + 1 < results.size() ? "," : "");
+        }
+        fprintf(fout, "]\n");
+        fprintf(fout, "}\n");
+
+        if (fout != stdout) {
+            fclose(fout);
+        }
+    }
+
+    if (params.fname_base.empty()) {
+        return 0;
+    }
+
+    if (std::abs(baseline_audio_s - (double) pcmf32.size()/WHISPER_SAMPLE_RATE) > 1e-3) {
+        fprintf(stderr, "%s: warning: the baseline was measured on %.3f s of audio, this run on %.3f s\n", __func__,
+                baseline_audio_s, (double) pcmf32.size()/WHISPER_SAMPLE_RATE);
+    }
+
+    int n_regressions = 0;
+
+    fprintf(stderr, "\n%-24s %12s %12s %9s\n", "stage", "base ms", "median ms", "change");
+    for (const auto & r : results) {
+        const auto it = baseline.find(r.key());
+        if (it == baseline.end()) {
+            fprintf(stderr, "%-24s %12s %12.3f %9s\n", r.key().c_str(), "-", percentile(r.samples_ms, 0.5), "new");
+            continue;
+        }
+
+        const double median = percentile(r.samples_ms, 0.5);
+        const double change = it->second > 0.0 ? median/it->second - 1.0 : 0.0;
+        const bool   slower = change > params.threshold;
+
+        n_regressions += slower;
+
+        fprintf(stderr, "%-24s %12.3f %12.3f %+8.1f%%%s\n", r.key().c_str(), it->second, median, 100.0*change, slower ? "  REGRESSION" : "");
+    }
+
+    fprintf(stderr, "\n%s: %d regression(s) above %.0f%%\n", __func__, n_regressions, 100.0*params.threshold);
+
+    return n_regressions > 0 ? 1 : 0;
+}
@@ -0,0 +1,245 @@
+// Benchmark of the transcript merge of stream.wasm over a long simulated session
+//
+// usage: wstream-bench-merge [options]
+//
+// simulates the segments of a live session: a synthetic speaker talks at a fixed rate, every step transcribes the last
+// window of audio, and the segment of each window overlaps the previous one. the first and last words of a segment
+// are sometimes wrong, like words cut by the window edges, and some words carry punctuation. every segment is merged
+// with HyniMerge::mergeStrings, which re-splits the whole transcript, and with HyniIncrementalMerge:
+//
+//   wstream-bench-merge --minutes 60 -o merge.json
+//
+// the time per merge is reported for every 10 minutes of the session, with the number of words where the two
+// transcripts differ at the end. the session is seeded, so two runs merge the same segments
+//
+#include "hyni_merge.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+struct merge_params {
+    std::string fname_out; // stdout if empty
+
+    int minutes   = 60;
+    int wpm       = 150;   // words per minute of the speaker
+    int step_ms   = 3000;
+    int length_ms = 5000;  // audio of each window
+    int window    = 256;   // words indexed by HyniIncrementalMerge
+    int n_vocab   = 5000;
+    int seed      = 42;
+
+    float p_edge  = 0.2f;  // probability of a wrong first or last word
+    float p_punct = 0.1f;  // probability of punctuation after a word
+
+    bool legacy = true;    // also run mergeStrings
+};
+
+static void print_usage(const char * argv0) {
+    const merge_params def;
+
+    fprintf(stderr, "usage: %s [options]\n", argv0);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "options:\n");
+    fprintf(stderr, "  --minutes N         length of the session (default: %d)\n", def.minutes);
+    fprintf(stderr, "  --wpm N             words per minute (default: %d)\n", def.wpm);
+    fprintf(stderr, "  --step N            step in ms (default: %d)\n", def.step_ms);
+    fprintf(stderr, "  --length N          window length in ms (default: %d)\n", def.length_ms);
+    fprintf(stderr, "  --window N          words indexed by the incremental merge (default: %d)\n", def.window);
+    fprintf(stderr, "  --vocab N           distinct words of the speaker (default: %d)\n", def.n_vocab);
+    fprintf(stderr, "  --seed N            seed of the session (default: %d)\n", def.seed);
+    fprintf(stderr, "  --no-legacy         do not run mergeStrings\n");
+    fprintf(stderr, "  -o FNAME            write the results to a file instead of stdout\n");
+}
+
+// zipf-like vocabulary, so that common trigrams repeat over the session like in speech
+struct merge_speaker {
+    std::vector<std::string> vocab;
+    std::vector<double> cdf;
+
+    std::mt19937 rng;
+
+    merge_speaker(int n_vocab, int seed) : rng(seed) {
+        static const char * syllables[] = { "ka", "lo", "mi", "ten", "ra", "su", "vo", "ne", "di", "por", "an", "el", "us", "ith", "ble" };
+        const int n_syl = sizeof(syllables)/sizeof(syllables[0]);
+
+        double sum = 0.0;
+        for (int i = 0; i < n_vocab; ++i) {
+            std::string w;
+            for (int j = i; ; j /= n_syl) {
+                w += syllables[j % n_syl];
+                if (j < n_syl) {
+                    break;
+                }
+            }
+            vocab.push_back(w);
+
+            sum += 1.0/(i + 1);
+            cdf.push_back(sum);
+        }
+        for (auto & c : cdf) {
+            c /= sum;
+        }
+    }
+
+    const std::string & word() {
+        const double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+        return vocab[std::min(vocab.size() - 1, (size_t) (std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin()))];
+    }
+};
+
+struct merge_bucket {
+    int    n_merges = 0;
+    int    n_words  = 0; // at the end of the bucket
+    double t_legacy_us = 0.0;
+    double t_incr_us   = 0.0;
+};
+
+int main(int argc, char ** argv) {
+    merge_params params;
+
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+
+        if (arg == "--minutes" && i + 1 < argc) {
+            params.minutes = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--wpm" && i + 1 < argc) {
+            params.wpm = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--step" && i + 1 < argc) {
+            params.step_ms = std::max(100, std::stoi(argv[++i]));
+        } else if (arg == "--length" && i + 1 < argc) {
+            params.length_ms = std::max(100, std::stoi(argv[++i]));
+        } else if (arg == "--window" && i + 1 < argc) {
+            params.window = std::max(3, std::stoi(argv[++i]));
+        } else if (arg == "--vocab" && i + 1 < argc) {
+            params.n_vocab = std::max(10, std::stoi(argv[++i]));
+        } else if (arg == "--seed" && i + 1 < argc) {
+            params.seed = std::stoi(argv[++i]);
+        } else if (arg == "--no-legacy") {
+            params.legacy = false;
+        } else if (arg == "-o" && i + 1 < argc) {
+            params.fname_out = argv[++i];
+        } else if (arg == "-h" || arg == "--help") {
+            print_usage(argv[0]);
+            return 0;
+        } else {
+            fprintf(stderr, "%s: unknown argument '%s'\n", __func__, arg.c_str());
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    merge_speaker speaker(params.n_vocab, params.seed);
+
+    // what was said, with punctuation
+    const size_t n_spoken = (size_t) params.minutes*params.wpm;
+    std::vector<std::string> spoken;
+    spoken.reserve(n_spoken);
+
+    std::uniform_real_distribution<float> u01(0.0f, 1.0f);
+
+    for (size_t i = 0; i < n_spoken; ++i) {
+        std::string w = speaker.word();
+        if (u01(speaker.rng) < params.p_punct) {
+            w += u01(speaker.rng) < 0.5f ? "," : ".";
+        }
+        spoken.push_back(w);
+    }
+
+    const double words_per_ms = params.wpm/60000.0;
+    const int64_t t_session_ms = (int64_t) params.minutes*60000;
+
+    std::string legacy;
+    hyni::HyniIncrementalMerge incremental(params.window);
+
+    const int64_t bucket_ms = 10*60000;
+    std::vector<merge_bucket> buckets((t_session_ms + bucket_ms - 1)/bucket_ms);
+
+    for (int64_t t_ms = params.step_ms; t_ms <= t_session_ms; t_ms += params.step_ms) {
+        const size_t end   = std::min(n_spoken, (size_t) (t_ms*words_per_ms));
+        const size_t begin = (size_t) std::max<int64_t>(0, (int64_t) ((t_ms - params.length_ms)*words_per_ms));
+        if (end <= begin) {
+            continue;
+        }
+
+        std::string segment;
+        for (size_t i = begin; i < end; ++i) {
+            const bool edge = i == begin || i + 1 == end;
+            segment += ' ';
+            segment += edge && u01(speaker.rng) < params.p_edge ? speaker.word() : spoken[i];
+        }
+
+        auto & bucket = buckets[std::min(buckets.size() - 1, (size_t) ((t_ms - 1)/bucket_ms))];
+
+        if (params.legacy) {
+            const auto t0 = std::chrono::steady_clock::now();
+            legacy = hyni::HyniMerge::mergeStrings(legacy, segment);
+            bucket.t_legacy_us += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+        }
+
+        {
+            const auto t0 = std::chrono::steady_clock::now();
+            incremental.append(segment);
+            bucket.t_incr_us += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+        }
+
+        bucket.n_merges++;
+        bucket.n_words = (int) incremental.size();
+    }
+
+    // words where the two transcripts differ, position by position
+    int n_diff = 0;
+    int n_legacy_words = 0;
+    if (params.legacy) {
+        const std::vector<std::string> words = hyni::HyniMerge::splitAndNormalize(legacy);
+        n_legacy_words = (int) words.size();
+
+        const size_t n = std::min(words.size(), incremental.size());
+        for (size_t i = 0; i < n; ++i) {
+            n_diff += words[i] != incremental.word(i);
+        }
+        n_diff += (int) (std::max(words.size(), incremental.size()) - n);
+    }
+
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        const auto & b = buckets[i];
+        fprintf(stderr, "%s: %3d-%3d min: %5d words, merge %8.2f us legacy, %6.2f us incremental\n", __func__,
+                (int) i*10, std::min(params.minutes, (int) (i + 1)*10), b.n_words,
+                b.n_merges > 0 ? b.t_legacy_us/b.n_merges : 0.0, b.n_merges > 0 ? b.t_incr_us/b.n_merges : 0.0);
+    }
+
+    FILE * fout = params.fname_out.empty() ? stdout : fopen(params.fname_out.c_str(), "w");
+    if (!fout) {
+        fprintf(stderr, "%s: failed to open '%s'\n", __func__, params.fname_out.c_str());
+        return 1;
+    }
+
+    fprintf(fout, "{\n");
+    fprintf(fout, "\"minutes\": %d,\n", params.minutes);
+    fprintf(fout, "\"wpm\": %d,\n", params.wpm);
+    fprintf(fout, "\"step_ms\": %d,\n", params.step_ms);
+    fprintf(fout, "\"length_ms\": %d,\n", params.length_ms);
+    fprintf(fout, "\"window\": %d,\n", params.window);
+    fprintf(fout, "\"words\": %d,\n", (int) incremental.size());
+    fprintf(fout, "\"legacy_words\": %d,\n", n_legacy_words);
+    fprintf(fout, "\"words_diff\": %d,\n", n_diff);
+    fprintf(fout, "\"buckets\": [\n");
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        const auto & b = buckets[i];
+        fprintf(fout, "{\"minute\": %d, \"merges\": %d, \"words\": %d, \"legacy_us\": %.3f, \"incremental_us\": %.3f}%s\n",
+                std::min(params.minutes, (int) (i + 1)*10), b.n_merges, b.n_words,
+                b.n_merges > 0 ? b.t_legacy_us/b.n_merges : 0.0, b.n_merges > 0 ? b.t_incr_us/b.n_merges : 0.0,
+                i + 1 < buckets.size() ? "," : "");
+    }
+    fprintf(fout, "]\n");
+    fprintf(fout, "}\n");
+
+    if (fout != stdout) {
+        fclose(fout);
+    }
+
+    return 0;
+}
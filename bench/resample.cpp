@@ -0,0 +1,310 @@
+// Quality check of the streaming resampler of wstream (common-resample.h)
+//
+// usage: wstream-bench-resample [options]
+//
+// resamples sine references at every input rate to WHISPER_SAMPLE_RATE and checks:
+//
+//   passband   tones below 3/4 of the lower Nyquist frequency match the ideal delayed sine with at least --min-snr dB
+//   stopband   tones above the output Nyquist frequency (decimation) or their images above the input Nyquist
+//              frequency (interpolation) are attenuated by at least --min-atten dB
+//   chunked    the input fed in random chunks gives bit-identical output to a single call
+//
+// with the throughput in 20 ms chunks:
+//
+//   wstream-bench-resample -r 8000 -r 44100 -r 48000 -o resample.json
+//
+// exits with 1 if a check fails
+//
+#define _USE_MATH_DEFINES // for M_PI
+
+#include "common-resample.h"
+
+#include "whisper.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+struct resample_params {
+    std::string fname_out; // stdout if empty
+
+    std::vector<int> rates;
+
+    double min_snr   = 70.0; // dB
+    double min_atten = 70.0; // dB
+
+    int seed = 42;
+};
+
+static void print_usage(const char * argv0) {
+    const resample_params def;
+
+    fprintf(stderr, "usage: %s [options]\n", argv0);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "options:\n");
+    fprintf(stderr, "  -r RATE             input rate, can be repeated (default: 8000, 44100, 48000)\n");
+    fprintf(stderr, "  --min-snr N         passband SNR in dB (default: %.0f)\n", def.min_snr);
+    fprintf(stderr, "  --min-atten N       stopband attenuation in dB (default: %.0f)\n", def.min_atten);
+    fprintf(stderr, "  --seed N            seed of the chunk sizes (default: %d)\n", def.seed);
+    fprintf(stderr, "  -o FNAME            write the results to a file instead of stdout\n");
+}
+
+struct resample_result {
+    int    rate = 0;
+    double latency_ms = 0.0;
+
+    double snr_min   = INFINITY; // dB, over the passband tones
+    double atten_min = INFINITY; // dB, over the stopband tones
+
+    size_t n_diff = 0; // chunked vs single call, including the difference in length
+
+    double speed = 0.0; // x real time
+
+    bool ok = false;
+};
+
+static std::vector<float> resample_sine(pcm_resampler & rs, double f, double seconds) {
+    const int n = (int) (rs.rate_in()*seconds);
+
+    std::vector<float> x(n);
+    for (int i = 0; i < n; ++i) {
+        x[i] = 0.5f*std::sin(2.0*M_PI*f*i/rs.rate_in());
+    }
+
+    std::vector<float> y;
+    rs.reset();
+    rs.process(x.data(), x.size(), y);
+
+    return y;
+}
+
+// amplitude of the frequency f in the middle half of y, with a Hann window so distant tones do not leak
+static double resample_amplitude(const std::vector<float> & y, double f, int rate) {
+    const size_t i0 = y.size()/4;
+    const size_t n  = y.size()/2;
+
+    double re = 0.0;
+    double im = 0.0;
+    double wsum = 0.0;
+
+    for (size_t i = 0; i < n; ++i) {
+        const double w = 0.5 - 0.5*std::cos(2.0*M_PI*i/(n - 1));
+        const double a = 2.0*M_PI*f*(i0 + i)/rate;
+
+        re += w*y[i0 + i]*std::cos(a);
+        im += w*y[i0 + i]*std::sin(a);
+        wsum += w;
+    }
+
+    return 2.0*std::sqrt(re*re + im*im)/wsum;
+}
+
+static resample_result resample_check(int rate, const resample_params & params) {
+    resample_result res;
+    res.rate = rate;
+
+    pcm_resampler rs;
+    if (!rs.init(rate, WHISPER_SAMPLE_RATE)) {
+        fprintf(stderr, "%s: invalid rate %d\n", __func__, rate);
+        return res;
+    }
+
+    const double latency = rs.latency()/rate; // seconds
+    res.latency_ms = 1000.0*latency;
+
+    const double nyquist_in  = 0.5*rate;
+    const double nyquist_out = 0.5*WHISPER_SAMPLE_RATE;
+    const double nyquist_min = std::min(nyquist_in, nyquist_out);
+
+    // passband - against the ideal sine, delayed by the latency of the filter
+    for (double r : { 0.05, 0.125, 0.25, 0.5, 0.75 }) {
+        const double f = r*nyquist_min;
+        const std::vector<float> y = resample_sine(rs, f, 2.0);
+
+        double se = 0.0;
+        double ss = 0.0;
+        for (size_t j = y.size()/4; j < 3*y.size()/4; ++j) {
+            const double ref = 0.5*std::sin(2.0*M_PI*f*((double) j/WHISPER_SAMPLE_RATE - latency));
+            se += (y[j] - ref)*(y[j] - ref);
+            ss += ref*ref;
+        }
+
+        const double snr = 10.0*std::log10(ss/std::max(se, 1e-30));
+        fprintf(stderr, "%s: %6d Hz: tone %7.1f Hz, snr %6.1f dB\n", __func__, rate, f, snr);
+
+        res.snr_min = std::min(res.snr_min, snr);
+    }
+
+    // stopband
+    if (rate > WHISPER_SAMPLE_RATE) {
+        // tones above the output Nyquist frequency must not alias into the output
+        for (double r : { 1.075, 1.25, 1.5, 0.95*nyquist_in/nyquist_out }) {
+            const double f = r*nyquist_out;
+            if (f >= nyquist_in) {
+                continue;
+            }
+
+            const std::vector<float> y = resample_sine(rs, f, 2.0);
+
+            double s = 0.0;
+            for (size_t j = y.size()/4; j < 3*y.size()/4; ++j) {
+                s += y[j]*y[j];
+            }
+            s /= y.size()/2;
+
+            const double atten = -10.0*std::log10(std::max(s, 1e-30)/0.125);
+            fprintf(stderr, "%s: %6d Hz: tone %7.1f Hz, attenuated by %6.1f dB\n", __func__, rate, f, atten);
+
+            res.atten_min = std::min(res.atten_min, atten);
+        }
+    } else if (rate < WHISPER_SAMPLE_RATE) {
+        // the images of the passband tones above the input Nyquist frequency must be removed
+        for (double r : { 0.125, 0.5, 0.75 }) {
+            const double f = r*nyquist_in;
+            const double f_image = rate - f;
+
+            const std::vector<float> y = resample_sine(rs, f, 2.0);
+
+            const double atten = 20.0*std::log10(0.5/std::max(resample_amplitude(y, f_image, WHISPER_SAMPLE_RATE), 1e-30));
+            fprintf(stderr, "%s: %6d Hz: image %7.1f Hz, attenuated by %6.1f dB\n", __func__, rate, f_image, atten);
+
+            res.atten_min = std::min(res.atten_min, atten);
+        }
+    }
+
+    // chunked vs single call, on noise so that every phase and tap contributes
+    std::vector<float> x(3*rate);
+    {
+        std::mt19937 rng(params.seed);
+        std::normal_distribution<float> nd(0.0f, 0.3f);
+        for (auto & v : x) {
+            v = nd(rng);
+        }
+
+        std::vector<float> y_single;
+        rs.reset();
+        rs.process(x.data(), x.size(), y_single);
+
+        std::vector<float> y_chunked;
+        rs.reset();
+
+        std::uniform_int_distribution<int> chunk(1, 2000);
+        for (size_t i = 0; i < x.size(); ) {
+            const size_t n = std::min<size_t>(chunk(rng), x.size() - i);
+            rs.process(x.data() + i, n, y_chunked);
+            i += n;
+        }
+
+        const size_t n = std::min(y_single.size(), y_chunked.size());
+        for (size_t i = 0; i < n; ++i) {
+            res.n_diff += memcmp(&y_single[i], &y_chunked[i], sizeof(float)) != 0;
+        }
+        res.n_diff += std::max(y_single.size(), y_chunked.size()) - n;
+
+        fprintf(stderr, "%s: %6d Hz: chunked %zu samples, single %zu samples, %zu differ\n", __func__, rate,
+                y_chunked.size(), y_single.size(), res.n_diff);
+    }
+
+    // throughput in 20 ms chunks, like the websocket frames
+    {
+        const int n_chunk = rate/50;
+        const int n_iter  = 3000;
+
+        std::vector<float> y;
+        y.reserve(WHISPER_SAMPLE_RATE);
+
+        rs.reset();
+
+        const auto t0 = std::chrono::steady_clock::now();
+        for (int it = 0; it < n_iter; ++it) {
+            y.clear();
+            rs.process(x.data() + (it % 100)*n_chunk, n_chunk, y);
+        }
+        const double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+        res.speed = 0.02*n_iter/sec;
+    }
+
+    res.ok = res.snr_min >= params.min_snr && res.atten_min >= params.min_atten && res.n_diff == 0;
+
+    return res;
+}
+
+int main(int argc, char ** argv) {
+    resample_params params;
+
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+
+        if (arg == "-r" && i + 1 < argc) {
+            params.rates.push_back(std::stoi(argv[++i]));
+        } else if (arg == "--min-snr" && i + 1 < argc) {
+            params.min_snr = std::stod(argv[++i]);
+        } else if (arg == "--min-atten" && i + 1 < argc) {
+            params.min_atten = std::stod(argv[++i]);
+        } else if (arg == "--seed" && i + 1 < argc) {
+            params.seed = std::stoi(argv[++i]);
+        } else if (arg == "-o" && i + 1 < argc) {
+            params.fname_out = argv[++i];
+        } else if (arg == "-h" || arg == "--help") {
+            print_usage(argv[0]);
+            return 0;
+        } else {
+            fprintf(stderr, "%s: unknown argument '%s'\n", __func__, arg.c_str());
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (params.rates.empty()) {
+        params.rates = { 8000, 44100, 48000 };
+    }
+
+    std::vector<resample_result> results;
+    for (int rate : params.rates) {
+        results.push_back(resample_check(rate, params));
+    }
+
+    bool ok = true;
+    for (const auto & r : results) {
+        fprintf(stderr, "%s: %6d Hz: snr %6.1f dB, stopband %6.1f dB, %zu chunked samples differ, %.0fx real time - %s\n",
+                __func__, r.rate, r.snr_min, r.atten_min, r.n_diff, r.speed, r.ok ? "ok" : "FAILED");
+        ok = ok && r.ok;
+    }
+
+    FILE * fout = params.fname_out.empty() ? stdout : fopen(params.fname_out.c_str(), "w");
+    if (!fout) {
+        fprintf(stderr, "%s: failed to open '%s'\n", __func__, params.fname_out.c_str());
+        return 1;
+    }
+
+    fprintf(fout, "{\n");
+    fprintf(fout, "\"min_snr\": %.1f,\n", params.min_snr);
+    fprintf(fout, "\"min_atten\": %.1f,\n", params.min_atten);
+    fprintf(fout, "\"results\": [\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto & r = results[i];
+        // no stopband without a rate change
+        char atten[32] = "null";
+        if (!std::isinf(r.atten_min)) {
+            snprintf(atten, sizeof(atten), "%.1f", r.atten_min);
+        }
+
+        fprintf(fout, "{\"rate\": %d, \"latency_ms\": %.3f, \"snr_db\": %.1f, \"stopband_db\": %s, \"chunked_diff\": %zu, \"speed\": %.0f, \"ok\": %s}%s\n",
+                r.rate, r.latency_ms, r.snr_min, atten, r.n_diff, r.speed,
+                r.ok ? "true" : "false", i + 1 < results.size() ? "," : "");
+    }
+    fprintf(fout, "]\n");
+    fprintf(fout, "}\n");
+
+    if (fout != stdout) {
+        fclose(fout);
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,344 @@
+#include "common-gguf.h"
+
+#include "whisper-arch.h"
+
+#include "ggml-cpp.h"
+#include "gguf.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+template<typename T>
+static bool read_val(std::ifstream & fin, T & dest) {
+    return (bool) fin.read((char *) &dest, sizeof(T));
+}
+
+static bool whisper_model_file_read_legacy(std::ifstream & fin, whisper_model_file & model) {
+    // hparams
+    {
+        read_val(fin, model.n_vocab);
+        read_val(fin, model.n_audio_ctx);
+        read_val(fin, model.n_audio_state);
+        read_val(fin, model.n_audio_head);
+        read_val(fin, model.n_audio_layer);
+        read_val(fin, model.n_text_ctx);
+        read_val(fin, model.n_text_state);
+        read_val(fin, model.n_text_head);
+        read_val(fin, model.n_text_layer);
+        read_val(fin, model.n_mels);
+        read_val(fin, model.ftype);
+    }
+
+    // mel filters
+    {
+        read_val(fin, model.n_mel);
+        read_val(fin, model.n_fft);
+
+        model.filters.resize(model.n_mel * model.n_fft);
+        fin.read((char *) model.filters.data(), model.filters.size() * sizeof(float));
+    }
+
+    // vocab
+    {
+        int32_t n_vocab = 0;
+        read_val(fin, n_vocab);
+
+        model.vocab.resize(n_vocab);
+
+        for (int i = 0; i < n_vocab; i++) {
+            uint32_t len = 0;
+            read_val(fin, len);
+
+            model.vocab[i].resize(len);
+            fin.read(&model.vocab[i][0], len);
+        }
+    }
+
+    if (!fin) {
+        fprintf(stderr, "%s: failed to read the model header\n", __func__);
+        return false;
+    }
+
+    // tensors
+    while (true) {
+        int32_t n_dims;
+        int32_t length;
+        int32_t ttype;
+
+        read_val(fin, n_dims);
+        read_val(fin, length);
+        read_val(fin, ttype);
+
+        if (fin.eof()) {
+            break;
+        }
+
+        if (n_dims < 1 || n_dims > 4 || length <= 0 || ttype < 0 || ttype >= GGML_TYPE_COUNT) {
+            fprintf(stderr, "%s: invalid tensor header (n_dims = %d, length = %d, ttype = %d)\n", __func__, n_dims, length, ttype);
+            return false;
+        }
+
+        whisper_model_file::tensor t;
+
+        t.type   = (ggml_type) ttype;
+        t.n_dims = n_dims;
+
+        for (int i = 0; i < n_dims; ++i) {
+            int32_t ne = 1;
+            read_val(fin, ne);
+            t.ne[i] = ne;
+        }
+
+        t.name.resize(length);
+        fin.read(&t.name[0], length);
+
+        t.data.resize((t.nelements()*ggml_type_size(t.type))/ggml_blck_size(t.type));
+        fin.read((char *) t.data.data(), t.data.size());
+
+        if (!fin) {
+            fprintf(stderr, "%s: failed to read tensor '%s'\n", __func__, t.name.c_str());
+            return false;
+        }
+
+        model.tensors.push_back(std::move(t));
+    }
+
+    return true;
+}
+
+static bool whisper_model_file_read_gguf(const std::string & fname, whisper_model_file & model) {
+    ggml_context * ctx_data = nullptr;
+
+    gguf_init_params params = {
+        /*.no_alloc =*/ false,
+        /*.ctx      =*/ &ctx_data,
+    };
+
+    gguf_context_ptr ctx_gguf { gguf_init_from_file(fname.c_str(), params) };
+    if (!ctx_gguf) {
+        fprintf(stderr, "%s: failed to read GGUF file '%s'\n", __func__, fname.c_str());
+        return false;
+    }
+
+    ggml_context_ptr ctx_data_ptr { ctx_data };
+
+    gguf_context * gctx = ctx_gguf.get();
+
+    auto get_key = [&](asr_kv kv, gguf_type type) -> int64_t {
+        const int64_t id = gguf_find_key(gctx, ASR_KV_NAMES.at(kv));
+        if (id < 0 || gguf_get_kv_type(gctx, id) != type) {
+            fprintf(stderr, "%s: key '%s' is missing or has the wrong type\n", __func__, ASR_KV_NAMES.at(kv));
+            return -1;
+        }
+        return id;
+    };
+
+    bool ok = true;
+
+    auto get_i32 = [&](asr_kv kv) -> int32_t {
+        const int64_t id = get_key(kv, GGUF_TYPE_INT32);
+        if (id < 0) {
+            ok = false;
+            return 0;
+        }
+        return gguf_get_val_i32(gctx, id);
+    };
+
+    {
+        const int64_t id = get_key(ASR_KV_GENERAL_ARCHITECTURE, GGUF_TYPE_STRING);
+        if (id < 0 || strcmp(gguf_get_val_str(gctx, id), ASR_ARCH_NAME) != 0) {
+            fprintf(stderr, "%s: '%s' is not a whisper model\n", __func__, fname.c_str());
+            return false;
+        }
+    }
+
+    model.n_vocab       = get_i32(ASR_KV_VOCAB_SIZE);
+    model.n_audio_ctx   = get_i32(ASR_KV_AUDIO_CONTEXT_LENGTH);
+    model.n_audio_state = get_i32(ASR_KV_AUDIO_EMBEDDING_LENGTH);
+    model.n_audio_head  = get_i32(ASR_KV_AUDIO_HEAD_COUNT);
+    model.n_audio_layer = get_i32(ASR_KV_AUDIO_BLOCK_COUNT);
+    model.n_text_ctx    = get_i32(ASR_KV_TEXT_CONTEXT_LENGTH);
+    model.n_text_state  = get_i32(ASR_KV_TEXT_EMBEDDING_LENGTH);
+    model.n_text_head   = get_i32(ASR_KV_TEXT_HEAD_COUNT);
+    model.n_text_layer  = get_i32(ASR_KV_TEXT_BLOCK_COUNT);
+    model.n_mels        = get_i32(ASR_KV_MEL_COUNT);
+    model.ftype         = get_i32(ASR_KV_GENERAL_FILE_TYPE) + get_i32(ASR_KV_GENERAL_QUANTIZATION_VERSION)*GGML_QNT_VERSION_FACTOR;
+
+    model.n_mel = get_i32(ASR_KV_MEL_FILTERS_N_MEL);
+    model.n_fft = get_i32(ASR_KV_MEL_FILTERS_N_FFT);
+
+    if (!ok) {
+        return false;
+    }
+
+    {
+        const int64_t id = get_key(ASR_KV_MEL_FILTERS_DATA, GGUF_TYPE_ARRAY);
+        if (id < 0 || gguf_get_arr_type(gctx, id) != GGUF_TYPE_FLOAT32 || gguf_get_arr_n(gctx, id) != (size_t) model.n_mel*model.n_fft) {
+            fprintf(stderr, "%s: invalid mel filters\n", __func__);
+            return false;
+        }
+
+        const float * data = (const float *) gguf_get_arr_data(gctx, id);
+        model.filters.assign(data, data + gguf_get_arr_n(gctx, id));
+    }
+
+    {
+        const int64_t id_bytes   = get_key(ASR_KV_TOKENIZER_TOKEN_BYTES,   GGUF_TYPE_ARRAY);
+        const int64_t id_lengths = get_key(ASR_KV_TOKENIZER_TOKEN_LENGTHS, GGUF_TYPE_ARRAY);
+        if (id_bytes < 0 || id_lengths < 0 ||
+            gguf_get_arr_type(gctx, id_bytes)   != GGUF_TYPE_UINT8 ||
+            gguf_get_arr_type(gctx, id_lengths) != GGUF_TYPE_UINT32) {
+            fprintf(stderr, "%s: invalid vocab\n", __func__);
+            return false;
+        }
+
+        const char     * bytes   = (const char     *) gguf_get_arr_data(gctx, id_bytes);
+        const uint32_t * lengths = (const uint32_t *) gguf_get_arr_data(gctx, id_lengths);
+
+        const size_t n_bytes = gguf_get_arr_n(gctx, id_bytes);
+
+        model.vocab.resize(gguf_get_arr_n(gctx, id_lengths));
+
+        size_t offs = 0;
+        for (size_t i = 0; i < model.vocab.size(); ++i) {
+            if (offs + lengths[i] > n_bytes) {
+                fprintf(stderr, "%s: vocab data is truncated\n", __func__);
+                return false;
+            }
+            model.vocab[i].assign(bytes + offs, lengths[i]);
+            offs += lengths[i];
+        }
+    }
+
+    for (int64_t i = 0; i < gguf_get_n_kv(gctx); ++i) {
+        const char * key = gguf_get_key(gctx, i);
+        if (gguf_get_kv_type(gctx, i) == GGUF_TYPE_STRING && strcmp(key, ASR_KV_NAMES.at(ASR_KV_GENERAL_ARCHITECTURE)) != 0) {
+            model.kv_str.emplace_back(key, gguf_get_val_str(gctx, i));
+        }
+    }
+
+    for (int64_t i = 0; i < gguf_get_n_tensors(gctx); ++i) {
+        const ggml_tensor * src = ggml_get_tensor(ctx_data, gguf_get_tensor_name(gctx, i));
+
+        whisper_model_file::tensor t;
+
+        t.name   = ggml_get_name(src);
+        t.type   = src->type;
+        t.n_dims = ggml_n_dims(src);
+
+        for (int j = 0; j < 4; ++j) {
+            t.ne[j] = src->ne[j];
+        }
+
+        t.data.resize(ggml_nbytes(src));
+        memcpy(t.data.data(), src->data, t.data.size());
+
+        model.tensors.push_back(std::move(t));
+    }
+
+    return true;
+}
+
+bool whisper_model_file_read(const std::string & fname, whisper_model_file & model) {
+    std::ifstream fin(fname, std::ios::binary);
+    if (!fin) {
+        fprintf(stderr, "%s: failed to open '%s'\n", __func__, fname.c_str());
+        return false;
+    }
+
+    char magic[4] = {};
+    fin.read(magic, sizeof(magic));
+
+    if (memcmp(magic, GGUF_MAGIC, sizeof(magic)) == 0) {
+        fin.close();
+        return whisper_model_file_read_gguf(fname, model);
+    }
+
+    uint32_t magic_u32 = 0;
+    memcpy(&magic_u32, magic, sizeof(magic_u32));
+
+    if (magic_u32 != GGML_FILE_MAGIC) {
+        fprintf(stderr, "%s: invalid model file '%s' (bad magic)\n", __func__, fname.c_str());
+        return false;
+    }
+
+    return whisper_model_file_read_legacy(fin, model);
+}
+
+bool whisper_model_file_write_gguf(const std::string & fname, const whisper_model_file & model) {
+    gguf_context_ptr ctx_gguf { gguf_init_empty() };
+
+    gguf_context * gctx = ctx_gguf.get();
+
+    gguf_set_val_str(gctx, ASR_KV_NAMES.at(ASR_KV_GENERAL_ARCHITECTURE),         ASR_ARCH_NAME);
+    gguf_set_val_i32(gctx, ASR_KV_NAMES.at(ASR_KV_GENERAL_FILE_TYPE),            model.ftype % GGML_QNT_VERSION_FACTOR);
+    gguf_set_val_i32(gctx, ASR_KV_NAMES.at(ASR_KV_GENERAL_QUANTIZATION_VERSION), model.ftype / GGML_QNT_VERSION_FACTOR);
+
+    gguf_set_val_i32(gctx, ASR_KV_NAMES.at(ASR_KV_VOCAB_SIZE),            model.n_vocab);
+    gguf_set_val_i32(gctx, ASR_KV_NAMES.at(ASR_KV_AUDIO_CONTEXT_LENGTH),   model.n_audio_ctx);
+    gguf_set_val_i32(gctx, ASR_KV_NAMES.at(ASR_KV_AUDIO_EMBEDDING_LENGTH), model.n_audio_state);
+    gguf_set_val_i32(gctx, ASR_KV_NAMES.at(ASR_KV_AUDIO_HEAD_COUNT),       model.n_audio_head);
+    gguf_set_val_i32(gctx, ASR_KV_NAMES.at(ASR_KV_AUDIO_BLOCK_COUNT),      model.n_audio_layer);
+    gguf_set_val_i32(gctx, ASR_KV_NAMES.at(ASR_KV_TEXT_CONTEXT_LENGTH),    model.n_text_ctx);
+    gguf_set_val_i32(gctx, ASR_KV_NAMES.at(ASR_KV_TEXT_EMBEDDING_LENGTH),  model.n_text_state);
+    gguf_set_val_i32(gctx, ASR_KV_NAMES.at(ASR_KV_TEXT_HEAD_COUNT),        model.n_text_head);
+    gguf_set_val_i32(gctx, ASR_KV_NAMES.at(ASR_KV_TEXT_BLOCK_COUNT),       model.n_text_layer);
+    gguf_set_val_i32(gctx, ASR_KV_NAMES.at(ASR_KV_MEL_COUNT),              model.n_mels);
+
+    gguf_set_val_i32 (gctx, ASR_KV_NAMES.at(ASR_KV_MEL_FILTERS_N_MEL), model.n_mel);
+    gguf_set_val_i32 (gctx, ASR_KV_NAMES.at(ASR_KV_MEL_FILTERS_N_FFT), model.n_fft);
+    gguf_set_arr_data(gctx, ASR_KV_NAMES.at(ASR_KV_MEL_FILTERS_DATA), GGUF_TYPE_FLOAT32, model.filters.data(), model.filters.size());
+
+    {
+        std::vector<uint8_t>  bytes;
+        std::vector<uint32_t> lengths;
+
+        lengths.reserve(model.vocab.size());
+
+        for (const auto & word : model.vocab) {
+            bytes.insert(bytes.end(), word.begin(), word.end());
+            lengths.push_back(word.size());
+        }
+
+        gguf_set_arr_data(gctx, ASR_KV_NAMES.at(ASR_KV_TOKENIZER_TOKEN_BYTES),   GGUF_TYPE_UINT8,  bytes.data(),   bytes.size());
+        gguf_set_arr_data(gctx, ASR_KV_NAMES.at(ASR_KV_TOKENIZER_TOKEN_LENGTHS), GGUF_TYPE_UINT32, lengths.data(), lengths.size());
+    }
+
+    for (const auto & kv : model.kv_str) {
+        gguf_set_val_str(gctx, kv.first.c_str(), kv.second.c_str());
+    }
+
+    ggml_init_params params = {
+        /*.mem_size   =*/ (model.tensors.size() + 1)*ggml_tensor_overhead(),
+        /*.mem_buffer =*/ nullptr,
+        /*.no_alloc   =*/ true,
+    };
+
+    ggml_context_ptr ctx_meta { ggml_init(params) };
+
+    for (const auto & t : model.tensors) {
+        if (t.name.size() >= GGML_MAX_NAME) {
+            fprintf(stderr, "%s: tensor name '%s' is too long\n", __func__, t.name.c_str());
+            return false;
+        }
+
+        ggml_tensor * tensor = ggml_new_tensor(ctx_meta.get(), t.type, t.n_dims, t.ne);
+        ggml_set_name(tensor, t.name.c_str());
+
+        if (ggml_nbytes(tensor) != t.data.size()) {
+            fprintf(stderr, "%s: tensor '%s' has %zu bytes of data, expected %zu\n", __func__, t.name.c_str(), t.data.size(), ggml_nbytes(tensor));
+            return false;
+        }
+
+        gguf_add_tensor(gctx, tensor);
+        gguf_set_tensor_data(gctx, t.name.c_str(), t.data.data());
+    }
+
+    if (!gguf_write_to_file(gctx, fname.c_str(), /*only_meta =*/ false)) {
+        fprintf(stderr, "%s: failed to write '%s'\n", __func__, fname.c_str());
+        return false;
+    }
+
+    return true;
+}
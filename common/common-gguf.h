@@ -0,0 +1,55 @@
+#pragma once
+
+#include "ggml.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// in-memory copy of a whisper model file
+//
+// used by the offline tools to convert between the legacy ggml format and GGUF
+struct whisper_model_file {
+    int32_t n_vocab       = 0;
+    int32_t n_audio_ctx   = 0;
+    int32_t n_audio_state = 0;
+    int32_t n_audio_head  = 0;
+    int32_t n_audio_layer = 0;
+    int32_t n_text_ctx    = 0;
+    int32_t n_text_state  = 0;
+    int32_t n_text_head   = 0;
+    int32_t n_text_layer  = 0;
+    int32_t n_mels        = 0;
+    int32_t ftype         = 0; // includes the quantization version (GGML_QNT_VERSION_FACTOR)
+
+    int32_t n_mel = 0;
+    int32_t n_fft = 0;
+
+    std::vector<float> filters;
+
+    std::vector<std::string> vocab;
+
+    struct tensor {
+        std::string name;
+
+        ggml_type type = GGML_TYPE_F32;
+
+        int32_t n_dims = 0;
+        int64_t ne[4]  = { 1, 1, 1, 1 };
+
+        std::vector<uint8_t> data;
+
+        int64_t nelements() const { return ne[0]*ne[1]*ne[2]*ne[3]; }
+    };
+
+    std::vector<tensor> tensors;
+
+    // additional string metadata written to GGUF files
+    std::vector<std::pair<std::string, std::string>> kv_str;
+};
+
+// read a legacy ggml or a GGUF model file - the format is detected from the magic
+bool whisper_model_file_read(const std::string & fname, whisper_model_file & model);
+
+// write the model as a GGUF file with the tensor data aligned to GGUF_DEFAULT_ALIGNMENT
+bool whisper_model_file_write_gguf(const std::string & fname, const whisper_model_file & model);
@@ -0,0 +1,230 @@
+#define _USE_MATH_DEFINES // for M_PI
+
+#include "common-resample.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <numeric>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// taps per output sample when the input rate is not higher than the output rate
+// decimation scales it by the ratio, so the transition band keeps the same width at the output rate
+#define RESAMPLE_TAPS_BASE 48
+
+// stopband attenuation of the Kaiser window in dB
+#define RESAMPLE_ATTEN 80.0
+
+// ratios with more phases are not cached - the common rates need at most 640 (11025 Hz), while an odd rate
+// like 47999 Hz needs 16000 phases and a bank of ~9 MB
+#define RESAMPLE_MAX_CACHED_PHASES 1024
+
+struct resample_bank {
+    int L = 1; // up
+    int M = 1; // down
+    int K = 1; // taps per phase, multiple of 8
+
+    // L phases of K taps each, reversed so that a phase is a dot product with K consecutive input samples
+    std::vector<float> taps;
+};
+
+// zeroth-order modified Bessel function of the first kind
+static double resample_bessel_i0(double x) {
+    double sum  = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 64; ++k) {
+        term *= (x/(2.0*k))*(x/(2.0*k));
+        sum  += term;
+        if (term < 1e-12*sum) {
+            break;
+        }
+    }
+    return sum;
+}
+
+static std::shared_ptr<const resample_bank> resample_bank_build(int L, int M, int rate_in, int rate_out) {
+    auto bank = std::make_shared<resample_bank>();
+
+    const int    K = (int) std::ceil(RESAMPLE_TAPS_BASE*std::max(1.0, (double) M/L)/8.0)*8;
+    const size_t N = (size_t) K*L;
+
+    bank->L = L;
+    bank->M = M;
+    bank->K = K;
+
+    // the prototype runs at L*rate_in - the stopband starts at the lower of the two Nyquist frequencies
+    const double beta = 0.1102*(RESAMPLE_ATTEN - 8.7);
+    const double df   = (RESAMPLE_ATTEN - 7.95)/(14.36*(N - 1));
+    const double fc   = 0.5*std::min(rate_in, rate_out)/((double) L*rate_in) - 0.5*df;
+
+    std::vector<double> h(N);
+
+    const double c  = 0.5*(N - 1);
+    const double i0 = resample_bessel_i0(beta);
+
+    for (size_t i = 0; i < N; ++i) {
+        const double t = i - c;
+        const double x = 2.0*fc*t;
+        const double s = std::abs(x) < 1e-12 ? 1.0 : std::sin(M_PI*x)/(M_PI*x);
+        const double r = t/c;
+        const double w = resample_bessel_i0(beta*std::sqrt(std::max(0.0, 1.0 - r*r)))/i0;
+
+        h[i] = 2.0*fc*s*w;
+    }
+
+    bank->taps.resize((size_t) L*K);
+
+    for (int p = 0; p < L; ++p) {
+        // unity gain at DC for every phase
+        double sum = 0.0;
+        for (int k = 0; k < K; ++k) {
+            sum += h[p + (size_t) k*L];
+        }
+
+        for (int k = 0; k < K; ++k) {
+            bank->taps[(size_t) p*K + (K - 1 - k)] = h[p + (size_t) k*L]/sum;
+        }
+    }
+
+    return bank;
+}
+
+static std::shared_ptr<const resample_bank> resample_bank_get(int rate_in, int rate_out) {
+    const int g = std::gcd(rate_in, rate_out);
+
+    const int L = rate_out/g;
+    const int M = rate_in/g;
+
+    if (L > RESAMPLE_MAX_CACHED_PHASES) {
+        return resample_bank_build(L, M, rate_in, rate_out);
+    }
+
+    static std::mutex mutex;
+    static std::map<std::pair<int, int>, std::shared_ptr<const resample_bank>> banks;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto & bank = banks[{ L, M }];
+    if (!bank) {
+        bank = resample_bank_build(L, M, rate_in, rate_out);
+    }
+
+    return bank;
+}
+
+static inline float resample_dot(const float * a, const float * b, int n) {
+    int i = 0;
+    float sum = 0.0f;
+
+#if defined(__AVX2__) && defined(__FMA__)
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i),     _mm256_loadu_ps(b + i),     acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+    }
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+    }
+
+    acc0 = _mm256_add_ps(acc0, acc1);
+
+    __m128 r = _mm_add_ps(_mm256_castps256_ps128(acc0), _mm256_extractf128_ps(acc0, 1));
+    r = _mm_add_ps(r, _mm_movehl_ps(r, r));
+    r = _mm_add_ss(r, _mm_movehdup_ps(r));
+
+    sum = _mm_cvtss_f32(r);
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    float32x4_t acc0 = vdupq_n_f32(0.0f);
+    float32x4_t acc1 = vdupq_n_f32(0.0f);
+
+    for (; i + 8 <= n; i += 8) {
+        acc0 = vfmaq_f32(acc0, vld1q_f32(a + i),     vld1q_f32(b + i));
+        acc1 = vfmaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    }
+
+    sum = vaddvq_f32(vaddq_f32(acc0, acc1));
+#endif
+
+    for (; i < n; ++i) {
+        sum += a[i]*b[i];
+    }
+
+    return sum;
+}
+
+bool pcm_resampler::init(int rate_in, int rate_out) {
+    if (rate_in < RATE_MIN || rate_in > RATE_MAX || rate_out < RATE_MIN || rate_out > RATE_MAX) {
+        return false;
+    }
+
+    m_rate_in  = rate_in;
+    m_rate_out = rate_out;
+
+    m_bank = rate_in == rate_out ? nullptr : resample_bank_get(rate_in, rate_out);
+
+    reset();
+
+    return true;
+}
+
+void pcm_resampler::reset() {
+    m_buf.clear();
+    m_pos = 0;
+
+    if (m_bank) {
+        m_buf.assign(m_bank->K - 1, 0.0f);
+        m_pos = (size_t) (m_bank->K - 1)*m_bank->L;
+    }
+}
+
+double pcm_resampler::latency() const {
+    // the prototype is symmetric around (K*L - 1)/2 in units of 1/L input samples
+    return m_bank ? (m_bank->K*m_bank->L - 1)/(2.0*m_bank->L) : 0.0;
+}
+
+size_t pcm_resampler::process(const float * pcmf32_in, size_t n_in, std::vector<float> & pcmf32_out) {
+    if (!m_bank) {
+        pcmf32_out.insert(pcmf32_out.end(), pcmf32_in, pcmf32_in + n_in);
+        return n_in;
+    }
+
+    const int L = m_bank->L;
+    const int M = m_bank->M;
+    const int K = m_bank->K;
+
+    const float * taps = m_bank->taps.data();
+
+    m_buf.insert(m_buf.end(), pcmf32_in, pcmf32_in + n_in);
+
+    const size_t n_buf   = m_buf.size();
+    const size_t n_start = pcmf32_out.size();
+
+    pcmf32_out.reserve(n_start + (n_in*L)/M + 1);
+
+    const float * buf = m_buf.data();
+
+    while (m_pos/L < n_buf) {
+        const size_t n = m_pos/L;
+        const size_t p = m_pos%L;
+
+        pcmf32_out.push_back(resample_dot(taps + p*K, buf + n - (K - 1), K));
+
+        m_pos += M;
+    }
+
+    // keep the last K - 1 samples as the history of the next chunk
+    const size_t n_drop = n_buf - (K - 1);
+
+    m_buf.erase(m_buf.begin(), m_buf.begin() + n_drop);
+    m_pos -= n_drop*L;
+
+    return pcmf32_out.size() - n_start;
+}
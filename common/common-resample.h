@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+//
+// Streaming polyphase FIR resampler
+//
+// Converts network audio (8 kHz telephony, 44.1 kHz, 48 kHz, ...) to WHISPER_SAMPLE_RATE with a Kaiser-windowed
+// sinc filter (~80 dB stopband). The rate ratio is reduced to L/M and the filter is split into L phases.
+// The filter banks of the common ratios are computed once and shared by all the streams with that ratio,
+// so a stream only keeps its history (one filter length of input) and the current phase.
+//
+
+struct resample_bank;
+
+class pcm_resampler {
+public:
+    static constexpr int RATE_MIN = 8000;
+    static constexpr int RATE_MAX = 192000;
+
+    // returns false if a rate is outside [RATE_MIN, RATE_MAX]
+    bool init(int rate_in, int rate_out);
+
+    // resample n_in samples and append the output to pcmf32_out
+    // the input can be split in chunks of any size, the output is the same as for a single call
+    // returns the number of samples appended
+    size_t process(const float * pcmf32_in, size_t n_in, std::vector<float> & pcmf32_out);
+
+    // forget the history, e.g. when the stream restarts
+    void reset();
+
+    int rate_in()  const { return m_rate_in; }
+    int rate_out() const { return m_rate_out; }
+
+    // delay of the output relative to the input, in input samples (can be fractional)
+    double latency() const;
+
+private:
+    int m_rate_in  = 0;
+    int m_rate_out = 0;
+
+    std::shared_ptr<const resample_bank> m_bank;
+
+    std::vector<float> m_buf; // history followed by the new input
+
+    size_t m_pos = 0; // position of the next output in units of 1/L input samples, relative to m_buf
+};
@@ -35,12 +35,13 @@
 #include <io.h>
 #endif
 
+#include <algorithm>
 #include <cstring>
 #include <fstream>
 
 #ifdef WHISPER_FFMPEG
 // as implemented in ffmpeg_trancode.cpp only embedded in common lib if whisper built with ffmpeg support
-extern bool ffmpeg_decode_audio(const std::string & ifname, std::vector<uint8_t> & wav_data);
+#include "ffmpeg-transcode.h"
 #endif
 
 bool read_audio_data(const std::string & fname, std::vector<float>& pcmf32, std::vector<std::vector<float>>& pcmf32s, bool stereo) {
@@ -78,17 +79,24 @@ bool read_audio_data(const std::string & fname, std::vector<float>& pcmf32, std:
     }
     else if (((result = ma_decoder_init_file(fname.c_str(), &decoder_config, &decoder)) != MA_SUCCESS)) {
 #if defined(WHISPER_FFMPEG)
-		if (ffmpeg_decode_audio(fname, audio_data) != 0) {
+		// decoded and resampled straight to mono float, there is no need for miniaudio
+		if (ffmpeg_decode_audio(fname, pcmf32) != 0) {
 			fprintf(stderr, "error: failed to ffmpeg decode '%s'\n", fname.c_str());
 
 			return false;
 		}
 
-		if ((result = ma_decoder_init_memory(audio_data.data(), audio_data.size(), &decoder_config, &decoder)) != MA_SUCCESS) {
-			fprintf(stderr, "error: failed to read audio data as wav (%s)\n", ma_result_description(result));
+		if (stereo) {
+			pcmf32s.assign(2, pcmf32);
 
-			return false;
+			pcmf32.resize(2*pcmf32s[0].size());
+			for (size_t i = 0; i < pcmf32s[0].size(); i++) {
+				pcmf32[2*i]     = pcmf32s[0][i];
+				pcmf32[2*i + 1] = pcmf32s[0][i];
+			}
 		}
+
+		return true;
 #else
 		if ((result = ma_decoder_init_memory(fname.c_str(), fname.size(), &decoder_config, &decoder)) != MA_SUCCESS) {
 			fprintf(stderr, "error: failed to read audio data as wav (%s)\n", ma_result_description(result));
@@ -130,6 +138,167 @@ bool read_audio_data(const std::string & fname, std::vector<float>& pcmf32, std:
     return true;
 }
 
+struct audio_stream {
+    ma_decoder decoder;
+
+#ifdef WHISPER_FFMPEG
+    // formats that miniaudio cannot decode
+    ffmpeg_audio * ffmpeg = nullptr;
+#endif
+
+    // stdin cannot seek, so the bytes read while the decoders probe the format are kept to rewind into
+    // once the decoder is initialized they are released as soon as they have been consumed
+    std::vector<uint8_t> head;
+    size_t               pos     = 0; // position in the input
+    bool                 probing = true;
+};
+
+static ma_result audio_stream_on_read(ma_decoder * decoder, void * buf, size_t n, size_t * n_read) {
+    audio_stream * stream = (audio_stream *) decoder->pUserData;
+
+    uint8_t * dst = (uint8_t *) buf;
+    size_t    cur = 0;
+
+    if (stream->pos < stream->head.size()) {
+        cur = std::min(n, stream->head.size() - stream->pos);
+        memcpy(dst, stream->head.data() + stream->pos, cur);
+    }
+
+    if (cur < n) {
+        const size_t n_new = fread(dst + cur, 1, n - cur, stdin);
+        if (stream->probing) {
+            stream->head.insert(stream->head.end(), dst + cur, dst + cur + n_new);
+        }
+        cur += n_new;
+    }
+
+    stream->pos += cur;
+
+    if (!stream->probing && stream->pos >= stream->head.size() && !stream->head.empty()) {
+        stream->head.clear();
+        stream->head.shrink_to_fit();
+    }
+
+    *n_read = cur;
+
+    return cur == 0 && n > 0 ? MA_AT_END : MA_SUCCESS;
+}
+
+static ma_result audio_stream_on_seek(ma_decoder * decoder, ma_int64 offset, ma_seek_origin origin) {
+    audio_stream * stream = (audio_stream *) decoder->pUserData;
+
+    int64_t target;
+    switch (origin) {
+        case ma_seek_origin_start:   target = offset;                       break;
+        case ma_seek_origin_current: target = (int64_t) stream->pos + offset; break;
+        default:                     return MA_NOT_IMPLEMENTED;
+    }
+
+    if (target < 0) {
+        return MA_INVALID_ARGS;
+    }
+
+    if ((size_t) target == stream->pos) {
+        return MA_SUCCESS;
+    }
+
+    // within the kept bytes or forward
+    if (!stream->head.empty() && (size_t) target <= stream->head.size()) {
+        stream->pos = target;
+        return MA_SUCCESS;
+    }
+
+    if ((size_t) target < stream->pos) {
+        return MA_NOT_IMPLEMENTED;
+    }
+
+    uint8_t buf[4096];
+    while (stream->pos < (size_t) target) {
+        size_t n_read = 0;
+        audio_stream_on_read(decoder, buf, std::min(sizeof(buf), (size_t) target - stream->pos), &n_read);
+        if (n_read == 0) {
+            return MA_AT_END;
+        }
+    }
+
+    return MA_SUCCESS;
+}
+
+audio_stream * audio_stream_open(const std::string & fname) {
+    audio_stream * stream = new audio_stream;
+
+    ma_result result;
+    ma_decoder_config decoder_config = ma_decoder_config_init(ma_format_f32, 1, WHISPER_SAMPLE_RATE);
+
+    if (fname == "-") {
+#ifdef _WIN32
+        _setmode(_fileno(stdin), _O_BINARY);
+#endif
+
+        result = ma_decoder_init(audio_stream_on_read, audio_stream_on_seek, stream, &decoder_config, &stream->decoder);
+    } else {
+        result = ma_decoder_init_file(fname.c_str(), &decoder_config, &stream->decoder);
+    }
+
+#ifdef WHISPER_FFMPEG
+    if (result != MA_SUCCESS && fname != "-") {
+        stream->ffmpeg = ffmpeg_audio_open(fname);
+        if (stream->ffmpeg) {
+            return stream;
+        }
+    }
+#endif
+
+    if (result != MA_SUCCESS) {
+        fprintf(stderr, "error: failed to open audio data from '%s' (%s)\n", fname.c_str(), ma_result_description(result));
+
+        delete stream;
+
+        return nullptr;
+    }
+
+    stream->probing = false;
+
+    return stream;
+}
+
+int64_t audio_stream_read(audio_stream * stream, float * pcmf32, int64_t n_max) {
+#ifdef WHISPER_FFMPEG
+    if (stream->ffmpeg) {
+        return ffmpeg_audio_read(stream->ffmpeg, pcmf32, n_max);
+    }
+#endif
+
+    ma_uint64 frames_read = 0;
+
+    const ma_result result = ma_decoder_read_pcm_frames(&stream->decoder, pcmf32, n_max, &frames_read);
+    if (result != MA_SUCCESS && result != MA_AT_END) {
+        fprintf(stderr, "error: failed to read the frames of the audio data (%s)\n", ma_result_description(result));
+
+        return -1;
+    }
+
+    return frames_read;
+}
+
+void audio_stream_close(audio_stream * stream) {
+    if (stream) {
+#ifdef WHISPER_FFMPEG
+        if (stream->ffmpeg) {
+            ffmpeg_audio_close(stream->ffmpeg);
+
+            delete stream;
+
+            return;
+        }
+#endif
+
+        ma_decoder_uninit(&stream->decoder);
+
+        delete stream;
+    }
+}
+
 //  500 -> 00:05.000
 // 6000 -> 01:00.000
 std::string to_timestamp(int64_t t, bool comma) {
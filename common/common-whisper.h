@@ -14,6 +14,20 @@ bool read_audio_data(
         std::vector<std::vector<float>> & pcmf32s,
         bool stereo);
 
+// Incremental decoding of an audio file to mono WHISPER_SAMPLE_RATE float PCM
+// fname can be "-" to read from stdin - the input is decoded while it is read
+// Unlike read_audio_data, the memory used does not depend on the length of the input
+struct audio_stream;
+
+// returns nullptr if the input cannot be opened or decoded
+audio_stream * audio_stream_open(const std::string & fname);
+
+// decode up to n_max samples into pcmf32
+// returns the number of samples, 0 at the end of the input or -1 on error
+int64_t audio_stream_read(audio_stream * stream, float * pcmf32, int64_t n_max);
+
+void audio_stream_close(audio_stream * stream);
+
 // convert timestamp to string, 6000 -> 01:00.000
 std::string to_timestamp(int64_t t, bool comma = false);
 
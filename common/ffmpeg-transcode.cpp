@@ -1,27 +1,18 @@
 /* SPDX-License-Identifier: GPL-2.0 */
 
 /*
- * transcode.c - convert audio file to WAVE
+ * transcode.c - decode audio files to mono 16 kHz float PCM
  *
  * Copyright (C) 2019		Andrew Clayton <andrew@digital-domain.net>
  * Copyright (C) 2024       William Tambellini <william.tambellini@gmail.com>
  */
 
-// Just for conveninent C++ API
-#include <vector>
-#include <string>
-
-// C
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <stdbool.h>
-#include <stdint.h>
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <fcntl.h>
-#include <unistd.h>
-#include <sys/mman.h>
+#include "ffmpeg-transcode.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
 extern "C" {
 #include <libavutil/opt.h>
@@ -30,334 +21,336 @@ extern "C" {
 #include <libswresample/swresample.h>
 }
 
-typedef uint64_t u64;
-typedef int64_t  s64;
-typedef uint32_t u32;
-typedef int32_t  s32;
-typedef uint16_t u16;
-typedef int16_t  s16;
-typedef uint8_t   u8;
-typedef int8_t    s8;
-
 #define WAVE_SAMPLE_RATE	16000
-#define AVIO_CTX_BUF_SZ		 4096
 
 static const char* ffmpegLog = getenv("FFMPEG_LOG");
 // Todo: add __FILE__ __LINE__
 #define LOG(...) \
   do { if (ffmpegLog) fprintf(stderr, __VA_ARGS__); } while(0) // C99
 
-/*
- * WAVE file header based on definition from
- * https://gist.github.com/Jon-Schneider/8b7c53d27a7a13346a643dac9c19d34f
- *
- * We must ensure this structure doesn't have any holes or
- * padding so we can just map it straight to the WAVE data.
- */
-struct wave_hdr {
-	/* RIFF Header: "RIFF" */
-	char riff_header[4];
-	/* size of audio data + sizeof(struct wave_hdr) - 8 */
-	int wav_size;
-	/* "WAVE" */
-	char wav_header[4];
-
-	/* Format Header */
-	/* "fmt " (includes trailing space) */
-	char fmt_header[4];
-	/* Should be 16 for PCM */
-	int fmt_chunk_size;
-	/* Should be 1 for PCM. 3 for IEEE Float */
-	s16 audio_format;
-	s16 num_channels;
-	int sample_rate;
-	/*
-	 * Number of bytes per second
-	 * sample_rate * num_channels * bit_depth/8
-	 */
-	int byte_rate;
-	/* num_channels * bytes per sample */
-	s16 sample_alignment;
-	/* bits per sample */
-	s16 bit_depth;
-
-	/* Data Header */
-	/* "data" */
-	char data_header[4];
-	/*
-	 * size of audio
-	 * number of samples * num_channels * bit_depth/8
-	 */
-	int data_bytes;
-} __attribute__((__packed__));
-
-struct audio_buffer {
-	u8 *ptr;
-	int size; /* size left in the buffer */
+struct ffmpeg_audio {
+    AVFormatContext * fmt_ctx = nullptr;
+    AVCodecContext  * codec   = nullptr;
+    SwrContext      * swr     = nullptr;
+    AVPacket        * packet  = nullptr;
+    AVFrame         * frame   = nullptr;
+
+    int stream_index = -1;
+
+    bool eof_input   = false; // the demuxer is done, the decoder is being drained
+    bool eof_decoder = false; // the decoder is done, the resampler is being flushed
+    bool eof         = false;
+
+    // converted samples that did not fit in the caller's buffer
+    std::vector<float> pending;
+    size_t             pending_pos = 0;
 };
 
-static void set_wave_hdr(wave_hdr& wh, size_t size) {
-    memcpy(&wh.riff_header, "RIFF", 4);
-    wh.wav_size = size + sizeof(struct wave_hdr) - 8;
-    memcpy(&wh.wav_header, "WAVE", 4);
-    memcpy(&wh.fmt_header, "fmt ", 4);
-    wh.fmt_chunk_size = 16;
-    wh.audio_format = 1;
-    wh.num_channels = 1;
-    wh.sample_rate = WAVE_SAMPLE_RATE;
-    wh.sample_alignment = 2;
-    wh.bit_depth = 16;
-    wh.byte_rate = wh.sample_rate * wh.sample_alignment;
-    memcpy(&wh.data_header, "data", 4);
-    wh.data_bytes = size;
-}
+void ffmpeg_audio_close(ffmpeg_audio * audio) {
+    if (!audio) {
+        return;
+    }
 
-static void write_wave_hdr(int fd, size_t size) {
-	struct wave_hdr wh;
-    set_wave_hdr(wh, size);
-	write(fd, &wh, sizeof(struct wave_hdr));
+    av_frame_free(&audio->frame);
+    av_packet_free(&audio->packet);
+    swr_free(&audio->swr);
+    avcodec_free_context(&audio->codec);
+    avformat_close_input(&audio->fmt_ctx);
+
+    delete audio;
 }
 
-static int map_file(int fd, u8 **ptr, size_t *size)
-{
-	struct stat sb;
+ffmpeg_audio * ffmpeg_audio_open(const std::string & ifname) {
+    LOG("ffmpeg_audio_open: %s\n", ifname.c_str());
 
-	fstat(fd, &sb);
-	*size = sb.st_size;
+    const size_t errbuffsize = 1024;
+    char errbuff[errbuffsize];
 
-    *ptr = (u8*)mmap(NULL, *size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
-	if (*ptr == MAP_FAILED) {
-		perror("mmap");
-		return -1;
-	}
+    ffmpeg_audio * audio = new ffmpeg_audio;
 
-	return 0;
-}
+    // the input is read incrementally through the file protocol instead of mapping it
+    const std::string url = ifname == "-" ? "pipe:0" : ifname;
 
-static int read_packet(void *opaque, u8 *buf, int buf_size)
-{
-    struct audio_buffer *audio_buf = (audio_buffer*)opaque;
+    int err = avformat_open_input(&audio->fmt_ctx, url.c_str(), NULL, NULL);
+    if (err) {
+        LOG("Could not open %s: %d: %s\n", ifname.c_str(), err, av_make_error_string(errbuff, errbuffsize, err));
+        ffmpeg_audio_close(audio);
+        return nullptr;
+    }
 
-	buf_size = FFMIN(buf_size, audio_buf->size);
+    err = avformat_find_stream_info(audio->fmt_ctx, NULL);
+    if (err < 0) {
+        LOG("Could not retrieve stream info from %s: %d\n", ifname.c_str(), err);
+        ffmpeg_audio_close(audio);
+        return nullptr;
+    }
 
-	/* copy internal buffer data to buf */
-	memcpy(buf, audio_buf->ptr, buf_size);
-	audio_buf->ptr += buf_size;
-	audio_buf->size -= buf_size;
+    audio->stream_index = av_find_best_stream(audio->fmt_ctx, AVMEDIA_TYPE_AUDIO, -1, -1, NULL, 0);
+    if (audio->stream_index < 0) {
+        LOG("Could not find an audio stream in %s\n", ifname.c_str());
+        ffmpeg_audio_close(audio);
+        return nullptr;
+    }
 
-	return buf_size;
-}
+    const AVStream * stream = audio->fmt_ctx->streams[audio->stream_index];
 
-static void convert_frame(struct SwrContext *swr, AVCodecContext *codec,
-			  AVFrame *frame, s16 **data, int *size, bool flush)
-{
-	int nr_samples;
-	s64 delay;
-	u8 *buffer;
-
-	delay = swr_get_delay(swr, codec->sample_rate);
-	nr_samples = av_rescale_rnd(delay + frame->nb_samples,
-				    WAVE_SAMPLE_RATE, codec->sample_rate,
-				    AV_ROUND_UP);
-	av_samples_alloc(&buffer, NULL, 1, nr_samples, AV_SAMPLE_FMT_S16, 0);
-
-	/*
-	 * !flush is used to check if we are flushing any remaining
-	 * conversion buffers...
-	 */
-	nr_samples = swr_convert(swr, &buffer, nr_samples,
-				 !flush ? (const u8 **)frame->data : NULL,
-				 !flush ? frame->nb_samples : 0);
-
-    *data = (s16*)realloc(*data, (*size + nr_samples) * sizeof(s16));
-	memcpy(*data + *size, buffer, nr_samples * sizeof(s16));
-	*size += nr_samples;
-	av_freep(&buffer);
-}
+    const AVCodec * decoder = avcodec_find_decoder(stream->codecpar->codec_id);
+    if (!decoder) {
+        LOG("No decoder for stream #%d in %s\n", audio->stream_index, ifname.c_str());
+        ffmpeg_audio_close(audio);
+        return nullptr;
+    }
 
-static bool is_audio_stream(const AVStream *stream)
-{
-	if (stream->codecpar->codec_type == AVMEDIA_TYPE_AUDIO)
-		return true;
+    audio->codec = avcodec_alloc_context3(decoder);
+    if (!audio->codec) {
+        LOG("Failed to allocate the decoder context for stream #%d in %s\n", audio->stream_index, ifname.c_str());
+        ffmpeg_audio_close(audio);
+        return nullptr;
+    }
 
-	return false;
-}
+    err = avcodec_parameters_to_context(audio->codec, stream->codecpar);
+    if (err < 0) {
+        LOG("Failed to copy the parameters of stream #%d in %s: %d: %s\n", audio->stream_index, ifname.c_str(), err, av_make_error_string(errbuff, errbuffsize, err));
+        ffmpeg_audio_close(audio);
+        return nullptr;
+    }
 
-// Return non zero on error, 0 on success
-// audio_buffer: input memory
-// data: decoded output audio data (wav file)
-// size: size of output data
-static int decode_audio(struct audio_buffer *audio_buf, s16 **data, int *size)
-{
-    LOG("decode_audio: input size: %d\n", audio_buf->size);
-	AVFormatContext *fmt_ctx;
-	AVIOContext *avio_ctx;
-	AVStream *stream;
-	AVCodecContext *codec;
-	AVPacket packet;
-	AVFrame *frame;
-	struct SwrContext *swr;
-	u8 *avio_ctx_buffer;
-	unsigned int i;
-	int stream_index = -1;
-	int err;
-    const size_t errbuffsize = 1024;
-    char errbuff[errbuffsize];
+    err = avcodec_open2(audio->codec, decoder, NULL);
+    if (err) {
+        LOG("Failed to open decoder for stream #%d in %s\n", audio->stream_index, ifname.c_str());
+        ffmpeg_audio_close(audio);
+        return nullptr;
+    }
 
-    fmt_ctx = avformat_alloc_context();
-    avio_ctx_buffer = (u8*)av_malloc(AVIO_CTX_BUF_SZ);
-    LOG("Creating an avio context: AVIO_CTX_BUF_SZ=%d\n", AVIO_CTX_BUF_SZ);
-    avio_ctx = avio_alloc_context(avio_ctx_buffer, AVIO_CTX_BUF_SZ, 0, audio_buf, &read_packet, NULL, NULL);
-	fmt_ctx->pb = avio_ctx;
-
-    // open the input stream and read header
-	err = avformat_open_input(&fmt_ctx, NULL, NULL, NULL);
-	if (err) {
-        LOG("Could not read audio buffer: %d: %s\n", err, av_make_error_string(errbuff, errbuffsize, err));
-        return err;
-	}
-
-	err = avformat_find_stream_info(fmt_ctx, NULL);
-	if (err < 0) {
-        LOG("Could not retrieve stream info from audio buffer: %d\n", err);
-        return err;
-	}
-
-	for (i = 0; i < fmt_ctx->nb_streams; i++) {
-		if (is_audio_stream(fmt_ctx->streams[i])) {
-			stream_index = i;
-			break;
-		}
-	}
-
-	if (stream_index == -1) {
-        LOG("Could not retrieve audio stream from buffer\n");
-		return -1;
-	}
-
-	stream = fmt_ctx->streams[stream_index];
-	codec = avcodec_alloc_context3(
-			avcodec_find_decoder(stream->codecpar->codec_id));
-	avcodec_parameters_to_context(codec, stream->codecpar);
-	err = avcodec_open2(codec, avcodec_find_decoder(codec->codec_id),
-							NULL);
-	if (err) {
-        LOG("Failed to open decoder for stream #%d in audio buffer\n", stream_index);
-        return err;
-	}
-
-	/* prepare resampler */
-	swr = swr_alloc();
+    /* prepare resampler */
+    AVCodecContext * codec = audio->codec;
+    SwrContext * swr = swr_alloc();
+    if (!swr) {
+        LOG("Failed to allocate the resampler\n");
+        ffmpeg_audio_close(audio);
+        return nullptr;
+    }
 
 #if LIBAVCODEC_VERSION_MAJOR > 60
-	AVChannelLayout in_ch_layout = codec->ch_layout;
-	AVChannelLayout out_ch_layout = AV_CHANNEL_LAYOUT_MONO;
-
-	/* Set the source audio layout as-is */
-	av_opt_set_chlayout(swr, "in_chlayout", &in_ch_layout, 0);
-	av_opt_set_int(swr, "in_sample_rate", codec->sample_rate, 0);
-	av_opt_set_sample_fmt(swr, "in_sample_fmt", codec->sample_fmt, 0);
-
-	/* Convert it into 16khz Mono */
-	av_opt_set_chlayout(swr, "out_chlayout", &out_ch_layout, 0);
-	av_opt_set_int(swr, "out_sample_rate", WAVE_SAMPLE_RATE, 0);
-	av_opt_set_sample_fmt(swr, "out_sample_fmt", AV_SAMPLE_FMT_S16, 0);
+    AVChannelLayout in_ch_layout = codec->ch_layout;
+    AVChannelLayout out_ch_layout = AV_CHANNEL_LAYOUT_MONO;
+
+    /* Set the source audio layout as-is */
+    av_opt_set_chlayout(swr, "in_chlayout", &in_ch_layout, 0);
+    av_opt_set_int(swr, "in_sample_rate", codec->sample_rate, 0);
+    av_opt_set_sample_fmt(swr, "in_sample_fmt", codec->sample_fmt, 0);
+
+    /* Convert it into 16khz Mono float */
+    av_opt_set_chlayout(swr, "out_chlayout", &out_ch_layout, 0);
+    av_opt_set_int(swr, "out_sample_rate", WAVE_SAMPLE_RATE, 0);
+    av_opt_set_sample_fmt(swr, "out_sample_fmt", AV_SAMPLE_FMT_FLT, 0);
 #else
-	av_opt_set_int(swr, "in_channel_count", codec->channels, 0);
-	av_opt_set_int(swr, "out_channel_count", 1, 0);
-	av_opt_set_int(swr, "in_channel_layout", codec->channel_layout, 0);
-	av_opt_set_int(swr, "out_channel_layout", AV_CH_LAYOUT_MONO, 0);
-	av_opt_set_int(swr, "in_sample_rate", codec->sample_rate, 0);
-	av_opt_set_int(swr, "out_sample_rate", WAVE_SAMPLE_RATE, 0);
-	av_opt_set_sample_fmt(swr, "in_sample_fmt", codec->sample_fmt, 0);
-	av_opt_set_sample_fmt(swr, "out_sample_fmt", AV_SAMPLE_FMT_S16, 0);
+    av_opt_set_int(swr, "in_channel_count", codec->channels, 0);
+    av_opt_set_int(swr, "out_channel_count", 1, 0);
+    av_opt_set_int(swr, "in_channel_layout", codec->channel_layout, 0);
+    av_opt_set_int(swr, "out_channel_layout", AV_CH_LAYOUT_MONO, 0);
+    av_opt_set_int(swr, "in_sample_rate", codec->sample_rate, 0);
+    av_opt_set_int(swr, "out_sample_rate", WAVE_SAMPLE_RATE, 0);
+    av_opt_set_sample_fmt(swr, "in_sample_fmt", codec->sample_fmt, 0);
+    av_opt_set_sample_fmt(swr, "out_sample_fmt", AV_SAMPLE_FMT_FLT, 0);
 #endif
 
-	swr_init(swr);
-	if (!swr_is_initialized(swr)) {
+    audio->swr = swr;
+
+    swr_init(swr);
+    if (!swr_is_initialized(swr)) {
         LOG("Resampler has not been properly initialized\n");
-		return -1;
-	}
-
-	av_init_packet(&packet);
-	frame = av_frame_alloc();
-	if (!frame) {
-        LOG("Error allocating the frame\n");
-		return -1;
-	}
-
-	/* iterate through frames */
-	*data = NULL;
-	*size = 0;
-	while (av_read_frame(fmt_ctx, &packet) >= 0) {
-		avcodec_send_packet(codec, &packet);
-
-		err = avcodec_receive_frame(codec, frame);
-		if (err == AVERROR(EAGAIN))
-			continue;
-
-		convert_frame(swr, codec, frame, data, size, false);
-	}
-	/* Flush any remaining conversion buffers... */
-	convert_frame(swr, codec, frame, data, size, true);
-
-	av_frame_free(&frame);
-	swr_free(&swr);
-    //avio_context_free(); // todo?
-	avcodec_close(codec);
-	avformat_close_input(&fmt_ctx);
-	avformat_free_context(fmt_ctx);
-
-	if (avio_ctx) {
-		av_freep(&avio_ctx->buffer);
-		av_freep(&avio_ctx);
-	}
-
-	return 0;
+        ffmpeg_audio_close(audio);
+        return nullptr;
+    }
+
+    audio->packet = av_packet_alloc();
+    audio->frame  = av_frame_alloc();
+    if (!audio->packet || !audio->frame) {
+        LOG("Error allocating the packet/frame\n");
+        ffmpeg_audio_close(audio);
+        return nullptr;
+    }
+
+    return audio;
+}
+
+// get the next decoded frame, draining the decoder at the end of the input
+// returns 1 with a frame, 0 when the decoder is done and -1 on error
+static int ffmpeg_audio_next_frame(ffmpeg_audio * audio) {
+    while (true) {
+        int err = avcodec_receive_frame(audio->codec, audio->frame);
+        if (err == 0) {
+            return 1;
+        }
+        if (err == AVERROR_EOF) {
+            return 0;
+        }
+        if (err != AVERROR(EAGAIN)) {
+            LOG("Error decoding a frame: %d\n", err);
+            return -1;
+        }
+
+        if (audio->eof_input) {
+            return 0;
+        }
+
+        // the decoder needs more input
+        err = av_read_frame(audio->fmt_ctx, audio->packet);
+        if (err < 0) {
+            audio->eof_input = true;
+            avcodec_send_packet(audio->codec, NULL);
+            continue;
+        }
+
+        if (audio->packet->stream_index == audio->stream_index) {
+            err = avcodec_send_packet(audio->codec, audio->packet);
+            if (err < 0 && err != AVERROR(EAGAIN) && err != AVERROR_INVALIDDATA) {
+                LOG("Error sending a packet to the decoder: %d\n", err);
+                av_packet_unref(audio->packet);
+                return -1;
+            }
+        }
+
+        av_packet_unref(audio->packet);
+    }
+}
+
+int64_t ffmpeg_audio_read(ffmpeg_audio * audio, float * pcmf32, int64_t n_max) {
+    int64_t n_done = 0;
+
+    while (n_done < n_max) {
+        // samples left over from the previous call
+        if (audio->pending_pos < audio->pending.size()) {
+            const int64_t n = std::min<int64_t>(n_max - n_done, audio->pending.size() - audio->pending_pos);
+            memcpy(pcmf32 + n_done, audio->pending.data() + audio->pending_pos, n*sizeof(float));
+            audio->pending_pos += n;
+            n_done += n;
+            continue;
+        }
+
+        if (audio->eof) {
+            break;
+        }
+
+        const uint8_t ** in_data = nullptr;
+        int in_samples = 0;
+
+        if (!audio->eof_decoder) {
+            const int ret = ffmpeg_audio_next_frame(audio);
+            if (ret < 0) {
+                return -1;
+            }
+            if (ret == 0) {
+                audio->eof_decoder = true;
+            } else {
+                in_data    = (const uint8_t **) audio->frame->extended_data;
+                in_samples = audio->frame->nb_samples;
+            }
+        }
+
+        // upper bound of the output, including the samples buffered in the resampler
+        const int n_out = swr_get_out_samples(audio->swr, in_samples);
+
+        // convert straight into the caller's buffer when the output fits
+        float * dst = pcmf32 + n_done;
+        if (n_out > n_max - n_done) {
+            audio->pending.resize(n_out);
+            audio->pending_pos = 0;
+            dst = audio->pending.data();
+        }
+
+        uint8_t * out_data = (uint8_t *) dst;
+        const int n = swr_convert(audio->swr, &out_data, n_out, in_data, in_samples);
+        if (n < 0) {
+            LOG("Error converting the samples: %d\n", n);
+            return -1;
+        }
+
+        if (dst == audio->pending.data()) {
+            audio->pending.resize(n);
+        } else {
+            n_done += n;
+        }
+
+        if (audio->eof_decoder && in_data == nullptr && n == 0) {
+            audio->eof = true;
+        }
+
+        av_frame_unref(audio->frame);
+    }
+
+    return n_done;
 }
 
-// in mem decoding/conversion/resampling:
-// ifname: input file path
-// owav_data: in mem wav file. Can be forwarded as it to whisper/drwav
-// return 0 on success
-int ffmpeg_decode_audio(const std::string &ifname, std::vector<uint8_t>& owav_data) {
-    LOG("ffmpeg_decode_audio: %s\n", ifname.c_str());
-    int ifd = open(ifname.c_str(), O_RDONLY);
-    if (ifd == -1) {
-        fprintf(stderr, "Couldn't open input file %s\n", ifname.c_str());
+int ffmpeg_decode_audio(const std::string & ifname, const std::function<bool(const float * pcmf32, int64_t n_samples)> & cb) {
+    ffmpeg_audio * audio = ffmpeg_audio_open(ifname);
+    if (!audio) {
         return -1;
     }
-    u8 *ibuf = NULL;
-    size_t ibuf_size;
-    int err = map_file(ifd, &ibuf, &ibuf_size);
-    if (err) {
-        LOG("Couldn't map input file %s\n", ifname.c_str());
-        return err;
+
+    // about 1 s
+    std::vector<float> buf(WAVE_SAMPLE_RATE);
+
+    int ret = 0;
+
+    while (true) {
+        const int64_t n = ffmpeg_audio_read(audio, buf.data(), buf.size());
+        if (n < 0) {
+            ret = -1;
+            break;
+        }
+        if (n == 0 || !cb(buf.data(), n)) {
+            break;
+        }
     }
-    LOG("Mapped input file: %s size: %d\n", ibuf, (int) ibuf_size);
-    struct audio_buffer inaudio_buf;
-    inaudio_buf.ptr = ibuf;
-    inaudio_buf.size = ibuf_size;
-
-    s16 *odata=NULL;
-    int osize=0;
-
-    err = decode_audio(&inaudio_buf, &odata, &osize);
-    LOG("decode_audio returned %d \n", err);
-    if (err != 0) {
-        LOG("decode_audio failed\n");
-        return err;
+
+    ffmpeg_audio_close(audio);
+
+    return ret;
+}
+
+int ffmpeg_decode_audio(const std::string & ifname, std::vector<float> & pcmf32) {
+    ffmpeg_audio * audio = ffmpeg_audio_open(ifname);
+    if (!audio) {
+        return -1;
+    }
+
+    pcmf32.clear();
+
+    // reserve from the duration of the container when known, so the output is decoded in place
+    if (audio->fmt_ctx->duration > 0) {
+        pcmf32.reserve(av_rescale(audio->fmt_ctx->duration, WAVE_SAMPLE_RATE, AV_TIME_BASE) + WAVE_SAMPLE_RATE);
     }
-    LOG("decode_audio output size: %d\n", osize);
-
-    wave_hdr wh;
-    const size_t outdatasize = osize * sizeof(s16);
-    set_wave_hdr(wh, outdatasize);
-    owav_data.resize(sizeof(wave_hdr) + outdatasize);
-    // header:
-    memcpy(owav_data.data(), &wh, sizeof(wave_hdr));
-    // the data:
-    memcpy(owav_data.data() + sizeof(wave_hdr), odata, osize* sizeof(s16));
-
-    return 0;
+
+    const int64_t n_block = WAVE_SAMPLE_RATE;
+
+    int ret = 0;
+
+    while (true) {
+        const size_t n_cur = pcmf32.size();
+        if (pcmf32.capacity() < n_cur + n_block) {
+            pcmf32.reserve(2*(n_cur + n_block));
+        }
+        pcmf32.resize(n_cur + n_block);
+
+        const int64_t n = ffmpeg_audio_read(audio, pcmf32.data() + n_cur, n_block);
+        if (n < 0) {
+            ret = -1;
+            pcmf32.resize(n_cur);
+            break;
+        }
+
+        pcmf32.resize(n_cur + n);
+
+        if (n == 0) {
+            break;
+        }
+    }
+
+    LOG("ffmpeg_decode_audio: %zu samples\n", pcmf32.size());
+
+    ffmpeg_audio_close(audio);
+
+    return ret;
 }
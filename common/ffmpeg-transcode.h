@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+//
+// FFmpeg audio decoding to mono 16 kHz float PCM
+//
+// Only available when whisper is built with WHISPER_FFMPEG.
+// libswresample converts the decoded frames straight to the output format, so there is no intermediate WAV or s16 copy.
+//
+
+struct ffmpeg_audio;
+
+// open a file in any container/codec supported by FFmpeg, "-" reads from stdin
+// returns nullptr on failure
+ffmpeg_audio * ffmpeg_audio_open(const std::string & ifname);
+
+// decode up to n_max samples into pcmf32
+// returns the number of samples, 0 at the end of the input or -1 on error
+int64_t ffmpeg_audio_read(ffmpeg_audio * audio, float * pcmf32, int64_t n_max);
+
+void ffmpeg_audio_close(ffmpeg_audio * audio);
+
+// decode the whole input, passing the samples to the callback as they are decoded
+// the callback returns false to stop early
+// returns 0 on success
+int ffmpeg_decode_audio(const std::string & ifname, const std::function<bool(const float * pcmf32, int64_t n_samples)> & cb);
+
+// decode the whole input into pcmf32
+// returns 0 on success
+int ffmpeg_decode_audio(const std::string & ifname, std::vector<float> & pcmf32);
@@ -0,0 +1,117 @@
+// Convert a legacy ggml whisper model (.bin) to GGUF
+//
+// usage: wstream-convert model.bin model.gguf [--bench N]
+//
+// with --bench, both files are loaded N times and the average load times are compared
+//
+#include "common-gguf.h"
+
+#include "whisper.h"
+#include "ggml.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+static void print_usage(const char * argv0) {
+    fprintf(stderr, "usage: %s model-in.bin model-out.gguf [--bench N]\n", argv0);
+}
+
+static void whisper_log_quiet(ggml_log_level level, const char * text, void * /*user_data*/) {
+    if (level == GGML_LOG_LEVEL_ERROR) {
+        fputs(text, stderr);
+    }
+}
+
+// average load time (without state) in ms
+static double bench_load(const std::string & fname, bool use_mmap, int n_runs) {
+    whisper_context_params cparams = whisper_context_default_params();
+    cparams.use_gpu  = false;
+    cparams.use_mmap = use_mmap;
+
+    double t_total_ms = 0.0;
+
+    for (int i = 0; i < n_runs; ++i) {
+        const int64_t t_start_us = ggml_time_us();
+
+        whisper_context * ctx = whisper_init_from_file_with_params_no_state(fname.c_str(), cparams);
+        if (!ctx) {
+            fprintf(stderr, "%s: failed to load '%s'\n", __func__, fname.c_str());
+            return -1.0;
+        }
+
+        t_total_ms += (ggml_time_us() - t_start_us)/1000.0;
+
+        whisper_free(ctx);
+    }
+
+    return t_total_ms/n_runs;
+}
+
+int main(int argc, char ** argv) {
+    if (argc < 3) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    const std::string fname_inp = argv[1];
+    const std::string fname_out = argv[2];
+
+    int n_bench = 0;
+
+    for (int i = 3; i < argc; ++i) {
+        if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc) {
+            n_bench = atoi(argv[++i]);
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    ggml_time_init();
+
+    const int64_t t_start_us = ggml_time_us();
+
+    whisper_model_file model;
+
+    if (!whisper_model_file_read(fname_inp, model)) {
+        fprintf(stderr, "%s: failed to read '%s'\n", __func__, fname_inp.c_str());
+        return 2;
+    }
+
+    size_t total_size = 0;
+    for (const auto & t : model.tensors) {
+        total_size += t.data.size();
+    }
+
+    fprintf(stderr, "%s: read '%s': %zu tensors, %zu tokens, %.2f MB\n",
+            __func__, fname_inp.c_str(), model.tensors.size(), model.vocab.size(), total_size/1e6);
+
+    if (!whisper_model_file_write_gguf(fname_out, model)) {
+        fprintf(stderr, "%s: failed to write '%s'\n", __func__, fname_out.c_str());
+        return 3;
+    }
+
+    fprintf(stderr, "%s: wrote '%s' in %.2f s\n", __func__, fname_out.c_str(), (ggml_time_us() - t_start_us)/1e6);
+
+    if (n_bench > 0) {
+        whisper_log_set(whisper_log_quiet, nullptr);
+
+        // warm the page cache so that both formats are measured under the same conditions
+        bench_load(fname_inp, false, 1);
+        bench_load(fname_out, false, 1);
+
+        const double t_legacy    = bench_load(fname_inp, false, n_bench);
+        const double t_gguf      = bench_load(fname_out, false, n_bench);
+        const double t_gguf_mmap = bench_load(fname_out, true,  n_bench);
+
+        fprintf(stderr, "\n");
+        fprintf(stderr, "%s: load time (avg of %d runs, warm page cache):\n", __func__, n_bench);
+        fprintf(stderr, "%s:   legacy      %8.2f ms\n", __func__, t_legacy);
+        fprintf(stderr, "%s:   gguf        %8.2f ms\n", __func__, t_gguf);
+        fprintf(stderr, "%s:   gguf + mmap %8.2f ms\n", __func__, t_gguf_mmap);
+    }
+
+    return 0;
+}
@@ -120,6 +120,10 @@ extern "C" {
 
     GGML_BACKEND_API void ggml_cpu_init(void);
 
+    // write the trace and the table of the per-op profiler (GGML_CPU_PROFILE) now instead of at exit,
+    // for the processes that end with _exit() or a signal - no-op if the profiler is not enabled or already written
+    GGML_BACKEND_API void ggml_cpu_profile_flush(void);
+
     //
     // CPU backend
     //
@@ -133,6 +137,16 @@ extern "C" {
 
     GGML_BACKEND_API ggml_backend_reg_t ggml_backend_cpu_reg(void);
 
+    // weights stored in the interleaved layouts of the CPU_AARCH64 buffer type ("repacked" at load time)
+    //  - repack_isa: name of the layouts used on this CPU, NULL if no tensor is repacked
+    //                data repacked on one CPU can be used on another CPU with the same name
+    //  - repack_tensor: write the repacked data of tensor to dst (ggml_nbytes(tensor) bytes)
+    //                   returns false if the tensor is not repacked on this CPU
+    //  - repacked_buffer_from_ptr: buffer over data that is already repacked (e.g. a mapped model file)
+    GGML_BACKEND_API const char *          ggml_backend_cpu_repack_isa(void);
+    GGML_BACKEND_API bool                  ggml_backend_cpu_repack_tensor(const struct ggml_tensor * tensor, const void * data, void * dst);
+    GGML_BACKEND_API ggml_backend_buffer_t ggml_backend_cpu_repacked_buffer_from_ptr(void * ptr, size_t size);
+
 #ifdef __cplusplus
 }
 #endif
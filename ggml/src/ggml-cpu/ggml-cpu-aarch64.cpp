@@ -15,6 +15,7 @@
 #include <cfloat>
 #include <cstdlib> // for qsort
 #include <cstdio>  // for GGML_ASSERT
+#include <string>
 
 #include "ggml-cpu-aarch64.h"
 
@@ -70,6 +71,15 @@ struct block_iq4_nlx4 {
 
 static_assert(sizeof(block_iq4_nlx4) == 4 * sizeof(ggml_half) + QK4_NL * 2, "wrong iq4_nlx4 block size/padding");
 
+struct block_q5_0x8 {
+    ggml_half d[8];     // deltas for 8 q5_0 blocks
+    uint8_t   qh[32];   // 5-th bit of quants - bit g of qh[i] belongs to byte i of group g
+    uint8_t   qs[128];  // nibbles / quants - groups 0-3 in the low nibbles, groups 4-7 in the high nibbles
+};
+
+static_assert(sizeof(block_q5_0x8) == 8 * sizeof(block_q5_0), "wrong q5_0x8 block size/padding");
+static_assert(sizeof(block_q8_0x8) == 8 * sizeof(block_q8_0), "wrong q8_0x8 block size/padding");
+
 #if defined(__GNUC__)
 #pragma GCC diagnostic ignored "-Woverlength-strings"
 #elif defined(_MSC_VER)
@@ -526,6 +536,45 @@ static void ggml_quantize_mat_q8_0_4x8(const float * GGML_RESTRICT x, void * GGM
 #endif
         }
     }
+#elif defined(__wasm_simd128__)
+    for (int i = 0; i < nb; i++) {
+        v128_t srcv[4][8];
+        float id[4];
+
+        for (int row_iter = 0; row_iter < 4; row_iter++) {
+            v128_t amaxv = wasm_f32x4_splat(0.0f);
+            for (int j = 0; j < 8; j++) {
+                srcv[row_iter][j] = wasm_v128_load(x + row_iter * k + i * 32 + 4 * j);
+                amaxv = wasm_f32x4_max(amaxv, wasm_f32x4_abs(srcv[row_iter][j]));
+            }
+
+            const float amax = MAX(MAX(wasm_f32x4_extract_lane(amaxv, 0), wasm_f32x4_extract_lane(amaxv, 1)),
+                                   MAX(wasm_f32x4_extract_lane(amaxv, 2), wasm_f32x4_extract_lane(amaxv, 3)));
+
+            const float d = amax / ((1 << 7) - 1);
+            id[row_iter] = d ? 1.0f / d : 0.0f;
+
+            y[i].d[row_iter] = GGML_FP32_TO_FP16(d);
+        }
+
+        // round to nearest like vcvtnq_s32_f32, then narrow two rows of 8 quants to 16 bytes
+        for (int j = 0; j < 4; j++) {
+            v128_t vi[4][2];
+            for (int row_iter = 0; row_iter < 4; row_iter++) {
+                const v128_t vid = wasm_f32x4_splat(id[row_iter]);
+                for (int h = 0; h < 2; h++) {
+                    vi[row_iter][h] = wasm_i32x4_trunc_sat_f32x4(wasm_f32x4_nearest(wasm_f32x4_mul(srcv[row_iter][2 * j + h], vid)));
+                }
+            }
+
+            for (int row_iter = 0; row_iter < 4; row_iter += 2) {
+                const v128_t r0 = wasm_i16x8_narrow_i32x4(vi[row_iter + 0][0], vi[row_iter + 0][1]);
+                const v128_t r1 = wasm_i16x8_narrow_i32x4(vi[row_iter + 1][0], vi[row_iter + 1][1]);
+
+                wasm_v128_store(y[i].qs + 32 * j + 8 * row_iter, wasm_i8x16_narrow_i16x8(r0, r1));
+            }
+        }
+    }
 #else
     // scalar
     const int blck_size_interleave = 8;
@@ -844,6 +893,226 @@ template <> void ggml_quantize_mat_t<8, GGML_TYPE_Q8_K>(const float * GGML_RESTR
     ggml_quantize_mat_q8_K_4x8(x, vy, n_per_row);
 }
 
+#if defined(__wasm_simd128__)
+// wasm simd128 kernels of the layouts interleaved 8 columns at a time: Q4_0 (block_q4_0x8, 8 bytes per column),
+// Q5_0 and Q8_0 (block_q5_0x8 and block_q8_0x8, see ggml_x8_index)
+//
+// the quants of a block are unpacked to bytes as w[k][p]: the elements 8*k .. 8*k + 7 of the columns 2*p and 2*p + 1,
+// which multiply the same 8 activations loaded into both halves of a vector
+//
+// with relaxed-simd the 4-bit and 5-bit quants are the 7-bit operand of i32x4.relaxed_dot_i8x16_i7x16_add. it must not
+// be negative (x86 uses pmaddubsw, which treats it as unsigned), so they are unpacked without the bias and bias times the
+// sum of the activations is subtracted, like mul_sum_us8_pairs on AVX. otherwise the quants are unpacked signed and
+// Q8_0 always uses the exact i16 dot product
+
+template <typename block_x8> struct ggml_x8_wasm_bias { static constexpr int value = 0; };
+template <> struct ggml_x8_wasm_bias<block_q4_0x8>    { static constexpr int value = 8; };
+template <> struct ggml_x8_wasm_bias<block_q5_0x8>    { static constexpr int value = 16; };
+
+static inline void ggml_x8_unpack_wasm(const block_q4_0x8 * b, v128_t w[4][4]) {
+#if defined(__wasm_relaxed_simd__)
+    // the nibbles are stored xor 0x88, flipping bit 3 back gives the quants in [0, 15]
+    const v128_t m4b = wasm_i8x16_splat(0x0F);
+    const v128_t s8b = wasm_i8x16_splat(0x08);
+
+    for (int k = 0; k < 2; k++) {
+        for (int p = 0; p < 4; p++) {
+            const v128_t q = wasm_v128_load(b->qs + 64 * k + 16 * p);
+
+            w[k + 0][p] = wasm_v128_xor(wasm_v128_and(q, m4b), s8b);
+            w[k + 2][p] = wasm_v128_xor(wasm_u8x16_shr(q, 4), s8b);
+        }
+    }
+#else
+    // the nibbles are stored xor 0x88, sign extending them gives the quants minus 8
+    for (int k = 0; k < 2; k++) {
+        for (int p = 0; p < 4; p++) {
+            const v128_t q = wasm_v128_load(b->qs + 64 * k + 16 * p);
+
+            w[k + 0][p] = wasm_i8x16_shr(wasm_i8x16_shl(q, 4), 4);
+            w[k + 2][p] = wasm_i8x16_shr(q, 4);
+        }
+    }
+#endif
+}
+
+static inline void ggml_x8_unpack_wasm(const block_q8_0x8 * b, v128_t w[4][4]) {
+    for (int k = 0; k < 4; k++) {
+        for (int p = 0; p < 4; p++) {
+            w[k][p] = wasm_v128_load(b->qs + 32 * (2 * k + (p & 1)) + 16 * (p >> 1));
+        }
+    }
+}
+
+static inline void ggml_x8_unpack_wasm(const block_q5_0x8 * b, v128_t w[4][4]) {
+    const v128_t m4b = wasm_i8x16_splat(0x0F);
+    const v128_t mhb = wasm_i8x16_splat(0x10);
+
+    const v128_t qh[2] = { wasm_v128_load(b->qh), wasm_v128_load(b->qh + 16) };
+
+    for (int k = 0; k < 4; k++) {
+        for (int p = 0; p < 4; p++) {
+            const int g = 2 * k + (p & 1);
+            const int c = p >> 1;
+
+            const v128_t q   = wasm_v128_load(b->qs + 32 * (g & 3) + 16 * c);
+            const v128_t nib = g < 4 ? wasm_v128_and(q, m4b) : wasm_u8x16_shr(q, 4);
+
+            // bit g of every qh byte moved to bit 4
+            const v128_t hb = g <= 4 ? wasm_i8x16_shl(qh[c], 4 - g) : wasm_u8x16_shr(qh[c], g - 4);
+
+#if defined(__wasm_relaxed_simd__)
+            // the quants in [0, 31]
+            w[k][p] = wasm_v128_or(nib, wasm_v128_and(hb, mhb));
+#else
+            w[k][p] = wasm_i8x16_sub(wasm_v128_or(nib, wasm_v128_and(hb, mhb)), mhb);
+#endif
+        }
+    }
+}
+
+// the sums of the 4 lanes of a, b, c and d
+static inline v128_t ggml_x8_hsum4_wasm(v128_t a, v128_t b, v128_t c, v128_t d) {
+    const v128_t ab = wasm_i32x4_add(wasm_i32x4_shuffle(a, b, 0, 4, 1, 5), wasm_i32x4_shuffle(a, b, 2, 6, 3, 7));
+    const v128_t cd = wasm_i32x4_add(wasm_i32x4_shuffle(c, d, 0, 4, 1, 5), wasm_i32x4_shuffle(c, d, 2, 6, 3, 7));
+
+    return wasm_i32x4_add(wasm_i32x4_shuffle(ab, cd, 0, 1, 4, 5), wasm_i32x4_shuffle(ab, cd, 2, 3, 6, 7));
+}
+
+// integer dot products of the 8 columns of a block with one row of activations, the group k of the row is at
+// a + k*stride - the results are the columns 0-3 and 4-7
+template <int bias>
+static inline void ggml_x8_dot_wasm(const v128_t w[4][4], const int8_t * a, int stride, v128_t & res_0, v128_t & res_1) {
+#if defined(__wasm_relaxed_simd__)
+    if (bias > 0) {
+        const v128_t vbias = wasm_i8x16_splat(bias);
+
+        v128_t acc[4] = { wasm_i32x4_splat(0), wasm_i32x4_splat(0), wasm_i32x4_splat(0), wasm_i32x4_splat(0) };
+        v128_t off    = wasm_i32x4_splat(0);
+
+        for (int k = 0; k < 4; k++) {
+            const v128_t av = wasm_v128_load64_splat(a + k * stride);
+
+            for (int p = 0; p < 4; p++) {
+                acc[p] = wasm_i32x4_relaxed_dot_i8x16_i7x16_add(av, w[k][p], acc[p]);
+            }
+
+            off = wasm_i32x4_relaxed_dot_i8x16_i7x16_add(av, vbias, off);
+        }
+
+        // acc[p] holds the column 2*p in the lanes 0, 1 and the column 2*p + 1 in the lanes 2, 3, off holds bias times
+        // the sum of the activations in the lanes 0, 1 and again in the lanes 2, 3
+        off = wasm_i32x4_add(off, wasm_i32x4_shuffle(off, off, 1, 0, 3, 2));
+
+        res_0 = wasm_i32x4_add(wasm_i32x4_shuffle(acc[0], acc[1], 0, 2, 4, 6), wasm_i32x4_shuffle(acc[0], acc[1], 1, 3, 5, 7));
+        res_1 = wasm_i32x4_add(wasm_i32x4_shuffle(acc[2], acc[3], 0, 2, 4, 6), wasm_i32x4_shuffle(acc[2], acc[3], 1, 3, 5, 7));
+
+        res_0 = wasm_i32x4_sub(res_0, off);
+        res_1 = wasm_i32x4_sub(res_1, off);
+        return;
+    }
+#endif
+    v128_t acc[8];
+    for (int j = 0; j < 8; j++) {
+        acc[j] = wasm_i32x4_splat(0);
+    }
+
+    for (int k = 0; k < 4; k++) {
+        const v128_t av = wasm_i16x8_load8x8(a + k * stride);
+
+        for (int p = 0; p < 4; p++) {
+            acc[2 * p + 0] = wasm_i32x4_add(acc[2 * p + 0], wasm_i32x4_dot_i16x8(wasm_i16x8_extend_low_i8x16 (w[k][p]), av));
+            acc[2 * p + 1] = wasm_i32x4_add(acc[2 * p + 1], wasm_i32x4_dot_i16x8(wasm_i16x8_extend_high_i8x16(w[k][p]), av));
+        }
+    }
+
+    res_0 = ggml_x8_hsum4_wasm(acc[0], acc[1], acc[2], acc[3]);
+    res_1 = ggml_x8_hsum4_wasm(acc[4], acc[5], acc[6], acc[7]);
+}
+
+template <typename block_x8>
+static void ggml_gemv_x8_q8_0_wasm(int nb, float * GGML_RESTRICT s, const void * GGML_RESTRICT vx, const void * GGML_RESTRICT vy, int nc) {
+    const block_q8_0 * a_ptr = (const block_q8_0 *) vy;
+
+    for (int x = 0; x < nc / 8; x++) {
+        const block_x8 * b_ptr = (const block_x8 *) vx + (x * nb);
+
+        v128_t acc_0 = wasm_f32x4_splat(0.0f);
+        v128_t acc_1 = wasm_f32x4_splat(0.0f);
+
+        for (int l = 0; l < nb; l++) {
+            v128_t w[4][4];
+            ggml_x8_unpack_wasm(b_ptr + l, w);
+
+            v128_t sumi_0;
+            v128_t sumi_1;
+            ggml_x8_dot_wasm<ggml_x8_wasm_bias<block_x8>::value>(w, a_ptr[l].qs, 8, sumi_0, sumi_1);
+
+            float col_scale[8];
+            for (int j = 0; j < 8; j++) {
+                col_scale[j] = GGML_FP16_TO_FP32(b_ptr[l].d[j]);
+            }
+
+            const v128_t row_scale = wasm_f32x4_splat(GGML_FP16_TO_FP32(a_ptr[l].d));
+
+            acc_0 = wasm_f32x4_add(acc_0, wasm_f32x4_mul(wasm_f32x4_convert_i32x4(sumi_0), wasm_f32x4_mul(wasm_v128_load(col_scale + 0), row_scale)));
+            acc_1 = wasm_f32x4_add(acc_1, wasm_f32x4_mul(wasm_f32x4_convert_i32x4(sumi_1), wasm_f32x4_mul(wasm_v128_load(col_scale + 4), row_scale)));
+        }
+
+        wasm_v128_store(s + x * 8 + 0, acc_0);
+        wasm_v128_store(s + x * 8 + 4, acc_1);
+    }
+}
+
+template <typename block_x8>
+static void ggml_gemm_x8_q8_0_wasm(int nb, float * GGML_RESTRICT s, size_t bs, const void * GGML_RESTRICT vx, const void * GGML_RESTRICT vy, int nr, int nc) {
+    for (int y = 0; y < nr / 4; y++) {
+        const block_q8_0x4 * a_ptr = (const block_q8_0x4 *) vy + (y * nb);
+
+        for (int x = 0; x < nc / 8; x++) {
+            const block_x8 * b_ptr = (const block_x8 *) vx + (x * nb);
+
+            v128_t acc[4][2];
+            for (int m = 0; m < 4; m++) {
+                acc[m][0] = wasm_f32x4_splat(0.0f);
+                acc[m][1] = wasm_f32x4_splat(0.0f);
+            }
+
+            for (int l = 0; l < nb; l++) {
+                // the unpacked weights are shared by the 4 rows
+                v128_t w[4][4];
+                ggml_x8_unpack_wasm(b_ptr + l, w);
+
+                float col_scale[8];
+                for (int j = 0; j < 8; j++) {
+                    col_scale[j] = GGML_FP16_TO_FP32(b_ptr[l].d[j]);
+                }
+
+                const v128_t col_scale_0 = wasm_v128_load(col_scale + 0);
+                const v128_t col_scale_1 = wasm_v128_load(col_scale + 4);
+
+                for (int m = 0; m < 4; m++) {
+                    // block_q8_0x4 interleaves the 4 rows in blocks of 8 bytes
+                    v128_t sumi_0;
+                    v128_t sumi_1;
+                    ggml_x8_dot_wasm<ggml_x8_wasm_bias<block_x8>::value>(w, a_ptr[l].qs + 8 * m, 32, sumi_0, sumi_1);
+
+                    const v128_t row_scale = wasm_f32x4_splat(GGML_FP16_TO_FP32(a_ptr[l].d[m]));
+
+                    acc[m][0] = wasm_f32x4_add(acc[m][0], wasm_f32x4_mul(wasm_f32x4_convert_i32x4(sumi_0), wasm_f32x4_mul(col_scale_0, row_scale)));
+                    acc[m][1] = wasm_f32x4_add(acc[m][1], wasm_f32x4_mul(wasm_f32x4_convert_i32x4(sumi_1), wasm_f32x4_mul(col_scale_1, row_scale)));
+                }
+            }
+
+            for (int m = 0; m < 4; m++) {
+                wasm_v128_store(s + (y * 4 + m) * bs + x * 8 + 0, acc[m][0]);
+                wasm_v128_store(s + (y * 4 + m) * bs + x * 8 + 4, acc[m][1]);
+            }
+        }
+    }
+}
+#endif // defined(__wasm_simd128__)
+
 static void ggml_gemv_q4_0_4x4_q8_0(int n, float * GGML_RESTRICT s, size_t bs, const void * GGML_RESTRICT vx, const void * GGML_RESTRICT vy, int nr, int nc) {
     const int qk = QK8_0;
     const int nb = n / qk;
@@ -1264,6 +1533,9 @@ static void ggml_gemv_q4_0_8x8_q8_0(int n, float * GGML_RESTRICT s, size_t bs, c
         }
         return;
     }
+#elif defined(__wasm_simd128__)
+    ggml_gemv_x8_q8_0_wasm<block_q4_0x8>(nb, s, vx, vy, nc);
+    return;
 #endif // #if ! ((defined(_MSC_VER)) && ! defined(__clang__)) && defined(__aarch64__)
     {
         float sumf[8];
@@ -1663,6 +1935,267 @@ static void ggml_gemv_iq4_nl_4x4_q8_0(int n, float * GGML_RESTRICT s, size_t bs,
     }
 }
 
+// Q5_0 and Q8_0 interleaved 8 columns at a time (block_q5_0x8, block_q8_0x8)
+//
+// the 256 quants of a block form 8 groups of 32 bytes: group g = 2*k + h holds the elements 8*k .. 8*k + 7
+// of the columns { 0, 1, 4, 5 } (h = 0) or { 2, 3, 6, 7 } (h = 1), 8 bytes per column, so that the 32-bit
+// pair sums of the two halves reduce with a single _mm256_hadd_epi32 to the 8 columns in their natural order
+//
+// the quants are multiplied with the activations as signed bytes (Q8_0 as stored, Q5_0 after subtracting 16)
+
+static inline void ggml_x8_index(int col, int e, int & g, int & i) {
+    g = 2 * (e / 8) + ((col >> 1) & 1);
+    i = 8 * ((col & 1) + 2 * (col >> 2)) + e % 8;
+}
+
+static inline int ggml_x8_quant(const block_q8_0x8 & b, int col, int e) {
+    int g, i;
+    ggml_x8_index(col, e, g, i);
+
+    return b.qs[32 * g + i];
+}
+
+static inline int ggml_x8_quant(const block_q5_0x8 & b, int col, int e) {
+    int g, i;
+    ggml_x8_index(col, e, g, i);
+
+    const int q = g < 4 ? (b.qs[32 * g + i] & 0x0F) : (b.qs[32 * (g - 4) + i] >> 4);
+    const int h = (b.qh[i] >> g) & 1;
+
+    return (q | (h << 4)) - 16;
+}
+
+template <typename block_x8>
+static void ggml_gemv_x8_q8_0_ref(int nb, float * GGML_RESTRICT s, const void * GGML_RESTRICT vx, const void * GGML_RESTRICT vy, int nc) {
+    const block_q8_0 * a_ptr = (const block_q8_0 *) vy;
+
+    for (int x = 0; x < nc / 8; x++) {
+        const block_x8 * b_ptr = (const block_x8 *) vx + (x * nb);
+
+        float sumf[8] = { 0.0f };
+
+        for (int l = 0; l < nb; l++) {
+            for (int j = 0; j < 8; j++) {
+                int sumi = 0;
+                for (int e = 0; e < QK8_0; e++) {
+                    sumi += ggml_x8_quant(b_ptr[l], j, e) * a_ptr[l].qs[e];
+                }
+                sumf[j] += sumi * GGML_FP16_TO_FP32(b_ptr[l].d[j]) * GGML_FP16_TO_FP32(a_ptr[l].d);
+            }
+        }
+
+        for (int j = 0; j < 8; j++) s[x * 8 + j] = sumf[j];
+    }
+}
+
+template <typename block_x8>
+static void ggml_gemm_x8_q8_0_ref(int nb, float * GGML_RESTRICT s, size_t bs, const void * GGML_RESTRICT vx, const void * GGML_RESTRICT vy, int nr, int nc) {
+    for (int y = 0; y < nr / 4; y++) {
+        const block_q8_0x4 * a_ptr = (const block_q8_0x4 *) vy + (y * nb);
+
+        for (int x = 0; x < nc / 8; x++) {
+            const block_x8 * b_ptr = (const block_x8 *) vx + (x * nb);
+
+            float sumf[4][8] = { { 0.0f } };
+
+            for (int l = 0; l < nb; l++) {
+                for (int m = 0; m < 4; m++) {
+                    for (int j = 0; j < 8; j++) {
+                        int sumi = 0;
+                        for (int e = 0; e < QK8_0; e++) {
+                            // block_q8_0x4 interleaves the 4 rows in blocks of 8 bytes
+                            sumi += ggml_x8_quant(b_ptr[l], j, e) * a_ptr[l].qs[(e / 8) * 32 + m * 8 + e % 8];
+                        }
+                        sumf[m][j] += sumi * GGML_FP16_TO_FP32(b_ptr[l].d[j]) * GGML_FP16_TO_FP32(a_ptr[l].d[m]);
+                    }
+                }
+            }
+
+            for (int m = 0; m < 4; m++) {
+                for (int j = 0; j < 8; j++) s[(y * 4 + m) * bs + x * 8 + j] = sumf[m][j];
+            }
+        }
+    }
+}
+
+#if defined(__AVX2__)
+static inline void ggml_x8_unpack_avx2(const block_q8_0x8 * b, __m256i * w) {
+    for (int g = 0; g < 8; g++) {
+        w[g] = _mm256_loadu_si256((const __m256i *) (b->qs + 32 * g));
+    }
+}
+
+static inline void ggml_x8_unpack_avx2(const block_q5_0x8 * b, __m256i * w) {
+    const __m256i m4b = _mm256_set1_epi8(0x0F);
+    const __m256i mhb = _mm256_set1_epi8(0x10);
+    const __m256i off = _mm256_set1_epi8(16);
+
+    const __m256i qh = _mm256_loadu_si256((const __m256i *) b->qh);
+
+    // move bit g of every qh byte to bit 4
+    const __m256i hb[8] = {
+        _mm256_slli_epi16(qh, 4), _mm256_slli_epi16(qh, 3), _mm256_slli_epi16(qh, 2), _mm256_slli_epi16(qh, 1),
+        qh,                       _mm256_srli_epi16(qh, 1), _mm256_srli_epi16(qh, 2), _mm256_srli_epi16(qh, 3),
+    };
+
+    for (int g = 0; g < 4; g++) {
+        const __m256i q = _mm256_loadu_si256((const __m256i *) (b->qs + 32 * g));
+
+        w[g + 0] = _mm256_sub_epi8(_mm256_or_si256(_mm256_and_si256(q, m4b),                        _mm256_and_si256(hb[g + 0], mhb)), off);
+        w[g + 4] = _mm256_sub_epi8(_mm256_or_si256(_mm256_and_si256(_mm256_srli_epi16(q, 4), m4b), _mm256_and_si256(hb[g + 4], mhb)), off);
+    }
+}
+
+// broadcast the 8 activations of one group to all 4 columns of a half
+static inline __m256i ggml_x8_load_a_avx2(const int8_t * qs) {
+    int64_t a;
+    memcpy(&a, qs, sizeof(a));
+    return _mm256_set1_epi64x(a);
+}
+
+template <typename block_x8>
+static void ggml_gemv_x8_q8_0_avx2(int nb, float * GGML_RESTRICT s, const void * GGML_RESTRICT vx, const void * GGML_RESTRICT vy, int nc) {
+    const block_q8_0 * a_ptr = (const block_q8_0 *) vy;
+
+    for (int x = 0; x < nc / 8; x++) {
+        const block_x8 * b_ptr = (const block_x8 *) vx + (x * nb);
+
+        __m256 acc = _mm256_setzero_ps();
+
+        for (int l = 0; l < nb; l++) {
+            __m256i w[8];
+            ggml_x8_unpack_avx2(b_ptr + l, w);
+
+            __m256i iacc_0 = _mm256_setzero_si256();
+            __m256i iacc_1 = _mm256_setzero_si256();
+
+            for (int k = 0; k < 4; k++) {
+                const __m256i a = ggml_x8_load_a_avx2(a_ptr[l].qs + 8 * k);
+
+                iacc_0 = _mm256_add_epi32(iacc_0, mul_sum_i8_pairs_int32x8(w[2 * k + 0], a));
+                iacc_1 = _mm256_add_epi32(iacc_1, mul_sum_i8_pairs_int32x8(w[2 * k + 1], a));
+            }
+
+            const __m256 scale = _mm256_mul_ps(GGML_F32Cx8_LOAD(b_ptr[l].d), _mm256_set1_ps(GGML_FP16_TO_FP32(a_ptr[l].d)));
+
+            acc = _mm256_fmadd_ps(_mm256_cvtepi32_ps(_mm256_hadd_epi32(iacc_0, iacc_1)), scale, acc);
+        }
+
+        _mm256_storeu_ps(s + x * 8, acc);
+    }
+}
+#endif // defined(__AVX2__)
+
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+static inline void ggml_x8_unpack_avx512(const block_q8_0x8 * b, __m512i * w) {
+    for (int k = 0; k < 4; k++) {
+        w[k] = _mm512_loadu_si512((const __m512i *) (b->qs + 64 * k));
+    }
+}
+
+// w[k] holds the groups 2*k and 2*k + 1
+static inline void ggml_x8_unpack_avx512(const block_q5_0x8 * b, __m512i * w) {
+    const __m512i m4b = _mm512_set1_epi8(0x0F);
+    const __m512i off = _mm512_set1_epi8(16);
+
+    const __m512i qh = _mm512_broadcast_i64x4(_mm256_loadu_si256((const __m256i *) b->qh));
+
+    for (int k = 0; k < 4; k++) {
+        const __m512i q   = _mm512_loadu_si512((const __m512i *) (b->qs + 64 * (k & 1)));
+        const __m512i nib = k < 2 ? _mm512_and_si512(q, m4b) : _mm512_and_si512(_mm512_srli_epi16(q, 4), m4b);
+
+        const __m512i sel = _mm512_mask_blend_epi64(0xF0, _mm512_set1_epi8((char) (1 << (2 * k))), _mm512_set1_epi8((char) (1 << (2 * k + 1))));
+
+        // quants without the 5-th bit are negative
+        w[k] = _mm512_mask_sub_epi8(nib, _mm512_testn_epi8_mask(qh, sel), nib, off);
+    }
+}
+
+static inline __m512i ggml_x8_load_a_avx512(const int8_t * qs) {
+    int64_t a;
+    memcpy(&a, qs, sizeof(a));
+    return _mm512_set1_epi64(a);
+}
+
+static inline __m256 ggml_x8_hsum_avx512(const __m512i iacc) {
+    return _mm256_cvtepi32_ps(_mm256_hadd_epi32(_mm512_castsi512_si256(iacc), _mm512_extracti64x4_epi64(iacc, 1)));
+}
+
+template <typename block_x8>
+static void ggml_gemv_x8_q8_0_avx512(int nb, float * GGML_RESTRICT s, const void * GGML_RESTRICT vx, const void * GGML_RESTRICT vy, int nc) {
+    const block_q8_0 * a_ptr = (const block_q8_0 *) vy;
+
+    for (int x = 0; x < nc / 8; x++) {
+        const block_x8 * b_ptr = (const block_x8 *) vx + (x * nb);
+
+        __m256 acc = _mm256_setzero_ps();
+
+        for (int l = 0; l < nb; l++) {
+            __m512i w[4];
+            ggml_x8_unpack_avx512(b_ptr + l, w);
+
+            __m512i iacc = _mm512_setzero_si512();
+
+            for (int k = 0; k < 4; k++) {
+                iacc = _mm512_add_epi32(iacc, mul_sum_i8_pairs_int32x16(w[k], ggml_x8_load_a_avx512(a_ptr[l].qs + 8 * k)));
+            }
+
+            const __m256 scale = _mm256_mul_ps(GGML_F32Cx8_LOAD(b_ptr[l].d), _mm256_set1_ps(GGML_FP16_TO_FP32(a_ptr[l].d)));
+
+            acc = _mm256_fmadd_ps(ggml_x8_hsum_avx512(iacc), scale, acc);
+        }
+
+        _mm256_storeu_ps(s + x * 8, acc);
+    }
+}
+#endif // defined(__AVX512F__) && defined(__AVX512BW__)
+
+static void ggml_gemv_q5_0_8x8_q8_0(int n, float * GGML_RESTRICT s, size_t bs, const void * GGML_RESTRICT vx, const void * GGML_RESTRICT vy, int nr, int nc) {
+    const int qk = QK8_0;
+    const int nb = n / qk;
+    const int ncols_interleaved = 8;
+
+    assert (n % qk == 0);
+    assert (nc % ncols_interleaved == 0);
+
+    UNUSED(bs);
+    UNUSED(nr);
+    UNUSED(ncols_interleaved);
+
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+    ggml_gemv_x8_q8_0_avx512<block_q5_0x8>(nb, s, vx, vy, nc);
+#elif defined(__AVX2__)
+    ggml_gemv_x8_q8_0_avx2<block_q5_0x8>(nb, s, vx, vy, nc);
+#elif defined(__wasm_simd128__)
+    ggml_gemv_x8_q8_0_wasm<block_q5_0x8>(nb, s, vx, vy, nc);
+#else
+    ggml_gemv_x8_q8_0_ref<block_q5_0x8>(nb, s, vx, vy, nc);
+#endif
+}
+
+static void ggml_gemv_q8_0_8x8_q8_0(int n, float * GGML_RESTRICT s, size_t bs, const void * GGML_RESTRICT vx, const void * GGML_RESTRICT vy, int nr, int nc) {
+    const int qk = QK8_0;
+    const int nb = n / qk;
+    const int ncols_interleaved = 8;
+
+    assert (n % qk == 0);
+    assert (nc % ncols_interleaved == 0);
+
+    UNUSED(bs);
+    UNUSED(nr);
+    UNUSED(ncols_interleaved);
+
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+    ggml_gemv_x8_q8_0_avx512<block_q8_0x8>(nb, s, vx, vy, nc);
+#elif defined(__AVX2__)
+    ggml_gemv_x8_q8_0_avx2<block_q8_0x8>(nb, s, vx, vy, nc);
+#elif defined(__wasm_simd128__)
+    ggml_gemv_x8_q8_0_wasm<block_q8_0x8>(nb, s, vx, vy, nc);
+#else
+    ggml_gemv_x8_q8_0_ref<block_q8_0x8>(nb, s, vx, vy, nc);
+#endif
+}
+
 static void ggml_gemm_q4_0_4x4_q8_0(int n, float * GGML_RESTRICT s, size_t bs, const void * GGML_RESTRICT vx, const void * GGML_RESTRICT vy, int nr, int nc) {
     const int qk = QK8_0;
     const int nb = n / qk;
@@ -4018,6 +4551,9 @@ static void ggml_gemm_q4_0_8x8_q8_0(int n, float * GGML_RESTRICT s, size_t bs, c
 
         return;
     }
+#elif defined(__wasm_simd128__)
+    ggml_gemm_x8_q8_0_wasm<block_q4_0x8>(nb, s, bs, vx, vy, nr, nc);
+    return;
 #endif // #if ! ((defined(_MSC_VER)) && ! defined(__clang__)) && defined(__aarch64__)
     float sumf[4][8];
     int sumi;
@@ -4939,6 +5475,146 @@ static void ggml_gemm_iq4_nl_4x4_q8_0(int n, float * GGML_RESTRICT s, size_t bs,
     }
 }
 
+#if defined(__AVX2__)
+template <typename block_x8>
+static void ggml_gemm_x8_q8_0_avx2(int nb, float * GGML_RESTRICT s, size_t bs, const void * GGML_RESTRICT vx, const void * GGML_RESTRICT vy, int nr, int nc) {
+    for (int y = 0; y < nr / 4; y++) {
+        const block_q8_0x4 * a_ptr = (const block_q8_0x4 *) vy + (y * nb);
+
+        for (int x = 0; x < nc / 8; x++) {
+            const block_x8 * b_ptr = (const block_x8 *) vx + (x * nb);
+
+            __m256 acc[4] = { _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps() };
+
+            for (int l = 0; l < nb; l++) {
+                // the unpacked weights are shared by the 4 rows
+                __m256i w[8];
+                __m256i aw[8];
+                ggml_x8_unpack_avx2(b_ptr + l, w);
+                for (int g = 0; g < 8; g++) {
+                    aw[g] = _mm256_sign_epi8(w[g], w[g]);
+                }
+
+                const __m256 col_scale = GGML_F32Cx8_LOAD(b_ptr[l].d);
+
+                for (int m = 0; m < 4; m++) {
+                    __m256i iacc_0 = _mm256_setzero_si256();
+                    __m256i iacc_1 = _mm256_setzero_si256();
+
+                    for (int k = 0; k < 4; k++) {
+                        const __m256i a = ggml_x8_load_a_avx2(a_ptr[l].qs + 32 * k + 8 * m);
+
+                        iacc_0 = _mm256_add_epi32(iacc_0, mul_sum_us8_pairs_int32x8(aw[2 * k + 0], _mm256_sign_epi8(a, w[2 * k + 0])));
+                        iacc_1 = _mm256_add_epi32(iacc_1, mul_sum_us8_pairs_int32x8(aw[2 * k + 1], _mm256_sign_epi8(a, w[2 * k + 1])));
+                    }
+
+                    const __m256 scale = _mm256_mul_ps(col_scale, _mm256_set1_ps(GGML_FP16_TO_FP32(a_ptr[l].d[m])));
+
+                    acc[m] = _mm256_fmadd_ps(_mm256_cvtepi32_ps(_mm256_hadd_epi32(iacc_0, iacc_1)), scale, acc[m]);
+                }
+            }
+
+            for (int m = 0; m < 4; m++) {
+                _mm256_storeu_ps(s + (y * 4 + m) * bs + x * 8, acc[m]);
+            }
+        }
+    }
+}
+#endif // defined(__AVX2__)
+
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+template <typename block_x8>
+static void ggml_gemm_x8_q8_0_avx512(int nb, float * GGML_RESTRICT s, size_t bs, const void * GGML_RESTRICT vx, const void * GGML_RESTRICT vy, int nr, int nc) {
+    const __m512i zero = _mm512_setzero_si512();
+
+    for (int y = 0; y < nr / 4; y++) {
+        const block_q8_0x4 * a_ptr = (const block_q8_0x4 *) vy + (y * nb);
+
+        for (int x = 0; x < nc / 8; x++) {
+            const block_x8 * b_ptr = (const block_x8 *) vx + (x * nb);
+
+            __m256 acc[4] = { _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps() };
+
+            for (int l = 0; l < nb; l++) {
+                // the unpacked weights are shared by the 4 rows
+                __m512i   w[4];
+                __m512i   aw[4];
+                __mmask64 sw[4];
+                ggml_x8_unpack_avx512(b_ptr + l, w);
+                for (int k = 0; k < 4; k++) {
+                    aw[k] = _mm512_abs_epi8(w[k]);
+                    sw[k] = _mm512_movepi8_mask(w[k]);
+                }
+
+                const __m256 col_scale = GGML_F32Cx8_LOAD(b_ptr[l].d);
+
+                for (int m = 0; m < 4; m++) {
+                    __m512i iacc = _mm512_setzero_si512();
+
+                    for (int k = 0; k < 4; k++) {
+                        const __m512i a = ggml_x8_load_a_avx512(a_ptr[l].qs + 32 * k + 8 * m);
+
+                        iacc = _mm512_add_epi32(iacc, mul_sum_us8_pairs_int32x16(aw[k], _mm512_mask_sub_epi8(a, sw[k], zero, a)));
+                    }
+
+                    const __m256 scale = _mm256_mul_ps(col_scale, _mm256_set1_ps(GGML_FP16_TO_FP32(a_ptr[l].d[m])));
+
+                    acc[m] = _mm256_fmadd_ps(ggml_x8_hsum_avx512(iacc), scale, acc[m]);
+                }
+            }
+
+            for (int m = 0; m < 4; m++) {
+                _mm256_storeu_ps(s + (y * 4 + m) * bs + x * 8, acc[m]);
+            }
+        }
+    }
+}
+#endif // defined(__AVX512F__) && defined(__AVX512BW__)
+
+static void ggml_gemm_q5_0_8x8_q8_0(int n, float * GGML_RESTRICT s, size_t bs, const void * GGML_RESTRICT vx, const void * GGML_RESTRICT vy, int nr, int nc) {
+    const int qk = QK8_0;
+    const int nb = n / qk;
+    const int ncols_interleaved = 8;
+
+    assert (n % qk == 0);
+    assert (nr % 4 == 0);
+    assert (nc % ncols_interleaved == 0);
+
+    UNUSED(ncols_interleaved);
+
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+    ggml_gemm_x8_q8_0_avx512<block_q5_0x8>(nb, s, bs, vx, vy, nr, nc);
+#elif defined(__AVX2__)
+    ggml_gemm_x8_q8_0_avx2<block_q5_0x8>(nb, s, bs, vx, vy, nr, nc);
+#elif defined(__wasm_simd128__)
+    ggml_gemm_x8_q8_0_wasm<block_q5_0x8>(nb, s, bs, vx, vy, nr, nc);
+#else
+    ggml_gemm_x8_q8_0_ref<block_q5_0x8>(nb, s, bs, vx, vy, nr, nc);
+#endif
+}
+
+static void ggml_gemm_q8_0_8x8_q8_0(int n, float * GGML_RESTRICT s, size_t bs, const void * GGML_RESTRICT vx, const void * GGML_RESTRICT vy, int nr, int nc) {
+    const int qk = QK8_0;
+    const int nb = n / qk;
+    const int ncols_interleaved = 8;
+
+    assert (n % qk == 0);
+    assert (nr % 4 == 0);
+    assert (nc % ncols_interleaved == 0);
+
+    UNUSED(ncols_interleaved);
+
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+    ggml_gemm_x8_q8_0_avx512<block_q8_0x8>(nb, s, bs, vx, vy, nr, nc);
+#elif defined(__AVX2__)
+    ggml_gemm_x8_q8_0_avx2<block_q8_0x8>(nb, s, bs, vx, vy, nr, nc);
+#elif defined(__wasm_simd128__)
+    ggml_gemm_x8_q8_0_wasm<block_q8_0x8>(nb, s, bs, vx, vy, nr, nc);
+#else
+    ggml_gemm_x8_q8_0_ref<block_q8_0x8>(nb, s, bs, vx, vy, nr, nc);
+#endif
+}
+
 static block_q4_0x4 make_block_q4_0x4(block_q4_0 * in, unsigned int blck_size_interleave) {
     block_q4_0x4 out;
 
@@ -5243,6 +5919,118 @@ static int repack_iq4_nl_to_iq4_nl_4_bl(struct ggml_tensor * t, int interleave_b
     GGML_UNUSED(data_size);
 }
 
+// interleave 8 block_q8_0s into the group layout of block_q8_0x8 (see ggml_x8_index)
+static block_q8_0x8 make_block_q8_0x8(block_q8_0 * in) {
+    block_q8_0x8 out;
+
+    for (int j = 0; j < 8; j++) {
+        out.d[j] = in[j].d;
+    }
+
+    for (int j = 0; j < 8; j++) {
+        for (int e = 0; e < QK8_0; e++) {
+            int g, i;
+            ggml_x8_index(j, e, g, i);
+
+            out.qs[32 * g + i] = in[j].qs[e];
+        }
+    }
+
+    return out;
+}
+
+// interleave 8 block_q5_0s into the group layout of block_q5_0x8 (see ggml_x8_index)
+static block_q5_0x8 make_block_q5_0x8(block_q5_0 * in) {
+    block_q5_0x8 out;
+
+    memset(out.qh, 0, sizeof(out.qh));
+    memset(out.qs, 0, sizeof(out.qs));
+
+    for (int j = 0; j < 8; j++) {
+        out.d[j] = in[j].d;
+    }
+
+    for (int j = 0; j < 8; j++) {
+        uint32_t qh;
+        memcpy(&qh, in[j].qh, sizeof(qh));
+
+        for (int e = 0; e < QK5_0; e++) {
+            const uint8_t q = e < QK5_0/2 ? (in[j].qs[e] & 0x0F) : (in[j].qs[e - QK5_0/2] >> 4);
+            const uint8_t h = (qh >> e) & 1;
+
+            int g, i;
+            ggml_x8_index(j, e, g, i);
+
+            out.qs[32 * (g & 3) + i] |= g < 4 ? q : (q << 4);
+            out.qh[i]                |= h << g;
+        }
+    }
+
+    return out;
+}
+
+static int repack_q8_0_to_q8_0_8_bl(struct ggml_tensor * t, int interleave_block, const void * GGML_RESTRICT data, size_t data_size) {
+    GGML_ASSERT(t->type == GGML_TYPE_Q8_0);
+    GGML_ASSERT(interleave_block == 8);
+    constexpr int nrows_interleaved = 8;
+
+    block_q8_0x8 * dst = (block_q8_0x8 *)t->data;
+    const block_q8_0 * src = (const block_q8_0 *) data;
+    block_q8_0 dst_tmp[8];
+    int nrow = ggml_nrows(t);
+    int nblocks = t->ne[0] / QK8_0;
+
+    GGML_ASSERT(data_size == nrow * nblocks * sizeof(block_q8_0));
+
+    if (t->ne[1] % nrows_interleaved != 0) {
+        return -1;
+    }
+
+    for (int b = 0; b < nrow; b += nrows_interleaved) {
+        for (int64_t x = 0; x < nblocks; x++) {
+            for (int i = 0; i < nrows_interleaved; i++) {
+                dst_tmp[i] = src[x + i * nblocks];
+            }
+            *dst++ = make_block_q8_0x8(dst_tmp);
+        }
+        src += nrows_interleaved * nblocks;
+    }
+    return 0;
+
+    GGML_UNUSED(data_size);
+}
+
+static int repack_q5_0_to_q5_0_8_bl(struct ggml_tensor * t, int interleave_block, const void * GGML_RESTRICT data, size_t data_size) {
+    GGML_ASSERT(t->type == GGML_TYPE_Q5_0);
+    GGML_ASSERT(interleave_block == 8);
+    constexpr int nrows_interleaved = 8;
+
+    block_q5_0x8 * dst = (block_q5_0x8 *)t->data;
+    const block_q5_0 * src = (const block_q5_0 *) data;
+    block_q5_0 dst_tmp[8];
+    int nrow = ggml_nrows(t);
+    int nblocks = t->ne[0] / QK5_0;
+
+    GGML_ASSERT(data_size == nrow * nblocks * sizeof(block_q5_0));
+
+    if (t->ne[1] % nrows_interleaved != 0) {
+        return -1;
+    }
+
+    for (int b = 0; b < nrow; b += nrows_interleaved) {
+        for (int64_t x = 0; x < nblocks; x++) {
+            for (int i = 0; i < nrows_interleaved; i++) {
+                dst_tmp[i] = src[x + i * nblocks];
+            }
+            *dst++ = make_block_q5_0x8(dst_tmp);
+        }
+        src += nrows_interleaved * nblocks;
+    }
+    return 0;
+
+    GGML_UNUSED(data_size);
+}
+
 namespace ggml::cpu::aarch64 {
 // repack
 template <typename BLOC_TYPE, int64_t INTER_SIZE, int64_t NB_COLS>
@@ -5269,6 +6057,14 @@ template <> int repack<block_iq4_nl, 4, 4>(struct ggml_tensor * t, const void *
     return repack_iq4_nl_to_iq4_nl_4_bl(t, 4, data, data_size);
 }
 
+template <> int repack<block_q5_0, 8, 8>(struct ggml_tensor * t, const void * data, size_t data_size) {
+    return repack_q5_0_to_q5_0_8_bl(t, 8, data, data_size);
+}
+
+template <> int repack<block_q8_0, 8, 8>(struct ggml_tensor * t, const void * data, size_t data_size) {
+    return repack_q8_0_to_q8_0_8_bl(t, 8, data, data_size);
+}
+
 // TODO: needs to be revisited
 //template <> int repack<block_iq4_nl, 8, 4>(struct ggml_tensor * t, const void * data, size_t data_size) {
 //    return repack_iq4_nl_to_iq4_nl_4_bl(t, 8, data, data_size);
@@ -5298,6 +6094,14 @@ template <> void gemv<block_iq4_nl, 4, 4, GGML_TYPE_Q8_0>(int n, float * s, size
     ggml_gemv_iq4_nl_4x4_q8_0(n, s, bs, vx, vy, nr, nc);
 }
 
+template <> void gemv<block_q5_0, 8, 8, GGML_TYPE_Q8_0>(int n, float * s, size_t bs, const void * vx, const void * vy, int nr, int nc) {
+    ggml_gemv_q5_0_8x8_q8_0(n, s, bs, vx, vy, nr, nc);
+}
+
+template <> void gemv<block_q8_0, 8, 8, GGML_TYPE_Q8_0>(int n, float * s, size_t bs, const void * vx, const void * vy, int nr, int nc) {
+    ggml_gemv_q8_0_8x8_q8_0(n, s, bs, vx, vy, nr, nc);
+}
+
 // gemm
 template <typename BLOC_TYPE, int64_t INTER_SIZE, int64_t NB_COLS, ggml_type PARAM_TYPE>
 void gemm(int, float *, size_t, const void *, const void *, int, int);
@@ -5322,6 +6126,14 @@ template <> void gemm<block_iq4_nl, 4, 4, GGML_TYPE_Q8_0>(int n, float * s, size
     ggml_gemm_iq4_nl_4x4_q8_0(n, s, bs, vx, vy, nr, nc);
 }
 
+template <> void gemm<block_q5_0, 8, 8, GGML_TYPE_Q8_0>(int n, float * s, size_t bs, const void * vx, const void * vy, int nr, int nc) {
+    ggml_gemm_q5_0_8x8_q8_0(n, s, bs, vx, vy, nr, nc);
+}
+
+template <> void gemm<block_q8_0, 8, 8, GGML_TYPE_Q8_0>(int n, float * s, size_t bs, const void * vx, const void * vy, int nr, int nc) {
+    ggml_gemm_q8_0_8x8_q8_0(n, s, bs, vx, vy, nr, nc);
+}
+
 class tensor_traits_base : public ggml::cpu::tensor_traits {
   public:
     virtual int repack(struct ggml_tensor * t, const void * data, size_t data_size) = 0;
@@ -5576,11 +6388,15 @@ static const tensor_traits<block_q4_K, 8, 8, GGML_TYPE_Q8_K> q4_K_8x8_q8_K;
 // instance for IQ4
 static const tensor_traits<block_iq4_nl, 4, 4, GGML_TYPE_Q8_0> iq4_nl_4x4_q8_0;
 
+// instance for Q5/Q8
+static const tensor_traits<block_q5_0, 8, 8, GGML_TYPE_Q8_0> q5_0_8x8_q8_0;
+static const tensor_traits<block_q8_0, 8, 8, GGML_TYPE_Q8_0> q8_0_8x8_q8_0;
+
 }  // namespace ggml::cpu::aarch64
 
 static const ggml::cpu::tensor_traits * ggml_aarch64_get_optimal_repack_type(const struct ggml_tensor * cur) {
     if (cur->type == GGML_TYPE_Q4_0) {
-        if (ggml_cpu_has_avx2() || (ggml_cpu_has_sve() && ggml_cpu_has_matmul_int8() && ggml_cpu_get_sve_cnt() == QK8_0)) {
+        if (ggml_cpu_has_avx2() || ggml_cpu_has_wasm_simd() || (ggml_cpu_has_sve() && ggml_cpu_has_matmul_int8() && ggml_cpu_get_sve_cnt() == QK8_0)) {
             if (cur->ne[1] % 8 == 0) {
                 return &ggml::cpu::aarch64::q4_0_8x8_q8_0;
             }
@@ -5607,6 +6423,18 @@ static const ggml::cpu::tensor_traits * ggml_aarch64_get_optimal_repack_type(con
                 return &ggml::cpu::aarch64::iq4_nl_4x4_q8_0;
             }
         }
+    } else if (cur->type == GGML_TYPE_Q5_0) {
+        if (ggml_cpu_has_avx2() || ggml_cpu_has_wasm_simd()) {
+            if (cur->ne[1] % 8 == 0) {
+                return &ggml::cpu::aarch64::q5_0_8x8_q8_0;
+            }
+        }
+    } else if (cur->type == GGML_TYPE_Q8_0) {
+        if (ggml_cpu_has_avx2() || ggml_cpu_has_wasm_simd()) {
+            if (cur->ne[1] % 8 == 0) {
+                return &ggml::cpu::aarch64::q8_0_8x8_q8_0;
+            }
+        }
     }
 
     return nullptr;
@@ -5631,6 +6459,20 @@ static void ggml_backend_cpu_aarch64_buffer_set_tensor(ggml_backend_buffer_t buf
     GGML_UNUSED(buffer);
 }
 
+// buffer over data that is already in the repacked layout - the data is used as-is
+static enum ggml_status ggml_backend_cpu_repacked_buffer_init_tensor(ggml_backend_buffer_t buffer, struct ggml_tensor * tensor) {
+    const auto * traits = ggml_aarch64_get_optimal_repack_type(tensor);
+    if (traits == nullptr) {
+        // this CPU would not repack the tensor, so the data cannot be in a layout it can use
+        return GGML_STATUS_FAILED;
+    }
+
+    tensor->extra = (void *) const_cast<ggml::cpu::tensor_traits *>(traits);
+
+    GGML_UNUSED(buffer);
+    return GGML_STATUS_SUCCESS;
+}
+
 static const char * ggml_backend_cpu_aarch64_buffer_type_get_name(ggml_backend_buffer_type_t buft) {
     return "CPU_AARCH64";
 
@@ -5723,3 +6565,60 @@ ggml_backend_buffer_type_t ggml_backend_cpu_aarch64_buffer_type(void) {
 
     return &ggml_backend_cpu_buffer_type_aarch64;
 }
+
+const char * ggml_backend_cpu_repack_isa(void) {
+#ifdef GGML_USE_CPU_AARCH64
+    // the features tested by ggml_aarch64_get_optimal_repack_type - they fully determine the selected layouts
+    // AVX2 and AVX-512 use the same layouts, wasm simd128 with and without relaxed-simd too
+    static const std::string isa = []() {
+        std::string res;
+        const auto add = [&](bool has, const char * name) {
+            if (has) {
+                res += (res.empty() ? "" : "+") + std::string(name);
+            }
+        };
+        add(ggml_cpu_has_avx2(),        "avx2");
+        add(ggml_cpu_has_neon(),        "neon");
+        add(ggml_cpu_has_dotprod(),     "dotprod");
+        add(ggml_cpu_has_matmul_int8(), "i8mm");
+        add(ggml_cpu_has_sve() && ggml_cpu_get_sve_cnt() == QK8_0, "sve256");
+        add(ggml_cpu_has_wasm_simd(),   "wasm_simd128");
+        return res;
+    }();
+
+    return isa.empty() ? nullptr : isa.c_str();
+#else
+    return nullptr;
+#endif
+}
+
+bool ggml_backend_cpu_repack_tensor(const struct ggml_tensor * tensor, const void * data, void * dst) {
+    if (ggml_backend_cpu_repack_isa() == nullptr || ggml_n_dims(tensor) != 2) {
+        return false;
+    }
+
+    auto * traits = (ggml::cpu::aarch64::tensor_traits_base *) const_cast<ggml::cpu::tensor_traits *>(ggml_aarch64_get_optimal_repack_type(tensor));
+    if (traits == nullptr) {
+        return false;
+    }
+
+    struct ggml_tensor tmp = *tensor;
+    tmp.data = dst;
+
+    return traits->repack(&tmp, data, ggml_nbytes(tensor)) == 0;
+}
+
+ggml_backend_buffer_t ggml_backend_cpu_repacked_buffer_from_ptr(void * ptr, size_t size) {
+    ggml_backend_buffer_t buffer = ggml_backend_cpu_buffer_from_ptr(ptr, size);
+
+    if (buffer == nullptr) {
+        return nullptr;
+    }
+
+    // the buffer type selects the repacked kernels (see extra_buffer_type), the data is set with a plain copy
+    buffer->buft              = ggml_backend_cpu_aarch64_buffer_type();
+    buffer->iface.init_tensor = ggml_backend_cpu_repacked_buffer_init_tensor;
+    buffer->iface.get_tensor  = nullptr;
+    buffer->iface.cpy_tensor  = nullptr;
+    return buffer;
+}
@@ -0,0 +1,433 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // for syscall
+#endif
+
+#include "ggml-cpu-profile.h"
+#include "ggml-impl.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#define GGML_CPU_PROFILE_MAX_EVENTS_DEFAULT (1 << 18)
+
+// ops and unary ops share the table
+#define GGML_CPU_PROFILE_N_KEYS (GGML_OP_COUNT + GGML_UNARY_OP_COUNT)
+
+// op of the events of a whole graph
+#define GGML_CPU_PROFILE_OP_GRAPH 0xFF
+
+static_assert(GGML_CPU_PROFILE_N_KEYS < GGML_CPU_PROFILE_OP_GRAPH, "the op of an event does not fit in 8 bits");
+
+struct ggml_cpu_profile_event {
+    int64_t t_start_ns;
+    int64_t t_end_ns;  // end of the computation
+    int64_t t_sync_ns; // end of the barrier
+    int64_t cycles;
+    int64_t cache_misses;
+
+    int64_t ne[3][4]; // node, src0, src1
+
+    int32_t tid;
+    int32_t node_n;
+    int16_t ith;
+    int16_t nth;
+
+    uint8_t key;
+    uint8_t type[3];
+
+    char name[GGML_MAX_NAME];
+};
+
+struct ggml_cpu_profile_op {
+    atomic_int_fast64_t n;       // nodes
+    atomic_int_fast64_t wall_ns; // thread 0, computation and barrier
+    atomic_int_fast64_t cpu_ns;  // all threads, computation
+    atomic_int_fast64_t wait_ns; // all threads, barrier
+    atomic_int_fast64_t cycles;
+    atomic_int_fast64_t cache_misses;
+};
+
+// per OS thread
+struct ggml_cpu_profile_thread {
+    int fd;              // group of cycles and cache misses, -1 if not available
+    int fd_cache_misses; // member of the group
+    int tid;
+};
+
+bool ggml_cpu_profile_enabled = false;
+
+static char    g_path[1024];
+static int64_t g_t_base_ns;
+
+static struct ggml_cpu_profile_event * g_events;
+static size_t                          g_events_max;
+static atomic_size_t                   g_n_events;
+
+static struct ggml_cpu_profile_op g_ops[GGML_CPU_PROFILE_N_KEYS];
+
+static atomic_int_fast64_t g_n_graphs;
+static atomic_int_fast64_t g_graph_ns;
+
+static bool          g_counters = false;
+static pthread_key_t g_thread_key;
+
+static int64_t ggml_cpu_profile_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec*1000000000 + ts.tv_nsec;
+}
+
+static void ggml_cpu_profile_thread_free(void * data) {
+    struct ggml_cpu_profile_thread * thread = (struct ggml_cpu_profile_thread *) data;
+    if (thread->fd_cache_misses >= 0) {
+        close(thread->fd_cache_misses);
+    }
+    if (thread->fd >= 0) {
+        close(thread->fd);
+    }
+    free(thread);
+}
+
+#ifdef __linux__
+static int ggml_cpu_profile_perf_open(uint64_t config, int group_fd) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+
+    attr.type           = PERF_TYPE_HARDWARE;
+    attr.size           = sizeof(attr);
+    attr.config         = config;
+    attr.disabled       = group_fd < 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+    attr.read_format    = PERF_FORMAT_GROUP;
+
+    return (int) syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+#endif
+
+static struct ggml_cpu_profile_thread * ggml_cpu_profile_thread_get(void) {
+    struct ggml_cpu_profile_thread * thread = (struct ggml_cpu_profile_thread *) pthread_getspecific(g_thread_key);
+    if (thread) {
+        return thread;
+    }
+
+    thread = (struct ggml_cpu_profile_thread *) calloc(1, sizeof(*thread));
+    thread->fd              = -1;
+    thread->fd_cache_misses = -1;
+
+#ifdef __linux__
+    thread->tid = (int) syscall(SYS_gettid);
+
+    const int fd = ggml_cpu_profile_perf_open(PERF_COUNT_HW_CPU_CYCLES, -1);
+    if (fd >= 0) {
+        const int fd_cache_misses = ggml_cpu_profile_perf_open(PERF_COUNT_HW_CACHE_MISSES, fd);
+        if (fd_cache_misses >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+            thread->fd              = fd;
+            thread->fd_cache_misses = fd_cache_misses;
+        } else {
+            close(fd);
+        }
+    }
+#else
+    thread->tid = (int) (intptr_t) pthread_self();
+#endif
+
+    if (thread->fd >= 0) {
+        g_counters = true;
+    }
+
+    pthread_setspecific(g_thread_key, thread);
+
+    return thread;
+}
+
+static void ggml_cpu_profile_read(int64_t * cycles, int64_t * cache_misses) {
+    *cycles       = -1;
+    *cache_misses = -1;
+
+#ifdef __linux__
+    const struct ggml_cpu_profile_thread * thread = ggml_cpu_profile_thread_get();
+    if (thread->fd >= 0) {
+        uint64_t values[3]; // nr, cycles, cache misses
+        if (read(thread->fd, values, sizeof(values)) == (ssize_t) sizeof(values)) {
+            *cycles       = (int64_t) values[1];
+            *cache_misses = (int64_t) values[2];
+        }
+    }
+#endif
+}
+
+static void ggml_cpu_profile_write_trace(void) {
+    char path[sizeof(g_path) + 32];
+    {
+        // replace %p with the pid, so that forked processes do not overwrite each other
+        const char * p = strstr(g_path, "%p");
+        if (p) {
+            snprintf(path, sizeof(path), "%.*s%d%s", (int) (p - g_path), g_path, (int) getpid(), p + 2);
+        } else {
+            snprintf(path, sizeof(path), "%s", g_path);
+        }
+    }
+
+    FILE * f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "%s: failed to open '%s'\n", __func__, path);
+        return;
+    }
+
+    const size_t n_events = atomic_load(&g_n_events) < g_events_max ? atomic_load(&g_n_events) : g_events_max;
+    const int    pid      = (int) getpid();
+
+    fprintf(f, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+
+    for (size_t i = 0; i < n_events; ++i) {
+        const struct ggml_cpu_profile_event * e = &g_events[i];
+
+        const double ts  = (e->t_start_ns - g_t_base_ns)/1000.0;
+        const double dur = (e->t_end_ns - e->t_start_ns)/1000.0;
+
+        if (e->key == GGML_CPU_PROFILE_OP_GRAPH) {
+            fprintf(f, "{\"name\": \"graph\", \"cat\": \"graph\", \"ph\": \"X\", \"pid\": %d, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f, "
+                    "\"args\": {\"n_nodes\": %d, \"n_threads\": %d}},\n",
+                    pid, e->tid, ts, dur, e->node_n, e->nth);
+            continue;
+        }
+
+        const char * op = e->key < GGML_OP_COUNT ? ggml_op_name((enum ggml_op) e->key) : ggml_unary_op_name((enum ggml_unary_op) (e->key - GGML_OP_COUNT));
+
+        fprintf(f, "{\"name\": \"%s\", \"cat\": \"op\", \"ph\": \"X\", \"pid\": %d, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f, \"args\": {"
+                "\"node\": %d, \"tensor\": \"%s\", \"ith\": %d, \"nth\": %d, \"wait_us\": %.3f, "
+                "\"ne\": [%" PRId64 ", %" PRId64 ", %" PRId64 ", %" PRId64 "], \"type\": \"%s\"",
+                op, pid, e->tid, ts, dur,
+                e->node_n, e->name, e->ith, e->nth, (e->t_sync_ns - e->t_end_ns)/1000.0,
+                e->ne[0][0], e->ne[0][1], e->ne[0][2], e->ne[0][3], ggml_type_name((enum ggml_type) e->type[0]));
+
+        for (int j = 1; j < 3; ++j) {
+            if (e->ne[j][0] > 0) {
+                fprintf(f, ", \"src%d\": [%" PRId64 ", %" PRId64 ", %" PRId64 ", %" PRId64 "], \"src%d_type\": \"%s\"",
+                        j - 1, e->ne[j][0], e->ne[j][1], e->ne[j][2], e->ne[j][3], j - 1, ggml_type_name((enum ggml_type) e->type[j]));
+            }
+        }
+
+        if (e->cycles >= 0) {
+            fprintf(f, ", \"cycles\": %" PRId64 ", \"cache_misses\": %" PRId64, e->cycles, e->cache_misses);
+        }
+
+        fprintf(f, "}},\n");
+    }
+
+    // the process name closes the array without a trailing comma
+    fprintf(f, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %d, \"args\": {\"name\": \"ggml-cpu\"}}\n", pid);
+    fprintf(f, "]}\n");
+
+    fclose(f);
+
+    fprintf(stderr, "%s: wrote %zu events to '%s'", __func__, n_events, path);
+    if (atomic_load(&g_n_events) > g_events_max) {
+        fprintf(stderr, " (%zu more dropped, see GGML_CPU_PROFILE_MAX_EVENTS)", atomic_load(&g_n_events) - g_events_max);
+    }
+    fprintf(stderr, "\n");
+}
+
+static void ggml_cpu_profile_print_table(void) {
+    int order[GGML_CPU_PROFILE_N_KEYS];
+    int n = 0;
+
+    int64_t wall_total = 0;
+    for (int i = 0; i < GGML_CPU_PROFILE_N_KEYS; ++i) {
+        if (atomic_load(&g_ops[i].n) > 0) {
+            order[n++] = i;
+            wall_total += atomic_load(&g_ops[i].wall_ns);
+        }
+    }
+
+    // by wall time, largest first
+    for (int i = 1; i < n; ++i) {
+        const int k = order[i];
+        int j = i;
+        while (j > 0 && atomic_load(&g_ops[order[j - 1]].wall_ns) < atomic_load(&g_ops[k].wall_ns)) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = k;
+    }
+
+    fprintf(stderr, "\n%s: %" PRId64 " graphs, %.3f ms\n", __func__, (int64_t) atomic_load(&g_n_graphs), atomic_load(&g_graph_ns)/1e6);
+    fprintf(stderr, "%-20s %10s %12s %7s %10s %12s %12s %14s %14s\n",
+            "op", "nodes", "wall ms", "wall %", "us/node", "cpu ms", "wait ms", "cycles", "cache misses");
+
+    for (int i = 0; i < n; ++i) {
+        const int k = order[i];
+        const struct ggml_cpu_profile_op * op = &g_ops[k];
+
+        const char * name = k < GGML_OP_COUNT ? ggml_op_name((enum ggml_op) k) : ggml_unary_op_name((enum ggml_unary_op) (k - GGML_OP_COUNT));
+
+        const int64_t n_nodes = atomic_load(&op->n);
+        const int64_t wall_ns = atomic_load(&op->wall_ns);
+
+        fprintf(stderr, "%-20s %10" PRId64 " %12.3f %6.1f%% %10.2f %12.3f %12.3f",
+                name, n_nodes, wall_ns/1e6, wall_total > 0 ? 100.0*wall_ns/wall_total : 0.0, wall_ns/1e3/n_nodes,
+                atomic_load(&op->cpu_ns)/1e6, atomic_load(&op->wait_ns)/1e6);
+
+        if (g_counters) {
+            fprintf(stderr, " %14" PRId64 " %14" PRId64 "\n", (int64_t) atomic_load(&op->cycles), (int64_t) atomic_load(&op->cache_misses));
+        } else {
+            fprintf(stderr, " %14s %14s\n", "-", "-");
+        }
+    }
+
+    if (!g_counters) {
+        fprintf(stderr, "%s: hardware counters not available (perf_event_paranoid or no PMU)\n", __func__);
+    }
+}
+
+void ggml_cpu_profile_write(void) {
+    // also marks the profile as written
+    if (!ggml_cpu_profile_enabled) {
+        return;
+    }
+    ggml_cpu_profile_enabled = false;
+
+    ggml_cpu_profile_write_trace();
+    ggml_cpu_profile_print_table();
+}
+
+void ggml_cpu_profile_init(void) {
+    const char * path = getenv("GGML_CPU_PROFILE");
+    if (!path || !path[0]) {
+        return;
+    }
+
+    snprintf(g_path, sizeof(g_path), "%s", path);
+
+    const char * max_events = getenv("GGML_CPU_PROFILE_MAX_EVENTS");
+    g_events_max = max_events ? (size_t) atoll(max_events) : GGML_CPU_PROFILE_MAX_EVENTS_DEFAULT;
+    g_events     = (struct ggml_cpu_profile_event *) calloc(g_events_max > 0 ? g_events_max : 1, sizeof(struct ggml_cpu_profile_event));
+
+    g_t_base_ns = ggml_cpu_profile_time_ns();
+
+    if (!g_events || pthread_key_create(&g_thread_key, ggml_cpu_profile_thread_free) != 0) {
+        GGML_LOG_ERROR("%s: failed to initialize the profiler\n", __func__);
+        return;
+    }
+
+    atexit(ggml_cpu_profile_write);
+
+    ggml_cpu_profile_enabled = true;
+
+    GGML_LOG_INFO("%s: profiling the CPU graph compute to '%s'\n", __func__, g_path);
+}
+
+void ggml_cpu_profile_graph_begin(struct ggml_cpu_profile_sample * sample) {
+    sample->t_start_ns = ggml_cpu_profile_time_ns();
+}
+
+void ggml_cpu_profile_graph_end(struct ggml_cpu_profile_sample * sample, int n_nodes, int n_threads) {
+    sample->t_end_ns = ggml_cpu_profile_time_ns();
+
+    atomic_fetch_add_explicit(&g_n_graphs, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&g_graph_ns, sample->t_end_ns - sample->t_start_ns, memory_order_relaxed);
+
+    const size_t i = atomic_fetch_add_explicit(&g_n_events, 1, memory_order_relaxed);
+    if (i >= g_events_max) {
+        return;
+    }
+
+    struct ggml_cpu_profile_event * e = &g_events[i];
+
+    memset(e, 0, sizeof(*e));
+
+    e->t_start_ns = sample->t_start_ns;
+    e->t_end_ns   = sample->t_end_ns;
+    e->t_sync_ns  = sample->t_end_ns;
+    e->tid        = ggml_cpu_profile_thread_get()->tid;
+    e->node_n     = n_nodes;
+    e->nth        = (int16_t) n_threads;
+    e->key        = GGML_CPU_PROFILE_OP_GRAPH;
+}
+
+void ggml_cpu_profile_node_begin(struct ggml_cpu_profile_sample * sample) {
+    ggml_cpu_profile_read(&sample->cycles, &sample->cache_misses);
+    sample->t_start_ns = ggml_cpu_profile_time_ns();
+}
+
+void ggml_cpu_profile_node_compute_end(struct ggml_cpu_profile_sample * sample) {
+    sample->t_end_ns = ggml_cpu_profile_time_ns();
+
+    int64_t cycles;
+    int64_t cache_misses;
+    ggml_cpu_profile_read(&cycles, &cache_misses);
+
+    if (sample->cycles >= 0 && cycles >= 0) {
+        sample->cycles       = cycles - sample->cycles;
+        sample->cache_misses = cache_misses - sample->cache_misses;
+    } else {
+        sample->cycles       = -1;
+        sample->cache_misses = -1;
+    }
+}
+
+void ggml_cpu_profile_node_end(const struct ggml_cpu_profile_sample * sample, const struct ggml_tensor * node, int node_n, int ith, int nth) {
+    const int64_t t_sync_ns = ggml_cpu_profile_time_ns();
+
+    const int key = node->op == GGML_OP_UNARY ? GGML_OP_COUNT + (int) ggml_get_unary_op(node) : (int) node->op;
+
+    struct ggml_cpu_profile_op * op = &g_ops[key];
+
+    if (ith == 0) {
+        atomic_fetch_add_explicit(&op->n,       1,                               memory_order_relaxed);
+        atomic_fetch_add_explicit(&op->wall_ns, t_sync_ns - sample->t_start_ns, memory_order_relaxed);
+    }
+    atomic_fetch_add_explicit(&op->cpu_ns,  sample->t_end_ns - sample->t_start_ns, memory_order_relaxed);
+    atomic_fetch_add_explicit(&op->wait_ns, t_sync_ns - sample->t_end_ns,          memory_order_relaxed);
+
+    if (sample->cycles >= 0) {
+        atomic_fetch_add_explicit(&op->cycles,       sample->cycles,       memory_order_relaxed);
+        atomic_fetch_add_explicit(&op->cache_misses, sample->cache_misses, memory_order_relaxed);
+    }
+
+    const size_t i = atomic_fetch_add_explicit(&g_n_events, 1, memory_order_relaxed);
+    if (i >= g_events_max) {
+        return;
+    }
+
+    struct ggml_cpu_profile_event * e = &g_events[i];
+
+    e->t_start_ns   = sample->t_start_ns;
+    e->t_end_ns     = sample->t_end_ns;
+    e->t_sync_ns    = t_sync_ns;
+    e->cycles       = sample->cycles;
+    e->cache_misses = sample->cache_misses;
+    e->tid          = ggml_cpu_profile_thread_get()->tid;
+    e->node_n       = node_n;
+    e->ith          = (int16_t) ith;
+    e->nth          = (int16_t) nth;
+    e->key          = (uint8_t) key;
+
+    const struct ggml_tensor * tensors[3] = { node, node->src[0], node->src[1] };
+    for (int j = 0; j < 3; ++j) {
+        if (tensors[j]) {
+            memcpy(e->ne[j], tensors[j]->ne, sizeof(e->ne[j]));
+            e->type[j] = (uint8_t) tensors[j]->type;
+        } else {
+            memset(e->ne[j], 0, sizeof(e->ne[j]));
+            e->type[j] = 0;
+        }
+    }
+
+    snprintf(e->name, sizeof(e->name), "%s", node->name);
+}
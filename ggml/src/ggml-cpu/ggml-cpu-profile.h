@@ -0,0 +1,53 @@
+#pragma once
+
+#include "ggml.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// GGML CPU internal header
+
+//
+// Per-op profiler of the CPU graph compute (GGML_CPU_PROFILE build option)
+//
+// Enabled at run time by setting GGML_CPU_PROFILE to the path of the trace, "%p" in the path is replaced by the pid.
+// Every thread records the start and end of its part of each node, and the end of the barrier that follows it,
+// with the cycles and cache misses of perf_event_open when the kernel allows it.
+// At exit (or on ggml_cpu_profile_flush) the events are written as a Chrome trace (chrome://tracing, ui.perfetto.dev) and a per-op table is
+// printed to stderr. GGML_CPU_PROFILE_MAX_EVENTS limits the number of events kept for the trace (default 262144),
+// the table includes all the nodes.
+//
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct ggml_cpu_profile_sample {
+    int64_t t_start_ns;
+    int64_t t_end_ns;
+    int64_t cycles;       // -1 if the counters are not available
+    int64_t cache_misses;
+};
+
+extern bool ggml_cpu_profile_enabled;
+
+// called once by ggml_cpu_init()
+void ggml_cpu_profile_init(void);
+
+// write the trace and the table, once - at exit or from ggml_cpu_profile_flush()
+void ggml_cpu_profile_write(void);
+
+// around the whole graph, on the calling thread
+void ggml_cpu_profile_graph_begin(struct ggml_cpu_profile_sample * sample);
+void ggml_cpu_profile_graph_end  (struct ggml_cpu_profile_sample * sample, int n_nodes, int n_threads);
+
+// around the computation of a node by one thread
+void ggml_cpu_profile_node_begin(struct ggml_cpu_profile_sample * sample);
+void ggml_cpu_profile_node_compute_end(struct ggml_cpu_profile_sample * sample);
+
+// after the barrier that follows the node
+void ggml_cpu_profile_node_end(const struct ggml_cpu_profile_sample * sample, const struct ggml_tensor * node, int node_n, int ith, int nth);
+
+#ifdef __cplusplus
+}
+#endif
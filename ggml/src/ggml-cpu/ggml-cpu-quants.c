@@ -294,8 +294,10 @@ static inline float hsum_float_4x4(const __m128 a, const __m128 b, const __m128
 
 // precomputed tables for expanding 8bits to 8 bytes:
 static const uint64_t table_b2b_0[1 << 8] = { B8(00, 10) }; // ( b) << 4
+#if !defined(__wasm_simd128__)
 static const uint64_t table_b2b_1[1 << 8] = { B8(10, 00) }; // (!b) << 4
 #endif
+#endif
 
 #if defined(__loongarch_sx)
 
@@ -795,14 +797,18 @@ void quantize_row_q8_0(const float * GGML_RESTRICT x, void * GGML_RESTRICT vy, i
 
         y[i].d = GGML_FP32_TO_FP16(d);
 
+        // round to nearest like the reference and the repacked activations, truncating biased them towards zero
+        v128_t vi[8];
         for (int j = 0; j < 8; j++) {
             const v128_t v  = wasm_f32x4_mul(srcv[j], wasm_f32x4_splat(id));
-            const v128_t vi = wasm_i32x4_trunc_sat_f32x4(v);
+            vi[j] = wasm_i32x4_trunc_sat_f32x4(wasm_f32x4_nearest(v));
+        }
 
-            y[i].qs[4*j + 0] = wasm_i32x4_extract_lane(vi, 0);
-            y[i].qs[4*j + 1] = wasm_i32x4_extract_lane(vi, 1);
-            y[i].qs[4*j + 2] = wasm_i32x4_extract_lane(vi, 2);
-            y[i].qs[4*j + 3] = wasm_i32x4_extract_lane(vi, 3);
+        // |vi| <= 127, the saturating narrows are exact
+        for (int j = 0; j < 2; j++) {
+            const v128_t v0 = wasm_i16x8_narrow_i32x4(vi[4*j + 0], vi[4*j + 1]);
+            const v128_t v1 = wasm_i16x8_narrow_i32x4(vi[4*j + 2], vi[4*j + 3]);
+            wasm_v128_store(y[i].qs + 16*j, wasm_i8x16_narrow_i16x8(v0, v1));
         }
     }
 #elif defined(__AVX2__) || defined(__AVX__)
@@ -2188,6 +2194,28 @@ void ggml_vec_dot_q4_0_q8_0(int n, float * GGML_RESTRICT s, size_t bs, const voi
     const v128_t m4b = wasm_i8x16_splat(0x0F);
     const v128_t s8b = wasm_i8x16_splat(0x8);
 
+#if defined(__wasm_relaxed_simd__)
+    // the unsigned nibbles are the 7-bit operand (it must not be negative, x86 uses pmaddubsw), one dot product per
+    // 16 bytes without extending to i16 - 8 times the sum of y is subtracted, like mul_sum_us8_pairs on AVX
+    for (; ib < nb; ++ib) {
+        const v128_t v0  = wasm_v128_load(x[ib].qs);
+        const v128_t v0l = wasm_v128_and(v0, m4b);
+        const v128_t v0h = wasm_u8x16_shr(v0, 4);
+
+        const v128_t v1l = wasm_v128_load(y[ib].qs);
+        const v128_t v1h = wasm_v128_load(y[ib].qs + 16);
+
+        const v128_t dp = wasm_i32x4_sub(
+                            wasm_i32x4_relaxed_dot_i8x16_i7x16_add(v1h, v0h,
+                            wasm_i32x4_relaxed_dot_i8x16_i7x16_add(v1l, v0l, wasm_i32x4_splat(0))),
+                            wasm_i32x4_relaxed_dot_i8x16_i7x16_add(v1h, s8b,
+                            wasm_i32x4_relaxed_dot_i8x16_i7x16_add(v1l, s8b, wasm_i32x4_splat(0))));
+
+        const float scale = GGML_FP16_TO_FP32(x[ib].d) * GGML_FP16_TO_FP32(y[ib].d);
+        sumv = wasm_f32x4_add(sumv, wasm_f32x4_mul(wasm_f32x4_convert_i32x4(dp), wasm_f32x4_splat(scale)));
+    }
+#endif
+
     for (; ib + 1 < nb; ib += 2) {
         const block_q4_0 * GGML_RESTRICT x0 = &x[ib];
         const block_q4_0 * GGML_RESTRICT x1 = &x[ib + 1];
@@ -3015,26 +3043,27 @@ void ggml_vec_dot_q5_0_q8_0(int n, float * GGML_RESTRICT s, size_t bs, const voi
 #elif defined __wasm_simd128__
     v128_t sumv = wasm_f32x4_splat(0.0f);
 
+    const v128_t m4b = wasm_i8x16_splat(0x0F);
+    const v128_t mhb = wasm_i8x16_splat(0x10);
+
+    // bit j % 8 of the lane j, to test the qh byte broadcast to 8 lanes
+    const v128_t mbit = wasm_i8x16_const(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+
     uint32_t qh_;
-    uint64_t tmp[4];
 
-    // TODO: check if unrolling this is better
     for (; ib < nb; ++ib) {
         const block_q5_0 * GGML_RESTRICT x0 = &x[ib];
         const block_q8_0 * GGML_RESTRICT y0 = &y[ib];
 
-        const v128_t m4b  = wasm_i8x16_splat(0x0F);
-
-        // extract the 5th bit
+        // extract the 5th bit: 0x10 where it is clear, like table_b2b_1
         memcpy(&qh_, x0->qh, sizeof(qh_));
 
-        tmp[0] = table_b2b_1[(qh_ >>  0) & 0xFF];
-        tmp[1] = table_b2b_1[(qh_ >>  8) & 0xFF];
-        tmp[2] = table_b2b_1[(qh_ >> 16) & 0xFF];
-        tmp[3] = table_b2b_1[(qh_ >> 24)       ];
+        const v128_t qh  = wasm_i32x4_splat(qh_);
+        const v128_t qhl = wasm_i8x16_shuffle(qh, qh, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1);
+        const v128_t qhh = wasm_i8x16_shuffle(qh, qh, 2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
 
-        const v128_t qhl = wasm_v128_load(tmp + 0);
-        const v128_t qhh = wasm_v128_load(tmp + 2);
+        const v128_t bl = wasm_v128_andnot(mhb, wasm_i8x16_eq(wasm_v128_and(qhl, mbit), mbit));
+        const v128_t bh = wasm_v128_andnot(mhb, wasm_i8x16_eq(wasm_v128_and(qhh, mbit), mbit));
 
         const v128_t v0 = wasm_v128_load(x0->qs);
 
@@ -3042,14 +3071,26 @@ void ggml_vec_dot_q5_0_q8_0(int n, float * GGML_RESTRICT s, size_t bs, const voi
         const v128_t v0l = wasm_v128_and (v0, m4b);
         const v128_t v0h = wasm_u8x16_shr(v0, 4);
 
-        // add high bit and sub 16 (equivalent to sub 0x10 when bit is zero)
-        const v128_t v0lf = wasm_i8x16_sub(v0l, qhl);
-        const v128_t v0hf = wasm_i8x16_sub(v0h, qhh);
-
         // load y
         const v128_t v1l = wasm_v128_load(y0->qs);
         const v128_t v1h = wasm_v128_load(y0->qs + 16);
 
+#if defined(__wasm_relaxed_simd__)
+        // add the high bit, the quants plus 16 in [0, 31] are the 7-bit operand (it must not be negative, x86 uses
+        // pmaddubsw) - 16 times the sum of y is subtracted, like mul_sum_us8_pairs on AVX
+        const v128_t v0lu = wasm_v128_or(v0l, wasm_v128_xor(bl, mhb));
+        const v128_t v0hu = wasm_v128_or(v0h, wasm_v128_xor(bh, mhb));
+
+        const v128_t dp = wasm_i32x4_sub(
+                            wasm_i32x4_relaxed_dot_i8x16_i7x16_add(v1h, v0hu,
+                            wasm_i32x4_relaxed_dot_i8x16_i7x16_add(v1l, v0lu, wasm_i32x4_splat(0))),
+                            wasm_i32x4_relaxed_dot_i8x16_i7x16_add(v1h, mhb,
+                            wasm_i32x4_relaxed_dot_i8x16_i7x16_add(v1l, mhb,  wasm_i32x4_splat(0))));
+#else
+        // add high bit and sub 16 (equivalent to sub 0x10 when bit is zero)
+        const v128_t v0lf = wasm_i8x16_sub(v0l, bl);
+        const v128_t v0hf = wasm_i8x16_sub(v0h, bh);
+
         // int8x16 -> int16x8
         const v128_t v0lfl = wasm_i16x8_extend_low_i8x16 (v0lf);
         const v128_t v0lfh = wasm_i16x8_extend_high_i8x16(v0lf);
@@ -3061,13 +3102,15 @@ void ggml_vec_dot_q5_0_q8_0(int n, float * GGML_RESTRICT s, size_t bs, const voi
         const v128_t v1hl = wasm_i16x8_extend_low_i8x16 (v1h);
         const v128_t v1hh = wasm_i16x8_extend_high_i8x16(v1h);
 
-        // dot product
-        sumv = wasm_f32x4_add(sumv, wasm_f32x4_mul(wasm_f32x4_convert_i32x4(
-                        wasm_i32x4_add(
+        const v128_t dp = wasm_i32x4_add(
                             wasm_i32x4_add(wasm_i32x4_dot_i16x8(v0lfl, v1ll),
                                            wasm_i32x4_dot_i16x8(v0lfh, v1lh)),
                             wasm_i32x4_add(wasm_i32x4_dot_i16x8(v0hfl, v1hl),
-                                           wasm_i32x4_dot_i16x8(v0hfh, v1hh)))),
+                                           wasm_i32x4_dot_i16x8(v0hfh, v1hh)));
+#endif
+
+        // dot product
+        sumv = wasm_f32x4_add(sumv, wasm_f32x4_mul(wasm_f32x4_convert_i32x4(dp),
                     wasm_f32x4_splat(GGML_FP16_TO_FP32(x0->d) * GGML_FP16_TO_FP32(y0->d))));
     }
 
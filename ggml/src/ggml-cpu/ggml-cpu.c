@@ -9,6 +9,9 @@
 #include "ggml-impl.h"
 #include "ggml-cpu-quants.h"
 #include "ggml-threading.h"
+#ifdef GGML_USE_CPU_PROFILE
+#include "ggml-cpu-profile.h"
+#endif
 #include "unary-ops.h"
 #include "binary-ops.h"
 #include "vec.h"
@@ -2872,8 +2875,22 @@ static thread_ret_t ggml_graph_compute_thread(void * data) {
     for (int node_n = 0; node_n < cgraph->n_nodes && atomic_load_explicit(&tp->abort, memory_order_relaxed) != node_n; node_n++) {
         struct ggml_tensor * node = cgraph->nodes[node_n];
 
+#ifdef GGML_USE_CPU_PROFILE
+        struct ggml_cpu_profile_sample sample;
+        const bool profile = ggml_cpu_profile_enabled;
+        if (profile) {
+            ggml_cpu_profile_node_begin(&sample);
+        }
+#endif
+
         ggml_compute_forward(&params, node);
 
+#ifdef GGML_USE_CPU_PROFILE
+        if (profile) {
+            ggml_cpu_profile_node_compute_end(&sample);
+        }
+#endif
+
         if (state->ith == 0 && cplan->abort_callback &&
                 cplan->abort_callback(cplan->abort_callback_data)) {
             atomic_store_explicit(&tp->abort, node_n + 1, memory_order_relaxed);
@@ -2883,6 +2900,12 @@ static thread_ret_t ggml_graph_compute_thread(void * data) {
         if (node_n + 1 < cgraph->n_nodes) {
             ggml_barrier(state->threadpool);
         }
+
+#ifdef GGML_USE_CPU_PROFILE
+        if (profile) {
+            ggml_cpu_profile_node_end(&sample, node, node_n, params.ith, params.nth);
+        }
+#endif
     }
 
     ggml_barrier(state->threadpool);
@@ -3120,6 +3143,14 @@ enum ggml_status ggml_graph_compute(struct ggml_cgraph * cgraph, struct ggml_cpl
 
     bool disposable_threadpool = false;
 
+#ifdef GGML_USE_CPU_PROFILE
+    struct ggml_cpu_profile_sample profile_sample;
+    const bool profile = ggml_cpu_profile_enabled;
+    if (profile) {
+        ggml_cpu_profile_graph_begin(&profile_sample);
+    }
+#endif
+
     if (threadpool == NULL) {
         //GGML_PRINT_DEBUG("Threadpool is not specified. Will create a disposable threadpool : n_threads %d\n", n_threads);
         disposable_threadpool = true;
@@ -3175,6 +3206,12 @@ enum ggml_status ggml_graph_compute(struct ggml_cgraph * cgraph, struct ggml_cpl
         ggml_threadpool_free(threadpool);
     }
 
+#ifdef GGML_USE_CPU_PROFILE
+    if (profile) {
+        ggml_cpu_profile_graph_end(&profile_sample, cgraph->n_nodes, n_threads);
+    }
+#endif
+
     return ret;
 }
 
@@ -3431,8 +3468,18 @@ void ggml_cpu_init(void) {
         ggml_init_arm_arch_features();
 #endif
 
+#ifdef GGML_USE_CPU_PROFILE
+        ggml_cpu_profile_init();
+#endif
+
         is_first_call = false;
     }
 
     ggml_critical_section_end();
 }
+
+void ggml_cpu_profile_flush(void) {
+#ifdef GGML_USE_CPU_PROFILE
+    ggml_cpu_profile_write();
+#endif
+}
@@ -617,6 +617,16 @@ static void * ggml_backend_cpu_get_proc_address(ggml_backend_reg_t reg, const ch
         return (void *)ggml_is_numa;
     }
 
+    if (strcmp(name, "ggml_backend_cpu_repack_isa") == 0) {
+        return (void *)ggml_backend_cpu_repack_isa;
+    }
+    if (strcmp(name, "ggml_backend_cpu_repacked_buffer_from_ptr") == 0) {
+        return (void *)ggml_backend_cpu_repacked_buffer_from_ptr;
+    }
+    if (strcmp(name, "ggml_cpu_profile_flush") == 0) {
+        return (void *)ggml_cpu_profile_flush;
+    }
+
     // threadpool - TODO:  move to ggml-base
     if (strcmp(name, "ggml_threadpool_new") == 0) {
         return (void *)ggml_threadpool_new;
@@ -118,6 +118,16 @@ extern "C" {
         bool  flash_attn;
         int   gpu_device;  // CUDA device
 
+        // map the model file into memory and use the CPU weights in-place (whisper_init_from_file only)
+        bool  use_mmap;
+        bool  mmap_prefetch; // pre-fault the mapping at load time (MAP_POPULATE / MADV_WILLNEED)
+
+        // NUMA mode: keep a copy of the CPU weights on each NUMA node and bind each state to one node
+        // the nodes are read from /sys/devices/system/node, or from the WHISPER_NUMA_TOPOLOGY environment variable:
+        //   "0-3;4-7" - CPU lists of the nodes
+        //   "2"       - split the CPUs evenly into 2 nodes (fake topology for testing on single-node machines)
+        bool  numa;
+
         // [EXPERIMENTAL] Token-level timestamps with DTW
         bool dtw_token_timestamps;
         enum whisper_alignment_heads_preset dtw_aheads_preset;
@@ -229,6 +239,14 @@ extern "C" {
 
     WHISPER_API struct whisper_state * whisper_init_state(struct whisper_context * ctx);
 
+    // In NUMA mode, the state computes on the CPUs of the given node and reads the copy of the weights local to it.
+    // whisper_init_state() assigns the nodes round-robin. node = -1 does the same here.
+    // Without NUMA mode, the node is ignored.
+    WHISPER_API struct whisper_state * whisper_init_state_on_node(struct whisper_context * ctx, int node);
+
+    // Number of NUMA nodes used by the context (1 without NUMA mode)
+    WHISPER_API int whisper_n_numa_nodes(struct whisper_context * ctx);
+
     // Given a context, enable use of OpenVINO for encode inference.
     // model_path: Optional path to OpenVINO encoder IR model. If set to nullptr,
     //                      the path will be generated from the ggml model path that was passed
@@ -275,6 +293,23 @@ extern "C" {
                                int   n_samples,
                                int   n_threads);
 
+    // Same as whisper_pcm_to_mel() for signed 16-bit PCM. The samples are converted to float inside the mel front end,
+    // so the caller can keep the audio as int16 (half the memory and bandwidth of float).
+    // Then run whisper_full() with n_samples = 0 to use the spectrogram without computing it again.
+    // Returns 0 on success
+    WHISPER_API int whisper_pcm16_to_mel(
+            struct whisper_context * ctx,
+                     const int16_t * samples,
+                               int   n_samples,
+                               int   n_threads);
+
+    WHISPER_API int whisper_pcm16_to_mel_with_state(
+            struct whisper_context * ctx,
+              struct whisper_state * state,
+                     const int16_t * samples,
+                               int   n_samples,
+                               int   n_threads);
+
     // This can be used to set a custom log mel spectrogram inside the default state of the provided whisper context.
     // Use this instead of whisper_pcm_to_mel() if you want to provide your own log mel spectrogram.
     // n_mel must be 80
@@ -435,6 +470,30 @@ extern "C" {
     WHISPER_API void whisper_print_timings(struct whisper_context * ctx);
     WHISPER_API void whisper_reset_timings(struct whisper_context * ctx);
 
+    // Cumulative counters of a state: total time and number of calls of each stage, and the temperature fallbacks
+    // The difference of two snapshots taken around whisper_full gives the cost of that run
+    // Not synchronized with whisper_full - read them from the thread that runs it
+    struct whisper_counters {
+        int64_t t_mel_us;
+        int64_t t_sample_us;
+        int64_t t_encode_us;
+        int64_t t_decode_us;
+        int64_t t_batchd_us;
+        int64_t t_prompt_us;
+
+        int32_t n_sample;
+        int32_t n_encode;
+        int32_t n_decode;
+        int32_t n_batchd;
+        int32_t n_prompt;
+        int32_t n_fail_p; // logprob threshold failures
+        int32_t n_fail_h; // entropy threshold failures
+    };
+
+    // All zero if the context has no default state
+    WHISPER_API struct whisper_counters whisper_get_counters           (struct whisper_context * ctx);
+    WHISPER_API struct whisper_counters whisper_get_counters_from_state(struct whisper_state * state);
+
     // Print system information
     WHISPER_API const char * whisper_print_system_info(void);
 
@@ -581,6 +640,8 @@ extern "C" {
     // Run the entire model: PCM -> log mel spectrogram -> encoder -> decoder -> text
     // Not thread safe for same context
     // Uses the specified decoding strategy to obtain the text.
+    // With n_samples = 0 the spectrogram already in the state is used (whisper_pcm16_to_mel(), whisper_set_mel()).
+    // token_timestamps needs the float samples and is not supported in that case.
     WHISPER_API int whisper_full(
                 struct whisper_context * ctx,
             struct whisper_full_params   params,
@@ -606,6 +667,31 @@ extern "C" {
                                    int   n_samples,
                                    int   n_processors);
 
+    // Like whisper_full_parallel(), but the audio is split at the quietest point of each window into chunks of
+    // at most max_chunk_ms (1 - 30 s, 0 for 30 s), so that words are not cut at the boundaries.
+    // The chunks are processed on a pool of n_processors states that is kept in the context between calls.
+    // Each state starts on its own range of chunks and steals from the others when done.
+    // The segments are stitched in timestamp order in the default state of the context.
+    // Not thread safe if executed in parallel on the same context.
+    WHISPER_API int whisper_full_parallel_vad(
+                struct whisper_context * ctx,
+            struct whisper_full_params   params,
+                           const float * samples,
+                                   int   n_samples,
+                                   int   n_processors,
+                                   int   max_chunk_ms);
+
+    // Prepare the state for low-latency serving before the first real request:
+    // pre-faults the host weight buffers and runs whisper_full_with_state() twice on synthetic audio
+    // with the given parameters, so that the compute buffers, the KV caches and the thread pool are hot.
+    // The cold and warm latencies are logged. The results and timings of the synthetic runs are discarded.
+    // If state is NULL, the default state of the context is used
+    // Returns 0 on success
+    WHISPER_API int whisper_warmup(
+                struct whisper_context * ctx,
+                  struct whisper_state * state,
+            struct whisper_full_params   params);
+
     // Number of generated text segments
     // A segment can be a few words, a sentence, or even a paragraph.
     WHISPER_API int whisper_full_n_segments           (struct whisper_context * ctx);
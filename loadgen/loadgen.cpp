@@ -0,0 +1,600 @@
+// Load generator for the multi-session ingest mode of wstream
+//
+// usage: wstream-loadgen [options] -f audio.wav
+//
+// opens N WebSocket connections to a local server, each streaming the audio in real time from a random start offset,
+// and measures the latency of every transcription: from the moment the client sent the last sample of the step the
+// message is for (its "audio_ms") to its arrival. the sweep doubles N until the p99 latency exceeds the SLO or
+// a connection fails, then bisects between the last passing and the first failing N:
+//
+//   wstream --workers 4 --port 8080 models/ggml-base.en.bin &
+//   wstream-loadgen -f samples/jfk.wav -p 8080 --sweep --slo 5000 -o sweep.json
+//
+// --mock runs an in-process server instead, which answers every step after a fixed delay on a bounded number of slots,
+// to check the generator itself or to model a host from its single-stream numbers
+//
+#include "common-whisper.h"
+
+#include "whisper.h"
+
+#include <boost/asio/connect.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/websocket.hpp>
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace beast = boost::beast;
+namespace websocket = beast::websocket;
+namespace net = boost::asio;
+using tcp = net::ip::tcp;
+
+using lg_clock = std::chrono::steady_clock;
+
+struct lg_params {
+    std::string fname_inp;
+    std::string fname_out; // stdout if empty
+    std::string host = "127.0.0.1";
+
+    int port = 8080;
+
+    int n_clients   = 1;
+    int n_max       = 256;   // sweep limit
+    bool sweep      = false;
+
+    int duration_s  = 30;    // streamed by every client per level
+    int jitter_ms   = 3000;  // start offsets are uniform in [0, jitter_ms)
+    int chunk_ms    = 100;   // audio per binary message
+    int step_ms     = 3000;  // step of the server, for the expected number of messages
+    int drain_ms    = -1;    // wait after the audio for the last messages, default slo_ms + step_ms
+    int slo_ms      = 5000;  // p99 latency of a passing level
+    int seed        = 42;
+
+    // in-process mock server
+    bool mock           = false;
+    int  mock_infer_ms  = 500;
+    int  mock_slots     = std::max(1, (int) std::thread::hardware_concurrency());
+};
+
+static void print_usage(const char * argv0) {
+    const lg_params def;
+
+    fprintf(stderr, "usage: %s [options] -f audio.wav\n", argv0);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "options:\n");
+    fprintf(stderr, "  -f FNAME            audio streamed by every client, looped to the duration\n");
+    fprintf(stderr, "  --host HOST         server address (default: %s)\n", def.host.c_str());
+    fprintf(stderr, "  -p, --port N        server port (default: %d)\n", def.port);
+    fprintf(stderr, "  -n N                concurrent clients (default: %d)\n", def.n_clients);
+    fprintf(stderr, "  --sweep             find the largest N that meets the SLO, starting from -n\n");
+    fprintf(stderr, "  --max-clients N     upper bound of the sweep (default: %d)\n", def.n_max);
+    fprintf(stderr, "  --duration N        seconds of audio streamed by each client per level (default: %d)\n", def.duration_s);
+    fprintf(stderr, "  --jitter N          start offsets of the clients in ms (default: %d)\n", def.jitter_ms);
+    fprintf(stderr, "  --chunk N           audio per message in ms (default: %d)\n", def.chunk_ms);
+    fprintf(stderr, "  --step N            step of the server in ms (default: %d)\n", def.step_ms);
+    fprintf(stderr, "  --drain N           wait for the last messages in ms (default: SLO + step)\n");
+    fprintf(stderr, "  --slo N             p99 latency of a passing level in ms (default: %d)\n", def.slo_ms);
+    fprintf(stderr, "  --seed N            seed of the start offsets (default: %d)\n", def.seed);
+    fprintf(stderr, "  -o FNAME            write the results to a file instead of stdout\n");
+    fprintf(stderr, "  --mock              run an in-process mock server on the port\n");
+    fprintf(stderr, "  --mock-infer N      mock inference time per step in ms (default: %d)\n", def.mock_infer_ms);
+    fprintf(stderr, "  --mock-slots N      mock steps processed concurrently (default: %d)\n", def.mock_slots);
+}
+
+static double percentile(std::vector<double> v, double p) {
+    if (v.empty()) {
+        return 0.0;
+    }
+    std::sort(v.begin(), v.end());
+    // nearest rank
+    const size_t k = (size_t) std::ceil(p*v.size());
+    return v[std::min(v.size() - 1, k > 0 ? k - 1 : 0)];
+}
+
+//
+// mock server
+//
+
+// counting semaphore of the mock inference slots
+struct lg_slots {
+    std::mutex mutex;
+    std::condition_variable cv;
+    int n_free = 0;
+
+    void acquire() {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&] { return n_free > 0; });
+        n_free--;
+    }
+
+    void release() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            n_free++;
+        }
+        cv.notify_one();
+    }
+};
+
+// same protocol as do_ingest_session: float32 16 kHz in, one message per step out, processed inline
+static void mock_session(tcp::socket socket, const lg_params & params, lg_slots & slots) {
+    websocket::stream<tcp::socket> ws{std::move(socket)};
+
+    try {
+        ws.accept();
+
+        const size_t n_step = (size_t) params.step_ms*WHISPER_SAMPLE_RATE/1000;
+
+        size_t n_bytes = 0;
+        size_t n_taken = 0;
+
+        for (;;) {
+            beast::flat_buffer buffer;
+            ws.read(buffer);
+
+            if (ws.got_text()) {
+                continue;
+            }
+
+            n_bytes += buffer.size();
+
+            while (n_bytes/sizeof(float) >= n_taken + n_step) {
+                n_taken += n_step;
+
+                slots.acquire();
+                std::this_thread::sleep_for(std::chrono::milliseconds(params.mock_infer_ms));
+                slots.release();
+
+                const nlohmann::json message = {
+                    {"type", "transcribe"},
+                    {"content", "mock"},
+                    {"audio_ms", n_taken*1000/WHISPER_SAMPLE_RATE}
+                };
+
+                ws.text(true);
+                ws.write(net::buffer(message.dump()));
+            }
+        }
+    } catch (const std::exception &) {
+        // closed by the client
+    }
+}
+
+// accepts until the io_context is stopped, one thread per session like the workers of wstream
+static void mock_accept(tcp::acceptor & acceptor, const lg_params & params, lg_slots & slots) {
+    acceptor.async_accept([&](beast::error_code ec, tcp::socket socket) {
+        if (ec) {
+            return;
+        }
+
+        std::thread(mock_session, std::move(socket), std::cref(params), std::ref(slots)).detach();
+
+        mock_accept(acceptor, params, slots);
+    });
+}
+
+//
+// clients
+//
+
+struct lg_conn_result {
+    int  n_messages = 0;
+    bool failed     = false;
+
+    std::string error;
+
+    std::vector<double> latency_ms;
+};
+
+// one connection, driven by its own io_context so that the reads, the paced writes and the close never overlap
+struct lg_client {
+    const lg_params & params;
+    const std::vector<float> & pcmf32;
+
+    lg_conn_result & result;
+
+    net::io_context ioc;
+    websocket::stream<tcp::socket> ws{ioc};
+    net::steady_timer timer{ioc};
+
+    beast::flat_buffer buffer;
+
+    size_t n_chunk = 0;
+    size_t n_total = 0;
+    size_t pos     = 0;
+
+    std::vector<float> chunk;
+
+    lg_clock::time_point t_start;
+
+    // send time of the last sample of every chunk
+    std::vector<std::pair<size_t, lg_clock::time_point>> t_sent;
+
+    bool closing = false;
+
+    lg_client(const lg_params & params, const std::vector<float> & pcmf32, lg_conn_result & result)
+        : params(params), pcmf32(pcmf32), result(result) {
+        n_chunk = (size_t) params.chunk_ms*WHISPER_SAMPLE_RATE/1000;
+        n_total = (size_t) params.duration_s*WHISPER_SAMPLE_RATE;
+        chunk.resize(n_chunk);
+    }
+
+    void fail(const char * what, beast::error_code ec) {
+        if (!result.failed) {
+            result.failed = true;
+            result.error  = std::string(what) + ": " + ec.message();
+        }
+
+        beast::error_code ec_ignored;
+        ws.next_layer().close(ec_ignored);
+        timer.cancel();
+    }
+
+    void run() {
+        beast::error_code ec;
+
+        tcp::resolver resolver{ioc};
+        const auto results = resolver.resolve(params.host, std::to_string(params.port), ec);
+        if (!ec) {
+            net::connect(ws.next_layer(), results, ec);
+        }
+        if (!ec) {
+            ws.handshake(params.host, "/", ec);
+        }
+        if (ec) {
+            fail("connect", ec);
+            return;
+        }
+
+        ws.binary(true);
+
+        t_start = lg_clock::now();
+
+        do_read();
+        do_send();
+
+        ioc.run();
+    }
+
+    void do_read() {
+        buffer.clear();
+        ws.async_read(buffer, [this](beast::error_code ec, size_t) {
+            if (ec) {
+                if (!closing) {
+                    fail("read", ec);
+                }
+                return;
+            }
+
+            const auto t_recv = lg_clock::now();
+
+            const nlohmann::json message = nlohmann::json::parse(beast::buffers_to_string(buffer.data()), nullptr, false);
+            if (message.is_object() && message.value("type", "") == "transcribe" && message.contains("audio_ms")) {
+                const size_t end = message["audio_ms"].get<size_t>()*WHISPER_SAMPLE_RATE/1000;
+
+                // the chunk that completed the step
+                auto it = std::lower_bound(t_sent.begin(), t_sent.end(), end,
+                        [](const std::pair<size_t, lg_clock::time_point> & c, size_t e) { return c.first < e; });
+                if (it != t_sent.end()) {
+                    result.n_messages++;
+                    result.latency_ms.push_back(1e-3*std::chrono::duration_cast<std::chrono::microseconds>(t_recv - it->second).count());
+                }
+            }
+
+            do_read();
+        });
+    }
+
+    // chunk k is due at t_start + k*chunk_ms, late writes do not shift the ones after them
+    void do_send() {
+        if (pos >= n_total) {
+            timer.expires_after(std::chrono::milliseconds(params.drain_ms));
+            timer.async_wait([this](beast::error_code ec) {
+                if (ec) {
+                    return;
+                }
+                closing = true;
+                ws.async_close(websocket::close_code::normal, [this](beast::error_code ec) {
+                    if (ec) {
+                        fail("close", ec);
+                    }
+                });
+            });
+            return;
+        }
+
+        timer.expires_at(t_start + std::chrono::milliseconds(pos/n_chunk*params.chunk_ms));
+        timer.async_wait([this](beast::error_code ec) {
+            if (ec) {
+                return;
+            }
+
+            for (size_t i = 0; i < n_chunk; ++i) {
+                chunk[i] = pcmf32[(pos + i) % pcmf32.size()];
+            }
+
+            ws.async_write(net::buffer(chunk.data(), chunk.size()*sizeof(float)), [this](beast::error_code ec, size_t) {
+                if (ec) {
+                    fail("write", ec);
+                    return;
+                }
+
+                pos += n_chunk;
+                t_sent.emplace_back(pos, lg_clock::now());
+
+                do_send();
+            });
+        });
+    }
+};
+
+static void run_client(const lg_params & params, const std::vector<float> & pcmf32, int start_ms, lg_conn_result & result) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(start_ms));
+
+    lg_client client(params, pcmf32, result);
+    client.run();
+}
+
+struct lg_level {
+    int n_clients  = 0;
+    int n_messages = 0;
+    int n_expected = 0;
+    int n_failed   = 0;
+
+    double p50_ms = 0.0;
+    double p95_ms = 0.0;
+    double p99_ms = 0.0;
+    double max_ms = 0.0;
+
+    bool ok = false;
+
+    std::vector<lg_conn_result> conns;
+};
+
+static lg_level run_level(const lg_params & params, const std::vector<float> & pcmf32, int n_clients) {
+    lg_level level;
+    level.n_clients = n_clients;
+    level.conns.resize(n_clients);
+
+    std::mt19937 rng(params.seed + n_clients);
+    std::uniform_int_distribution<int> start(0, std::max(0, params.jitter_ms - 1));
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < n_clients; ++i) {
+        threads.emplace_back(run_client, std::cref(params), std::cref(pcmf32), start(rng), std::ref(level.conns[i]));
+    }
+    for (auto & t : threads) {
+        t.join();
+    }
+
+    std::vector<double> latency_ms;
+    for (const auto & c : level.conns) {
+        level.n_messages += c.n_messages;
+        level.n_failed   += c.failed ? 1 : 0;
+        latency_ms.insert(latency_ms.end(), c.latency_ms.begin(), c.latency_ms.end());
+
+        if (c.failed) {
+            fprintf(stderr, "%s: connection failed: %s\n", __func__, c.error.c_str());
+        }
+    }
+
+    level.n_expected = n_clients*(params.duration_s*1000/params.step_ms);
+
+    level.p50_ms = percentile(latency_ms, 0.50);
+    level.p95_ms = percentile(latency_ms, 0.95);
+    level.p99_ms = percentile(latency_ms, 0.99);
+    level.max_ms = latency_ms.empty() ? 0.0 : *std::max_element(latency_ms.begin(), latency_ms.end());
+
+    level.ok = level.n_failed == 0 && level.n_messages > 0 && level.p99_ms <= params.slo_ms;
+
+    fprintf(stderr, "%s: %3d clients: messages %d/%d, failed %d, latency p50 %.1f p95 %.1f p99 %.1f max %.1f ms -> %s\n", __func__,
+            n_clients, level.n_messages, level.n_expected, level.n_failed, level.p50_ms, level.p95_ms, level.p99_ms, level.max_ms,
+            level.ok ? "ok" : "over SLO");
+
+    return level;
+}
+
+static std::string level_json(const lg_level & l) {
+    nlohmann::json conns = nlohmann::json::array();
+    for (const auto & c : l.conns) {
+        conns.push_back({
+            {"messages", c.n_messages},
+            {"failed",   c.failed},
+            {"p50_ms",   percentile(c.latency_ms, 0.50)},
+            {"p99_ms",   percentile(c.latency_ms, 0.99)},
+        });
+    }
+
+    const nlohmann::json res = {
+        {"clients",     l.n_clients},
+        {"messages",    l.n_messages},
+        {"expected",    l.n_expected},
+        {"failed",      l.n_failed},
+        {"p50_ms",      l.p50_ms},
+        {"p95_ms",      l.p95_ms},
+        {"p99_ms",      l.p99_ms},
+        {"max_ms",      l.max_ms},
+        {"ok",          l.ok},
+        {"connections", conns},
+    };
+
+    return res.dump();
+}
+
+int main(int argc, char ** argv) {
+    lg_params params;
+
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+
+        if (arg == "-f" && i + 1 < argc) {
+            params.fname_inp = argv[++i];
+        } else if (arg == "--host" && i + 1 < argc) {
+            params.host = argv[++i];
+        } else if ((arg == "-p" || arg == "--port") && i + 1 < argc) {
+            params.port = std::stoi(argv[++i]);
+        } else if (arg == "-n" && i + 1 < argc) {
+            params.n_clients = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--sweep") {
+            params.sweep = true;
+        } else if (arg == "--max-clients" && i + 1 < argc) {
+            params.n_max = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--duration" && i + 1 < argc) {
+            params.duration_s = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--jitter" && i + 1 < argc) {
+            params.jitter_ms = std::max(0, std::stoi(argv[++i]));
+        } else if (arg == "--chunk" && i + 1 < argc) {
+            params.chunk_ms = std::max(10, std::stoi(argv[++i]));
+        } else if (arg == "--step" && i + 1 < argc) {
+            params.step_ms = std::max(100, std::stoi(argv[++i]));
+        } else if (arg == "--drain" && i + 1 < argc) {
+            params.drain_ms = std::max(0, std::stoi(argv[++i]));
+        } else if (arg == "--slo" && i + 1 < argc) {
+            params.slo_ms = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--seed" && i + 1 < argc) {
+            params.seed = std::stoi(argv[++i]);
+        } else if (arg == "-o" && i + 1 < argc) {
+            params.fname_out = argv[++i];
+        } else if (arg == "--mock") {
+            params.mock = true;
+        } else if (arg == "--mock-infer" && i + 1 < argc) {
+            params.mock_infer_ms = std::max(0, std::stoi(argv[++i]));
+        } else if (arg == "--mock-slots" && i + 1 < argc) {
+            params.mock_slots = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "-h" || arg == "--help") {
+            print_usage(argv[0]);
+            return 0;
+        } else {
+            fprintf(stderr, "%s: unknown argument '%s'\n", __func__, arg.c_str());
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (params.fname_inp.empty()) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    if (params.drain_ms < 0) {
+        params.drain_ms = params.slo_ms + params.step_ms;
+    }
+
+    std::vector<float> pcmf32;
+    std::vector<std::vector<float>> pcmf32s;
+    if (!read_audio_data(params.fname_inp, pcmf32, pcmf32s, false) || pcmf32.empty()) {
+        fprintf(stderr, "%s: failed to read '%s'\n", __func__, params.fname_inp.c_str());
+        return 1;
+    }
+
+    net::io_context ioc_mock;
+    std::unique_ptr<tcp::acceptor> acceptor;
+    std::thread mock_thread;
+
+    lg_slots slots;
+    slots.n_free = params.mock_slots;
+
+    if (params.mock) {
+        try {
+            acceptor = std::make_unique<tcp::acceptor>(ioc_mock, tcp::endpoint{tcp::v4(), static_cast<unsigned short>(params.port)});
+        } catch (const std::exception & e) {
+            fprintf(stderr, "%s: mock server: %s\n", __func__, e.what());
+            return 1;
+        }
+
+        mock_accept(*acceptor, params, slots);
+        mock_thread = std::thread([&]() { ioc_mock.run(); });
+
+        fprintf(stderr, "%s: mock server on port %d: %d ms per step, %d slots\n", __func__,
+                params.port, params.mock_infer_ms, params.mock_slots);
+    }
+
+    std::vector<lg_level> levels;
+
+    if (!params.sweep) {
+        levels.push_back(run_level(params, pcmf32, params.n_clients));
+    } else {
+        // double until the first failing level, then bisect
+        int n_good = 0;
+        int n_bad  = 0;
+
+        for (int n = params.n_clients; n <= params.n_max; n *= 2) {
+            levels.push_back(run_level(params, pcmf32, n));
+            if (!levels.back().ok) {
+                n_bad = n;
+                break;
+            }
+            n_good = n;
+        }
+
+        while (n_bad > 0 && n_bad - n_good > 1) {
+            const int n = (n_good + n_bad)/2;
+
+            levels.push_back(run_level(params, pcmf32, n));
+            if (levels.back().ok) {
+                n_good = n;
+            } else {
+                n_bad = n;
+            }
+        }
+
+        if (n_bad == 0) {
+            fprintf(stderr, "%s: no saturation up to %d clients\n", __func__, n_good);
+        } else {
+            fprintf(stderr, "%s: saturation at %d clients, %d clients meet the p99 SLO of %d ms\n", __func__,
+                    n_bad, n_good, params.slo_ms);
+        }
+    }
+
+    FILE * fout = stdout;
+    if (!params.fname_out.empty()) {
+        fout = fopen(params.fname_out.c_str(), "w");
+        if (!fout) {
+            fprintf(stderr, "%s: failed to open '%s'\n", __func__, params.fname_out.c_str());
+            return 1;
+        }
+    }
+
+    int n_ok = 0;
+    for (const auto & l : levels) {
+        if (l.ok) {
+            n_ok = std::max(n_ok, l.n_clients);
+        }
+    }
+
+    fprintf(fout, "{\n");
+    fprintf(fout, "\"audio\": \"%s\",\n", params.fname_inp.c_str());
+    fprintf(fout, "\"server\": \"%s\",\n", params.mock ? "mock" : "wstream");
+    fprintf(fout, "\"duration_s\": %d,\n", params.duration_s);
+    fprintf(fout, "\"slo_ms\": %d,\n", params.slo_ms);
+    fprintf(fout, "\"max_clients_ok\": %d,\n", n_ok);
+    fprintf(fout, "\"levels\": [\n");
+    for (size_t i = 0; i < levels.size(); ++i) {
+        fprintf(fout, "%s%s\n", level_json(levels[i]).c_str(), i + 1 < levels.size() ? "," : "");
+    }
+    fprintf(fout, "]\n");
+    fprintf(fout, "}\n");
+
+    if (fout != stdout) {
+        fclose(fout);
+    }
+
+    if (mock_thread.joinable()) {
+        ioc_mock.stop();
+        mock_thread.join();
+    }
+
+    return 0;
+}
@@ -0,0 +1,944 @@
+// Mixed-precision quantization of whisper models
+//
+// usage: wstream-quantize [options] model-in model-out.gguf
+//
+// the tensors are grouped in classes (conv, encoder attention, FFN, token embedding, ...) and each class can be
+// stored in a different type, e.g.:
+//
+//   wstream-quantize --rule conv=f16 --rule enc_attn=q8_0 --rule ffn=q4_k --rule tok_embd=q6_k in.bin out.gguf
+//
+// with --auto, the sensitivity of each class is measured on a set of reference clips and a table of the
+// Pareto-optimal configurations (model size, encoder ms, decoder ms, WER) is printed
+//
+// with --repack, the weight matrices are stored in the interleaved layout that the CPU backend would otherwise
+// create at load time, so the loader can map them directly
+//
+#include "common-gguf.h"
+#include "common-whisper.h"
+
+#include "whisper.h"
+#include "whisper-arch.h"
+#include "ggml.h"
+#include "ggml-cpu.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <regex>
+#include <string>
+#include <vector>
+
+// tensor classes that can be quantized independently
+struct quant_class {
+    const char * name;
+    const char * desc;
+    const char * pattern;
+
+    bool conv; // used by im2col - F16 or F32 only
+};
+
+static const std::vector<quant_class> QUANT_CLASSES = {
+    { "conv",      "encoder convolutions",                         R"(encoder\.conv[12]\.weight)",                                     true  },
+    { "enc_attn",  "encoder self-attention",                       R"(encoder\.blocks\.\d+\.attn\.(query|key|value|out)\.weight)",     false },
+    { "enc_ffn",   "encoder feed-forward",                         R"(encoder\.blocks\.\d+\.mlp\.[02]\.weight)",                       false },
+    { "dec_attn",  "decoder self-attention",                       R"(decoder\.blocks\.\d+\.attn\.(query|key|value|out)\.weight)",     false },
+    { "dec_cross", "decoder cross-attention",                      R"(decoder\.blocks\.\d+\.cross_attn\.(query|key|value|out)\.weight)", false },
+    { "dec_ffn",   "decoder feed-forward",                         R"(decoder\.blocks\.\d+\.mlp\.[02]\.weight)",                       false },
+    { "tok_embd",  "token embedding (also the decoder output)",    R"(decoder\.token_embedding\.weight)",                              false },
+};
+
+// shorthands for several classes
+static const std::map<std::string, std::vector<std::string>> QUANT_ALIASES = {
+    { "attn", { "enc_attn", "dec_attn", "dec_cross" } },
+    { "ffn",  { "enc_ffn",  "dec_ffn" } },
+    { "enc",  { "enc_attn", "enc_ffn" } },
+    { "dec",  { "dec_attn", "dec_cross", "dec_ffn", "tok_embd" } },
+};
+
+static const std::map<std::string, ggml_type> QUANT_TYPES = {
+    { "f32",  GGML_TYPE_F32  },
+    { "f16",  GGML_TYPE_F16  },
+    { "q4_0", GGML_TYPE_Q4_0 },
+    { "q4_1", GGML_TYPE_Q4_1 },
+    { "q5_0", GGML_TYPE_Q5_0 },
+    { "q5_1", GGML_TYPE_Q5_1 },
+    { "q8_0", GGML_TYPE_Q8_0 },
+    { "q2_k", GGML_TYPE_Q2_K },
+    { "q3_k", GGML_TYPE_Q3_K },
+    { "q4_k", GGML_TYPE_Q4_K },
+    { "q5_k", GGML_TYPE_Q5_K },
+    { "q6_k", GGML_TYPE_Q6_K },
+};
+
+// the tensors matching pattern are stored as type
+struct quant_rule {
+    std::string pattern;
+    ggml_type   type;
+};
+
+using quant_config = std::vector<quant_rule>;
+
+struct quant_params {
+    std::string fname_inp;
+    std::string fname_out;
+
+    quant_config rules;
+
+    ggml_type type_default = GGML_TYPE_COUNT; // keep
+
+    // auto mode
+    std::string dir_clips;
+    std::string language = "en";
+
+    std::vector<ggml_type> candidates = { GGML_TYPE_Q8_0, GGML_TYPE_Q5_0, GGML_TYPE_Q4_K };
+
+    float max_wer   = -1.0f;
+    int   n_threads = 4;
+
+    std::string repack_isa; // empty - keep the plain layout
+};
+
+static void print_usage(const char * argv0) {
+    fprintf(stderr, "usage: %s [options] model-in model-out.gguf\n", argv0);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "options:\n");
+    fprintf(stderr, "  --rule CLASS=TYPE   store the tensors of CLASS as TYPE - can be repeated, later rules win\n");
+    fprintf(stderr, "                      CLASS is one of the classes below or a regex matched against the tensor names\n");
+    fprintf(stderr, "  --type TYPE         type of the weight matrices not matched by any rule (default: keep)\n");
+    fprintf(stderr, "  --auto DIR          measure the sensitivity of each class on the clips in DIR (*.wav with a .txt\n");
+    fprintf(stderr, "                      reference transcript each) and print the Pareto-optimal configurations\n");
+    fprintf(stderr, "  --candidates LIST   comma-separated types tried by --auto (default: q8_0,q5_0,q4_k)\n");
+    fprintf(stderr, "  --max-wer WER       with --auto, write the smallest Pareto-optimal model with a WER (%%) not above WER\n");
+    fprintf(stderr, "  -l LANG             language of the clips (default: en)\n");
+    fprintf(stderr, "  -t N                number of threads used by --auto (default: 4)\n");
+    fprintf(stderr, "  --repack ISA        store the weight matrices in the repacked CPU layout for ISA - must be the layout\n");
+    fprintf(stderr, "                      of this CPU (\"native\" or %s), the model only loads on CPUs with the same layout\n",
+            ggml_backend_cpu_repack_isa() ? ggml_backend_cpu_repack_isa() : "none available");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "classes:\n");
+    for (const auto & c : QUANT_CLASSES) {
+        fprintf(stderr, "  %-10s %s\n", c.name, c.desc);
+    }
+    for (const auto & a : QUANT_ALIASES) {
+        std::string list;
+        for (const auto & c : a.second) {
+            list += (list.empty() ? "" : ", ") + c;
+        }
+        fprintf(stderr, "  %-10s %s\n", a.first.c_str(), list.c_str());
+    }
+    fprintf(stderr, "\n");
+    fprintf(stderr, "types:\n ");
+    for (const auto & t : QUANT_TYPES) {
+        fprintf(stderr, " %s", t.first.c_str());
+    }
+    fprintf(stderr, "\n");
+}
+
+static ggml_type parse_type(const std::string & str) {
+    std::string s = str;
+    std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+
+    const auto it = QUANT_TYPES.find(s);
+    if (it == QUANT_TYPES.end()) {
+        fprintf(stderr, "%s: unknown type '%s'\n", __func__, str.c_str());
+        return GGML_TYPE_COUNT;
+    }
+
+    return it->second;
+}
+
+static const quant_class * find_class(const std::string & name) {
+    for (const auto & c : QUANT_CLASSES) {
+        if (name == c.name) {
+            return &c;
+        }
+    }
+    return nullptr;
+}
+
+// CLASS=TYPE -> one rule per class
+static bool parse_rule(const std::string & str, quant_config & rules) {
+    const size_t pos = str.rfind('=');
+    if (pos == std::string::npos) {
+        fprintf(stderr, "%s: invalid rule '%s', expected CLASS=TYPE\n", __func__, str.c_str());
+        return false;
+    }
+
+    const std::string name = str.substr(0, pos);
+    const ggml_type   type = parse_type(str.substr(pos + 1));
+    if (type == GGML_TYPE_COUNT) {
+        return false;
+    }
+
+    std::vector<std::string> names = { name };
+    if (QUANT_ALIASES.count(name)) {
+        names = QUANT_ALIASES.at(name);
+    }
+
+    for (const auto & n : names) {
+        const quant_class * c = find_class(n);
+        if (c && c->conv && type != GGML_TYPE_F16 && type != GGML_TYPE_F32) {
+            fprintf(stderr, "%s: the convolutions can only be stored as f16 or f32\n", __func__);
+            return false;
+        }
+
+        rules.push_back({ c ? c->pattern : n, type });
+    }
+
+    return true;
+}
+
+static std::string type_name(ggml_type type) {
+    for (const auto & t : QUANT_TYPES) {
+        if (t.second == type) {
+            return t.first;
+        }
+    }
+    return ggml_type_name(type);
+}
+
+static ggml_ftype type_to_ftype(ggml_type type) {
+    switch (type) {
+        case GGML_TYPE_F32:  return GGML_FTYPE_ALL_F32;
+        case GGML_TYPE_F16:  return GGML_FTYPE_MOSTLY_F16;
+        case GGML_TYPE_Q4_0: return GGML_FTYPE_MOSTLY_Q4_0;
+        case GGML_TYPE_Q4_1: return GGML_FTYPE_MOSTLY_Q4_1;
+        case GGML_TYPE_Q5_0: return GGML_FTYPE_MOSTLY_Q5_0;
+        case GGML_TYPE_Q5_1: return GGML_FTYPE_MOSTLY_Q5_1;
+        case GGML_TYPE_Q8_0: return GGML_FTYPE_MOSTLY_Q8_0;
+        case GGML_TYPE_Q2_K: return GGML_FTYPE_MOSTLY_Q2_K;
+        case GGML_TYPE_Q3_K: return GGML_FTYPE_MOSTLY_Q3_K;
+        case GGML_TYPE_Q4_K: return GGML_FTYPE_MOSTLY_Q4_K;
+        case GGML_TYPE_Q5_K: return GGML_FTYPE_MOSTLY_Q5_K;
+        case GGML_TYPE_Q6_K: return GGML_FTYPE_MOSTLY_Q6_K;
+        default:             return GGML_FTYPE_UNKNOWN;
+    }
+}
+
+// the k-quants need rows that are a multiple of 256 - e.g. n_state = 384 in the tiny models is not
+static ggml_type type_for_row(ggml_type type, int64_t n_per_row) {
+    while (n_per_row % ggml_blck_size(type) != 0) {
+        switch (type) {
+            case GGML_TYPE_Q2_K:
+            case GGML_TYPE_Q3_K: type = GGML_TYPE_Q4_0; break;
+            case GGML_TYPE_Q4_K: type = GGML_TYPE_Q5_0; break;
+            case GGML_TYPE_Q5_K: type = GGML_TYPE_Q5_1; break;
+            case GGML_TYPE_Q6_K: type = GGML_TYPE_Q8_0; break;
+            default:             type = GGML_TYPE_F16;  break;
+        }
+    }
+    return type;
+}
+
+// apply the rules to the source model
+//
+// only the 2D weight matrices are converted - the positional embeddings, biases and norms keep their type
+static bool quantize_model(const whisper_model_file & src, const quant_config & rules, ggml_type type_default, whisper_model_file & dst, bool verbose) {
+    dst = src;
+    dst.tensors.clear();
+
+    std::vector<std::regex> patterns;
+    for (const auto & r : rules) {
+        patterns.emplace_back(r.pattern);
+    }
+
+    std::map<ggml_type, size_t> type_bytes;
+
+    std::vector<float> data_f32;
+
+    size_t total_size_org = 0;
+    size_t total_size_new = 0;
+
+    for (const auto & t : src.tensors) {
+        ggml_type type = t.type;
+
+        const bool weight = t.n_dims == 2 && t.name.find("positional_embedding") == std::string::npos;
+
+        if (weight) {
+            if (type_default != GGML_TYPE_COUNT) {
+                type = type_default;
+            }
+
+            for (size_t i = 0; i < rules.size(); ++i) {
+                if (std::regex_match(t.name, patterns[i])) {
+                    type = rules[i].type;
+                }
+            }
+
+            // the convolutions are evaluated with im2col, which needs F16 or F32 kernels
+            if (t.name.find("conv") != std::string::npos && type != GGML_TYPE_F16 && type != GGML_TYPE_F32) {
+                type = t.type;
+            }
+
+            const ggml_type type_row = type_for_row(type, t.ne[0]);
+            if (type_row != type) {
+                if (verbose) {
+                    fprintf(stderr, "%s: %s: row size %d is not a multiple of %d, using %s instead of %s\n", __func__,
+                            t.name.c_str(), (int) t.ne[0], (int) ggml_blck_size(type), type_name(type_row).c_str(), type_name(type).c_str());
+                }
+                type = type_row;
+            }
+        }
+
+        whisper_model_file::tensor out;
+        out.name   = t.name;
+        out.type   = type;
+        out.n_dims = t.n_dims;
+        std::copy(t.ne, t.ne + 4, out.ne);
+
+        if (type == t.type) {
+            out.data = t.data;
+        } else {
+            const int64_t n_per_row = t.ne[0];
+            const int64_t nrows     = t.nelements()/n_per_row;
+
+            const auto * traits = ggml_get_type_traits(t.type);
+            if (!traits->to_float) {
+                fprintf(stderr, "%s: cannot convert tensor '%s' from %s\n", __func__, t.name.c_str(), ggml_type_name(t.type));
+                return false;
+            }
+
+            data_f32.resize(t.nelements());
+            traits->to_float(t.data.data(), data_f32.data(), t.nelements());
+
+            out.data.resize(ggml_row_size(type, n_per_row)*nrows);
+
+            if (type == GGML_TYPE_F32) {
+                memcpy(out.data.data(), data_f32.data(), out.data.size());
+            } else if (type == GGML_TYPE_F16) {
+                ggml_fp32_to_fp16_row(data_f32.data(), (ggml_fp16_t *) out.data.data(), t.nelements());
+            } else {
+                ggml_quantize_chunk(type, data_f32.data(), out.data.data(), 0, nrows, n_per_row, nullptr);
+            }
+        }
+
+        if (verbose) {
+            fprintf(stderr, "%48s - [%5d, %5d], %5s -> %5s, %8.2f MB -> %8.2f MB\n", t.name.c_str(), (int) t.ne[0], (int) t.ne[1],
+                    type_name(t.type).c_str(), type_name(type).c_str(), t.data.size()/1e6, out.data.size()/1e6);
+        }
+
+        if (weight) {
+            type_bytes[type] += out.data.size();
+        }
+
+        total_size_org += t.data.size();
+        total_size_new += out.data.size();
+
+        dst.tensors.push_back(std::move(out));
+    }
+
+    // the file type is the type that holds most of the weights
+    ggml_type type_main = GGML_TYPE_F16;
+    for (const auto & tb : type_bytes) {
+        if (tb.second > type_bytes[type_main]) {
+            type_main = tb.first;
+        }
+    }
+
+    const bool quantized = ggml_is_quantized(type_main);
+
+    dst.ftype = type_to_ftype(type_main) + (quantized ? GGML_QNT_VERSION*GGML_QNT_VERSION_FACTOR : 0);
+
+    if (verbose) {
+        fprintf(stderr, "%s: model size = %8.2f MB -> %8.2f MB, ftype = %s\n", __func__, total_size_org/1e6, total_size_new/1e6, type_name(type_main).c_str());
+    }
+
+    return true;
+}
+
+static size_t model_size(const whisper_model_file & model) {
+    size_t size = 0;
+    for (const auto & t : model.tensors) {
+        size += t.data.size();
+    }
+    return size;
+}
+
+// store the weight matrices in the repacked layout of the CPU backend
+//
+// the layout is selected by the CPU features, so it can only be produced for the CPU the tool runs on
+// the token embedding is also used by get_rows and the convolutions by im2col, so these are kept as they are
+static bool repack_model(whisper_model_file & model, const std::string & isa, bool verbose) {
+    const char * isa_cpu = ggml_backend_cpu_repack_isa();
+    if (!isa_cpu) {
+        fprintf(stderr, "%s: the CPU backend does not repack weights on this CPU\n", __func__);
+        return false;
+    }
+
+    if (isa != "native" && isa != isa_cpu) {
+        fprintf(stderr, "%s: cannot repack for '%s' on this CPU, its layout is '%s'\n", __func__, isa.c_str(), isa_cpu);
+        return false;
+    }
+
+    std::vector<std::regex> patterns;
+    for (const auto & c : QUANT_CLASSES) {
+        if (!c.conv && strcmp(c.name, "tok_embd") != 0) {
+            patterns.emplace_back(c.pattern);
+        }
+    }
+
+    ggml_init_params params = {
+        /*.mem_size   =*/ ggml_tensor_overhead(),
+        /*.mem_buffer =*/ nullptr,
+        /*.no_alloc   =*/ true,
+    };
+
+    ggml_context * ctx = ggml_init(params);
+
+    std::string names;
+
+    int    n_repacked    = 0;
+    size_t size_repacked = 0;
+
+    std::vector<uint8_t> data;
+
+    for (auto & t : model.tensors) {
+        if (t.n_dims != 2 || std::none_of(patterns.begin(), patterns.end(), [&](const std::regex & re) { return std::regex_match(t.name, re); })) {
+            continue;
+        }
+
+        ggml_tensor * meta = ggml_new_tensor_2d(ctx, t.type, t.ne[0], t.ne[1]);
+
+        data.resize(t.data.size());
+        if (ggml_backend_cpu_repack_tensor(meta, t.data.data(), data.data())) {
+            t.data.swap(data);
+
+            names += (names.empty() ? "" : ",") + t.name;
+
+            n_repacked++;
+            size_repacked += t.data.size();
+        } else if (verbose) {
+            fprintf(stderr, "%s: %s: %s [%d, %d] is not repacked on this CPU\n", __func__, t.name.c_str(), type_name(t.type).c_str(), (int) t.ne[0], (int) t.ne[1]);
+        }
+
+        ggml_reset(ctx);
+    }
+
+    ggml_free(ctx);
+
+    if (n_repacked == 0) {
+        fprintf(stderr, "%s: none of the weight matrices is repacked on this CPU - use a type such as q4_0, q5_0 or q8_0\n", __func__);
+        return false;
+    }
+
+    model.kv_str.emplace_back(ASR_KV_NAMES.at(ASR_KV_REPACK_ISA), isa_cpu);
+    model.kv_str.emplace_back(ASR_KV_NAMES.at(ASR_KV_REPACK_TENSORS), names);
+
+    if (verbose) {
+        fprintf(stderr, "%s: repacked %d tensors (%.2f MB) for '%s'\n", __func__, n_repacked, size_repacked/1e6, isa_cpu);
+    }
+
+    return true;
+}
+
+//
+// auto mode
+//
+
+struct ref_clip {
+    std::string        name;
+    std::vector<float> pcmf32;
+    std::vector<std::string> words;
+};
+
+struct eval_result {
+    std::string desc;
+
+    quant_config rules;
+
+    size_t size = 0;
+
+    float encode_ms = 0.0f; // per encoder run
+    float decode_ms = 0.0f; // per decoded token
+    float wer       = 0.0f; // %
+
+    bool pareto = false;
+};
+
+// lower case words without punctuation
+static std::vector<std::string> normalize_words(const std::string & text) {
+    std::vector<std::string> words;
+    std::string word;
+
+    for (char c : text) {
+        if (std::isalnum((unsigned char) c) || c == '\'' || (c & 0x80)) {
+            word += (char) std::tolower((unsigned char) c);
+        } else if (!word.empty()) {
+            words.push_back(word);
+            word.clear();
+        }
+    }
+    if (!word.empty()) {
+        words.push_back(word);
+    }
+
+    return words;
+}
+
+// word-level Levenshtein distance
+static int word_errors(const std::vector<std::string> & ref, const std::vector<std::string> & hyp) {
+    std::vector<int> prev(hyp.size() + 1);
+    std::vector<int> cur (hyp.size() + 1);
+
+    for (size_t j = 0; j <= hyp.size(); ++j) {
+        prev[j] = j;
+    }
+
+    for (size_t i = 1; i <= ref.size(); ++i) {
+        cur[0] = i;
+        for (size_t j = 1; j <= hyp.size(); ++j) {
+            const int sub = prev[j - 1] + (ref[i - 1] == hyp[j - 1] ? 0 : 1);
+            cur[j] = std::min({ sub, prev[j] + 1, cur[j - 1] + 1 });
+        }
+        std::swap(prev, cur);
+    }
+
+    return prev[hyp.size()];
+}
+
+static bool load_clips(const std::string & dir, std::vector<ref_clip> & clips) {
+    std::error_code ec;
+
+    std::vector<std::string> names;
+    for (const auto & e : std::filesystem::directory_iterator(dir, ec)) {
+        if (e.path().extension() == ".wav") {
+            names.push_back(e.path().stem().string());
+        }
+    }
+
+    if (ec) {
+        fprintf(stderr, "%s: failed to open '%s': %s\n", __func__, dir.c_str(), ec.message().c_str());
+        return false;
+    }
+
+    std::sort(names.begin(), names.end());
+
+    for (const auto & name : names) {
+        const std::string path = dir + "/" + name;
+
+        FILE * f = fopen((path + ".txt").c_str(), "rb");
+        if (!f) {
+            fprintf(stderr, "%s: no reference transcript for '%s.wav' - skipping\n", __func__, path.c_str());
+            continue;
+        }
+
+        std::string text;
+        char buf[4096];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+            text.append(buf, n);
+        }
+        fclose(f);
+
+        ref_clip clip;
+        clip.name  = name;
+        clip.words = normalize_words(text);
+
+        std::vector<std::vector<float>> pcmf32s;
+        if (!read_audio_data(path + ".wav", clip.pcmf32, pcmf32s, false)) {
+            fprintf(stderr, "%s: failed to read '%s.wav'\n", __func__, path.c_str());
+            return false;
+        }
+
+        clips.push_back(std::move(clip));
+    }
+
+    if (clips.empty()) {
+        fprintf(stderr, "%s: no clips found in '%s'\n", __func__, dir.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+static void whisper_log_quiet(ggml_log_level level, const char * text, void * /*user_data*/) {
+    if (level == GGML_LOG_LEVEL_ERROR) {
+        fputs(text, stderr);
+    }
+}
+
+// quantize with the given rules, transcribe the clips and measure size, speed and WER
+static bool evaluate(const whisper_model_file & src, const quant_params & params, const std::vector<ref_clip> & clips, eval_result & res) {
+    whisper_model_file model;
+    if (!quantize_model(src, res.rules, params.type_default, model, false)) {
+        return false;
+    }
+
+    res.size = model_size(model);
+
+    const std::string fname_tmp = params.fname_out + ".tmp";
+    if (!whisper_model_file_write_gguf(fname_tmp, model)) {
+        return false;
+    }
+
+    whisper_context_params cparams = whisper_context_default_params();
+    cparams.use_gpu = false;
+
+    whisper_context * ctx = whisper_init_from_file_with_params(fname_tmp.c_str(), cparams);
+    remove(fname_tmp.c_str());
+
+    if (!ctx) {
+        fprintf(stderr, "%s: failed to load the quantized model\n", __func__);
+        return false;
+    }
+
+    whisper_full_params wparams = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+    wparams.print_progress   = false;
+    wparams.print_realtime   = false;
+    wparams.print_timestamps = false;
+    wparams.no_timestamps    = true;
+    wparams.temperature_inc  = 0.0f; // no fallbacks - measure the model, not the sampling
+    wparams.language         = params.language.c_str();
+    wparams.n_threads        = params.n_threads;
+
+    if (whisper_warmup(ctx, nullptr, wparams) != 0) {
+        fprintf(stderr, "%s: failed to warm up the quantized model\n", __func__);
+        whisper_free(ctx);
+        return false;
+    }
+
+    int n_words  = 0;
+    int n_errors = 0;
+
+    for (const auto & clip : clips) {
+        if (whisper_full(ctx, wparams, clip.pcmf32.data(), clip.pcmf32.size()) != 0) {
+            fprintf(stderr, "%s: failed to transcribe '%s'\n", __func__, clip.name.c_str());
+            whisper_free(ctx);
+            return false;
+        }
+
+        std::string text;
+        for (int i = 0; i < whisper_full_n_segments(ctx); ++i) {
+            text += whisper_full_get_segment_text(ctx, i);
+        }
+
+        n_words  += clip.words.size();
+        n_errors += word_errors(clip.words, normalize_words(text));
+    }
+
+    whisper_timings * timings = whisper_get_timings(ctx);
+    res.encode_ms = timings->encode_ms;
+    res.decode_ms = timings->decode_ms;
+    delete timings;
+
+    res.wer = 100.0f*n_errors/std::max(1, n_words);
+
+    whisper_free(ctx);
+
+    fprintf(stderr, "%s: %-40s %8.2f MB, encode %8.2f ms, decode %6.2f ms/token, WER %6.2f %%\n", __func__,
+            res.desc.c_str(), res.size/1e6, res.encode_ms, res.decode_ms, res.wer);
+
+    return true;
+}
+
+// a dominates b if it is not worse in any metric and better in at least one
+static bool dominates(const eval_result & a, const eval_result & b) {
+    const bool no_worse = a.size <= b.size && a.encode_ms <= b.encode_ms && a.decode_ms <= b.decode_ms && a.wer <= b.wer;
+    const bool better   = a.size <  b.size || a.encode_ms <  b.encode_ms || a.decode_ms <  b.decode_ms || a.wer <  b.wer;
+
+    return no_worse && better;
+}
+
+static std::string rules_to_args(const quant_config & rules) {
+    std::string args;
+    for (const auto & r : rules) {
+        std::string name = r.pattern;
+        for (const auto & c : QUANT_CLASSES) {
+            if (r.pattern == c.pattern) {
+                name = c.name;
+            }
+        }
+        args += (args.empty() ? "" : " ") + std::string("--rule ") + name + "=" + type_name(r.type);
+    }
+    return args.empty() ? "-" : args;
+}
+
+// 1. quantize one class at a time to each candidate type and measure the WER increase per MB saved
+// 2. starting from the source model, greedily lower the class with the cheapest next step and evaluate each step
+// 3. print the configurations that are not dominated by any other
+static int run_auto(const whisper_model_file & src, const quant_params & params) {
+    std::vector<ref_clip> clips;
+    if (!load_clips(params.dir_clips, clips)) {
+        return 4;
+    }
+
+    fprintf(stderr, "%s: %zu reference clips\n", __func__, clips.size());
+
+    whisper_log_set(whisper_log_quiet, nullptr);
+
+    std::vector<eval_result> results;
+
+    eval_result base;
+    base.desc = "source";
+    if (!evaluate(src, params, clips, base)) {
+        return 5;
+    }
+    results.push_back(base);
+
+    // the classes that can be quantized
+    std::vector<const quant_class *> classes;
+    for (const auto & c : QUANT_CLASSES) {
+        if (!c.conv) {
+            classes.push_back(&c);
+        }
+    }
+
+    const auto & cand = params.candidates;
+
+    // sensitivity[i][j] - WER increase per MB saved when quantizing class i to candidate j
+    std::vector<std::vector<float>> sensitivity(classes.size(), std::vector<float>(cand.size(), 0.0f));
+    std::vector<std::vector<float>> saved      (classes.size(), std::vector<float>(cand.size(), 0.0f));
+
+    for (size_t i = 0; i < classes.size(); ++i) {
+        for (size_t j = 0; j < cand.size(); ++j) {
+            eval_result res;
+            res.desc  = std::string(classes[i]->name) + "=" + type_name(cand[j]);
+            res.rules = { { classes[i]->pattern, cand[j] } };
+
+            if (!evaluate(src, params, clips, res)) {
+                return 5;
+            }
+
+            saved[i][j] = std::max(1e-3f, (float(base.size) - float(res.size))/1e6f);
+
+            sensitivity[i][j] = std::max(0.0f, res.wer - base.wer)/saved[i][j];
+
+            results.push_back(res);
+        }
+    }
+
+    fprintf(stderr, "\n%s: sensitivity (WER %% per MB saved):\n", __func__);
+    for (size_t i = 0; i < classes.size(); ++i) {
+        fprintf(stderr, "%s:   %-10s", __func__, classes[i]->name);
+        for (size_t j = 0; j < cand.size(); ++j) {
+            fprintf(stderr, "  %s %8.4f", type_name(cand[j]).c_str(), sensitivity[i][j]);
+        }
+        fprintf(stderr, "\n");
+    }
+    fprintf(stderr, "\n");
+
+    // greedy descent - level[i] is the index of the candidate currently used for class i (-1: source type)
+    std::vector<int> level(classes.size(), -1);
+
+    int n_steps = 0;
+
+    while (true) {
+        int best = -1;
+        for (size_t i = 0; i < classes.size(); ++i) {
+            if (level[i] + 1 >= (int) cand.size()) {
+                continue;
+            }
+            if (best < 0) {
+                best = i;
+                continue;
+            }
+
+            const float s_i = sensitivity[i][level[i] + 1];
+            const float s_b = sensitivity[best][level[best] + 1];
+
+            // on ties, take the larger saving first
+            if (s_i < s_b || (s_i == s_b && saved[i][level[i] + 1] > saved[best][level[best] + 1])) {
+                best = i;
+            }
+        }
+
+        if (best < 0) {
+            break;
+        }
+
+        level[best]++;
+
+        eval_result res;
+        for (size_t i = 0; i < classes.size(); ++i) {
+            if (level[i] >= 0) {
+                res.rules.push_back({ classes[i]->pattern, cand[level[i]] });
+            }
+        }
+        res.desc = "step " + std::to_string(++n_steps) + ": " + classes[best]->name + "=" + type_name(cand[level[best]]);
+
+        if (!evaluate(src, params, clips, res)) {
+            return 5;
+        }
+
+        results.push_back(res);
+    }
+
+    for (auto & a : results) {
+        a.pareto = true;
+        for (const auto & b : results) {
+            if (dominates(b, a)) {
+                a.pareto = false;
+                break;
+            }
+        }
+    }
+
+    std::vector<const eval_result *> table;
+    for (const auto & r : results) {
+        if (r.pareto) {
+            table.push_back(&r);
+        }
+    }
+
+    std::sort(table.begin(), table.end(), [](const eval_result * a, const eval_result * b) { return a->size < b->size; });
+
+    printf("\n");
+    printf("| size MB | encoder ms | decoder ms/token | WER %% | rules |\n");
+    printf("| ------: | ---------: | ---------------: | ----: | ----- |\n");
+    for (const auto * r : table) {
+        printf("| %7.2f | %10.2f | %16.2f | %5.2f | %s |\n", r->size/1e6, r->encode_ms, r->decode_ms, r->wer, rules_to_args(r->rules).c_str());
+    }
+    printf("\n");
+
+    if (params.max_wer >= 0.0f) {
+        for (const auto * r : table) {
+            if (r->wer > params.max_wer) {
+                continue;
+            }
+
+            fprintf(stderr, "%s: writing the smallest model with WER <= %.2f %%: %s\n", __func__, params.max_wer, rules_to_args(r->rules).c_str());
+
+            whisper_model_file model;
+            if (!quantize_model(src, r->rules, params.type_default, model, false) ||
+                (!params.repack_isa.empty() && !repack_model(model, params.repack_isa, false)) ||
+                !whisper_model_file_write_gguf(params.fname_out, model)) {
+                return 3;
+            }
+
+            return 0;
+        }
+
+        fprintf(stderr, "%s: no configuration with WER <= %.2f %%\n", __func__, params.max_wer);
+        return 6;
+    }
+
+    return 0;
+}
+
+int main(int argc, char ** argv) {
+    quant_params params;
+
+    std::vector<std::string> positional;
+
+    // std::stof and std::stoi throw on values that are not numbers
+    int i = 1;
+    try {
+        for (; i < argc; ++i) {
+            const std::string arg = argv[i];
+
+            if (arg == "--rule" && i + 1 < argc) {
+                if (!parse_rule(argv[++i], params.rules)) {
+                    print_usage(argv[0]);
+                    return 1;
+                }
+            } else if (arg == "--type" && i + 1 < argc) {
+                params.type_default = parse_type(argv[++i]);
+                if (params.type_default == GGML_TYPE_COUNT) {
+                    print_usage(argv[0]);
+                    return 1;
+                }
+            } else if (arg == "--auto" && i + 1 < argc) {
+                params.dir_clips = argv[++i];
+            } else if (arg == "--candidates" && i + 1 < argc) {
+                params.candidates.clear();
+
+                std::string list = argv[++i];
+                size_t pos = 0;
+                while (pos <= list.size()) {
+                    const size_t end = std::min(list.find(',', pos), list.size());
+                    const ggml_type type = parse_type(list.substr(pos, end - pos));
+                    if (type == GGML_TYPE_COUNT) {
+                        print_usage(argv[0]);
+                        return 1;
+                    }
+                    params.candidates.push_back(type);
+                    pos = end + 1;
+                }
+            } else if (arg == "--max-wer" && i + 1 < argc) {
+                params.max_wer = std::stof(argv[++i]);
+            } else if (arg == "-l" && i + 1 < argc) {
+                params.language = argv[++i];
+            } else if (arg == "-t" && i + 1 < argc) {
+                params.n_threads = std::stoi(argv[++i]);
+            } else if (arg == "--repack" && i + 1 < argc) {
+                params.repack_isa = argv[++i];
+            } else if (arg == "-h" || arg == "--help") {
+                print_usage(argv[0]);
+                return 0;
+            } else if (arg[0] == '-') {
+                fprintf(stderr, "%s: unknown argument '%s'\n", __func__, arg.c_str());
+                print_usage(argv[0]);
+                return 1;
+            } else {
+                positional.push_back(arg);
+            }
+        }
+    } catch (const std::exception &) {
+        fprintf(stderr, "%s: invalid value '%s' for '%s'\n", __func__, argv[i], argv[i - 1]);
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    if (positional.size() != 2) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    params.fname_inp = positional[0];
+    params.fname_out = positional[1];
+
+    ggml_time_init();
+
+    // needed to initialize the f16 tables
+    {
+        struct ggml_init_params ggml_params = { 0, NULL, false };
+        struct ggml_context * ctx = ggml_init(ggml_params);
+        ggml_free(ctx);
+    }
+
+    whisper_model_file src;
+
+    if (!whisper_model_file_read(params.fname_inp, src)) {
+        fprintf(stderr, "%s: failed to read '%s'\n", __func__, params.fname_inp.c_str());
+        return 2;
+    }
+
+    for (const auto & kv : src.kv_str) {
+        if (kv.first == ASR_KV_NAMES.at(ASR_KV_REPACK_ISA)) {
+            fprintf(stderr, "%s: the weights in '%s' are already repacked, use the original model\n", __func__, params.fname_inp.c_str());
+            return 2;
+        }
+    }
+
+    if (!params.dir_clips.empty()) {
+        return run_auto(src, params);
+    }
+
+    const int64_t t_start_us = ggml_time_us();
+
+    whisper_model_file model;
+
+    if (!quantize_model(src, params.rules, params.type_default, model, true)) {
+        fprintf(stderr, "%s: failed to quantize '%s'\n", __func__, params.fname_inp.c_str());
+        return 3;
+    }
+
+    if (!params.repack_isa.empty() && !repack_model(model, params.repack_isa, true)) {
+        fprintf(stderr, "%s: failed to repack '%s'\n", __func__, params.fname_inp.c_str());
+        return 3;
+    }
+
+    if (!whisper_model_file_write_gguf(params.fname_out, model)) {
+        fprintf(stderr, "%s: failed to write '%s'\n", __func__, params.fname_out.c_str());
+        return 3;
+    }
+
+    fprintf(stderr, "%s: wrote '%s' in %.2f s\n", __func__, params.fname_out.c_str(), (ggml_time_us() - t_start_us)/1e6);
+
+    return 0;
+}
@@ -139,3 +139,58 @@ static const std::map<asr_tensor, ggml_op> ASR_TENSOR_INFO = {
     {ASR_TENSOR_ATTN_OUT_WEIGHT,       GGML_OP_MUL_MAT},
     {ASR_TENSOR_ATTN_OUT_BIAS,         GGML_OP_ADD},
 };
+
+// GGUF metadata
+//
+// the tensors use the same names as in the legacy ggml files (see ASR_TENSOR_NAMES)
+// the vocab is stored as raw bytes, because some of the byte-level tokens are not valid strings (e.g. "\0")
+// the optional repack keys list the tensors stored in the interleaved layout of the CPU backend and the name of the
+// layouts (ggml_backend_cpu_repack_isa) - such files can only be loaded on CPUs with the same name
+
+#define ASR_ARCH_NAME "whisper"
+
+enum asr_kv {
+    ASR_KV_GENERAL_ARCHITECTURE,
+    ASR_KV_GENERAL_FILE_TYPE,
+    ASR_KV_GENERAL_QUANTIZATION_VERSION,
+    ASR_KV_VOCAB_SIZE,
+    ASR_KV_AUDIO_CONTEXT_LENGTH,
+    ASR_KV_AUDIO_EMBEDDING_LENGTH,
+    ASR_KV_AUDIO_HEAD_COUNT,
+    ASR_KV_AUDIO_BLOCK_COUNT,
+    ASR_KV_TEXT_CONTEXT_LENGTH,
+    ASR_KV_TEXT_EMBEDDING_LENGTH,
+    ASR_KV_TEXT_HEAD_COUNT,
+    ASR_KV_TEXT_BLOCK_COUNT,
+    ASR_KV_MEL_COUNT,
+    ASR_KV_MEL_FILTERS_N_MEL,
+    ASR_KV_MEL_FILTERS_N_FFT,
+    ASR_KV_MEL_FILTERS_DATA,
+    ASR_KV_TOKENIZER_TOKEN_BYTES,
+    ASR_KV_TOKENIZER_TOKEN_LENGTHS,
+    ASR_KV_REPACK_ISA,
+    ASR_KV_REPACK_TENSORS,
+};
+
+static const std::map<asr_kv, const char *> ASR_KV_NAMES = {
+    {ASR_KV_GENERAL_ARCHITECTURE,         "general.architecture"},
+    {ASR_KV_GENERAL_FILE_TYPE,            "general.file_type"},
+    {ASR_KV_GENERAL_QUANTIZATION_VERSION, "general.quantization_version"},
+    {ASR_KV_VOCAB_SIZE,                   "whisper.vocab_size"},
+    {ASR_KV_AUDIO_CONTEXT_LENGTH,         "whisper.audio.context_length"},
+    {ASR_KV_AUDIO_EMBEDDING_LENGTH,       "whisper.audio.embedding_length"},
+    {ASR_KV_AUDIO_HEAD_COUNT,             "whisper.audio.attention.head_count"},
+    {ASR_KV_AUDIO_BLOCK_COUNT,            "whisper.audio.block_count"},
+    {ASR_KV_TEXT_CONTEXT_LENGTH,          "whisper.text.context_length"},
+    {ASR_KV_TEXT_EMBEDDING_LENGTH,        "whisper.text.embedding_length"},
+    {ASR_KV_TEXT_HEAD_COUNT,              "whisper.text.attention.head_count"},
+    {ASR_KV_TEXT_BLOCK_COUNT,             "whisper.text.block_count"},
+    {ASR_KV_MEL_COUNT,                    "whisper.mel_count"},
+    {ASR_KV_MEL_FILTERS_N_MEL,            "whisper.mel_filters.n_mel"},
+    {ASR_KV_MEL_FILTERS_N_FFT,            "whisper.mel_filters.n_fft"},
+    {ASR_KV_MEL_FILTERS_DATA,             "whisper.mel_filters.data"},
+    {ASR_KV_TOKENIZER_TOKEN_BYTES,        "tokenizer.whisper.token_bytes"},
+    {ASR_KV_TOKENIZER_TOKEN_LENGTHS,      "tokenizer.whisper.token_lengths"},
+    {ASR_KV_REPACK_ISA,                   "whisper.repack.isa"},
+    {ASR_KV_REPACK_TENSORS,               "whisper.repack.tensors"},
+};
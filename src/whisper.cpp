@@ -5,6 +5,7 @@
 #include "ggml-cpp.h"
 #include "ggml-alloc.h"
 #include "ggml-backend.h"
+#include "gguf.h"
 
 #ifdef WHISPER_USE_COREML
 #include "coreml/whisper-encoder.h"
@@ -16,16 +17,21 @@
 
 #include <atomic>
 #include <algorithm>
+#include <array>
 #include <cassert>
+#include <cerrno>
 #define _USE_MATH_DEFINES
 #include <cmath>
 #include <climits>
 #include <codecvt>
 #include <cstdarg>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <exception>
 #include <fstream>
 #include <functional>
+#include <limits>
 #include <map>
 #include <mutex>
 #include <random>
@@ -35,6 +41,26 @@
 #include <thread>
 #include <vector>
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#endif
+
 // dummy
 
 #if defined(_MSC_VER)
@@ -144,6 +170,7 @@ static void whisper_log_callback_default(ggml_log_level level, const char * text
 
 #define WHISPER_MAX_DECODERS 8
 #define WHISPER_MAX_NODES 4096
+#define WHISPER_MAX_GRAPHS 64 // max number of cached decoder graphs per state
 
 static std::string format(const char * fmt, ...) {
     va_list ap;
@@ -187,27 +214,6 @@ static bool ggml_graph_compute_helper(
     return ggml_backend_graph_compute(backend.get(), graph) == GGML_STATUS_SUCCESS;
 }
 
-static bool ggml_graph_compute_helper(
-      ggml_backend_sched_t   sched,
-        struct ggml_cgraph * graph,
-                       int   n_threads) {
-
-    for (int i = 0; i < ggml_backend_sched_get_n_backends(sched); ++i) {
-        ggml_backend_t backend = ggml_backend_sched_get_backend(sched, i);
-        ggml_backend_dev_t dev = ggml_backend_get_device(backend);
-        ggml_backend_reg_t reg = dev ? ggml_backend_dev_backend_reg(dev) : nullptr;
-
-        auto * fn_set_n_threads = (ggml_backend_set_n_threads_t) ggml_backend_reg_get_proc_address(reg, "ggml_backend_set_n_threads");
-        if (fn_set_n_threads) {
-            fn_set_n_threads(backend, n_threads);
-        }
-    }
-
-    bool t = ggml_backend_sched_graph_compute(sched, graph) == GGML_STATUS_SUCCESS;
-    ggml_backend_sched_reset(sched);
-    return t;
-}
-
 static void whisper_load_backends() {
 #ifdef GGML_BACKEND_DL
     static std::once_flag flag;
@@ -578,11 +584,45 @@ struct whisper_pair {
     whisper_pair() : first(A()), second(B()) {}
 };
 
+// shapes and external tensors that a cached graph was built for
+using whisper_graph_key = std::array<int64_t, 4>;
+
+// compute graph that is kept around to be reused for identical shapes
+struct whisper_sched_graph {
+    whisper_graph_key key = {};
+
+    // meta data of the graph - empty if the graph lives in the meta buffer of the scheduler
+    std::vector<uint8_t> meta;
+
+    ggml_cgraph * graph = nullptr;
+
+    int32_t  i_alloc = -1; // compute buffer generation that the graph tensors have been allocated in
+    uint64_t t_last  = 0;  // used to evict the least recently used graph
+};
+
 // ggml_backend_sched wrapper for whisper usage
 struct whisper_sched {
     ggml_backend_sched_t sched = nullptr;
 
     std::vector<uint8_t> meta;
+
+    size_t meta_used  = 0; // bytes of meta used by the last graph build
+    size_t meta_graph = 0; // size of the meta buffer of a cached graph
+
+    // graph cache - see whisper_sched_graph_get()
+    int n_graphs_max = 1;
+
+    std::vector<whisper_sched_graph> graphs;
+
+    ggml_cgraph * graph_alloc = nullptr; // graph currently allocated by the scheduler
+
+    size_t   buf_size = 0;
+    int32_t  i_alloc  = 0; // incremented each time the compute buffers are re-allocated
+    uint64_t t_last   = 0;
+
+    int64_t t_build_us = 0;
+    int32_t n_build    = 0;
+    int32_t n_reuse    = 0;
 };
 
 static size_t whisper_sched_size(struct whisper_sched & allocr) {
@@ -613,9 +653,160 @@ static bool whisper_sched_graph_init(struct whisper_sched & allocr, std::vector<
 
     ggml_backend_sched_reset(sched);
 
+    allocr.buf_size = whisper_sched_size(allocr) - meta.size();
+
     return true;
 }
 
+// drop all cached graphs, e.g. when the tensors that they reference are re-created
+static void whisper_sched_graph_clear(struct whisper_sched & allocr) {
+    allocr.graphs.clear();
+    allocr.graph_alloc = nullptr;
+}
+
+// return an allocated graph for the given key
+//
+// the graph is built and allocated only if there is no cached graph for the key - otherwise only the inputs
+// have to be set before computing it with ggml_graph_compute_helper()
+//
+// a cached graph is reused if:
+//   - it is still allocated by the scheduler (it was the last graph computed with it), or
+//   - the scheduler has a single backend and the compute buffer has not been re-allocated since
+//     the graph was allocated - with multiple backends, splitting another graph rewrites the graph sources
+//
+static struct ggml_cgraph * whisper_sched_graph_get(
+        struct whisper_sched & allocr,
+     const whisper_graph_key & key,
+        const std::function<struct ggml_cgraph *()> & build) {
+    auto & sched = allocr.sched;
+
+    const bool single = ggml_backend_sched_get_n_backends(sched) == 1;
+
+    for (size_t i = 0; i < allocr.graphs.size(); ++i) {
+        auto & g = allocr.graphs[i];
+        if (g.key != key) {
+            continue;
+        }
+
+        if (allocr.graph_alloc == g.graph || (single && g.i_alloc == allocr.i_alloc)) {
+            g.t_last = ++allocr.t_last;
+            allocr.n_reuse++;
+
+            return g.graph;
+        }
+
+        // stale
+        allocr.graphs.erase(allocr.graphs.begin() + i);
+        break;
+    }
+
+    const int64_t t_start_us = ggml_time_us();
+
+    ggml_cgraph * gf = nullptr;
+
+    if (allocr.n_graphs_max <= 1 || !single) {
+        // build in the meta buffer of the scheduler - this invalidates the previous graph
+        whisper_sched_graph_clear(allocr);
+
+        gf = build();
+
+        if (allocr.n_graphs_max > 0) {
+            allocr.graphs.emplace_back();
+            allocr.graphs.back().key   = key;
+            allocr.graphs.back().graph = gf;
+        }
+    } else {
+        std::vector<uint8_t> meta;
+
+        if ((int) allocr.graphs.size() >= allocr.n_graphs_max) {
+            auto it = std::min_element(allocr.graphs.begin(), allocr.graphs.end(),
+                    [](const whisper_sched_graph & a, const whisper_sched_graph & b) { return a.t_last < b.t_last; });
+
+            if (allocr.graph_alloc == it->graph) {
+                allocr.graph_alloc = nullptr;
+            }
+
+            meta = std::move(it->meta);
+            allocr.graphs.erase(it);
+        }
+
+        if (allocr.meta_graph == 0) {
+            // the number of objects in a graph does not depend on the shapes, so measure it once
+            // with a full-size meta buffer and then build each graph in a buffer of just the right size
+            build();
+
+            allocr.meta_graph = allocr.meta_used;
+        }
+
+        meta.resize(allocr.meta_graph);
+
+        std::swap(allocr.meta, meta);
+        gf = build();
+        std::swap(allocr.meta, meta);
+
+        allocr.graphs.emplace_back();
+        allocr.graphs.back().key   = key;
+        allocr.graphs.back().meta  = std::move(meta);
+        allocr.graphs.back().graph = gf;
+    }
+
+    ggml_backend_sched_reset(sched);
+    allocr.graph_alloc = nullptr;
+
+    if (!ggml_backend_sched_alloc_graph(sched, gf)) {
+        // should never happen as we pre-allocate the memory
+        whisper_sched_graph_clear(allocr);
+        return nullptr;
+    }
+
+    allocr.graph_alloc = gf;
+
+    // the allocations of the other cached graphs are no longer valid if the compute buffers have grown
+    const size_t buf_size = whisper_sched_size(allocr) - allocr.meta.size();
+    if (buf_size != allocr.buf_size) {
+        allocr.buf_size = buf_size;
+        allocr.i_alloc++;
+    }
+
+    if (!allocr.graphs.empty() && allocr.graphs.back().graph == gf) {
+        allocr.graphs.back().i_alloc = allocr.i_alloc;
+        allocr.graphs.back().t_last  = ++allocr.t_last;
+    }
+
+    allocr.t_build_us += ggml_time_us() - t_start_us;
+    allocr.n_build++;
+
+    return gf;
+}
+
+// compute a graph returned by whisper_sched_graph_get()
+//
+// the scheduler is not reset afterwards, so that the graph can be computed again without re-allocating it
+static bool ggml_graph_compute_helper(
+       struct whisper_sched & allocr,
+        struct ggml_cgraph * graph,
+                       int   n_threads) {
+    auto & sched = allocr.sched;
+
+    for (int i = 0; i < ggml_backend_sched_get_n_backends(sched); ++i) {
+        ggml_backend_t backend = ggml_backend_sched_get_backend(sched, i);
+        ggml_backend_dev_t dev = ggml_backend_get_device(backend);
+        ggml_backend_reg_t reg = dev ? ggml_backend_dev_backend_reg(dev) : nullptr;
+
+        auto * fn_set_n_threads = (ggml_backend_set_n_threads_t) ggml_backend_reg_get_proc_address(reg, "ggml_backend_set_n_threads");
+        if (fn_set_n_threads) {
+            fn_set_n_threads(backend, n_threads);
+        }
+    }
+
+    if (allocr.graph_alloc == graph) {
+        return ggml_backend_sched_graph_compute(sched, graph) == GGML_STATUS_SUCCESS;
+    }
+
+    // cached graph that is still allocated in the compute buffer of the (single) backend
+    return ggml_backend_graph_compute(ggml_backend_sched_get_backend(sched, 0), graph) == GGML_STATUS_SUCCESS;
+}
+
 // medium
 // hparams: {
 // 'n_mels': 80,
@@ -760,6 +951,114 @@ struct whisper_kv_cache {
     std::vector<uint8_t> ctx_buf;
 };
 
+// read-only mapping of a model file
+//
+// the CPU weights can reference the mapping directly, so that the pages are shared through the page cache
+// between all processes that load the same file and are only faulted in when first touched
+struct whisper_mmap {
+    uint8_t * addr = nullptr;
+    size_t    size = 0;
+
+    // read cursor used by the model loader
+    size_t pos = 0;
+
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(WHISPER_BIG_ENDIAN)
+    static constexpr bool SUPPORTED = true;
+
+    whisper_mmap(const char * fname, bool prefetch) {
+        int fd = open(fname, O_RDONLY);
+        if (fd == -1) {
+            throw std::runtime_error(format("failed to open '%s': %s", fname, strerror(errno)));
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            close(fd);
+            throw std::runtime_error(format("failed to stat '%s'", fname));
+        }
+
+        size = st.st_size;
+
+        int flags = MAP_PRIVATE;
+#ifdef __linux__
+        if (prefetch) {
+            flags |= MAP_POPULATE;
+        }
+#endif
+        void * ptr = mmap(nullptr, size, PROT_READ, flags, fd, 0);
+        close(fd);
+
+        if (ptr == MAP_FAILED) {
+            throw std::runtime_error(format("mmap failed: %s", strerror(errno)));
+        }
+
+        addr = (uint8_t *) ptr;
+
+        mapped.emplace_back(0, size);
+
+        if (prefetch) {
+            if (posix_madvise(addr, size, POSIX_MADV_WILLNEED) != 0) {
+                WHISPER_LOG_WARN("%s: posix_madvise(.., POSIX_MADV_WILLNEED) failed: %s\n", __func__, strerror(errno));
+            }
+        }
+    }
+
+    ~whisper_mmap() {
+        // only the pieces that are still mapped - the released holes can hold other mappings by now
+        for (const auto & m : mapped) {
+            munmap(addr + m.first, m.second - m.first);
+        }
+    }
+
+    // drop the pages of a range that has been copied out of the mapping and is not referenced anymore
+    void release(size_t offs, size_t n) {
+        const size_t page_size = sysconf(_SC_PAGESIZE);
+
+        const size_t beg = GGML_PAD(offs, page_size);
+        const size_t end = (offs + n) & ~(page_size - 1);
+
+        if (beg >= end) {
+            return;
+        }
+
+        std::vector<std::pair<size_t, size_t>> res;
+        for (const auto & m : mapped) {
+            if (m.second <= beg || m.first >= end) {
+                res.push_back(m);
+                continue;
+            }
+
+            const size_t ubeg = std::max(m.first,  beg);
+            const size_t uend = std::min(m.second, end);
+
+            munmap(addr + ubeg, uend - ubeg);
+
+            if (m.first < ubeg) {
+                res.emplace_back(m.first, ubeg);
+            }
+            if (uend < m.second) {
+                res.emplace_back(uend, m.second);
+            }
+        }
+        mapped = std::move(res);
+    }
+
+    // [begin, end) of the pieces of the file that are still mapped
+    std::vector<std::pair<size_t, size_t>> mapped;
+#else
+    static constexpr bool SUPPORTED = false;
+
+    whisper_mmap(const char * /*fname*/, bool /*prefetch*/) {
+        throw std::runtime_error("mmap not supported on this platform");
+    }
+
+    void release(size_t /*offs*/, size_t /*n*/) {}
+#endif
+
+    whisper_mmap(const whisper_mmap &) = delete;
+    whisper_mmap & operator=(const whisper_mmap &) = delete;
+};
+
 struct whisper_model {
     e_model type = MODEL_UNKNOWN;
 
@@ -800,6 +1099,10 @@ struct whisper_model {
     // the model backend data is read-only and can be shared between processors
     std::vector<ggml_backend_buffer_t> buffers;
 
+    // model file mapping - CPU tensors with a suitably aligned file offset point directly into it
+    std::unique_ptr<whisper_mmap> mapping;
+    int n_mapped = 0;
+
     // tensors
     int n_loaded;
     std::map<std::string, struct ggml_tensor *> tensors;
@@ -955,6 +1258,19 @@ struct whisper_state {
 
     // [EXPERIMENTAL] speed-up techniques
     int32_t exp_n_audio_ctx = 0; // 0 - use default
+
+    // NUMA mode - node the state is bound to (-1 if none) and the thread pool pinned to its CPUs
+    int numa_node = -1;
+
+    ggml_threadpool_t threadpool = nullptr;
+
+    int threadpool_n_threads = 0;
+};
+
+struct whisper_numa_node {
+    int id = 0; // system node id
+
+    std::vector<int> cpus;
 };
 
 struct whisper_context {
@@ -972,8 +1288,22 @@ struct whisper_context {
     whisper_state * state = nullptr;
 
     std::string path_model; // populated by whisper_init_from_file_with_params()
+
+    // NUMA mode - the weights in `model` are local to the first node, the other nodes use a replica
+    std::vector<whisper_numa_node> numa_nodes;
+    std::vector<std::unique_ptr<whisper_model>> numa_replicas; // [i] - weights of numa_nodes[i + 1]
+
+    std::atomic<int> numa_next = { 0 }; // round-robin assignment of the states
+
+    // states reused by whisper_full_parallel_vad() across calls
+    std::vector<whisper_state *> parallel_states;
 };
 
+// weights used by the state - the replica local to its NUMA node, if any
+static const whisper_model & whisper_state_model(const whisper_context & wctx, const whisper_state & wstate) {
+    return wstate.numa_node > 0 ? *wctx.numa_replicas[wstate.numa_node - 1] : wctx.model;
+}
+
 struct whisper_global {
     // We save the log callback globally
     ggml_log_callback log_callback = whisper_log_callback_default;
@@ -982,95 +1312,307 @@ struct whisper_global {
 
 static whisper_global g_state;
 
-template<typename T>
-static void read_safe(whisper_model_loader * loader, T & dest) {
-    loader->read(loader->context, &dest, sizeof(T));
-    BYTESWAP_VALUE(dest);
-}
-
-static bool whisper_kv_cache_init(
-             struct whisper_kv_cache & cache,
-                      ggml_backend_t   backend,
-                           ggml_type   wtype,
-                             int64_t   n_text_state,
-                             int64_t   n_text_layer,
-                                 int   n_ctx) {
-    const int64_t n_mem      = n_text_layer*n_ctx;
-    const int64_t n_elements = n_text_state*n_mem;
+//
+// NUMA
+//
 
-    cache.ctx_buf.resize(2*ggml_tensor_overhead());
+// "0-3,8,10-11" -> 0, 1, 2, 3, 8, 10, 11
+static std::vector<int> whisper_parse_cpu_list(const std::string & str) {
+    std::vector<int> cpus;
 
-    struct ggml_init_params params = {
-        /*.mem_size   =*/ cache.ctx_buf.size(),
-        /*.mem_buffer =*/ cache.ctx_buf.data(),
-        /*.no_alloc   =*/ true,
-    };
+    size_t pos = 0;
+    while (pos < str.size()) {
+        const size_t end = std::min(str.find(',', pos), str.size());
+        const std::string range = str.substr(pos, end - pos);
 
-    cache.head = 0;
-    cache.size = n_ctx;
+        try {
+            const size_t dash = range.find('-');
 
-    cache.cells.clear();
-    cache.cells.resize(n_ctx);
+            const int first = std::stoi(range.substr(0, dash));
+            const int last  = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
 
-    struct ggml_context * ctx = ggml_init(params);
+            for (int cpu = first; cpu <= last; ++cpu) {
+                cpus.push_back(cpu);
+            }
+        } catch (const std::exception &) {
+            // empty or malformed range
+        }
 
-    if (!ctx) {
-        WHISPER_LOG_ERROR("%s: failed to allocate memory for the kv cache context\n", __func__);
-        return false;
+        pos = end + 1;
     }
 
-    cache.k = ggml_new_tensor_1d(ctx, wtype, n_elements);
-    cache.v = ggml_new_tensor_1d(ctx, wtype, n_elements);
+    return cpus;
+}
 
-    cache.buffer = ggml_backend_alloc_ctx_tensors(ctx, backend);
-    if (!cache.buffer) {
-        WHISPER_LOG_ERROR("%s: failed to allocate memory for the kv cache\n", __func__);
-        return false;
-    }
+// CPUs the process is allowed to run on
+static std::vector<int> whisper_cpus_allowed() {
+    std::vector<int> cpus;
 
-    ggml_backend_buffer_clear(cache.buffer, 0);
+#ifdef __linux__
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+#endif
 
-    ggml_free(ctx);
+    if (cpus.empty()) {
+        for (int cpu = 0; cpu < (int) std::max(1u, std::thread::hardware_concurrency()); ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
 
-    return true;
+    return cpus;
 }
 
-static void whisper_kv_cache_free(struct whisper_kv_cache & cache) {
-    ggml_backend_buffer_free(cache.buffer);
-}
+// CPUs of each NUMA node - see whisper_context_params.numa
+static std::vector<whisper_numa_node> whisper_numa_topology() {
+    std::vector<whisper_numa_node> nodes;
 
-static bool whisper_kv_cache_find_slot(
-           struct whisper_kv_cache & cache,
-        const struct whisper_batch & batch) {
-    const uint32_t n_ctx    = cache.size;
-    const uint32_t n_tokens = batch.n_tokens;
+    const char * topology = getenv("WHISPER_NUMA_TOPOLOGY");
 
-    if (n_tokens > n_ctx) {
-        WHISPER_LOG_ERROR("%s: n_tokens=%d > n_ctx=%d\n", __func__, n_tokens, n_ctx);
-        return false;
-    }
+    if (topology && *topology) {
+        const std::string str = topology;
 
-    uint32_t n_tested = 0;
+        if (str.find_first_not_of("0123456789") == std::string::npos) {
+            // split the allowed CPUs evenly - with more nodes than CPUs, the nodes share CPUs
+            const std::vector<int> cpus = whisper_cpus_allowed();
 
-    while (true) {
-        if (cache.head + n_tokens > n_ctx) {
-            n_tested += n_ctx - cache.head;
-            cache.head = 0;
-            continue;
-        }
+            const int n_nodes = std::max(1, atoi(topology));
+            const int n_cpus  = cpus.size();
 
-        bool found = true;
-        for (uint32_t i = 0; i < n_tokens; i++) {
-            if (cache.cells[cache.head + i].pos >= 0) {
-                found = false;
-                cache.head += i + 1;
-                n_tested   += i + 1;
-                break;
+            for (int i = 0; i < n_nodes; ++i) {
+                whisper_numa_node node;
+                node.id = i;
+
+                for (int j = i*n_cpus/n_nodes; j < (i + 1)*n_cpus/n_nodes; ++j) {
+                    node.cpus.push_back(cpus[j]);
+                }
+
+                if (node.cpus.empty()) {
+                    node.cpus.push_back(cpus[i % n_cpus]);
+                }
+
+                nodes.push_back(std::move(node));
             }
-        }
+        } else {
+            size_t pos = 0;
+            while (pos < str.size()) {
+                const size_t end = std::min(str.find(';', pos), str.size());
 
-        if (found) {
-            break;
+                whisper_numa_node node;
+                node.id   = nodes.size();
+                node.cpus = whisper_parse_cpu_list(str.substr(pos, end - pos));
+
+                if (!node.cpus.empty()) {
+                    nodes.push_back(std::move(node));
+                }
+
+                pos = end + 1;
+            }
+        }
+
+        return nodes;
+    }
+
+#ifdef __linux__
+    auto read_line = [](const std::string & fname) {
+        std::string line;
+        std::ifstream fin(fname);
+        std::getline(fin, line);
+        return line;
+    };
+
+    for (int id : whisper_parse_cpu_list(read_line("/sys/devices/system/node/online"))) {
+        whisper_numa_node node;
+        node.id   = id;
+        node.cpus = whisper_parse_cpu_list(read_line(format("/sys/devices/system/node/node%d/cpulist", id)));
+
+        // memory-only nodes have no CPUs
+        if (!node.cpus.empty()) {
+            nodes.push_back(std::move(node));
+        }
+    }
+#endif
+
+    if (nodes.empty()) {
+        whisper_numa_node node;
+        node.cpus = whisper_cpus_allowed();
+
+        nodes.push_back(std::move(node));
+    }
+
+    return nodes;
+}
+
+// binds the calling thread to the CPUs of a NUMA node, the previous affinity is restored on destruction
+//
+// the calling thread takes part in the graph computations, and OpenMP worker threads inherit the affinity of the
+// thread that creates them - the threads of a ggml thread pool are pinned by its cpumask instead
+struct whisper_numa_scope {
+#ifdef __linux__
+    cpu_set_t prev;
+    bool      bound = false;
+#endif
+
+    explicit whisper_numa_scope(const whisper_numa_node * node) {
+#ifdef __linux__
+        if (node == nullptr) {
+            return;
+        }
+
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : node->cpus) {
+            if (cpu < CPU_SETSIZE) {
+                CPU_SET(cpu, &set);
+            }
+        }
+
+        bound = pthread_getaffinity_np(pthread_self(), sizeof(prev), &prev) == 0 &&
+                pthread_setaffinity_np(pthread_self(), sizeof(set),  &set)  == 0;
+#else
+        GGML_UNUSED(node);
+#endif
+    }
+
+    ~whisper_numa_scope() {
+#ifdef __linux__
+        if (bound) {
+            pthread_setaffinity_np(pthread_self(), sizeof(prev), &prev);
+        }
+#endif
+    }
+
+    whisper_numa_scope(const whisper_numa_scope &) = delete;
+    whisper_numa_scope & operator=(const whisper_numa_scope &) = delete;
+};
+
+// run fn on a thread bound to the node, so that the memory first touched by fn is allocated on the node
+static bool whisper_numa_run(const whisper_numa_node & node, const std::function<bool()> & fn) {
+    bool ok = false;
+
+    std::exception_ptr err;
+
+    std::thread worker([&]() {
+        whisper_numa_scope scope(&node);
+
+        try {
+            ok = fn();
+        } catch (...) {
+            err = std::current_exception();
+        }
+    });
+    worker.join();
+
+    if (err) {
+        std::rethrow_exception(err);
+    }
+
+    return ok;
+}
+
+static const whisper_numa_node * whisper_state_numa_node(const whisper_context & wctx, const whisper_state & wstate) {
+    return wstate.numa_node >= 0 ? &wctx.numa_nodes[wstate.numa_node] : nullptr;
+}
+
+// the thread pool of a state bound to a NUMA node has one worker per CPU of the node and cannot run more threads
+static int whisper_state_n_threads(const whisper_state & wstate, int n_threads) {
+    return wstate.threadpool ? std::min(n_threads, wstate.threadpool_n_threads) : n_threads;
+}
+
+template<typename T>
+static void read_safe(whisper_model_loader * loader, T & dest) {
+    loader->read(loader->context, &dest, sizeof(T));
+    BYTESWAP_VALUE(dest);
+}
+
+static bool whisper_kv_cache_init(
+             struct whisper_kv_cache & cache,
+                      ggml_backend_t   backend,
+                           ggml_type   wtype,
+                             int64_t   n_text_state,
+                             int64_t   n_text_layer,
+                                 int   n_ctx) {
+    const int64_t n_mem      = n_text_layer*n_ctx;
+    const int64_t n_elements = n_text_state*n_mem;
+
+    cache.ctx_buf.resize(2*ggml_tensor_overhead());
+
+    struct ggml_init_params params = {
+        /*.mem_size   =*/ cache.ctx_buf.size(),
+        /*.mem_buffer =*/ cache.ctx_buf.data(),
+        /*.no_alloc   =*/ true,
+    };
+
+    cache.head = 0;
+    cache.size = n_ctx;
+
+    cache.cells.clear();
+    cache.cells.resize(n_ctx);
+
+    struct ggml_context * ctx = ggml_init(params);
+
+    if (!ctx) {
+        WHISPER_LOG_ERROR("%s: failed to allocate memory for the kv cache context\n", __func__);
+        return false;
+    }
+
+    cache.k = ggml_new_tensor_1d(ctx, wtype, n_elements);
+    cache.v = ggml_new_tensor_1d(ctx, wtype, n_elements);
+
+    cache.buffer = ggml_backend_alloc_ctx_tensors(ctx, backend);
+    if (!cache.buffer) {
+        WHISPER_LOG_ERROR("%s: failed to allocate memory for the kv cache\n", __func__);
+        return false;
+    }
+
+    ggml_backend_buffer_clear(cache.buffer, 0);
+
+    ggml_free(ctx);
+
+    return true;
+}
+
+static void whisper_kv_cache_free(struct whisper_kv_cache & cache) {
+    ggml_backend_buffer_free(cache.buffer);
+}
+
+static bool whisper_kv_cache_find_slot(
+           struct whisper_kv_cache & cache,
+        const struct whisper_batch & batch) {
+    const uint32_t n_ctx    = cache.size;
+    const uint32_t n_tokens = batch.n_tokens;
+
+    if (n_tokens > n_ctx) {
+        WHISPER_LOG_ERROR("%s: n_tokens=%d > n_ctx=%d\n", __func__, n_tokens, n_ctx);
+        return false;
+    }
+
+    uint32_t n_tested = 0;
+
+    while (true) {
+        if (cache.head + n_tokens > n_ctx) {
+            n_tested += n_ctx - cache.head;
+            cache.head = 0;
+            continue;
+        }
+
+        bool found = true;
+        for (uint32_t i = 0; i < n_tokens; i++) {
+            if (cache.cells[cache.head + i].pos >= 0) {
+                found = false;
+                cache.head += i + 1;
+                n_tested   += i + 1;
+                break;
+            }
+        }
+
+        if (found) {
+            break;
         }
 
         if (n_tested >= n_ctx) {
@@ -1424,6 +1966,15 @@ static buft_list_t make_buft_list(whisper_context_params & params) {
     return buft_list;
 }
 
+// name of the repacked weight layouts of the CPU backend, nullptr if the weights are not repacked
+static const char * whisper_cpu_repack_isa() {
+    auto * cpu_reg = ggml_backend_dev_backend_reg(ggml_backend_dev_by_type(GGML_BACKEND_DEVICE_TYPE_CPU));
+    auto repack_isa_fn = (const char * (*)(void))
+        ggml_backend_reg_get_proc_address(cpu_reg, "ggml_backend_cpu_repack_isa");
+
+    return repack_isa_fn ? repack_isa_fn() : nullptr;
+}
+
 static bool weight_buft_supported(const whisper_hparams & hparams, ggml_tensor * w, ggml_op op, ggml_backend_buffer_type_t buft, ggml_backend_dev_t dev) {
     bool op_supported = true;
 
@@ -1484,220 +2035,371 @@ static ggml_backend_buffer_type_t select_weight_buft(const whisper_hparams & hpa
     return nullptr;
 }
 
-// load the model from a ggml file
-//
-// file format:
-//
-//   - hparams
-//   - pre-computed mel filters
-//   - vocab
-//   - weights
-//
-// see the convert-pt-to-ggml.py script for details
-//
-static bool whisper_model_load(struct whisper_model_loader * loader, whisper_context & wctx) {
-    WHISPER_LOG_INFO("%s: loading model\n", __func__);
-
-    const int64_t t_start_us = ggml_time_us();
+// finalize the hyperparameters read from the model file
+static bool whisper_model_init_hparams(whisper_context & wctx) {
+    auto & model   = wctx.model;
+    auto & hparams = model.hparams;
 
-    wctx.t_start_us = t_start_us;
+    assert(hparams.n_text_state == hparams.n_audio_state);
 
-    auto & model = wctx.model;
-    auto & vocab = wctx.vocab;
+    std::string mver = "";
 
-    // verify magic
-    {
-        uint32_t magic;
-        read_safe(loader, magic);
-        if (magic != GGML_FILE_MAGIC) {
-            WHISPER_LOG_ERROR("%s: invalid model data (bad magic)\n", __func__);
-            return false;
-        }
+    if (hparams.n_audio_layer == 4) {
+        model.type = e_model::MODEL_TINY;
     }
 
-    //load hparams
-    {
-        auto & hparams = model.hparams;
+    if (hparams.n_audio_layer == 6) {
+        model.type = e_model::MODEL_BASE;
+    }
 
-        read_safe(loader, hparams.n_vocab);
-        read_safe(loader, hparams.n_audio_ctx);
-        read_safe(loader, hparams.n_audio_state);
-        read_safe(loader, hparams.n_audio_head);
-        read_safe(loader, hparams.n_audio_layer);
-        read_safe(loader, hparams.n_text_ctx);
-        read_safe(loader, hparams.n_text_state);
-        read_safe(loader, hparams.n_text_head);
-        read_safe(loader, hparams.n_text_layer);
-        read_safe(loader, hparams.n_mels);
-        read_safe(loader, hparams.ftype);
+    if (hparams.n_audio_layer == 12) {
+        model.type = e_model::MODEL_SMALL;
+    }
 
-        assert(hparams.n_text_state == hparams.n_audio_state);
+    if (hparams.n_audio_layer == 24) {
+        model.type = e_model::MODEL_MEDIUM;
+    }
 
-        std::string mver = "";
+    if (hparams.n_audio_layer == 32) {
+        model.type = e_model::MODEL_LARGE;
 
-        if (hparams.n_audio_layer == 4) {
-            model.type = e_model::MODEL_TINY;
+        if (hparams.n_vocab == 51866) {
+            mver = " v3";
         }
+    }
 
-        if (hparams.n_audio_layer == 6) {
-            model.type = e_model::MODEL_BASE;
-        }
+    const int32_t qntvr = hparams.ftype / GGML_QNT_VERSION_FACTOR;
 
-        if (hparams.n_audio_layer == 12) {
-            model.type = e_model::MODEL_SMALL;
-        }
+    hparams.ftype %= GGML_QNT_VERSION_FACTOR;
 
-        if (hparams.n_audio_layer == 24) {
-            model.type = e_model::MODEL_MEDIUM;
-        }
+    // for the big tensors, we have the option to store the data in 16-bit floats or quantized
+    // in order to save memory and also to speed up the computation
+    wctx.wtype = ggml_ftype_to_ggml_type((ggml_ftype) (model.hparams.ftype));
+    if (wctx.wtype == GGML_TYPE_COUNT) {
+        WHISPER_LOG_ERROR("%s: invalid model (bad ftype value %d)\n", __func__, model.hparams.ftype);
+        return false;
+    }
+
+    WHISPER_LOG_INFO("%s: n_vocab       = %d\n", __func__, hparams.n_vocab);
+    WHISPER_LOG_INFO("%s: n_audio_ctx   = %d\n", __func__, hparams.n_audio_ctx);
+    WHISPER_LOG_INFO("%s: n_audio_state = %d\n", __func__, hparams.n_audio_state);
+    WHISPER_LOG_INFO("%s: n_audio_head  = %d\n", __func__, hparams.n_audio_head);
+    WHISPER_LOG_INFO("%s: n_audio_layer = %d\n", __func__, hparams.n_audio_layer);
+    WHISPER_LOG_INFO("%s: n_text_ctx    = %d\n", __func__, hparams.n_text_ctx);
+    WHISPER_LOG_INFO("%s: n_text_state  = %d\n", __func__, hparams.n_text_state);
+    WHISPER_LOG_INFO("%s: n_text_head   = %d\n", __func__, hparams.n_text_head);
+    WHISPER_LOG_INFO("%s: n_text_layer  = %d\n", __func__, hparams.n_text_layer);
+    WHISPER_LOG_INFO("%s: n_mels        = %d\n", __func__, hparams.n_mels);
+    WHISPER_LOG_INFO("%s: ftype         = %d\n", __func__, model.hparams.ftype);
+    WHISPER_LOG_INFO("%s: qntvr         = %d\n", __func__, qntvr);
+    WHISPER_LOG_INFO("%s: type          = %d (%s%s)\n", __func__, model.type, g_model_name.at(model.type).c_str(), mver.c_str());
+
+    return true;
+}
 
-        if (hparams.n_audio_layer == 32) {
-            model.type = e_model::MODEL_LARGE;
+// build the vocab from the tokens stored in the model file and add the special tokens
+static void whisper_vocab_init(whisper_context & wctx, const std::vector<std::string> & words) {
+    const auto & model = wctx.model;
+    auto & vocab = wctx.vocab;
 
-            if (hparams.n_vocab == 51866) {
-                mver = " v3";
+    const int n_vocab = words.size();
+
+    for (int i = 0; i < n_vocab; i++) {
+        vocab.token_to_id[words[i]] = i;
+        vocab.id_to_token[i] = words[i];
+
+        //printf("%s: vocab[%d] = '%s'\n", __func__, i, words[i].c_str());
+    }
+
+    std::string word;
+
+    vocab.n_vocab = model.hparams.n_vocab;
+    if (vocab.is_multilingual()) {
+        vocab.token_eot++;
+        vocab.token_sot++;
+
+        // account for variable number of language tokens
+        const int dt = vocab.num_languages() - 98;
+
+        vocab.token_translate  += dt;
+        vocab.token_transcribe += dt;
+        vocab.token_solm       += dt;
+        vocab.token_prev       += dt;
+        vocab.token_nosp       += dt;
+        vocab.token_not        += dt;
+        vocab.token_beg        += dt;
+    }
+
+    if (n_vocab < model.hparams.n_vocab) {
+        WHISPER_LOG_INFO("%s: adding %d extra tokens\n", __func__, model.hparams.n_vocab - n_vocab);
+        for (int i = n_vocab; i < model.hparams.n_vocab; i++) {
+            if (i > vocab.token_beg) {
+                word = "[_TT_" + std::to_string(i - vocab.token_beg) + "]";
+            } else if (i == vocab.token_eot) {
+                word = "[_EOT_]";
+            } else if (i == vocab.token_sot) {
+                word = "[_SOT_]";
+            } else if (i == vocab.token_translate) {
+                word = "[_TRANSLATE_]";
+            } else if (i == vocab.token_transcribe) {
+                word = "[_TRANSCRIBE_]";
+            } else if (i == vocab.token_solm) {
+                word = "[_SOLM_]";
+            } else if (i == vocab.token_prev) {
+                word = "[_PREV_]";
+            } else if (i == vocab.token_nosp) {
+                word = "[_NOSP_]";
+            } else if (i == vocab.token_not) {
+                word = "[_NOT_]";
+            } else if (i == vocab.token_beg) {
+                word = "[_BEG_]";
+            } else if (i > vocab.token_sot && i <= vocab.token_sot + vocab.num_languages()) {
+                word = "[_LANG_" + std::string(whisper_lang_str(i - vocab.token_sot - 1)) + "]";
+            } else {
+                word = "[_extra_token_" + std::to_string(i) + "]";
             }
+            vocab.token_to_id[word] = i;
+            vocab.id_to_token[i] = word;
         }
+    }
 
-        const int32_t qntvr = hparams.ftype / GGML_QNT_VERSION_FACTOR;
+    WHISPER_LOG_INFO("%s: n_langs       = %d\n", __func__, vocab.num_languages());
+}
 
-        hparams.ftype %= GGML_QNT_VERSION_FACTOR;
+// create the weight tensors with the shapes and types implied by the hparams and assign them to the model
+//
+// create_tensor_fn returns the tensor to use for the given meta data
+using whisper_create_tensor_t = std::function<ggml_tensor * (asr_tensor type, asr_system system, ggml_tensor * meta, int layer)>;
 
-        // for the big tensors, we have the option to store the data in 16-bit floats or quantized
-        // in order to save memory and also to speed up the computation
-        wctx.wtype = ggml_ftype_to_ggml_type((ggml_ftype) (model.hparams.ftype));
-        if (wctx.wtype == GGML_TYPE_COUNT) {
-            WHISPER_LOG_ERROR("%s: invalid model (bad ftype value %d)\n", __func__, model.hparams.ftype);
-            return false;
-        }
+static void whisper_model_create_tensors(whisper_model & model, ggml_type wtype, ggml_type vtype, const whisper_create_tensor_t & create_tensor_fn) {
+    const auto & hparams = model.hparams;
 
-        WHISPER_LOG_INFO("%s: n_vocab       = %d\n", __func__, hparams.n_vocab);
-        WHISPER_LOG_INFO("%s: n_audio_ctx   = %d\n", __func__, hparams.n_audio_ctx);
-        WHISPER_LOG_INFO("%s: n_audio_state = %d\n", __func__, hparams.n_audio_state);
-        WHISPER_LOG_INFO("%s: n_audio_head  = %d\n", __func__, hparams.n_audio_head);
-        WHISPER_LOG_INFO("%s: n_audio_layer = %d\n", __func__, hparams.n_audio_layer);
-        WHISPER_LOG_INFO("%s: n_text_ctx    = %d\n", __func__, hparams.n_text_ctx);
-        WHISPER_LOG_INFO("%s: n_text_state  = %d\n", __func__, hparams.n_text_state);
-        WHISPER_LOG_INFO("%s: n_text_head   = %d\n", __func__, hparams.n_text_head);
-        WHISPER_LOG_INFO("%s: n_text_layer  = %d\n", __func__, hparams.n_text_layer);
-        WHISPER_LOG_INFO("%s: n_mels        = %d\n", __func__, hparams.n_mels);
-        WHISPER_LOG_INFO("%s: ftype         = %d\n", __func__, model.hparams.ftype);
-        WHISPER_LOG_INFO("%s: qntvr         = %d\n", __func__, qntvr);
-        WHISPER_LOG_INFO("%s: type          = %d (%s%s)\n", __func__, model.type, g_model_name.at(model.type).c_str(), mver.c_str());
-    }
+    auto create_tensor = [&](asr_tensor type, asr_system system, ggml_tensor * meta, int layer = 0) -> ggml_tensor * {
+        return create_tensor_fn(type, system, meta, layer);
+    };
 
-    // load mel filters
-    {
-        auto & filters = wctx.model.filters;
+    const size_t n_tensors = 10 /* input */ + 15 + 15*hparams.n_audio_layer + 24*hparams.n_text_layer;
 
-        read_safe(loader, filters.n_mel);
-        read_safe(loader, filters.n_fft);
+    ggml_init_params params = {
+        /*.mem_size   =*/ n_tensors * ggml_tensor_overhead(),
+        /*.mem_buffer =*/ nullptr,
+        /*.no_alloc   =*/ true,
+    };
 
-        filters.data.resize(filters.n_mel * filters.n_fft);
-        loader->read(loader->context, filters.data.data(), filters.data.size() * sizeof(float));
-        BYTESWAP_FILTERS(filters);
-    }
+    ggml_context * ctx = ggml_init(params);
 
-    // load vocab
-    {
-        int32_t n_vocab = 0;
-        read_safe(loader, n_vocab);
+    const int n_vocab = hparams.n_vocab;
 
-        //if (n_vocab != model.hparams.n_vocab) {
-        //    WHISPER_LOG_ERROR("%s: invalid model file '%s' (bad vocab size %d != %d)\n",
-        //            __func__, fname.c_str(), n_vocab, model.hparams.n_vocab);
-        //    return false;
-        //}
+    const int n_audio_ctx   = hparams.n_audio_ctx;
+    const int n_audio_state = hparams.n_audio_state;
+    const int n_audio_layer = hparams.n_audio_layer;
 
-        std::string word;
-        std::vector<char> tmp;
+    const int n_text_ctx   = hparams.n_text_ctx;
+    const int n_text_state = hparams.n_text_state;
+    const int n_text_layer = hparams.n_text_layer;
 
-        tmp.reserve(128);
+    const int n_mels = hparams.n_mels;
 
-        for (int i = 0; i < n_vocab; i++) {
-            uint32_t len;
-            read_safe(loader, len);
+    model.layers_encoder.resize(n_audio_layer);
+    model.layers_decoder.resize(n_text_layer);
 
-            if (len > 0) {
-                tmp.resize(len);
-                loader->read(loader->context, &tmp[0], tmp.size()); // read to buffer
-                word.assign(&tmp[0], tmp.size());
-            } else {
-                // seems like we have an empty-string token in multi-language models (i = 50256)
-                //WHISPER_LOG_WARN("%s: warning: empty-string token in vocab, i = %d\n", __func__, i);
-                word = "";
-            }
+    // encoder
+    model.e_pe = create_tensor(ASR_TENSOR_ENC_POS_EMBD, ASR_SYSTEM_ENCODER, ggml_new_tensor_2d(ctx, GGML_TYPE_F32, n_audio_state, n_audio_ctx));
 
-            vocab.token_to_id[word] = i;
-            vocab.id_to_token[i] = word;
+    model.e_conv_1_w = create_tensor(ASR_TENSOR_CONV1_WEIGHT, ASR_SYSTEM_ENCODER, ggml_new_tensor_3d(ctx, vtype, 3, n_mels, n_audio_state));
+    model.e_conv_1_b = create_tensor(ASR_TENSOR_CONV1_BIAS, ASR_SYSTEM_ENCODER, ggml_new_tensor_2d(ctx, GGML_TYPE_F32, 1, n_audio_state));
 
-            //printf("%s: vocab[%d] = '%s'\n", __func__, i, word.c_str());
-        }
-
-        vocab.n_vocab = model.hparams.n_vocab;
-        if (vocab.is_multilingual()) {
-            vocab.token_eot++;
-            vocab.token_sot++;
-
-            // account for variable number of language tokens
-            const int dt = vocab.num_languages() - 98;
-
-            vocab.token_translate  += dt;
-            vocab.token_transcribe += dt;
-            vocab.token_solm       += dt;
-            vocab.token_prev       += dt;
-            vocab.token_nosp       += dt;
-            vocab.token_not        += dt;
-            vocab.token_beg        += dt;
-        }
-
-        if (n_vocab < model.hparams.n_vocab) {
-            WHISPER_LOG_INFO("%s: adding %d extra tokens\n", __func__, model.hparams.n_vocab - n_vocab);
-            for (int i = n_vocab; i < model.hparams.n_vocab; i++) {
-                if (i > vocab.token_beg) {
-                    word = "[_TT_" + std::to_string(i - vocab.token_beg) + "]";
-                } else if (i == vocab.token_eot) {
-                    word = "[_EOT_]";
-                } else if (i == vocab.token_sot) {
-                    word = "[_SOT_]";
-                } else if (i == vocab.token_translate) {
-                    word = "[_TRANSLATE_]";
-                } else if (i == vocab.token_transcribe) {
-                    word = "[_TRANSCRIBE_]";
-                } else if (i == vocab.token_solm) {
-                    word = "[_SOLM_]";
-                } else if (i == vocab.token_prev) {
-                    word = "[_PREV_]";
-                } else if (i == vocab.token_nosp) {
-                    word = "[_NOSP_]";
-                } else if (i == vocab.token_not) {
-                    word = "[_NOT_]";
-                } else if (i == vocab.token_beg) {
-                    word = "[_BEG_]";
-                } else if (i > vocab.token_sot && i <= vocab.token_sot + vocab.num_languages()) {
-                    word = "[_LANG_" + std::string(whisper_lang_str(i - vocab.token_sot - 1)) + "]";
-                } else {
-                    word = "[_extra_token_" + std::to_string(i) + "]";
-                }
-                vocab.token_to_id[word] = i;
-                vocab.id_to_token[i] = word;
-            }
-        }
+    model.e_conv_2_w = create_tensor(ASR_TENSOR_CONV2_WEIGHT, ASR_SYSTEM_ENCODER, ggml_new_tensor_3d(ctx, vtype, 3, n_audio_state, n_audio_state));
+    model.e_conv_2_b = create_tensor(ASR_TENSOR_CONV2_BIAS, ASR_SYSTEM_ENCODER, ggml_new_tensor_2d(ctx, GGML_TYPE_F32, 1, n_audio_state));
 
-        WHISPER_LOG_INFO("%s: n_langs       = %d\n", __func__, vocab.num_languages());
-    }
+    model.e_ln_w = create_tensor(ASR_TENSOR_LN_WEIGHT, ASR_SYSTEM_ENCODER, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_audio_state));
+    model.e_ln_b = create_tensor(ASR_TENSOR_LN_POST_BIAS, ASR_SYSTEM_ENCODER, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_audio_state));
 
-    const ggml_type wtype = wctx.wtype;
-    const ggml_type vtype = wctx.wtype == GGML_TYPE_F32 ? GGML_TYPE_F32 : GGML_TYPE_F16; // conv type
+    for (int i = 0; i < n_audio_layer; ++i) {
+        auto & layer = model.layers_encoder[i];
 
-    const auto & hparams = model.hparams;
+        layer.mlp_ln_w = create_tensor(ASR_TENSOR_MLP_LN_WEIGHT, ASR_SYSTEM_ENCODER, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_audio_state), i);
+        layer.mlp_ln_b = create_tensor(ASR_TENSOR_MLP_LN_BIAS, ASR_SYSTEM_ENCODER, ggml_new_tensor_1d(ctx, GGML_TYPE_F32,   n_audio_state), i);
 
-    const int n_audio_layer = hparams.n_audio_layer;
-    const int n_text_layer  = hparams.n_text_layer;
+        layer.mlp_0_w = create_tensor(ASR_TENSOR_MLP_0_WEIGHT, ASR_SYSTEM_ENCODER, ggml_new_tensor_2d(ctx, wtype, n_audio_state, 4*n_audio_state), i);
+        layer.mlp_0_b = create_tensor(ASR_TENSOR_MLP_0_BIAS, ASR_SYSTEM_ENCODER, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, 4*n_audio_state), i);
 
-    const size_t n_tensors = 10 /* input */ + 15 + 15*n_audio_layer + 24*n_text_layer;
+        layer.mlp_1_w = create_tensor(ASR_TENSOR_MLP_2_WEIGHT, ASR_SYSTEM_ENCODER, ggml_new_tensor_2d(ctx, wtype, 4*n_audio_state, n_audio_state), i);
+        layer.mlp_1_b = create_tensor(ASR_TENSOR_MLP_2_BIAS, ASR_SYSTEM_ENCODER, ggml_new_tensor_1d(ctx, GGML_TYPE_F32,   n_audio_state), i);
 
-    std::map<ggml_backend_buffer_type_t, ggml_context *> ctx_map;
+        layer.attn_ln_0_w = create_tensor(ASR_TENSOR_ATTN_LN_WEIGHT, ASR_SYSTEM_ENCODER, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_audio_state), i);
+        layer.attn_ln_0_b = create_tensor(ASR_TENSOR_ATTN_LN_BIAS, ASR_SYSTEM_ENCODER, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_audio_state), i);
+
+        layer.attn_q_w = create_tensor(ASR_TENSOR_ATTN_QUERY_WEIGHT, ASR_SYSTEM_ENCODER, ggml_new_tensor_2d(ctx, wtype, n_audio_state, n_audio_state), i);
+        layer.attn_q_b = create_tensor(ASR_TENSOR_ATTN_QUERY_BIAS, ASR_SYSTEM_ENCODER, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_audio_state), i);
+
+        layer.attn_k_w = create_tensor(ASR_TENSOR_ATTN_KEY_WEIGHT, ASR_SYSTEM_ENCODER, ggml_new_tensor_2d(ctx, wtype, n_audio_state, n_audio_state), i);
+
+        layer.attn_v_w = create_tensor(ASR_TENSOR_ATTN_VALUE_WEIGHT, ASR_SYSTEM_ENCODER, ggml_new_tensor_2d(ctx, wtype, n_audio_state, n_audio_state), i);
+        layer.attn_v_b = create_tensor(ASR_TENSOR_ATTN_VALUE_BIAS, ASR_SYSTEM_ENCODER, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_audio_state), i);
+
+        layer.attn_ln_1_w = create_tensor(ASR_TENSOR_ATTN_OUT_WEIGHT, ASR_SYSTEM_ENCODER, ggml_new_tensor_2d(ctx, wtype, n_audio_state, n_audio_state), i);
+        layer.attn_ln_1_b = create_tensor(ASR_TENSOR_ATTN_OUT_BIAS, ASR_SYSTEM_ENCODER, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_audio_state), i);
+    }
+
+    // decoder
+    model.d_pe = create_tensor(ASR_TENSOR_DEC_POS_EMBD, ASR_SYSTEM_DECODER, ggml_new_tensor_2d(ctx, GGML_TYPE_F32, n_text_state, n_text_ctx));
+
+    model.d_te = create_tensor(ASR_TENSOR_DEC_TOKEN_EMBD_WEIGHT, ASR_SYSTEM_DECODER, ggml_new_tensor_2d(ctx, wtype, n_text_state, n_vocab));
+
+    model.d_ln_w = create_tensor(ASR_TENSOR_LN_WEIGHT, ASR_SYSTEM_DECODER, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_text_state));
+    model.d_ln_b = create_tensor(ASR_TENSOR_LN_BIAS, ASR_SYSTEM_DECODER, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_text_state));
+
+    for (int i = 0; i < n_text_layer; ++i) {
+        auto & layer = model.layers_decoder[i];
+
+        layer.mlp_ln_w = create_tensor(ASR_TENSOR_MLP_LN_WEIGHT, ASR_SYSTEM_DECODER, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_text_state), i);
+        layer.mlp_ln_b = create_tensor(ASR_TENSOR_MLP_LN_BIAS, ASR_SYSTEM_DECODER, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_text_state), i);
+
+        layer.mlp_0_w = create_tensor(ASR_TENSOR_MLP_0_WEIGHT, ASR_SYSTEM_DECODER, ggml_new_tensor_2d(ctx, wtype, n_text_state, 4*n_text_state), i);
+        layer.mlp_0_b = create_tensor(ASR_TENSOR_MLP_0_BIAS, ASR_SYSTEM_DECODER, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, 4*n_text_state), i);
+
+        layer.mlp_1_w = create_tensor(ASR_TENSOR_MLP_2_WEIGHT, ASR_SYSTEM_DECODER, ggml_new_tensor_2d(ctx, wtype, 4*n_text_state, n_text_state), i);
+        layer.mlp_1_b = create_tensor(ASR_TENSOR_MLP_2_BIAS, ASR_SYSTEM_DECODER, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_text_state), i);
+
+        layer.attn_ln_0_w = create_tensor(ASR_TENSOR_ATTN_LN_WEIGHT, ASR_SYSTEM_DECODER, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_text_state), i);
+        layer.attn_ln_0_b = create_tensor(ASR_TENSOR_ATTN_LN_BIAS, ASR_SYSTEM_DECODER, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_text_state), i);
+
+        layer.attn_q_w = create_tensor(ASR_TENSOR_ATTN_QUERY_WEIGHT, ASR_SYSTEM_DECODER, ggml_new_tensor_2d(ctx, wtype, n_text_state, n_text_state), i);
+        layer.attn_q_b = create_tensor(ASR_TENSOR_ATTN_QUERY_BIAS, ASR_SYSTEM_DECODER, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_text_state), i);
+
+        layer.attn_k_w = create_tensor(ASR_TENSOR_ATTN_KEY_WEIGHT, ASR_SYSTEM_DECODER, ggml_new_tensor_2d(ctx, wtype, n_text_state, n_text_state), i);
+
+        layer.attn_v_w = create_tensor(ASR_TENSOR_ATTN_VALUE_WEIGHT, ASR_SYSTEM_DECODER, ggml_new_tensor_2d(ctx, wtype, n_text_state, n_text_state), i);
+        layer.attn_v_b = create_tensor(ASR_TENSOR_ATTN_VALUE_BIAS, ASR_SYSTEM_DECODER, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_text_state), i);
+
+        layer.attn_ln_1_w = create_tensor(ASR_TENSOR_ATTN_OUT_WEIGHT, ASR_SYSTEM_DECODER, ggml_new_tensor_2d(ctx, wtype, n_text_state, n_text_state), i);
+        layer.attn_ln_1_b = create_tensor(ASR_TENSOR_ATTN_OUT_BIAS, ASR_SYSTEM_DECODER, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_text_state), i);
+
+        layer.cross_attn_ln_0_w = create_tensor(ASR_TENSOR_ATTN_LN_WEIGHT, ASR_SYSTEM_CROSS, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_text_state), i);
+        layer.cross_attn_ln_0_b = create_tensor(ASR_TENSOR_ATTN_LN_BIAS, ASR_SYSTEM_CROSS, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_text_state), i);
+
+        layer.cross_attn_q_w = create_tensor(ASR_TENSOR_ATTN_QUERY_WEIGHT, ASR_SYSTEM_CROSS, ggml_new_tensor_2d(ctx, wtype, n_text_state, n_text_state), i);
+        layer.cross_attn_q_b = create_tensor(ASR_TENSOR_ATTN_QUERY_BIAS, ASR_SYSTEM_CROSS, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_text_state), i);
+
+        layer.cross_attn_k_w = create_tensor(ASR_TENSOR_ATTN_KEY_WEIGHT, ASR_SYSTEM_CROSS, ggml_new_tensor_2d(ctx, wtype, n_text_state, n_text_state), i);
+
+        layer.cross_attn_v_w = create_tensor(ASR_TENSOR_ATTN_VALUE_WEIGHT, ASR_SYSTEM_CROSS, ggml_new_tensor_2d(ctx, wtype, n_text_state, n_text_state), i);
+        layer.cross_attn_v_b = create_tensor(ASR_TENSOR_ATTN_VALUE_BIAS, ASR_SYSTEM_CROSS, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_text_state), i);
+
+        layer.cross_attn_ln_1_w = create_tensor(ASR_TENSOR_ATTN_OUT_WEIGHT, ASR_SYSTEM_CROSS, ggml_new_tensor_2d(ctx, wtype, n_text_state, n_text_state), i);
+        layer.cross_attn_ln_1_b = create_tensor(ASR_TENSOR_ATTN_OUT_BIAS, ASR_SYSTEM_CROSS, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_text_state), i);
+    }
+
+    ggml_free(ctx);
+}
+
+// find the data offsets of the tensors in a mapped legacy ggml file, starting at the current read position
+// only the tensors that lie within the file and have the type and shape implied by the hparams are recorded
+static std::map<std::string, size_t> whisper_mmap_scan_legacy(const whisper_mmap & mapping, const whisper_hparams & hparams, ggml_type wtype, ggml_type vtype) {
+    std::map<std::string, size_t> offsets;
+
+    struct tensor_meta {
+        ggml_type type;
+        int64_t   ne[4];
+    };
+
+    std::map<std::string, tensor_meta> expected;
+    {
+        whisper_model model;
+        model.hparams = hparams;
+
+        whisper_model_create_tensors(model, wtype, vtype, [&](asr_tensor type, asr_system system, ggml_tensor * meta, int layer) {
+            expected[format(ASR_TENSOR_NAMES.at(system).at(type), layer)] = { meta->type, { meta->ne[0], meta->ne[1], meta->ne[2], meta->ne[3] } };
+            return meta;
+        });
+    }
+
+    {
+        size_t offs = mapping.pos;
+
+        auto read_mapped = [&](void * dst, size_t n) {
+            if (offs + n > mapping.size) {
+                return false;
+            }
+            memcpy(dst, mapping.addr + offs, n);
+            offs += n;
+            return true;
+        };
+
+        while (true) {
+            int32_t n_dims;
+            int32_t length;
+            int32_t ttype;
+
+            if (!read_mapped(&n_dims, sizeof(n_dims)) || !read_mapped(&length, sizeof(length)) || !read_mapped(&ttype, sizeof(ttype))) {
+                break;
+            }
+
+            if (n_dims < 0 || n_dims > 4 || length <= 0 || ttype < 0 || ttype >= GGML_TYPE_COUNT) {
+                break;
+            }
+
+            int64_t ne[4] = { 1, 1, 1, 1 };
+            bool ok = true;
+            for (int i = 0; i < n_dims; ++i) {
+                int32_t ne_i = 0;
+                if (!read_mapped(&ne_i, sizeof(ne_i)) || ne_i < 0) {
+                    ok = false;
+                    break;
+                }
+                ne[i] = ne_i;
+            }
+
+            std::string name(length, 0);
+            if (!ok || !read_mapped(&name[0], length)) {
+                break;
+            }
+
+            const ggml_type type = ggml_type(ttype);
+            if (ggml_blck_size(type) == 0 || ggml_type_size(type) == 0 || ne[0] % ggml_blck_size(type) != 0) {
+                break;
+            }
+
+            const size_t nbytes = (ne[0]*ne[1]*ne[2]*ne[3]*ggml_type_size(type))/ggml_blck_size(type);
+            if (offs + nbytes > mapping.size) {
+                break;
+            }
+
+            // a tensor that does not match is left to the copy path, which rejects it
+            auto it = expected.find(name);
+            if (it != expected.end() && it->second.type == type &&
+                it->second.ne[0] == ne[0] && it->second.ne[1] == ne[1] && it->second.ne[2] == ne[2] && it->second.ne[3] == ne[3]) {
+                offsets[name] = offs;
+            }
+
+            offs += nbytes;
+        }
+    }
+
+    return offsets;
+}
+
+// create the model tensors and allocate them in the backend buffers
+//
+// offsets  - data offsets of the tensors in the mapped model file, used to reference the CPU weights in-place
+// types    - tensor types declared by the model file, overriding the types implied by the ftype
+// repacked - tensors stored in the repacked layout of the CPU backend, placed in the repacked buffer type as-is
+static bool whisper_model_init_tensors(whisper_context & wctx, const std::map<std::string, size_t> & offsets, const std::map<std::string, ggml_type> & types,
+                                       const std::set<std::string> & repacked) {
+    auto & model = wctx.model;
+
+    const ggml_type wtype = wctx.wtype;
+    const ggml_type vtype = wctx.wtype == GGML_TYPE_F32 ? GGML_TYPE_F32 : GGML_TYPE_F16; // conv type
+
+    const auto & hparams = model.hparams;
+
+    const int n_audio_layer = hparams.n_audio_layer;
+    const int n_text_layer  = hparams.n_text_layer;
+
+    const size_t n_tensors = 10 /* input */ + 15 + 15*n_audio_layer + 24*n_text_layer;
+
+    std::map<ggml_backend_buffer_type_t, ggml_context *> ctx_map;
     auto get_ctx = [&](ggml_backend_buffer_type_t buft) -> ggml_context * {
         auto it = ctx_map.find(buft);
         if (it == ctx_map.end()) {
@@ -1721,154 +2423,710 @@ static bool whisper_model_load(struct whisper_model_loader * loader, whisper_con
         return it->second;
     };
 
+    // the repacked tensors do not go through the buffer type selection
+    ggml_context * ctx_repacked = nullptr;
+    if (!repacked.empty()) {
+        ggml_init_params params = {
+            /*.mem_size   =*/ repacked.size() * ggml_tensor_overhead(),
+            /*.mem_buffer =*/ nullptr,
+            /*.no_alloc   =*/ true,
+        };
+
+        ctx_repacked = ggml_init(params);
+        if (!ctx_repacked) {
+            throw std::runtime_error("failed to create ggml context");
+        }
+
+        model.ctxs.emplace_back(ctx_repacked);
+    }
+
     // Create a list of available bufts, in priority order
     buft_list_t buft_list = make_buft_list(wctx.params);
 
     auto create_tensor = [&](asr_tensor type, asr_system system, ggml_tensor * meta, int layer = 0) -> ggml_tensor * {
+        const std::string name = format(ASR_TENSOR_NAMES.at(system).at(type), layer);
+
+        // the model file can store individual tensors in a different type than the ftype suggests
+        ggml_context_ptr ctx_meta;
+        auto it = types.find(name);
+        if (it != types.end() && it->second != meta->type) {
+            ggml_init_params params = {
+                /*.mem_size   =*/ ggml_tensor_overhead(),
+                /*.mem_buffer =*/ nullptr,
+                /*.no_alloc   =*/ true,
+            };
+
+            ctx_meta.reset(ggml_init(params));
+            meta = ggml_new_tensor(ctx_meta.get(), it->second, ggml_n_dims(meta), meta->ne);
+        }
+
+        if (repacked.count(name) > 0) {
+            ggml_tensor * tensor = ggml_dup_tensor(ctx_repacked, meta);
+
+            model.tensors[name] = tensor;
+
+            return tensor;
+        }
+
         ggml_op op = ASR_TENSOR_INFO.at(type);
         ggml_backend_buffer_type_t buft = select_weight_buft(hparams, meta, op, buft_list);
         if (!buft) {
-            throw std::runtime_error(format("failed to find a compatible buffer type for tensor %s", ASR_TENSOR_NAMES.at(system).at(type)));
+            throw std::runtime_error(format("failed to find a compatible buffer type for tensor %s", name.c_str()));
         }
 
         ggml_context * ctx = get_ctx(buft);
         ggml_tensor * tensor = ggml_dup_tensor(ctx, meta);
 
-        model.tensors[format(ASR_TENSOR_NAMES.at(system).at(type), layer)] = tensor;
+        model.tensors[name] = tensor;
+
+        return tensor;
+    };
+
+
+    whisper_model_create_tensors(model, wtype, vtype, create_tensor);
+
+    // point the CPU tensors directly into the model file mapping
+    // only tensors whose data happens to be aligned in the file can be used in-place - the rest is copied below
+    if (model.mapping) {
+        auto & mapping = *model.mapping;
+
+        ggml_backend_buffer_type_t buft_cpu = ggml_backend_cpu_buffer_type();
+
+        const size_t align = ggml_backend_buft_get_alignment(buft_cpu);
+
+        auto it_ctx = ctx_map.find(buft_cpu);
+        if (it_ctx != ctx_map.end()) {
+            std::set<ggml_tensor *> cpu_tensors;
+            for (ggml_tensor * t = ggml_get_first_tensor(it_ctx->second); t != nullptr; t = ggml_get_next_tensor(it_ctx->second, t)) {
+                cpu_tensors.insert(t);
+            }
+
+            std::vector<std::pair<ggml_tensor *, size_t>> candidates;
+
+            size_t size_cpu    = 0;
+            size_t size_mapped = 0;
+
+            for (auto & t : model.tensors) {
+                ggml_tensor * tensor = t.second;
+                if (cpu_tensors.find(tensor) == cpu_tensors.end()) {
+                    continue;
+                }
+
+                size_cpu += ggml_nbytes(tensor);
+
+                auto it = offsets.find(t.first);
+                if (it == offsets.end() || it->second % align != 0) {
+                    continue;
+                }
+
+                // a truncated file must fail here, the buffer asserts on a tensor past its end
+                if (it->second + ggml_nbytes(tensor) > mapping.size) {
+                    WHISPER_LOG_ERROR("%s: tensor '%s' data is out of bounds of the model file\n", __func__, t.first.c_str());
+                    return false;
+                }
+
+                candidates.emplace_back(tensor, it->second);
+                size_mapped += ggml_nbytes(tensor);
+            }
+
+            // keeping the whole file mapped for a handful of tensors is not worth it
+            if (2*size_mapped < size_cpu) {
+                WHISPER_LOG_INFO("%s: only %.2f MB of %.2f MB CPU weights are aligned in the model file - copying instead\n", __func__, size_mapped / 1e6, size_cpu / 1e6);
+                candidates.clear();
+                size_mapped = 0;
+            }
+
+            if (!candidates.empty()) {
+                ggml_backend_buffer_t buf = ggml_backend_cpu_buffer_from_ptr(mapping.addr, mapping.size);
+                model.buffers.emplace_back(buf);
+
+                for (auto & c : candidates) {
+                    if (ggml_backend_tensor_alloc(buf, c.first, mapping.addr + c.second) != GGML_STATUS_SUCCESS) {
+                        WHISPER_LOG_ERROR("%s: failed to map tensor at offset %zu\n", __func__, c.second);
+                        return false;
+                    }
+                    model.n_mapped++;
+                }
+            }
+
+            WHISPER_LOG_INFO("%s: %12s total size = %8.2f MB (%d tensors in-place)\n", __func__, "mmap", size_mapped / 1e6, model.n_mapped);
+        }
+    }
+
+    // the repacked tensors are used in-place from the mapping or copied as-is into a CPU buffer
+    if (ctx_repacked) {
+        auto * cpu_reg = ggml_backend_dev_backend_reg(ggml_backend_dev_by_type(GGML_BACKEND_DEVICE_TYPE_CPU));
+        auto buffer_from_ptr_fn = (ggml_backend_buffer_t (*)(void *, size_t))
+            ggml_backend_reg_get_proc_address(cpu_reg, "ggml_backend_cpu_repacked_buffer_from_ptr");
+        if (!buffer_from_ptr_fn) {
+            WHISPER_LOG_ERROR("%s: the CPU backend does not support repacked weights\n", __func__);
+            return false;
+        }
+
+        ggml_backend_buffer_t buf = nullptr;
+
+        if (model.mapping) {
+            auto & mapping = *model.mapping;
+
+            buf = buffer_from_ptr_fn(mapping.addr, mapping.size);
+        } else {
+            const size_t align = ggml_backend_buft_get_alignment(ggml_backend_cpu_buffer_type());
+
+            size_t size = align;
+            for (ggml_tensor * t = ggml_get_first_tensor(ctx_repacked); t != nullptr; t = ggml_get_next_tensor(ctx_repacked, t)) {
+                size += GGML_PAD(ggml_nbytes(t), align);
+            }
+
+            ggml_backend_buffer_t buf_host = ggml_backend_buft_alloc_buffer(ggml_backend_cpu_buffer_type(), size);
+            if (!buf_host) {
+                WHISPER_LOG_ERROR("%s: failed to allocate %.2f MB for the repacked weights\n", __func__, size / 1e6);
+                return false;
+            }
+            model.buffers.emplace_back(buf_host);
+
+            buf = buffer_from_ptr_fn(ggml_backend_buffer_get_base(buf_host), ggml_backend_buffer_get_size(buf_host));
+        }
+
+        if (!buf) {
+            WHISPER_LOG_ERROR("%s: failed to create the buffer for the repacked weights\n", __func__);
+            return false;
+        }
+        model.buffers.emplace_back(buf);
+
+        const size_t align = ggml_backend_buffer_get_alignment(buf);
+
+        ggml_tallocr talloc = ggml_tallocr_new(buf);
+
+        size_t size_repacked = 0;
+
+        for (auto & p : model.tensors) {
+            if (repacked.count(p.first) == 0) {
+                continue;
+            }
+
+            ggml_tensor * t = p.second;
+
+            enum ggml_status status = GGML_STATUS_FAILED;
+
+            if (model.mapping) {
+                auto it = offsets.find(p.first);
+                if (it != offsets.end() && it->second + ggml_backend_buffer_get_alloc_size(buf, t) > model.mapping->size) {
+                    WHISPER_LOG_ERROR("%s: tensor '%s' data is out of bounds of the model file\n", __func__, p.first.c_str());
+                    return false;
+                }
+                if (it != offsets.end() && it->second % align == 0) {
+                    status = ggml_backend_tensor_alloc(buf, t, model.mapping->addr + it->second);
+                }
+            } else {
+                status = ggml_tallocr_alloc(&talloc, t);
+            }
+
+            // fails if this CPU would not repack the tensor
+            if (status != GGML_STATUS_SUCCESS) {
+                WHISPER_LOG_ERROR("%s: failed to place repacked tensor '%s' (%s [%d, %d])\n", __func__,
+                        p.first.c_str(), ggml_type_name(t->type), (int) t->ne[0], (int) t->ne[1]);
+                return false;
+            }
+
+            if (model.mapping) {
+                model.n_mapped++;
+            }
+
+            size_repacked += ggml_nbytes(t);
+        }
+
+        WHISPER_LOG_INFO("%s: %12s total size = %8.2f MB (%zu tensors pre-repacked%s)\n", __func__, ggml_backend_buffer_name(buf),
+                size_repacked / 1e6, repacked.size(), model.mapping ? ", in-place" : "");
+    }
+
+    // allocate tensors in the backend buffers
+    for (auto & p : ctx_map) {
+        ggml_backend_buffer_type_t buft = p.first;
+        ggml_context * ctx = p.second;
+        ggml_backend_buffer_t buf = ggml_backend_alloc_ctx_tensors_from_buft(ctx, buft);
+        if (buf) {
+            model.buffers.emplace_back(buf);
+
+            size_t size_main = ggml_backend_buffer_get_size(buf);
+            WHISPER_LOG_INFO("%s: %12s total size = %8.2f MB\n", __func__, ggml_backend_buffer_name(buf), size_main / 1e6);
+        }
+    }
+
+    return true;
+}
+
+// copy the CPU weights of the model into new buffers of the same types
+//
+// the copy is made by the calling thread, so with first-touch allocation the pages end up on its NUMA node
+// the weights of other devices are shared with the model
+static bool whisper_model_replicate(const whisper_context & wctx, whisper_model & replica) {
+    const auto & model = wctx.model;
+
+    const ggml_type wtype = wctx.wtype;
+    const ggml_type vtype = wctx.wtype == GGML_TYPE_F32 ? GGML_TYPE_F32 : GGML_TYPE_F16; // conv type
+
+    replica.type    = model.type;
+    replica.hparams = model.hparams;
+
+    std::map<ggml_backend_buffer_type_t, ggml_context *> ctx_map;
+
+    std::vector<std::pair<const ggml_tensor *, ggml_tensor *>> copies;
+
+    whisper_model_create_tensors(replica, wtype, vtype, [&](asr_tensor type, asr_system system, ggml_tensor * /*meta*/, int layer) {
+        const std::string name = format(ASR_TENSOR_NAMES.at(system).at(type), layer);
+
+        ggml_tensor * src = model.tensors.at(name);
+
+        // the mapped weights use a CPU buffer type as well
+        ggml_backend_buffer_type_t buft = ggml_backend_buffer_get_type(src->buffer);
+        ggml_backend_dev_t dev = ggml_backend_buft_get_device(buft);
+        if (dev && ggml_backend_dev_type(dev) != GGML_BACKEND_DEVICE_TYPE_CPU) {
+            replica.tensors[name] = src;
+            return src;
+        }
+
+        ggml_context * ctx = ctx_map[buft];
+        if (!ctx) {
+            ggml_init_params params = {
+                /*.mem_size   =*/ model.tensors.size() * ggml_tensor_overhead(),
+                /*.mem_buffer =*/ nullptr,
+                /*.no_alloc   =*/ true,
+            };
+
+            ctx = ggml_init(params);
+            if (!ctx) {
+                throw std::runtime_error("failed to create ggml context");
+            }
+
+            ctx_map[buft] = ctx;
+            replica.ctxs.emplace_back(ctx);
+        }
+
+        ggml_tensor * dst = ggml_dup_tensor(ctx, src);
+
+        replica.tensors[name] = dst;
+        copies.emplace_back(src, dst);
+
+        return dst;
+    });
+
+    for (auto & p : ctx_map) {
+        ggml_backend_buffer_t buf = ggml_backend_alloc_ctx_tensors_from_buft(p.second, p.first);
+        if (!buf) {
+            WHISPER_LOG_ERROR("%s: failed to allocate the %s weights\n", __func__, ggml_backend_buft_name(p.first));
+            return false;
+        }
+
+        ggml_backend_buffer_set_usage(buf, GGML_BACKEND_BUFFER_USAGE_WEIGHTS);
+        replica.buffers.emplace_back(buf);
+    }
+
+    // the data is copied as-is - ggml_backend_tensor_set() would repack the weights of the extra buffer types again
+    for (auto & c : copies) {
+        memcpy(c.second->data, c.first->data, ggml_nbytes(c.first));
+    }
+
+    replica.n_loaded = copies.size();
+
+    return true;
+}
+
+// load the model from a ggml file
+//
+// file format:
+//
+//   - hparams
+//   - pre-computed mel filters
+//   - vocab
+//   - weights
+//
+// see the convert-pt-to-ggml.py script for details
+//
+static bool whisper_model_load(struct whisper_model_loader * loader, whisper_context & wctx) {
+    WHISPER_LOG_INFO("%s: loading model\n", __func__);
+
+    const int64_t t_start_us = ggml_time_us();
+
+    wctx.t_start_us = t_start_us;
+
+    auto & model = wctx.model;
+
+    // verify magic
+    {
+        uint32_t magic;
+        read_safe(loader, magic);
+        if (memcmp(&magic, GGUF_MAGIC, sizeof(magic)) == 0) {
+            WHISPER_LOG_ERROR("%s: GGUF models can only be loaded from a file (whisper_init_from_file_with_params)\n", __func__);
+            return false;
+        }
+        if (magic != GGML_FILE_MAGIC) {
+            WHISPER_LOG_ERROR("%s: invalid model data (bad magic)\n", __func__);
+            return false;
+        }
+    }
+
+    //load hparams
+    {
+        auto & hparams = model.hparams;
+
+        read_safe(loader, hparams.n_vocab);
+        read_safe(loader, hparams.n_audio_ctx);
+        read_safe(loader, hparams.n_audio_state);
+        read_safe(loader, hparams.n_audio_head);
+        read_safe(loader, hparams.n_audio_layer);
+        read_safe(loader, hparams.n_text_ctx);
+        read_safe(loader, hparams.n_text_state);
+        read_safe(loader, hparams.n_text_head);
+        read_safe(loader, hparams.n_text_layer);
+        read_safe(loader, hparams.n_mels);
+        read_safe(loader, hparams.ftype);
+
+    }
+
+    if (!whisper_model_init_hparams(wctx)) {
+        return false;
+    }
+
+    // load mel filters
+    {
+        auto & filters = wctx.model.filters;
+
+        read_safe(loader, filters.n_mel);
+        read_safe(loader, filters.n_fft);
+
+        filters.data.resize(filters.n_mel * filters.n_fft);
+        loader->read(loader->context, filters.data.data(), filters.data.size() * sizeof(float));
+        BYTESWAP_FILTERS(filters);
+    }
+
+    // load vocab
+    {
+        int32_t n_vocab = 0;
+        read_safe(loader, n_vocab);
+
+        //if (n_vocab != model.hparams.n_vocab) {
+        //    WHISPER_LOG_ERROR("%s: invalid model file '%s' (bad vocab size %d != %d)\n",
+        //            __func__, fname.c_str(), n_vocab, model.hparams.n_vocab);
+        //    return false;
+        //}
+
+        std::vector<std::string> words(n_vocab);
+        std::vector<char> tmp;
+
+        tmp.reserve(128);
+
+        for (int i = 0; i < n_vocab; i++) {
+            uint32_t len;
+            read_safe(loader, len);
+
+            if (len > 0) {
+                tmp.resize(len);
+                loader->read(loader->context, &tmp[0], tmp.size()); // read to buffer
+                words[i].assign(&tmp[0], tmp.size());
+            } else {
+                // seems like we have an empty-string token in multi-language models (i = 50256)
+                //WHISPER_LOG_WARN("%s: warning: empty-string token in vocab, i = %d\n", __func__, i);
+            }
+        }
+
+        whisper_vocab_init(wctx, words);
+    }
+
+    // create the tensors - when the file is mapped, find the data offsets upfront so the CPU weights can be used in-place
+    std::map<std::string, size_t> offsets;
+    if (model.mapping) {
+        offsets = whisper_mmap_scan_legacy(*model.mapping, model.hparams, wctx.wtype, wctx.wtype == GGML_TYPE_F32 ? GGML_TYPE_F32 : GGML_TYPE_F16);
+    }
+
+    if (!whisper_model_init_tensors(wctx, offsets, {}, {})) {
+        return false;
+    }
+
+    // load weights
+    {
+        size_t total_size = 0;
+
+        model.n_loaded = 0;
+
+        std::vector<char> read_buf;
+
+        while (true) {
+            int32_t n_dims;
+            int32_t length;
+            int32_t ttype;
+
+            read_safe(loader, n_dims);
+            read_safe(loader, length);
+            read_safe(loader, ttype);
+
+            if (loader->eof(loader->context)) {
+                break;
+            }
+
+            int32_t nelements = 1;
+            int32_t ne[4] = { 1, 1, 1, 1 };
+            for (int i = 0; i < n_dims; ++i) {
+                read_safe(loader, ne[i]);
+                nelements *= ne[i];
+            }
+
+            std::string name;
+            std::vector<char> tmp(length); // create a buffer
+            loader->read(loader->context, &tmp[0], tmp.size()); // read to buffer
+            name.assign(&tmp[0], tmp.size());
+
+            if (model.tensors.find(name) == model.tensors.end()) {
+                WHISPER_LOG_ERROR("%s: unknown tensor '%s' in model file\n", __func__, name.data());
+                return false;
+            }
+
+            auto tensor = model.tensors[name.data()];
+
+            if (ggml_nelements(tensor) != nelements) {
+                WHISPER_LOG_ERROR("%s: tensor '%s' has wrong size in model file\n", __func__, name.data());
+                WHISPER_LOG_ERROR("%s: shape: [%d, %d, %d], expected: [%d, %d, %d]\n",
+                        __func__, ne[0], ne[1], ne[2], (int) tensor->ne[0], (int) tensor->ne[1], (int) tensor->ne[2]);
+                return false;
+            }
+
+            if (tensor->ne[0] != ne[0] || tensor->ne[1] != ne[1] || tensor->ne[2] != ne[2]) {
+                WHISPER_LOG_ERROR("%s: tensor '%s' has wrong shape in model file: got [%d, %d, %d], expected [%d, %d, %d]\n",
+                        __func__, name.data(), (int) tensor->ne[0], (int) tensor->ne[1], (int) tensor->ne[2], ne[0], ne[1], ne[2]);
+                return false;
+            }
+
+            const size_t bpe = ggml_type_size(ggml_type(ttype));
+
+            if ((nelements*bpe)/ggml_blck_size(tensor->type) != ggml_nbytes(tensor)) {
+                WHISPER_LOG_ERROR("%s: tensor '%s' has wrong size in model file: got %zu, expected %zu\n",
+                        __func__, name.data(), ggml_nbytes(tensor), nelements*bpe);
+                return false;
+            }
+
+            const uint8_t * data = (const uint8_t *) tensor->data;
+            if (model.mapping && data >= model.mapping->addr && data < model.mapping->addr + model.mapping->size) {
+                // the tensor is used in-place from the mapped file
+                model.mapping->pos += ggml_nbytes(tensor);
+            } else {
+                const size_t offs = model.mapping ? model.mapping->pos : 0;
+
+                if (ggml_backend_buffer_is_host(tensor->buffer)) {
+                    // for the CPU and Metal backend, we can read directly into the tensor
+                    loader->read(loader->context, tensor->data, ggml_nbytes(tensor));
+                    BYTESWAP_TENSOR(tensor);
+                } else {
+                    // read into a temporary buffer first, then copy to device memory
+                    read_buf.resize(ggml_nbytes(tensor));
+
+                    loader->read(loader->context, read_buf.data(), read_buf.size());
+
+                    ggml_backend_tensor_set(tensor, read_buf.data(), 0, ggml_nbytes(tensor));
+                }
+
+                if (model.mapping && model.n_mapped > 0) {
+                    model.mapping->release(offs, ggml_nbytes(tensor));
+                }
+            }
+
+            total_size += ggml_nbytes(tensor);
+            model.n_loaded++;
+        }
+
+        WHISPER_LOG_INFO("%s: model size    = %7.2f MB\n", __func__, total_size/1e6);
+
+        if (model.n_loaded == 0) {
+            WHISPER_LOG_WARN("%s: WARN no tensors loaded from model file - assuming empty model for testing\n", __func__);
+        } else if (model.n_loaded != (int) model.tensors.size()) {
+            WHISPER_LOG_ERROR("%s: ERROR not all tensors loaded from model file - expected %zu, got %d\n", __func__, model.tensors.size(), model.n_loaded);
+            return false;
+        }
+    }
 
-        return tensor;
-    };
+    for (auto & buf : model.buffers) {
+        ggml_backend_buffer_set_usage(buf, GGML_BACKEND_BUFFER_USAGE_WEIGHTS);
+    }
 
+    wctx.t_load_us = ggml_time_us() - t_start_us;
 
-    // prepare tensors for the weights
-    {
-        ggml_init_params params = {
-            /*.mem_size   =*/ n_tensors * ggml_tensor_overhead(),
-            /*.mem_buffer =*/ nullptr,
-            /*.no_alloc   =*/ true,
-        };
+    if (model.mapping) {
+        WHISPER_LOG_INFO("%s: mmap: %d/%d tensors used in-place from the model file\n", __func__, model.n_mapped, model.n_loaded);
+    }
 
-        ggml_context * ctx = ggml_init(params);
+    return true;
+}
 
-        const auto & hparams = model.hparams;
+// load the model from a GGUF file
+//
+// the hparams, the mel filters and the vocab are stored as key-value metadata (see ASR_KV_NAMES in whisper-arch.h)
+// the tensor data is aligned and read by offset - from the mapping when the file is mapped, otherwise with seek + read
+//
+static bool whisper_model_load_gguf(const char * fname, whisper_context & wctx) {
+    WHISPER_LOG_INFO("%s: loading model\n", __func__);
 
-        const int n_vocab = hparams.n_vocab;
+    const int64_t t_start_us = ggml_time_us();
 
-        const int n_audio_ctx   = hparams.n_audio_ctx;
-        const int n_audio_state = hparams.n_audio_state;
-        const int n_audio_layer = hparams.n_audio_layer;
+    wctx.t_start_us = t_start_us;
 
-        const int n_text_ctx   = hparams.n_text_ctx;
-        const int n_text_state = hparams.n_text_state;
-        const int n_text_layer = hparams.n_text_layer;
+    auto & model = wctx.model;
 
-        const int n_mels = hparams.n_mels;
+    ggml_context * ctx_meta = nullptr;
 
-        model.layers_encoder.resize(n_audio_layer);
-        model.layers_decoder.resize(n_text_layer);
+    gguf_init_params params = {
+        /*.no_alloc =*/ true,
+        /*.ctx      =*/ &ctx_meta,
+    };
 
-        // encoder
-        model.e_pe = create_tensor(ASR_TENSOR_ENC_POS_EMBD, ASR_SYSTEM_ENCODER, ggml_new_tensor_2d(ctx, GGML_TYPE_F32, n_audio_state, n_audio_ctx));
+    gguf_context_ptr ctx_gguf { gguf_init_from_file(fname, params) };
+    if (!ctx_gguf) {
+        WHISPER_LOG_ERROR("%s: failed to read GGUF file '%s'\n", __func__, fname);
+        return false;
+    }
 
-        model.e_conv_1_w = create_tensor(ASR_TENSOR_CONV1_WEIGHT, ASR_SYSTEM_ENCODER, ggml_new_tensor_3d(ctx, vtype, 3, n_mels, n_audio_state));
-        model.e_conv_1_b = create_tensor(ASR_TENSOR_CONV1_BIAS, ASR_SYSTEM_ENCODER, ggml_new_tensor_2d(ctx, GGML_TYPE_F32, 1, n_audio_state));
+    ggml_context_ptr ctx_meta_ptr { ctx_meta };
 
-        model.e_conv_2_w = create_tensor(ASR_TENSOR_CONV2_WEIGHT, ASR_SYSTEM_ENCODER, ggml_new_tensor_3d(ctx, vtype, 3, n_audio_state, n_audio_state));
-        model.e_conv_2_b = create_tensor(ASR_TENSOR_CONV2_BIAS, ASR_SYSTEM_ENCODER, ggml_new_tensor_2d(ctx, GGML_TYPE_F32, 1, n_audio_state));
+    gguf_context * gctx = ctx_gguf.get();
 
-        model.e_ln_w = create_tensor(ASR_TENSOR_LN_WEIGHT, ASR_SYSTEM_ENCODER, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_audio_state));
-        model.e_ln_b = create_tensor(ASR_TENSOR_LN_POST_BIAS, ASR_SYSTEM_ENCODER, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_audio_state));
+    // read the metadata
+    try {
+        auto get_key = [&](asr_kv kv, gguf_type type) -> int64_t {
+            const int64_t id = gguf_find_key(gctx, ASR_KV_NAMES.at(kv));
+            if (id < 0) {
+                throw std::runtime_error(format("key '%s' not found in model file", ASR_KV_NAMES.at(kv)));
+            }
+            if (gguf_get_kv_type(gctx, id) != type) {
+                throw std::runtime_error(format("key '%s' has wrong type %s, expected %s",
+                            ASR_KV_NAMES.at(kv), gguf_type_name(gguf_get_kv_type(gctx, id)), gguf_type_name(type)));
+            }
+            return id;
+        };
 
-        for (int i = 0; i < n_audio_layer; ++i) {
-            auto & layer = model.layers_encoder[i];
+        auto get_i32 = [&](asr_kv kv) -> int32_t {
+            return gguf_get_val_i32(gctx, get_key(kv, GGUF_TYPE_INT32));
+        };
 
-            layer.mlp_ln_w = create_tensor(ASR_TENSOR_MLP_LN_WEIGHT, ASR_SYSTEM_ENCODER, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_audio_state), i);
-            layer.mlp_ln_b = create_tensor(ASR_TENSOR_MLP_LN_BIAS, ASR_SYSTEM_ENCODER, ggml_new_tensor_1d(ctx, GGML_TYPE_F32,   n_audio_state), i);
+        auto get_arr = [&](asr_kv kv, gguf_type type, size_t & n) -> const void * {
+            const int64_t id = get_key(kv, GGUF_TYPE_ARRAY);
+            if (gguf_get_arr_type(gctx, id) != type) {
+                throw std::runtime_error(format("array '%s' has wrong element type %s, expected %s",
+                            ASR_KV_NAMES.at(kv), gguf_type_name(gguf_get_arr_type(gctx, id)), gguf_type_name(type)));
+            }
+            n = gguf_get_arr_n(gctx, id);
+            return gguf_get_arr_data(gctx, id);
+        };
 
-            layer.mlp_0_w = create_tensor(ASR_TENSOR_MLP_0_WEIGHT, ASR_SYSTEM_ENCODER, ggml_new_tensor_2d(ctx, wtype, n_audio_state, 4*n_audio_state), i);
-            layer.mlp_0_b = create_tensor(ASR_TENSOR_MLP_0_BIAS, ASR_SYSTEM_ENCODER, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, 4*n_audio_state), i);
+        const std::string arch = gguf_get_val_str(gctx, get_key(ASR_KV_GENERAL_ARCHITECTURE, GGUF_TYPE_STRING));
+        if (arch != ASR_ARCH_NAME) {
+            throw std::runtime_error(format("unsupported architecture '%s'", arch.c_str()));
+        }
 
-            layer.mlp_1_w = create_tensor(ASR_TENSOR_MLP_2_WEIGHT, ASR_SYSTEM_ENCODER, ggml_new_tensor_2d(ctx, wtype, 4*n_audio_state, n_audio_state), i);
-            layer.mlp_1_b = create_tensor(ASR_TENSOR_MLP_2_BIAS, ASR_SYSTEM_ENCODER, ggml_new_tensor_1d(ctx, GGML_TYPE_F32,   n_audio_state), i);
+        auto & hparams = model.hparams;
 
-            layer.attn_ln_0_w = create_tensor(ASR_TENSOR_ATTN_LN_WEIGHT, ASR_SYSTEM_ENCODER, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_audio_state), i);
-            layer.attn_ln_0_b = create_tensor(ASR_TENSOR_ATTN_LN_BIAS, ASR_SYSTEM_ENCODER, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_audio_state), i);
+        hparams.n_vocab       = get_i32(ASR_KV_VOCAB_SIZE);
+        hparams.n_audio_ctx   = get_i32(ASR_KV_AUDIO_CONTEXT_LENGTH);
+        hparams.n_audio_state = get_i32(ASR_KV_AUDIO_EMBEDDING_LENGTH);
+        hparams.n_audio_head  = get_i32(ASR_KV_AUDIO_HEAD_COUNT);
+        hparams.n_audio_layer = get_i32(ASR_KV_AUDIO_BLOCK_COUNT);
+        hparams.n_text_ctx    = get_i32(ASR_KV_TEXT_CONTEXT_LENGTH);
+        hparams.n_text_state  = get_i32(ASR_KV_TEXT_EMBEDDING_LENGTH);
+        hparams.n_text_head   = get_i32(ASR_KV_TEXT_HEAD_COUNT);
+        hparams.n_text_layer  = get_i32(ASR_KV_TEXT_BLOCK_COUNT);
+        hparams.n_mels        = get_i32(ASR_KV_MEL_COUNT);
+        hparams.ftype         = get_i32(ASR_KV_GENERAL_FILE_TYPE) + get_i32(ASR_KV_GENERAL_QUANTIZATION_VERSION)*GGML_QNT_VERSION_FACTOR;
+
+        if (!whisper_model_init_hparams(wctx)) {
+            return false;
+        }
 
-            layer.attn_q_w = create_tensor(ASR_TENSOR_ATTN_QUERY_WEIGHT, ASR_SYSTEM_ENCODER, ggml_new_tensor_2d(ctx, wtype, n_audio_state, n_audio_state), i);
-            layer.attn_q_b = create_tensor(ASR_TENSOR_ATTN_QUERY_BIAS, ASR_SYSTEM_ENCODER, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_audio_state), i);
+        // mel filters
+        {
+            auto & filters = model.filters;
 
-            layer.attn_k_w = create_tensor(ASR_TENSOR_ATTN_KEY_WEIGHT, ASR_SYSTEM_ENCODER, ggml_new_tensor_2d(ctx, wtype, n_audio_state, n_audio_state), i);
+            filters.n_mel = get_i32(ASR_KV_MEL_FILTERS_N_MEL);
+            filters.n_fft = get_i32(ASR_KV_MEL_FILTERS_N_FFT);
 
-            layer.attn_v_w = create_tensor(ASR_TENSOR_ATTN_VALUE_WEIGHT, ASR_SYSTEM_ENCODER, ggml_new_tensor_2d(ctx, wtype, n_audio_state, n_audio_state), i);
-            layer.attn_v_b = create_tensor(ASR_TENSOR_ATTN_VALUE_BIAS, ASR_SYSTEM_ENCODER, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_audio_state), i);
+            size_t n = 0;
+            const float * data = (const float *) get_arr(ASR_KV_MEL_FILTERS_DATA, GGUF_TYPE_FLOAT32, n);
+            if (n != (size_t) filters.n_mel*filters.n_fft) {
+                throw std::runtime_error(format("mel filters have wrong size %zu, expected %d", n, filters.n_mel*filters.n_fft));
+            }
 
-            layer.attn_ln_1_w = create_tensor(ASR_TENSOR_ATTN_OUT_WEIGHT, ASR_SYSTEM_ENCODER, ggml_new_tensor_2d(ctx, wtype, n_audio_state, n_audio_state), i);
-            layer.attn_ln_1_b = create_tensor(ASR_TENSOR_ATTN_OUT_BIAS, ASR_SYSTEM_ENCODER, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_audio_state), i);
+            filters.data.assign(data, data + n);
         }
 
-        // decoder
-        model.d_pe = create_tensor(ASR_TENSOR_DEC_POS_EMBD, ASR_SYSTEM_DECODER, ggml_new_tensor_2d(ctx, GGML_TYPE_F32, n_text_state, n_text_ctx));
-
-        model.d_te = create_tensor(ASR_TENSOR_DEC_TOKEN_EMBD_WEIGHT, ASR_SYSTEM_DECODER, ggml_new_tensor_2d(ctx, wtype, n_text_state, n_vocab));
+        // vocab
+        {
+            size_t n_bytes  = 0;
+            size_t n_tokens = 0;
 
-        model.d_ln_w = create_tensor(ASR_TENSOR_LN_WEIGHT, ASR_SYSTEM_DECODER, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_text_state));
-        model.d_ln_b = create_tensor(ASR_TENSOR_LN_BIAS, ASR_SYSTEM_DECODER, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_text_state));
+            const char     * bytes   = (const char     *) get_arr(ASR_KV_TOKENIZER_TOKEN_BYTES,   GGUF_TYPE_UINT8,  n_bytes);
+            const uint32_t * lengths = (const uint32_t *) get_arr(ASR_KV_TOKENIZER_TOKEN_LENGTHS, GGUF_TYPE_UINT32, n_tokens);
 
-        for (int i = 0; i < n_text_layer; ++i) {
-            auto & layer = model.layers_decoder[i];
+            std::vector<std::string> words(n_tokens);
 
-            layer.mlp_ln_w = create_tensor(ASR_TENSOR_MLP_LN_WEIGHT, ASR_SYSTEM_DECODER, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_text_state), i);
-            layer.mlp_ln_b = create_tensor(ASR_TENSOR_MLP_LN_BIAS, ASR_SYSTEM_DECODER, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_text_state), i);
+            size_t offs = 0;
+            for (size_t i = 0; i < n_tokens; ++i) {
+                if (offs + lengths[i] > n_bytes) {
+                    throw std::runtime_error("vocab data is truncated");
+                }
+                words[i].assign(bytes + offs, lengths[i]);
+                offs += lengths[i];
+            }
 
-            layer.mlp_0_w = create_tensor(ASR_TENSOR_MLP_0_WEIGHT, ASR_SYSTEM_DECODER, ggml_new_tensor_2d(ctx, wtype, n_text_state, 4*n_text_state), i);
-            layer.mlp_0_b = create_tensor(ASR_TENSOR_MLP_0_BIAS, ASR_SYSTEM_DECODER, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, 4*n_text_state), i);
+            whisper_vocab_init(wctx, words);
+        }
+    } catch (const std::exception & e) {
+        WHISPER_LOG_ERROR("%s: invalid model file '%s': %s\n", __func__, fname, e.what());
+        return false;
+    }
 
-            layer.mlp_1_w = create_tensor(ASR_TENSOR_MLP_2_WEIGHT, ASR_SYSTEM_DECODER, ggml_new_tensor_2d(ctx, wtype, 4*n_text_state, n_text_state), i);
-            layer.mlp_1_b = create_tensor(ASR_TENSOR_MLP_2_BIAS, ASR_SYSTEM_DECODER, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_text_state), i);
+    // tensor index
+    std::map<std::string, size_t>    offsets;
+    std::map<std::string, ggml_type> types;
 
-            layer.attn_ln_0_w = create_tensor(ASR_TENSOR_ATTN_LN_WEIGHT, ASR_SYSTEM_DECODER, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_text_state), i);
-            layer.attn_ln_0_b = create_tensor(ASR_TENSOR_ATTN_LN_BIAS, ASR_SYSTEM_DECODER, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_text_state), i);
+    const size_t data_offset = gguf_get_data_offset(gctx);
 
-            layer.attn_q_w = create_tensor(ASR_TENSOR_ATTN_QUERY_WEIGHT, ASR_SYSTEM_DECODER, ggml_new_tensor_2d(ctx, wtype, n_text_state, n_text_state), i);
-            layer.attn_q_b = create_tensor(ASR_TENSOR_ATTN_QUERY_BIAS, ASR_SYSTEM_DECODER, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_text_state), i);
+    for (int64_t i = 0; i < gguf_get_n_tensors(gctx); ++i) {
+        const char * name = gguf_get_tensor_name(gctx, i);
 
-            layer.attn_k_w = create_tensor(ASR_TENSOR_ATTN_KEY_WEIGHT, ASR_SYSTEM_DECODER, ggml_new_tensor_2d(ctx, wtype, n_text_state, n_text_state), i);
+        offsets[name] = data_offset + gguf_get_tensor_offset(gctx, i);
+        types[name]   = gguf_get_tensor_type(gctx, i);
+    }
 
-            layer.attn_v_w = create_tensor(ASR_TENSOR_ATTN_VALUE_WEIGHT, ASR_SYSTEM_DECODER, ggml_new_tensor_2d(ctx, wtype, n_text_state, n_text_state), i);
-            layer.attn_v_b = create_tensor(ASR_TENSOR_ATTN_VALUE_BIAS, ASR_SYSTEM_DECODER, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_text_state), i);
+    // tensors stored in the repacked layout of the CPU backend (wstream-quantize --repack)
+    std::set<std::string> repacked;
 
-            layer.attn_ln_1_w = create_tensor(ASR_TENSOR_ATTN_OUT_WEIGHT, ASR_SYSTEM_DECODER, ggml_new_tensor_2d(ctx, wtype, n_text_state, n_text_state), i);
-            layer.attn_ln_1_b = create_tensor(ASR_TENSOR_ATTN_OUT_BIAS, ASR_SYSTEM_DECODER, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_text_state), i);
+    if (gguf_find_key(gctx, ASR_KV_NAMES.at(ASR_KV_REPACK_ISA)) >= 0) {
+        const int64_t id_isa     = gguf_find_key(gctx, ASR_KV_NAMES.at(ASR_KV_REPACK_ISA));
+        const int64_t id_tensors = gguf_find_key(gctx, ASR_KV_NAMES.at(ASR_KV_REPACK_TENSORS));
 
-            layer.cross_attn_ln_0_w = create_tensor(ASR_TENSOR_ATTN_LN_WEIGHT, ASR_SYSTEM_CROSS, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_text_state), i);
-            layer.cross_attn_ln_0_b = create_tensor(ASR_TENSOR_ATTN_LN_BIAS, ASR_SYSTEM_CROSS, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_text_state), i);
+        if (gguf_get_kv_type(gctx, id_isa) != GGUF_TYPE_STRING || id_tensors < 0 || gguf_get_kv_type(gctx, id_tensors) != GGUF_TYPE_STRING) {
+            WHISPER_LOG_ERROR("%s: invalid model file '%s': invalid repack metadata\n", __func__, fname);
+            return false;
+        }
 
-            layer.cross_attn_q_w = create_tensor(ASR_TENSOR_ATTN_QUERY_WEIGHT, ASR_SYSTEM_CROSS, ggml_new_tensor_2d(ctx, wtype, n_text_state, n_text_state), i);
-            layer.cross_attn_q_b = create_tensor(ASR_TENSOR_ATTN_QUERY_BIAS, ASR_SYSTEM_CROSS, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_text_state), i);
+        const std::string isa = gguf_get_val_str(gctx, id_isa);
+        const char * isa_cpu  = whisper_cpu_repack_isa();
 
-            layer.cross_attn_k_w = create_tensor(ASR_TENSOR_ATTN_KEY_WEIGHT, ASR_SYSTEM_CROSS, ggml_new_tensor_2d(ctx, wtype, n_text_state, n_text_state), i);
+        if (!isa_cpu || isa != isa_cpu) {
+            WHISPER_LOG_ERROR("%s: the weights in '%s' are repacked for '%s', but this CPU uses '%s' - use a model without --repack\n",
+                    __func__, fname, isa.c_str(), isa_cpu ? isa_cpu : "none");
+            return false;
+        }
 
-            layer.cross_attn_v_w = create_tensor(ASR_TENSOR_ATTN_VALUE_WEIGHT, ASR_SYSTEM_CROSS, ggml_new_tensor_2d(ctx, wtype, n_text_state, n_text_state), i);
-            layer.cross_attn_v_b = create_tensor(ASR_TENSOR_ATTN_VALUE_BIAS, ASR_SYSTEM_CROSS, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_text_state), i);
+        const std::string list = gguf_get_val_str(gctx, id_tensors);
 
-            layer.cross_attn_ln_1_w = create_tensor(ASR_TENSOR_ATTN_OUT_WEIGHT, ASR_SYSTEM_CROSS, ggml_new_tensor_2d(ctx, wtype, n_text_state, n_text_state), i);
-            layer.cross_attn_ln_1_b = create_tensor(ASR_TENSOR_ATTN_OUT_BIAS, ASR_SYSTEM_CROSS, ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n_text_state), i);
+        size_t pos = 0;
+        while (pos < list.size()) {
+            const size_t end = std::min(list.find(',', pos), list.size());
+            repacked.insert(list.substr(pos, end - pos));
+            pos = end + 1;
         }
 
-        ggml_free(ctx);
+        WHISPER_LOG_INFO("%s: %zu tensors are pre-repacked for '%s'\n", __func__, repacked.size(), isa.c_str());
     }
 
-    // allocate tensors in the backend buffers
-    for (auto & p : ctx_map) {
-        ggml_backend_buffer_type_t buft = p.first;
-        ggml_context * ctx = p.second;
-        ggml_backend_buffer_t buf = ggml_backend_alloc_ctx_tensors_from_buft(ctx, buft);
-        if (buf) {
-            model.buffers.emplace_back(buf);
-
-            size_t size_main = ggml_backend_buffer_get_size(buf);
-            WHISPER_LOG_INFO("%s: %12s total size = %8.2f MB\n", __func__, ggml_backend_buffer_name(buf), size_main / 1e6);
-        }
+    if (!whisper_model_init_tensors(wctx, model.mapping ? offsets : std::map<std::string, size_t>(), types, repacked)) {
+        return false;
     }
 
     // load weights
@@ -1877,86 +3135,76 @@ static bool whisper_model_load(struct whisper_model_loader * loader, whisper_con
 
         model.n_loaded = 0;
 
-        std::vector<char> read_buf;
-
-        while (true) {
-            int32_t n_dims;
-            int32_t length;
-            int32_t ttype;
-
-            read_safe(loader, n_dims);
-            read_safe(loader, length);
-            read_safe(loader, ttype);
-
-            if (loader->eof(loader->context)) {
-                break;
-            }
-
-            int32_t nelements = 1;
-            int32_t ne[4] = { 1, 1, 1, 1 };
-            for (int i = 0; i < n_dims; ++i) {
-                read_safe(loader, ne[i]);
-                nelements *= ne[i];
+        std::ifstream fin;
+        if (!model.mapping) {
+            fin.open(fname, std::ios::binary);
+            if (!fin) {
+                WHISPER_LOG_ERROR("%s: failed to open '%s'\n", __func__, fname);
+                return false;
             }
+        }
 
-            std::string name;
-            std::vector<char> tmp(length); // create a buffer
-            loader->read(loader->context, &tmp[0], tmp.size()); // read to buffer
-            name.assign(&tmp[0], tmp.size());
+        std::vector<char> read_buf;
 
-            if (model.tensors.find(name) == model.tensors.end()) {
-                WHISPER_LOG_ERROR("%s: unknown tensor '%s' in model file\n", __func__, name.data());
-                return false;
-            }
+        for (auto & t : model.tensors) {
+            const std::string & name = t.first;
 
-            auto tensor = model.tensors[name.data()];
+            ggml_tensor * tensor = t.second;
 
-            if (ggml_nelements(tensor) != nelements) {
-                WHISPER_LOG_ERROR("%s: tensor '%s' has wrong size in model file\n", __func__, name.data());
-                WHISPER_LOG_ERROR("%s: shape: [%d, %d, %d], expected: [%d, %d, %d]\n",
-                        __func__, ne[0], ne[1], ne[2], (int) tensor->ne[0], (int) tensor->ne[1], (int) tensor->ne[2]);
+            ggml_tensor * meta = ggml_get_tensor(ctx_meta, name.c_str());
+            if (!meta) {
+                WHISPER_LOG_ERROR("%s: tensor '%s' not found in model file\n", __func__, name.c_str());
                 return false;
             }
 
-            if (tensor->ne[0] != ne[0] || tensor->ne[1] != ne[1] || tensor->ne[2] != ne[2]) {
-                WHISPER_LOG_ERROR("%s: tensor '%s' has wrong shape in model file: got [%d, %d, %d], expected [%d, %d, %d]\n",
-                        __func__, name.data(), (int) tensor->ne[0], (int) tensor->ne[1], (int) tensor->ne[2], ne[0], ne[1], ne[2]);
+            if (meta->type != tensor->type || !ggml_are_same_shape(meta, tensor)) {
+                WHISPER_LOG_ERROR("%s: tensor '%s' has wrong type or shape in model file: got %s [%d, %d, %d], expected %s [%d, %d, %d]\n",
+                        __func__, name.c_str(),
+                        ggml_type_name(meta->type),   (int) meta->ne[0],   (int) meta->ne[1],   (int) meta->ne[2],
+                        ggml_type_name(tensor->type), (int) tensor->ne[0], (int) tensor->ne[1], (int) tensor->ne[2]);
                 return false;
             }
 
-            const size_t bpe = ggml_type_size(ggml_type(ttype));
+            const size_t offs   = offsets.at(name);
+            const size_t nbytes = ggml_nbytes(tensor);
 
-            if ((nelements*bpe)/ggml_blck_size(tensor->type) != ggml_nbytes(tensor)) {
-                WHISPER_LOG_ERROR("%s: tensor '%s' has wrong size in model file: got %zu, expected %zu\n",
-                        __func__, name.data(), ggml_nbytes(tensor), nelements*bpe);
-                return false;
-            }
+            const uint8_t * data = (const uint8_t *) tensor->data;
+            if (model.mapping && data >= model.mapping->addr && data < model.mapping->addr + model.mapping->size) {
+                // the tensor is used in-place from the mapped file
+            } else if (model.mapping) {
+                if (offs + nbytes > model.mapping->size) {
+                    WHISPER_LOG_ERROR("%s: tensor '%s' data is out of bounds of the model file\n", __func__, name.c_str());
+                    return false;
+                }
+
+                ggml_backend_tensor_set(tensor, model.mapping->addr + offs, 0, nbytes);
 
-            if (ggml_backend_buffer_is_host(tensor->buffer)) {
-                // for the CPU and Metal backend, we can read directly into the tensor
-                loader->read(loader->context, tensor->data, ggml_nbytes(tensor));
-                BYTESWAP_TENSOR(tensor);
+                if (model.n_mapped > 0) {
+                    model.mapping->release(offs, nbytes);
+                }
             } else {
-                // read into a temporary buffer first, then copy to device memory
-                read_buf.resize(ggml_nbytes(tensor));
+                fin.seekg(offs);
+
+                if (ggml_backend_buffer_is_host(tensor->buffer)) {
+                    fin.read((char *) tensor->data, nbytes);
+                } else {
+                    read_buf.resize(nbytes);
+                    fin.read(read_buf.data(), nbytes);
 
-                loader->read(loader->context, read_buf.data(), read_buf.size());
+                    ggml_backend_tensor_set(tensor, read_buf.data(), 0, nbytes);
+                }
 
-                ggml_backend_tensor_set(tensor, read_buf.data(), 0, ggml_nbytes(tensor));
+                if (!fin) {
+                    WHISPER_LOG_ERROR("%s: failed to read tensor '%s' data\n", __func__, name.c_str());
+                    return false;
+                }
             }
 
-            total_size += ggml_nbytes(tensor);
+            total_size += nbytes;
             model.n_loaded++;
         }
 
         WHISPER_LOG_INFO("%s: model size    = %7.2f MB\n", __func__, total_size/1e6);
-
-        if (model.n_loaded == 0) {
-            WHISPER_LOG_WARN("%s: WARN no tensors loaded from model file - assuming empty model for testing\n", __func__);
-        } else if (model.n_loaded != (int) model.tensors.size()) {
-            WHISPER_LOG_ERROR("%s: ERROR not all tensors loaded from model file - expected %zu, got %d\n", __func__, model.tensors.size(), model.n_loaded);
-            return false;
-        }
     }
 
     for (auto & buf : model.buffers) {
@@ -1965,6 +3213,10 @@ static bool whisper_model_load(struct whisper_model_loader * loader, whisper_con
 
     wctx.t_load_us = ggml_time_us() - t_start_us;
 
+    if (model.mapping) {
+        WHISPER_LOG_INFO("%s: mmap: %d/%d tensors used in-place from the model file\n", __func__, model.n_mapped, model.n_loaded);
+    }
+
     return true;
 }
 
@@ -1989,7 +3241,7 @@ static bool whisper_encode_external(const whisper_state & wstate) {
 static struct ggml_cgraph * whisper_build_graph_conv(
         whisper_context & wctx,
           whisper_state & wstate) {
-    const auto & model   = wctx.model;
+    const auto & model   = whisper_state_model(wctx, wstate);
     const auto & hparams = model.hparams;
 
     const int n_ctx   = wstate.exp_n_audio_ctx > 0 ? wstate.exp_n_audio_ctx : hparams.n_audio_ctx;
@@ -2043,6 +3295,8 @@ static struct ggml_cgraph * whisper_build_graph_conv(
 
     ggml_build_forward_expand(gf, cur);
 
+    wstate.sched_conv.meta_used = ggml_used_mem(ctx0);
+
     ggml_free(ctx0);
 
     return gf;
@@ -2051,7 +3305,7 @@ static struct ggml_cgraph * whisper_build_graph_conv(
 static struct ggml_cgraph * whisper_build_graph_encoder(
         whisper_context & wctx,
           whisper_state & wstate) {
-    const auto & model   = wctx.model;
+    const auto & model   = whisper_state_model(wctx, wstate);
     const auto & hparams = model.hparams;
 
     const int n_ctx   = wstate.exp_n_audio_ctx > 0 ? wstate.exp_n_audio_ctx : hparams.n_audio_ctx;
@@ -2276,6 +3530,8 @@ static struct ggml_cgraph * whisper_build_graph_encoder(
     //        wstate.get_buf_max_mem(2)/1e6,
     //        wstate.get_buf_max_mem(3)/1e6);
 
+    wstate.sched_encode.meta_used = ggml_used_mem(ctx0);
+
     ggml_free(ctx0);
 
     return gf;
@@ -2285,7 +3541,7 @@ static struct ggml_cgraph * whisper_build_graph_encoder(
 static struct ggml_cgraph * whisper_build_graph_cross(
         whisper_context & wctx,
           whisper_state & wstate) {
-    const auto & model   = wctx.model;
+    const auto & model   = whisper_state_model(wctx, wstate);
     const auto & hparams = model.hparams;
 
     const int n_ctx   = wstate.exp_n_audio_ctx > 0 ? wstate.exp_n_audio_ctx : hparams.n_audio_ctx;
@@ -2353,6 +3609,8 @@ static struct ggml_cgraph * whisper_build_graph_cross(
 
     //ggml_graph_print(gf);
 
+    wstate.sched_cross.meta_used = ggml_used_mem(ctx0);
+
     ggml_free(ctx0);
 
     return gf;
@@ -2372,19 +3630,27 @@ static bool whisper_encode_internal(
         whisper_context & wctx,
           whisper_state & wstate,
               const int   mel_offset,
-              const int   n_threads,
+                    int   n_threads,
     ggml_abort_callback   abort_callback,
                    void * abort_callback_data) {
     const int64_t t_start_us = ggml_time_us();
 
+    whisper_numa_scope numa_scope(whisper_state_numa_node(wctx, wstate));
+
+    n_threads = whisper_state_n_threads(wstate, n_threads);
+
+    const int n_ctx = wstate.exp_n_audio_ctx > 0 ? wstate.exp_n_audio_ctx : wctx.model.hparams.n_audio_ctx;
+
     // conv
     {
-        auto & sched = wstate.sched_conv.sched;
+        auto & sched = wstate.sched_conv;
 
-        ggml_cgraph * gf = whisper_build_graph_conv(wctx, wstate);
+        ggml_cgraph * gf = whisper_sched_graph_get(sched, { n_ctx, 0, 0, 0 },
+                [&]() {
+                    return whisper_build_graph_conv(wctx, wstate);
+                });
 
-        if (!ggml_backend_sched_alloc_graph(sched, gf)) {
-            // should never happen as we pre-allocate the memory
+        if (!gf) {
             return false;
         }
 
@@ -2393,7 +3659,6 @@ static bool whisper_encode_internal(
         // set the input
         {
             const auto & mel_inp = wstate.mel;
-            const int n_ctx      = wstate.exp_n_audio_ctx > 0 ? wstate.exp_n_audio_ctx : wctx.model.hparams.n_audio_ctx;
 
             assert(mel->type == GGML_TYPE_F32);
             assert(mel_inp.n_mel == wctx.model.hparams.n_mels);
@@ -2430,12 +3695,14 @@ static bool whisper_encode_internal(
 
     // encoder
     if (!whisper_encode_external(wstate)) {
-        auto & sched = wstate.sched_encode.sched;
+        auto & sched = wstate.sched_encode;
 
-        ggml_cgraph * gf = whisper_build_graph_encoder(wctx, wstate);
+        ggml_cgraph * gf = whisper_sched_graph_get(sched, { n_ctx, (intptr_t) wstate.embd_conv, (intptr_t) wstate.embd_conv->data, 0 },
+                [&]() {
+                    return whisper_build_graph_encoder(wctx, wstate);
+                });
 
-        if (!ggml_backend_sched_alloc_graph(sched, gf)) {
-            // should never happen as we pre-allocate the memory
+        if (!gf) {
             return false;
         }
 
@@ -2446,12 +3713,14 @@ static bool whisper_encode_internal(
 
     // cross
     {
-        auto & sched = wstate.sched_cross.sched;
+        auto & sched = wstate.sched_cross;
 
-        ggml_cgraph * gf = whisper_build_graph_cross(wctx, wstate);
+        ggml_cgraph * gf = whisper_sched_graph_get(sched, { n_ctx, (intptr_t) wstate.embd_enc, (intptr_t) wstate.embd_enc->data, 0 },
+                [&]() {
+                    return whisper_build_graph_cross(wctx, wstate);
+                });
 
-        if (!ggml_backend_sched_alloc_graph(sched, gf)) {
-            // should never happen as we pre-allocate the memory
+        if (!gf) {
             return false;
         }
 
@@ -2472,7 +3741,7 @@ static struct ggml_cgraph * whisper_build_graph_decoder(
      const whisper_batch & batch,
                     bool   save_alignment_heads_QKs,
                     bool   worst_case) {
-    const auto & model   = wctx.model;
+    const auto & model   = whisper_state_model(wctx, wstate);
     const auto & hparams = model.hparams;
 
     auto & kv_self = wstate.kv_self;
@@ -2841,6 +4110,8 @@ static struct ggml_cgraph * whisper_build_graph_decoder(
 
     ggml_build_forward_expand(gf, logits);
 
+    wstate.sched_decode.meta_used = ggml_used_mem(ctx0);
+
     ggml_free(ctx0);
 
     return gf;
@@ -2860,12 +4131,16 @@ static bool whisper_decode_internal(
         whisper_context & wctx,
           whisper_state & wstate,
     const whisper_batch & batch,
-              const int   n_threads,
+                    int   n_threads,
                    bool   save_alignment_heads_QKs,
     ggml_abort_callback   abort_callback,
                    void * abort_callback_data) {
     const int64_t t_start_us = ggml_time_us();
 
+    whisper_numa_scope numa_scope(whisper_state_numa_node(wctx, wstate));
+
+    n_threads = whisper_state_n_threads(wstate, n_threads);
+
     const auto & model   = wctx.model;
     const auto & hparams = model.hparams;
 
@@ -2893,12 +4168,20 @@ static bool whisper_decode_internal(
 
     // decoder
     {
-        auto & sched = wstate.sched_decode.sched;
+        auto & sched = wstate.sched_decode;
 
-        ggml_cgraph * gf = whisper_build_graph_decoder(wctx, wstate, batch, save_alignment_heads_QKs, false);
+        // the KV cache slot is part of the graph (views into the cache), so the same graph is reused only for
+        // the same position in the cache - e.g. the n-th token of each window when streaming
+        const auto & kv_self = wstate.kv_self;
 
-        if (!ggml_backend_sched_alloc_graph(sched, gf)) {
-            // should never happen as we pre-allocate the memory
+        const int n_audio_ctx = wstate.exp_n_audio_ctx > 0 ? wstate.exp_n_audio_ctx : hparams.n_audio_ctx;
+
+        ggml_cgraph * gf = whisper_sched_graph_get(sched, { n_tokens, kv_self.n, kv_self.head, n_audio_ctx },
+                [&]() {
+                    return whisper_build_graph_decoder(wctx, wstate, batch, save_alignment_heads_QKs, false);
+                });
+
+        if (!gf) {
             return false;
         }
 
@@ -3006,6 +4289,12 @@ static std::string to_timestamp(int64_t t, bool comma = false) {
 }
 
 #define SIN_COS_N_COUNT WHISPER_N_FFT
+
+// the FFT halves WHISPER_N_FFT down to its odd factor, which is transformed with a DFT
+#define DFT_N_COUNT 25
+static_assert(WHISPER_N_FFT % DFT_N_COUNT == 0 && ((WHISPER_N_FFT / DFT_N_COUNT) & (WHISPER_N_FFT / DFT_N_COUNT - 1)) == 0,
+              "WHISPER_N_FFT must be DFT_N_COUNT times a power of two");
+
 namespace {
 struct whisper_global_cache {
     // In FFT, we frequently use sine and cosine operations with the same values.
@@ -3018,9 +4307,15 @@ struct whisper_global_cache {
     // ref: https://github.com/openai/whisper/blob/main/whisper/audio.py#L147
     float hann_window[WHISPER_N_FFT];
 
+    // the sine and cosine of the DFT of size DFT_N_COUNT at [k*DFT_N_COUNT + n], the same values as in sin_vals and
+    // cos_vals without the modulo of the index - the tables are symmetric
+    float dft_sin_vals[DFT_N_COUNT*DFT_N_COUNT];
+    float dft_cos_vals[DFT_N_COUNT*DFT_N_COUNT];
+
     whisper_global_cache() {
         fill_sin_cos_table();
         fill_hann_window(sizeof(hann_window)/sizeof(hann_window[0]), true, hann_window);
+        fill_dft_table();
     }
 
     void fill_sin_cos_table() {
@@ -3031,6 +4326,17 @@ struct whisper_global_cache {
         }
     }
 
+    void fill_dft_table() {
+        const int sin_cos_step = SIN_COS_N_COUNT / DFT_N_COUNT;
+        for (int k = 0; k < DFT_N_COUNT; k++) {
+            for (int n = 0; n < DFT_N_COUNT; n++) {
+                const int idx = (k * n * sin_cos_step) % SIN_COS_N_COUNT;
+                dft_sin_vals[k*DFT_N_COUNT + n] = sin_vals[idx];
+                dft_cos_vals[k*DFT_N_COUNT + n] = cos_vals[idx];
+            }
+        }
+    }
+
     void fill_hann_window(int length, bool periodic, float * output) {
         int offset = -1;
         if (periodic) {
@@ -3047,6 +4353,43 @@ struct whisper_global_cache {
 // input is real-valued
 // output is complex-valued
 static void dft(const float* in, int N, float* out) {
+    if (N == DFT_N_COUNT) {
+        const float * sin_vals = global_cache.dft_sin_vals;
+        const float * cos_vals = global_cache.dft_cos_vals;
+
+        int k = 0;
+#if defined(__wasm_simd128__)
+        // 4 outputs at a time - the row n of the symmetric tables holds the values of the outputs k .. k + 3
+        for (; k + 4 <= N; k += 4) {
+            v128_t re = wasm_f32x4_splat(0.0f);
+            v128_t im = wasm_f32x4_splat(0.0f);
+
+            for (int n = 0; n < N; n++) {
+                const v128_t x = wasm_f32x4_splat(in[n]);
+                re = wasm_f32x4_add(re, wasm_f32x4_mul(x, wasm_v128_load(cos_vals + n*N + k)));
+                im = wasm_f32x4_sub(im, wasm_f32x4_mul(x, wasm_v128_load(sin_vals + n*N + k)));
+            }
+
+            wasm_v128_store(out + 2*k + 0, wasm_i32x4_shuffle(re, im, 0, 4, 1, 5));
+            wasm_v128_store(out + 2*k + 4, wasm_i32x4_shuffle(re, im, 2, 6, 3, 7));
+        }
+#endif
+        for (; k < N; k++) {
+            float re = 0;
+            float im = 0;
+
+            for (int n = 0; n < N; n++) {
+                re += in[n]*cos_vals[k*N + n];
+                im -= in[n]*sin_vals[k*N + n];
+            }
+
+            out[k*2 + 0] = re;
+            out[k*2 + 1] = im;
+        }
+
+        return;
+    }
+
     const int sin_cos_step = SIN_COS_N_COUNT / N;
 
     for (int k = 0; k < N; k++) {
@@ -3096,7 +4439,39 @@ static void fft(float* in, int N, float* out) {
     fft(odd, half_N, odd_fft);
 
     const int sin_cos_step = SIN_COS_N_COUNT / N;
-    for (int k = 0; k < half_N; k++) {
+
+    int k = 0;
+#if defined(__wasm_simd128__)
+    // 4 butterflies at a time on the deinterleaved real and imaginary parts, in the order of the operations below
+    for (; k + 4 <= half_N; k += 4) {
+        const float * cos_vals = global_cache.cos_vals + k * sin_cos_step;
+        const float * sin_vals = global_cache.sin_vals + k * sin_cos_step;
+
+        const v128_t re = wasm_f32x4_make(cos_vals[0], cos_vals[sin_cos_step], cos_vals[2*sin_cos_step], cos_vals[3*sin_cos_step]);
+        const v128_t im = wasm_f32x4_neg(wasm_f32x4_make(sin_vals[0], sin_vals[sin_cos_step], sin_vals[2*sin_cos_step], sin_vals[3*sin_cos_step]));
+
+        const v128_t odd_0  = wasm_v128_load(odd_fft  + 2*k + 0);
+        const v128_t odd_1  = wasm_v128_load(odd_fft  + 2*k + 4);
+        const v128_t even_0 = wasm_v128_load(even_fft + 2*k + 0);
+        const v128_t even_1 = wasm_v128_load(even_fft + 2*k + 4);
+
+        const v128_t re_odd  = wasm_i32x4_shuffle(odd_0,  odd_1,  0, 2, 4, 6);
+        const v128_t im_odd  = wasm_i32x4_shuffle(odd_0,  odd_1,  1, 3, 5, 7);
+        const v128_t re_even = wasm_i32x4_shuffle(even_0, even_1, 0, 2, 4, 6);
+        const v128_t im_even = wasm_i32x4_shuffle(even_0, even_1, 1, 3, 5, 7);
+
+        const v128_t re_0 = wasm_f32x4_sub(wasm_f32x4_add(re_even, wasm_f32x4_mul(re, re_odd)), wasm_f32x4_mul(im, im_odd));
+        const v128_t im_0 = wasm_f32x4_add(wasm_f32x4_add(im_even, wasm_f32x4_mul(re, im_odd)), wasm_f32x4_mul(im, re_odd));
+        const v128_t re_1 = wasm_f32x4_add(wasm_f32x4_sub(re_even, wasm_f32x4_mul(re, re_odd)), wasm_f32x4_mul(im, im_odd));
+        const v128_t im_1 = wasm_f32x4_sub(wasm_f32x4_sub(im_even, wasm_f32x4_mul(re, im_odd)), wasm_f32x4_mul(im, re_odd));
+
+        wasm_v128_store(out + 2*k + 0,            wasm_i32x4_shuffle(re_0, im_0, 0, 4, 1, 5));
+        wasm_v128_store(out + 2*k + 4,            wasm_i32x4_shuffle(re_0, im_0, 2, 6, 3, 7));
+        wasm_v128_store(out + 2*(k + half_N) + 0, wasm_i32x4_shuffle(re_1, im_1, 0, 4, 1, 5));
+        wasm_v128_store(out + 2*(k + half_N) + 4, wasm_i32x4_shuffle(re_1, im_1, 2, 6, 3, 7));
+    }
+#endif
+    for (; k < half_N; k++) {
         int idx = k * sin_cos_step; // t = 2*M_PI*k/N
         float re = global_cache.cos_vals[idx]; // cos(t)
         float im = -global_cache.sin_vals[idx]; // sin(t)
@@ -3114,7 +4489,8 @@ static void fft(float* in, int N, float* out) {
 
 static void log_mel_spectrogram_worker_thread(int ith, const float * hann, const std::vector<float> & samples,
                                               int n_samples, int frame_size, int frame_step, int n_threads,
-                                              const whisper_filters & filters, whisper_mel & mel) {
+                                              const whisper_filters & filters, const std::vector<int> & filters_range,
+                                              whisper_mel & mel) {
     std::vector<float> fft_in(frame_size * 2, 0.0);
     std::vector<float> fft_out(frame_size * 2 * 2 * 2);
 
@@ -3129,8 +4505,18 @@ static void log_mel_spectrogram_worker_thread(int ith, const float * hann, const
         const int offset = i * frame_step;
 
         // apply Hann window (~10% faster)
-        for (int j = 0; j < std::min(frame_size, n_samples - offset); j++) {
-            fft_in[j] = hann[j] * samples[offset + j];
+        {
+            const int n_frame = std::min(frame_size, n_samples - offset);
+
+            int j = 0;
+#if defined(__wasm_simd128__)
+            for (; j + 4 <= n_frame; j += 4) {
+                wasm_v128_store(fft_in.data() + j, wasm_f32x4_mul(wasm_v128_load(hann + j), wasm_v128_load(samples.data() + offset + j)));
+            }
+#endif
+            for (; j < n_frame; j++) {
+                fft_in[j] = hann[j] * samples[offset + j];
+            }
         }
 
         // fill the rest with zeros
@@ -3143,16 +4529,31 @@ static void log_mel_spectrogram_worker_thread(int ith, const float * hann, const
 
         // Calculate modulus^2 of complex numbers
         // Use pow(fft_out[2 * j + 0], 2) + pow(fft_out[2 * j + 1], 2) causes inference quality problem? Interesting.
-        for (int j = 0; j < n_fft; j++) {
-            fft_out[j] = (fft_out[2 * j + 0] * fft_out[2 * j + 0] + fft_out[2 * j + 1] * fft_out[2 * j + 1]);
+        {
+            int j = 0;
+#if defined(__wasm_simd128__)
+            // in place: the outputs j .. j + 3 are written after the inputs 2*j .. 2*j + 7 are read
+            for (; j + 4 <= n_fft; j += 4) {
+                const v128_t x0 = wasm_v128_load(fft_out.data() + 2 * j + 0);
+                const v128_t x1 = wasm_v128_load(fft_out.data() + 2 * j + 4);
+                const v128_t re = wasm_i32x4_shuffle(x0, x1, 0, 2, 4, 6);
+                const v128_t im = wasm_i32x4_shuffle(x0, x1, 1, 3, 5, 7);
+                wasm_v128_store(fft_out.data() + j, wasm_f32x4_add(wasm_f32x4_mul(re, re), wasm_f32x4_mul(im, im)));
+            }
+#endif
+            for (; j < n_fft; j++) {
+                fft_out[j] = (fft_out[2 * j + 0] * fft_out[2 * j + 0] + fft_out[2 * j + 1] * fft_out[2 * j + 1]);
+            }
         }
 
         // mel spectrogram
         for (int j = 0; j < mel.n_mel; j++) {
             double sum = 0.0;
             // unroll loop (suggested by GH user @lunixbochs)
-            int k = 0;
-            for (k = 0; k < n_fft - 3; k += 4) {
+            // only over the nonzero range of the filter, the groups of 4 stay aligned so that the sum does not change
+            int k = filters_range[2 * j + 0];
+            const int k_end = filters_range[2 * j + 1];
+            for (; k < std::min(k_end, n_fft - 3); k += 4) {
                 sum +=
                         fft_out[k + 0] * filters.data[j * n_fft + k + 0] +
                         fft_out[k + 1] * filters.data[j * n_fft + k + 1] +
@@ -3160,7 +4561,7 @@ static void log_mel_spectrogram_worker_thread(int ith, const float * hann, const
                         fft_out[k + 3] * filters.data[j * n_fft + k + 3];
             }
             // handle n_fft remainder
-            for (; k < n_fft; k++) {
+            for (; k < k_end; k++) {
                 sum += fft_out[k] * filters.data[j * n_fft + k];
             }
             sum = log10(std::max(sum, 1e-10));
@@ -3177,10 +4578,56 @@ static void log_mel_spectrogram_worker_thread(int ith, const float * hann, const
     }
 }
 
+// convert signed 16-bit PCM to float in [-1, 1)
+static void pcm16_to_f32(const int16_t * src, float * dst, int64_t n) {
+    const float scale = 1.0f/32768.0f;
+
+    int64_t i = 0;
+
+#if defined(__AVX2__)
+    const __m256 vscale = _mm256_set1_ps(scale);
+    for (; i + 16 <= n; i += 16) {
+        const __m256i x  = _mm256_loadu_si256((const __m256i *) (src + i));
+        const __m256i lo = _mm256_cvtepi16_epi32(_mm256_castsi256_si128(x));
+        const __m256i hi = _mm256_cvtepi16_epi32(_mm256_extracti128_si256(x, 1));
+        _mm256_storeu_ps(dst + i,     _mm256_mul_ps(_mm256_cvtepi32_ps(lo), vscale));
+        _mm256_storeu_ps(dst + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(hi), vscale));
+    }
+#elif defined(__ARM_NEON)
+    const float32x4_t vscale = vdupq_n_f32(scale);
+    for (; i + 8 <= n; i += 8) {
+        const int16x8_t x = vld1q_s16(src + i);
+        vst1q_f32(dst + i,     vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(x))),  vscale));
+        vst1q_f32(dst + i + 4, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(x))), vscale));
+    }
+#elif defined(__wasm_simd128__)
+    const v128_t vscale = wasm_f32x4_splat(scale);
+    for (; i + 8 <= n; i += 8) {
+        const v128_t x = wasm_v128_load(src + i);
+        wasm_v128_store(dst + i,     wasm_f32x4_mul(wasm_f32x4_convert_i32x4(wasm_i32x4_extend_low_i16x8(x)),  vscale));
+        wasm_v128_store(dst + i + 4, wasm_f32x4_mul(wasm_f32x4_convert_i32x4(wasm_i32x4_extend_high_i16x8(x)), vscale));
+    }
+#endif
+
+    for (; i < n; ++i) {
+        dst[i] = scale*src[i];
+    }
+}
+
+static void log_mel_copy_samples(const float * src, float * dst, int n_samples) {
+    std::copy(src, src + n_samples, dst);
+}
+
+static void log_mel_copy_samples(const int16_t * src, float * dst, int n_samples) {
+    pcm16_to_f32(src, dst, n_samples);
+}
+
 // ref: https://github.com/openai/whisper/blob/main/whisper/audio.py#L110-L157
+// the samples are float or int16 - int16 is converted to float while filling the padded buffer
+template <typename T>
 static bool log_mel_spectrogram(
               whisper_state & wstate,
-              const float * samples,
+              const T * samples,
               const int   n_samples,
               const int   /*sample_rate*/,
               const int   frame_size,
@@ -3203,13 +4650,13 @@ static bool log_mel_spectrogram(
     // Initialize a vector and copy data from C array to it.
     std::vector<float> samples_padded;
     samples_padded.resize(n_samples + stage_1_pad + stage_2_pad * 2);
-    std::copy(samples, samples + n_samples, samples_padded.begin() + stage_2_pad);
+    log_mel_copy_samples(samples, samples_padded.data() + stage_2_pad, n_samples);
 
     // pad 30 seconds of zeros at the end of audio (480,000 samples) + reflective pad 200 samples at the end of audio
     std::fill(samples_padded.begin() + n_samples + stage_2_pad, samples_padded.begin() + n_samples + stage_1_pad + 2 * stage_2_pad, 0);
 
-    // reflective pad 200 samples at the beginning of audio
-    std::reverse_copy(samples + 1, samples + 1 + stage_2_pad, samples_padded.begin());
+    // reflective pad 200 samples at the beginning of audio, from the converted samples
+    std::reverse_copy(samples_padded.begin() + stage_2_pad + 1, samples_padded.begin() + 2*stage_2_pad + 1, samples_padded.begin());
 
     mel.n_mel     = n_mel;
     // https://github.com/pytorch/pytorch/blob/main/aten/src/ATen/native/SpectralOps.cpp#L936
@@ -3219,17 +4666,35 @@ static bool log_mel_spectrogram(
     mel.n_len_org = 1 + (n_samples + stage_2_pad - frame_size) / frame_step;
     mel.data.resize(mel.n_mel * mel.n_len);
 
+    // the range of the frequency bins where each filter is nonzero, widened to multiples of 4 - most of the
+    // triangular filters cover a few bins only
+    std::vector<int> filters_range(2 * n_mel, 0);
+    for (int j = 0; j < n_mel; j++) {
+        int k_begin = filters.n_fft;
+        int k_end   = 0;
+        for (int k = 0; k < filters.n_fft; k++) {
+            if (filters.data[j * filters.n_fft + k] != 0.0f) {
+                k_begin = std::min(k_begin, k);
+                k_end   = k + 1;
+            }
+        }
+        if (k_end > 0) {
+            filters_range[2 * j + 0] = k_begin / 4 * 4;
+            filters_range[2 * j + 1] = std::min(filters.n_fft, (k_end + 3) / 4 * 4);
+        }
+    }
+
     {
         std::vector<std::thread> workers(n_threads - 1);
         for (int iw = 0; iw < n_threads - 1; ++iw) {
             workers[iw] = std::thread(
                     log_mel_spectrogram_worker_thread, iw + 1, hann, std::cref(samples_padded),
                     n_samples + stage_2_pad, frame_size, frame_step, n_threads,
-                    std::cref(filters), std::ref(mel));
+                    std::cref(filters), std::cref(filters_range), std::ref(mel));
         }
 
         // main thread
-        log_mel_spectrogram_worker_thread(0, hann, samples_padded, n_samples + stage_2_pad, frame_size, frame_step, n_threads, filters, mel);
+        log_mel_spectrogram_worker_thread(0, hann, samples_padded, n_samples + stage_2_pad, frame_size, frame_step, n_threads, filters, filters_range, mel);
 
         for (int iw = 0; iw < n_threads - 1; ++iw) {
             workers[iw].join();
@@ -3383,6 +4848,15 @@ static std::string whisper_openvino_get_path_cache(std::string path_bin) {
 #endif
 
 struct whisper_state * whisper_init_state(whisper_context * ctx) {
+    return whisper_init_state_on_node(ctx, -1);
+}
+
+struct whisper_state * whisper_init_state_on_node(whisper_context * ctx, int node) {
+    if (!ctx->numa_nodes.empty() && node >= (int) ctx->numa_nodes.size()) {
+        WHISPER_LOG_ERROR("%s: invalid numa node %d, the context uses %zu nodes\n", __func__, node, ctx->numa_nodes.size());
+        return nullptr;
+    }
+
     whisper_state * state = new whisper_state;
 
     state->backends = whisper_backend_init(ctx->params);
@@ -3392,6 +4866,44 @@ struct whisper_state * whisper_init_state(whisper_context * ctx) {
         return nullptr;
     }
 
+    // bind the CPU backend to the CPUs of the node
+    if (!ctx->numa_nodes.empty()) {
+        state->numa_node = node >= 0 ? node : ctx->numa_next++ % (int) ctx->numa_nodes.size();
+
+        const whisper_numa_node & numa_node = ctx->numa_nodes[state->numa_node];
+
+        ggml_backend_t backend_cpu = state->backends.back();
+        ggml_backend_reg_t reg = ggml_backend_dev_backend_reg(ggml_backend_get_device(backend_cpu));
+
+        auto * threadpool_new_fn = (ggml_threadpool_t (*)(ggml_threadpool_params *))
+            ggml_backend_reg_get_proc_address(reg, "ggml_threadpool_new");
+        auto * set_threadpool_fn = (void (*)(ggml_backend_t, ggml_threadpool_t))
+            ggml_backend_reg_get_proc_address(reg, "ggml_backend_cpu_set_threadpool");
+
+        if (threadpool_new_fn && set_threadpool_fn) {
+            ggml_threadpool_params tpp = ggml_threadpool_params_default(std::min((int) numa_node.cpus.size(), GGML_MAX_N_THREADS));
+            state->threadpool_n_threads = tpp.n_threads;
+            for (int cpu : numa_node.cpus) {
+                if (cpu < GGML_MAX_N_THREADS) {
+                    tpp.cpumask[cpu] = true;
+                }
+            }
+
+            // the threads may move between the CPUs of the node
+            tpp.strict_cpu = false;
+
+            // do not pin the calling thread now - it is bound to the node only while computing (whisper_numa_scope)
+            tpp.paused = true;
+
+            state->threadpool = threadpool_new_fn(&tpp);
+            if (state->threadpool) {
+                set_threadpool_fn(backend_cpu, state->threadpool);
+            }
+        }
+
+        WHISPER_LOG_INFO("%s: numa node    = %d (%zu CPUs)\n", __func__, numa_node.id, numa_node.cpus.size());
+    }
+
     // at this point, we don't know yet how many decoders will be used
     // later during decoding, if more decoders are used, we will recreate the KV cache respectively
     state->kv_self_n_dec = 1;
@@ -3550,6 +5062,10 @@ struct whisper_state * whisper_init_state(whisper_context * ctx) {
         }
 
         WHISPER_LOG_INFO("%s: compute buffer (decode) = %7.2f MB\n", __func__, whisper_sched_size(state->sched_decode) / 1e6);
+
+        // the decoder graph depends on the position in the KV cache, so keep several of them around
+        // the alignment heads tensor of the DTW timestamps is taken from the last built graph, so do not cache with DTW
+        state->sched_decode.n_graphs_max = ctx->params.dtw_token_timestamps ? 0 : WHISPER_MAX_GRAPHS;
     }
 
     return state;
@@ -3620,6 +5136,11 @@ struct whisper_context_params whisper_context_default_params() {
         /*.flash_attn           =*/ false,
         /*.gpu_device           =*/ 0,
 
+        /*.use_mmap             =*/ false,
+        /*.mmap_prefetch        =*/ false,
+
+        /*.numa                 =*/ false,
+
         /*.dtw_token_timestamps =*/ false,
         /*.dtw_aheads_preset    =*/ WHISPER_AHEADS_NONE,
         /*.dtw_n_top            =*/ -1,
@@ -3632,8 +5153,100 @@ struct whisper_context_params whisper_context_default_params() {
     return result;
 }
 
+static struct whisper_context * whisper_init_with_params_no_state_impl(
+        struct whisper_context_params params,
+        std::unique_ptr<whisper_mmap> mapping,
+        const std::function<bool(whisper_context &)> & load);
+
+static std::unique_ptr<whisper_mmap> whisper_mmap_open(const char * path_model, const whisper_context_params & params) {
+    if (!params.use_mmap) {
+        return nullptr;
+    }
+
+    if (!whisper_mmap::SUPPORTED) {
+        WHISPER_LOG_WARN("%s: mmap is not supported on this platform - falling back to regular file reads\n", __func__);
+        return nullptr;
+    }
+
+    try {
+        return std::unique_ptr<whisper_mmap>(new whisper_mmap(path_model, params.mmap_prefetch));
+    } catch (const std::exception & e) {
+        WHISPER_LOG_WARN("%s: %s - falling back to regular file reads\n", __func__, e.what());
+    }
+
+    return nullptr;
+}
+
+static bool whisper_file_is_gguf(const char * path_model) {
+    char magic[4] = {};
+
+    std::ifstream fin(path_model, std::ios::binary);
+    fin.read(magic, sizeof(magic));
+
+    return fin && memcmp(magic, GGUF_MAGIC, sizeof(magic)) == 0;
+}
+
+static struct whisper_context * whisper_init_from_mmap_no_state(std::unique_ptr<whisper_mmap> mapping, struct whisper_context_params params) {
+    whisper_model_loader loader = {};
+
+    loader.context = mapping.get();
+
+    loader.read = [](void * ctx, void * output, size_t read_size) {
+        whisper_mmap * mapping = reinterpret_cast<whisper_mmap *>(ctx);
+
+        size_t size_to_copy = mapping->pos + read_size < mapping->size ? read_size : mapping->size - mapping->pos;
+
+        memcpy(output, mapping->addr + mapping->pos, size_to_copy);
+        mapping->pos += size_to_copy;
+
+        return size_to_copy;
+    };
+
+    loader.eof = [](void * ctx) {
+        whisper_mmap * mapping = reinterpret_cast<whisper_mmap *>(ctx);
+
+        return mapping->pos >= mapping->size;
+    };
+
+    loader.close = [](void * /*ctx*/) { };
+
+    return whisper_init_with_params_no_state_impl(params, std::move(mapping), [&](whisper_context & wctx) {
+        return whisper_model_load(&loader, wctx);
+    });
+}
+
 struct whisper_context * whisper_init_from_file_with_params_no_state(const char * path_model, struct whisper_context_params params) {
     WHISPER_LOG_INFO("%s: loading model from '%s'\n", __func__, path_model);
+
+    std::unique_ptr<whisper_mmap> mapping = whisper_mmap_open(path_model, params);
+    if (!mapping) {
+        params.use_mmap = false;
+    }
+
+    if (whisper_file_is_gguf(path_model)) {
+        std::string fname = path_model;
+
+        auto ctx = whisper_init_with_params_no_state_impl(params, std::move(mapping), [&](whisper_context & wctx) {
+            return whisper_model_load_gguf(fname.c_str(), wctx);
+        });
+
+        if (ctx) {
+            ctx->path_model = path_model;
+        }
+
+        return ctx;
+    }
+
+    if (mapping) {
+        auto ctx = whisper_init_from_mmap_no_state(std::move(mapping), params);
+
+        if (ctx) {
+            ctx->path_model = path_model;
+        }
+
+        return ctx;
+    }
+
 #ifdef _MSC_VER
     // Convert UTF-8 path to wide string (UTF-16) for Windows, resolving character encoding issues.
     std::wstring_convert<std::codecvt_utf8<wchar_t>> converter;
@@ -3714,6 +5327,19 @@ struct whisper_context * whisper_init_from_buffer_with_params_no_state(void * bu
 }
 
 struct whisper_context * whisper_init_with_params_no_state(struct whisper_model_loader * loader, struct whisper_context_params params) {
+    params.use_mmap = false;
+
+    return whisper_init_with_params_no_state_impl(params, nullptr, [&](whisper_context & wctx) {
+        const bool ok = whisper_model_load(loader, wctx);
+        loader->close(loader->context);
+        return ok;
+    });
+}
+
+static struct whisper_context * whisper_init_with_params_no_state_impl(
+        struct whisper_context_params params,
+        std::unique_ptr<whisper_mmap> mapping,
+        const std::function<bool(whisper_context &)> & load) {
     ggml_time_init();
 
     if (params.flash_attn && params.dtw_token_timestamps) {
@@ -3724,21 +5350,48 @@ struct whisper_context * whisper_init_with_params_no_state(struct whisper_model_
     WHISPER_LOG_INFO("%s: use gpu    = %d\n", __func__, params.use_gpu);
     WHISPER_LOG_INFO("%s: flash attn = %d\n", __func__, params.flash_attn);
     WHISPER_LOG_INFO("%s: gpu_device = %d\n", __func__, params.gpu_device);
+    WHISPER_LOG_INFO("%s: use mmap   = %d\n", __func__, mapping != nullptr);
     WHISPER_LOG_INFO("%s: dtw        = %d\n", __func__, params.dtw_token_timestamps);
+    WHISPER_LOG_INFO("%s: numa       = %d\n", __func__, params.numa);
     WHISPER_LOG_INFO("%s: devices    = %zu\n", __func__, ggml_backend_dev_count());
     WHISPER_LOG_INFO("%s: backends   = %zu\n", __func__, ggml_backend_reg_count());
 
     whisper_context * ctx = new whisper_context;
     ctx->params = params;
+    ctx->model.mapping = std::move(mapping);
 
-    if (!whisper_model_load(loader, *ctx)) {
-        loader->close(loader->context);
+    if (params.numa) {
+        ctx->numa_nodes = whisper_numa_topology();
+
+        for (const auto & node : ctx->numa_nodes) {
+            WHISPER_LOG_INFO("%s: numa node %d: %zu CPUs (%d - %d)\n", __func__,
+                    node.id, node.cpus.size(), node.cpus.front(), node.cpus.back());
+        }
+    }
+
+    // in NUMA mode, the weights are loaded from a thread on the first node and copied from threads on the other nodes
+    bool ok = ctx->numa_nodes.empty() ? load(*ctx) : whisper_numa_run(ctx->numa_nodes[0], [&]() { return load(*ctx); });
+
+    for (size_t i = 1; ok && i < ctx->numa_nodes.size(); ++i) {
+        const int64_t t_start_us = ggml_time_us();
+
+        ctx->numa_replicas.emplace_back(new whisper_model);
+
+        ok = whisper_numa_run(ctx->numa_nodes[i], [&]() { return whisper_model_replicate(*ctx, *ctx->numa_replicas.back()); });
+
+        WHISPER_LOG_INFO("%s: numa node %d: replicated the CPU weights in %.2f ms\n", __func__, ctx->numa_nodes[i].id, (ggml_time_us() - t_start_us)/1e3);
+    }
+
+    if (!ok) {
         WHISPER_LOG_ERROR("%s: failed to load model\n", __func__);
-        delete ctx;
+        whisper_free(ctx);
         return nullptr;
     }
 
-    loader->close(loader->context);
+    if (ctx->model.mapping && ctx->model.n_mapped == 0) {
+        // everything was copied out of the mapping - no need to keep it around
+        ctx->model.mapping.reset();
+    }
 
     return ctx;
 }
@@ -3843,6 +5496,15 @@ void whisper_free_state(struct whisper_state * state) {
             ggml_backend_free(backend);
         }
 
+        if (state->threadpool) {
+            ggml_backend_reg_t reg = ggml_backend_dev_backend_reg(ggml_backend_dev_by_type(GGML_BACKEND_DEVICE_TYPE_CPU));
+
+            auto * threadpool_free_fn = (void (*)(ggml_threadpool_t)) ggml_backend_reg_get_proc_address(reg, "ggml_threadpool_free");
+            if (threadpool_free_fn) {
+                threadpool_free_fn(state->threadpool);
+            }
+        }
+
         // [EXPERIMENTAL] Token-level timestamps with DTW
         aheads_masks_free(state->aheads_masks);
 
@@ -3860,6 +5522,20 @@ void whisper_free(struct whisper_context * ctx) {
             ggml_backend_buffer_free(buf);
         }
 
+        for (auto & replica : ctx->numa_replicas) {
+            for (ggml_context * context : replica->ctxs) {
+                ggml_free(context);
+            }
+
+            for (ggml_backend_buffer_t buf : replica->buffers) {
+                ggml_backend_buffer_free(buf);
+            }
+        }
+
+        for (whisper_state * state : ctx->parallel_states) {
+            whisper_free_state(state);
+        }
+
         whisper_free_state(ctx->state);
 
         delete ctx;
@@ -3891,6 +5567,19 @@ int whisper_pcm_to_mel(struct whisper_context * ctx, const float * samples, int
     return whisper_pcm_to_mel_with_state(ctx, ctx->state, samples, n_samples, n_threads);
 }
 
+int whisper_pcm16_to_mel_with_state(struct whisper_context * ctx, struct whisper_state * state, const int16_t * samples, int n_samples, int n_threads) {
+    if (!log_mel_spectrogram(*state, samples, n_samples, WHISPER_SAMPLE_RATE, WHISPER_N_FFT, WHISPER_HOP_LENGTH, ctx->model.filters.n_mel, n_threads, ctx->model.filters, false, state->mel)) {
+        WHISPER_LOG_ERROR("%s: failed to compute mel spectrogram\n", __func__);
+        return -1;
+    }
+
+    return 0;
+}
+
+int whisper_pcm16_to_mel(struct whisper_context * ctx, const int16_t * samples, int n_samples, int n_threads) {
+    return whisper_pcm16_to_mel_with_state(ctx, ctx->state, samples, n_samples, n_threads);
+}
+
 int whisper_set_mel_with_state(
         struct whisper_context * ctx,
           struct whisper_state * state,
@@ -4192,6 +5881,10 @@ int whisper_n_audio_ctx(struct whisper_context * ctx) {
     return ctx->model.hparams.n_audio_ctx;
 }
 
+int whisper_n_numa_nodes(struct whisper_context * ctx) {
+    return ctx->numa_nodes.empty() ? 1 : (int) ctx->numa_nodes.size();
+}
+
 int whisper_is_multilingual(struct whisper_context * ctx) {
     return ctx->vocab.is_multilingual() ? 1 : 0;
 }
@@ -4261,6 +5954,35 @@ struct whisper_timings * whisper_get_timings(struct whisper_context * ctx) {
     return timings;
 }
 
+struct whisper_counters whisper_get_counters_from_state(struct whisper_state * state) {
+    whisper_counters counters = {};
+
+    if (state == nullptr) {
+        return counters;
+    }
+
+    counters.t_mel_us    = state->t_mel_us;
+    counters.t_sample_us = state->t_sample_us;
+    counters.t_encode_us = state->t_encode_us;
+    counters.t_decode_us = state->t_decode_us;
+    counters.t_batchd_us = state->t_batchd_us;
+    counters.t_prompt_us = state->t_prompt_us;
+
+    counters.n_sample = state->n_sample;
+    counters.n_encode = state->n_encode;
+    counters.n_decode = state->n_decode;
+    counters.n_batchd = state->n_batchd;
+    counters.n_prompt = state->n_prompt;
+    counters.n_fail_p = state->n_fail_p;
+    counters.n_fail_h = state->n_fail_h;
+
+    return counters;
+}
+
+struct whisper_counters whisper_get_counters(struct whisper_context * ctx) {
+    return whisper_get_counters_from_state(ctx->state);
+}
+
 void whisper_print_timings(struct whisper_context * ctx) {
     const int64_t t_end_us = ggml_time_us();
 
@@ -4281,24 +6003,45 @@ void whisper_print_timings(struct whisper_context * ctx) {
         WHISPER_LOG_INFO("%s:   decode time = %8.2f ms / %5d runs ( %8.2f ms per run)\n", __func__, 1e-3f * ctx->state->t_decode_us, n_decode, 1e-3f * ctx->state->t_decode_us / n_decode);
         WHISPER_LOG_INFO("%s:   batchd time = %8.2f ms / %5d runs ( %8.2f ms per run)\n", __func__, 1e-3f * ctx->state->t_batchd_us, n_batchd, 1e-3f * ctx->state->t_batchd_us / n_batchd);
         WHISPER_LOG_INFO("%s:   prompt time = %8.2f ms / %5d runs ( %8.2f ms per run)\n", __func__, 1e-3f * ctx->state->t_prompt_us, n_prompt, 1e-3f * ctx->state->t_prompt_us / n_prompt);
+
+        int64_t t_build_us = 0;
+        int32_t n_build    = 0;
+        int32_t n_reuse    = 0;
+        for (const auto * sched : { &ctx->state->sched_conv, &ctx->state->sched_encode, &ctx->state->sched_cross, &ctx->state->sched_decode }) {
+            t_build_us += sched->t_build_us;
+            n_build    += sched->n_build;
+            n_reuse    += sched->n_reuse;
+        }
+
+        WHISPER_LOG_INFO("%s:    graph time = %8.2f ms / %5d runs ( %8.2f ms per run, %5d graphs reused)\n", __func__, 1e-3f * t_build_us, n_build, 1e-3f * t_build_us / std::max(1, n_build), n_reuse);
     }
     WHISPER_LOG_INFO("%s:    total time = %8.2f ms\n", __func__, (t_end_us - ctx->t_start_us)/1000.0f);
 }
 
+static void whisper_reset_timings_state(struct whisper_state * state) {
+    state->t_mel_us = 0;
+    state->t_sample_us = 0;
+    state->t_encode_us = 0;
+    state->t_decode_us = 0;
+    state->t_batchd_us = 0;
+    state->t_prompt_us = 0;
+    state->n_sample = 0;
+    state->n_encode = 0;
+    state->n_decode = 0;
+    state->n_batchd = 0;
+    state->n_prompt = 0;
+
+    for (auto * sched : { &state->sched_conv, &state->sched_encode, &state->sched_cross, &state->sched_decode }) {
+        sched->t_build_us = 0;
+        sched->n_build    = 0;
+        sched->n_reuse    = 0;
+    }
+}
+
 void whisper_reset_timings(struct whisper_context * ctx) {
     ctx->t_start_us = ggml_time_us();
     if (ctx->state != nullptr) {
-        ctx->state->t_mel_us = 0;
-        ctx->state->t_sample_us = 0;
-        ctx->state->t_encode_us = 0;
-        ctx->state->t_decode_us = 0;
-        ctx->state->t_batchd_us = 0;
-        ctx->state->t_prompt_us = 0;
-        ctx->state->n_sample = 0;
-        ctx->state->n_encode = 0;
-        ctx->state->n_decode = 0;
-        ctx->state->n_batchd = 0;
-        ctx->state->n_prompt = 0;
+        whisper_reset_timings_state(ctx->state);
     }
 }
 
@@ -5783,6 +7526,9 @@ int whisper_full_with_state(
 
                     whisper_kv_cache_free(state->kv_self);
 
+                    // the cached decoder graphs reference the old cache
+                    whisper_sched_graph_clear(state->sched_decode);
+
                     // overallocate to workaround KV cache fragmentation issues
                     const int factor = n_decoders_cur > 1 ? n_decoders_cur + 2 : 1;
 
@@ -6519,10 +8265,417 @@ int whisper_full_parallel(
     return ret;
 }
 
+// split [i0, i1) into chunks of at most n_max samples, cutting at the quietest 100 ms of the second half of each chunk
+static std::vector<std::pair<int, int>> whisper_vad_split(const float * samples, int i0, int i1, int n_max) {
+    const int n_frame  = WHISPER_SAMPLE_RATE/100; // 10 ms
+    const int n_smooth = 10;
+
+    const int n_frames = (i1 - i0 + n_frame - 1)/n_frame;
+
+    // energy of the frames, averaged over n_smooth frames
+    std::vector<double> energy(n_frames + 1, 0.0);
+    for (int f = 0; f < n_frames; ++f) {
+        const int s0 = i0 + f*n_frame;
+        const int s1 = std::min(s0 + n_frame, i1);
+
+        double sum = 0.0;
+        for (int i = s0; i < s1; ++i) {
+            sum += samples[i]*samples[i];
+        }
+        energy[f + 1] = energy[f] + sum;
+    }
+
+    std::vector<std::pair<int, int>> chunks;
+
+    int start = 0; // frame
+    while ((n_frames - start)*n_frame > n_max) {
+        const int f_end = start + n_max/n_frame;
+        const int f_beg = start + n_max/(2*n_frame);
+
+        int    f_cut = f_end;
+        double e_min = std::numeric_limits<double>::max();
+
+        for (int f = f_beg; f + n_smooth <= f_end; ++f) {
+            const double e = energy[f + n_smooth] - energy[f];
+            if (e < e_min) {
+                e_min = e;
+                f_cut = f + n_smooth/2;
+            }
+        }
+
+        // always advance, even if n_max is shorter than a frame
+        f_cut = std::max(f_cut, start + 1);
+
+        chunks.emplace_back(i0 + start*n_frame, i0 + f_cut*n_frame);
+        start = f_cut;
+    }
+
+    chunks.emplace_back(i0 + start*n_frame, i1);
+
+    return chunks;
+}
+
+int whisper_full_parallel_vad(
+        struct whisper_context * ctx,
+        struct whisper_full_params params,
+        const float * samples,
+        int n_samples,
+        int n_processors,
+        int max_chunk_ms) {
+    const int64_t t_start_us = ggml_time_us();
+
+    n_processors = std::max(1, n_processors);
+    // shorter chunks leave no room to search for a cut and mostly cost decoder context
+    max_chunk_ms = max_chunk_ms > 0 ? std::min(std::max(max_chunk_ms, 1000), 30000) : 30000;
+
+    const int i0 = std::min(n_samples, (WHISPER_SAMPLE_RATE*params.offset_ms)/1000);
+    const int i1 = params.duration_ms > 0 ? std::min(n_samples, i0 + (int) ((int64_t) WHISPER_SAMPLE_RATE*params.duration_ms/1000)) : n_samples;
+
+    const std::vector<std::pair<int, int>> chunks = whisper_vad_split(samples, i0, i1, (WHISPER_SAMPLE_RATE/1000)*max_chunk_ms);
+
+    const int n_chunks = chunks.size();
+
+    n_processors = std::min(n_processors, n_chunks);
+
+    while ((int) ctx->parallel_states.size() < n_processors) {
+        whisper_state * state = whisper_init_state(ctx);
+        if (state == nullptr) {
+            return -1;
+        }
+        ctx->parallel_states.push_back(state);
+    }
+
+    // each processor owns a contiguous range of chunks of about the same total length and takes them from the front
+    // when it runs out, it steals from the back of the range with the most samples left
+    struct range {
+        std::mutex mutex;
+
+        int begin = 0;
+        int end   = 0;
+    };
+
+    std::vector<range> ranges(n_processors);
+    {
+        int c = 0;
+        for (int p = 0; p < n_processors; ++p) {
+            const int64_t target = i0 + (int64_t) (i1 - i0)*(p + 1)/n_processors;
+
+            ranges[p].begin = c;
+            while (c < n_chunks && (p == n_processors - 1 || chunks[c].second <= target || c == ranges[p].begin)) {
+                ++c;
+            }
+            ranges[p].end = c;
+        }
+    }
+
+    auto samples_left = [&](int p) {
+        return chunks[ranges[p].end - 1].second - chunks[ranges[p].begin].first;
+    };
+
+    auto next_chunk = [&](int p, int & n_stolen) -> int {
+        {
+            std::lock_guard<std::mutex> lock(ranges[p].mutex);
+            if (ranges[p].begin < ranges[p].end) {
+                return ranges[p].begin++;
+            }
+        }
+
+        for (;;) {
+            int victim   = -1;
+            int max_left = 0;
+
+            for (int q = 0; q < n_processors; ++q) {
+                if (q == p) {
+                    continue;
+                }
+                std::lock_guard<std::mutex> lock(ranges[q].mutex);
+                if (ranges[q].begin < ranges[q].end && samples_left(q) > max_left) {
+                    victim   = q;
+                    max_left = samples_left(q);
+                }
+            }
+
+            if (victim < 0) {
+                return -1;
+            }
+
+            std::lock_guard<std::mutex> lock(ranges[victim].mutex);
+            if (ranges[victim].begin < ranges[victim].end) {
+                n_stolen++;
+                return --ranges[victim].end;
+            }
+        }
+    };
+
+    std::vector<std::vector<whisper_segment>> results(n_chunks);
+    std::vector<int> n_done(n_processors, 0);
+    std::vector<int> n_stolen(n_processors, 0);
+
+    std::atomic<int> ret = { 0 };
+
+    auto worker = [&](int p) {
+        whisper_state * state = ctx->parallel_states[p];
+
+        auto params_cur = params;
+
+        params_cur.offset_ms   = 0;
+        params_cur.duration_ms = 0;
+
+        // the chunks of a state are not contiguous
+        params_cur.no_context = true;
+
+        params_cur.print_progress = false;
+        params_cur.print_realtime = false;
+
+        params_cur.new_segment_callback = nullptr;
+        params_cur.new_segment_callback_user_data = nullptr;
+
+        params_cur.progress_callback = nullptr;
+        params_cur.progress_callback_user_data = nullptr;
+
+        for (int c = next_chunk(p, n_stolen[p]); c >= 0 && ret == 0; c = next_chunk(p, n_stolen[p])) {
+            const int n_cur = chunks[c].second - chunks[c].first;
+
+            const int res = whisper_full_with_state(ctx, state, params_cur, samples + chunks[c].first, n_cur);
+            if (res != 0) {
+                ret = res;
+                break;
+            }
+
+            const int64_t offset_t = (int64_t) 100*chunks[c].first/WHISPER_SAMPLE_RATE;
+
+            results[c] = std::move(state->result_all);
+            state->result_all.clear();
+
+            for (auto & result : results[c]) {
+                result.t0 += offset_t;
+                result.t1 += offset_t;
+
+                for (auto & token : result.tokens) {
+                    if (token.t0 >= 0) {
+                        token.t0 += offset_t;
+                    }
+                    if (token.t1 >= 0) {
+                        token.t1 += offset_t;
+                    }
+                }
+            }
+
+            n_done[p]++;
+        }
+    };
+
+    for (whisper_state * state : ctx->parallel_states) {
+        whisper_reset_timings_state(state);
+        state->n_fail_p = 0;
+        state->n_fail_h = 0;
+    }
+
+    {
+        std::vector<std::thread> workers;
+        for (int p = 1; p < n_processors; ++p) {
+            workers.emplace_back(worker, p);
+        }
+
+        worker(0);
+
+        for (auto & w : workers) {
+            w.join();
+        }
+    }
+
+    if (ret != 0) {
+        return ret;
+    }
+
+    // stitch the chunks in timestamp order into the default state
+    whisper_state * state = ctx->state;
+
+    state->result_all.clear();
+    whisper_reset_timings_state(state);
+    state->n_fail_p = 0;
+    state->n_fail_h = 0;
+
+    for (int c = 0; c < n_chunks; ++c) {
+        for (auto & result : results[c]) {
+            // make sure that segments are not overlapping
+            if (!state->result_all.empty()) {
+                result.t0 = std::max(result.t0, state->result_all.back().t1);
+            }
+
+            state->result_all.push_back(std::move(result));
+
+            if (params.new_segment_callback) {
+                params.new_segment_callback(ctx, state, 1, params.new_segment_callback_user_data);
+            }
+        }
+    }
+
+    for (int p = 0; p < n_processors; ++p) {
+        const whisper_state * ps = ctx->parallel_states[p];
+
+        state->t_mel_us    += ps->t_mel_us;
+        state->t_sample_us += ps->t_sample_us;
+        state->t_encode_us += ps->t_encode_us;
+        state->t_decode_us += ps->t_decode_us;
+        state->t_batchd_us += ps->t_batchd_us;
+        state->t_prompt_us += ps->t_prompt_us;
+
+        state->n_sample += ps->n_sample;
+        state->n_encode += ps->n_encode;
+        state->n_decode += ps->n_decode;
+        state->n_batchd += ps->n_batchd;
+        state->n_prompt += ps->n_prompt;
+
+        state->n_fail_p += ps->n_fail_p;
+        state->n_fail_h += ps->n_fail_h;
+    }
+
+    // average the timings
+    state->t_mel_us    /= n_processors;
+    state->t_sample_us /= n_processors;
+    state->t_encode_us /= n_processors;
+    state->t_decode_us /= n_processors;
+
+    WHISPER_LOG_INFO("%s: %d chunks (%.1f s on average) on %d processors in %.2f ms\n", __func__,
+            n_chunks, (double) (i1 - i0)/WHISPER_SAMPLE_RATE/n_chunks, n_processors, (ggml_time_us() - t_start_us)/1000.0);
+    for (int p = 0; p < n_processors; ++p) {
+        WHISPER_LOG_DEBUG("%s: processor %d: %d chunks, %d stolen\n", __func__, p, n_done[p], n_stolen[p]);
+    }
+    for (int c = 1; c < n_chunks; ++c) {
+        WHISPER_LOG_DEBUG("%s: split %d - %s\n", __func__, c, to_timestamp(100*chunks[c].first/WHISPER_SAMPLE_RATE).c_str());
+    }
+
+    return 0;
+}
+
 int whisper_full_n_segments_from_state(struct whisper_state * state) {
     return state->result_all.size();
 }
 
+// touch every page of the CPU weights so that the first request does not pay for the page faults
+// the tensors can reference a read-only file mapping, so the pages are only read
+static size_t whisper_prefault_weights(const whisper_model & model) {
+    const size_t page_size = 4096;
+
+    size_t n_bytes = 0;
+
+    for (const auto & it : model.tensors) {
+        ggml_tensor * tensor = it.second;
+        if (tensor->buffer == nullptr) {
+            continue;
+        }
+
+        // the repacked CPU buffers, mapped or not, are not host buffers, and the buffers from a pointer have no device
+        ggml_backend_dev_t dev = ggml_backend_buft_get_device(ggml_backend_buffer_get_type(tensor->buffer));
+        if (!ggml_backend_buffer_is_host(tensor->buffer) && (dev == nullptr || ggml_backend_dev_type(dev) != GGML_BACKEND_DEVICE_TYPE_CPU)) {
+            continue;
+        }
+
+        const volatile uint8_t * data = (const volatile uint8_t *) tensor->data;
+        const size_t size = ggml_backend_buffer_get_alloc_size(tensor->buffer, tensor);
+
+        uint8_t sum = 0;
+        for (size_t i = 0; i < size; i += page_size) {
+            sum ^= data[i];
+        }
+        sum ^= data[size - 1];
+        (void) sum;
+
+        n_bytes += size;
+    }
+
+    return n_bytes;
+}
+
+int whisper_warmup(
+        struct whisper_context * ctx,
+          struct whisper_state * state,
+    struct whisper_full_params   params) {
+    if (state == nullptr) {
+        state = ctx->state;
+    }
+
+    if (state == nullptr) {
+        WHISPER_LOG_ERROR("%s: no state\n", __func__);
+        return -1;
+    }
+
+    const int64_t t_start_us = ggml_time_us();
+
+    size_t n_prefault = 0;
+    {
+        whisper_numa_scope numa_scope(whisper_state_numa_node(*ctx, *state));
+
+        n_prefault = whisper_prefault_weights(whisper_state_model(*ctx, *state));
+    }
+
+    const int64_t t_prefault_us = ggml_time_us() - t_start_us;
+
+    // the runs below must not produce any output or call back into the application
+    params.print_special    = false;
+    params.print_progress   = false;
+    params.print_realtime   = false;
+    params.print_timestamps = false;
+
+    params.new_segment_callback   = nullptr;
+    params.progress_callback      = nullptr;
+    params.encoder_begin_callback = nullptr;
+    params.abort_callback         = nullptr;
+    params.logits_filter_callback = nullptr;
+
+    params.no_context  = true;
+    params.offset_ms   = 0;
+    params.duration_ms = 0;
+
+    if (params.language == nullptr || strcmp(params.language, "auto") == 0) {
+        params.language = "en";
+    }
+
+    // low-level noise - enough to make the decoder generate a few tokens
+    std::vector<float> pcm(2*WHISPER_SAMPLE_RATE);
+    {
+        std::mt19937 rng(0);
+        std::normal_distribution<float> dist(0.0f, 0.05f);
+        for (auto & s : pcm) {
+            s = dist(rng);
+        }
+    }
+
+    // the first run faults in the compute buffers and the KV cache, and grows the self-attention cache
+    // to the number of decoders used by the sampling strategy, so the second run is a steady-state run
+    int64_t t_run_us[2] = { 0, 0 };
+
+    for (int i = 0; i < 2; ++i) {
+        const int64_t t_run_start_us = ggml_time_us();
+
+        const int ret = whisper_full_with_state(ctx, state, params, pcm.data(), pcm.size());
+        if (ret != 0) {
+            WHISPER_LOG_ERROR("%s: warm-up run %d failed (%d)\n", __func__, i, ret);
+            return ret;
+        }
+
+        t_run_us[i] = ggml_time_us() - t_run_start_us;
+    }
+
+    WHISPER_LOG_INFO("%s: pre-faulted %7.2f MB of weights in %8.2f ms\n", __func__, n_prefault/1e6, t_prefault_us/1000.0f);
+    WHISPER_LOG_INFO("%s: cold run = %8.2f ms, warm run = %8.2f ms (%d encode, %d decode calls)\n",
+            __func__, t_run_us[0]/1000.0f, t_run_us[1]/1000.0f, state->n_encode/2, state->n_decode/2);
+
+    // do not leak the synthetic runs into the results, the sampling and the performance counters
+    state->result_all.clear();
+    state->prompt_past.clear();
+
+    // the other decoders are reseeded by every run
+    state->decoders[0].rng = std::mt19937(0);
+
+    whisper_reset_timings_state(state);
+    state->n_fail_p = 0;
+    state->n_fail_h = 0;
+
+    return 0;
+}
+
 int whisper_full_n_segments(struct whisper_context * ctx) {
     return ctx->state->result_all.size();
 }
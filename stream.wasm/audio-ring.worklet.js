@@ -0,0 +1,67 @@
+// AudioWorklet that writes the microphone samples straight into the audio ring of the wasm heap
+//
+// The main thread posts the SharedArrayBuffer of the heap and the addresses of the ring (Module.get_audio_ring),
+// then every render quantum is copied once into the ring and published with Atomics.store, without a message
+// to the main thread and without a lock. The layout is the one of struct audio_ring in audio_ring.h.
+
+class AudioRingWriter {
+    constructor(ring) {
+        this.write    = new Uint32Array(ring.buffer, ring.write, 1);
+        this.read     = new Uint32Array(ring.buffer, ring.read, 1);
+        this.dropped  = new Uint32Array(ring.buffer, ring.dropped, 1);
+        this.data     = new Float32Array(ring.buffer, ring.data, ring.capacity);
+        this.capacity = ring.capacity;
+    }
+
+    // returns the number of samples written, the rest is dropped when the reader is behind
+    push(samples) {
+        const w = Atomics.load(this.write, 0);
+        const r = Atomics.load(this.read, 0);
+
+        const free = this.capacity - ((w - r) >>> 0);
+        const n = Math.min(samples.length, free);
+
+        if (n < samples.length) {
+            Atomics.add(this.dropped, 0, samples.length - n);
+        }
+
+        const i  = w & (this.capacity - 1);
+        const n0 = Math.min(n, this.capacity - i);
+
+        this.data.set(n0 == samples.length ? samples : samples.subarray(0, n0), i);
+        if (n > n0) {
+            this.data.set(samples.subarray(n0, n), 0);
+        }
+
+        Atomics.store(this.write, 0, (w + n) >>> 0);
+
+        return n;
+    }
+}
+
+if (typeof registerProcessor === 'function') {
+    class AudioRingProcessor extends AudioWorkletProcessor {
+        constructor() {
+            super();
+
+            this.writer = null;
+            this.port.onmessage = (e) => {
+                this.writer = e.data ? new AudioRingWriter(e.data) : null;
+            };
+        }
+
+        process(inputs) {
+            const input = inputs[0];
+            if (this.writer && input && input.length > 0) {
+                this.writer.push(input[0]);
+            }
+            return true;
+        }
+    }
+
+    registerProcessor('audio-ring', AudioRingProcessor);
+}
+
+if (typeof module !== 'undefined') {
+    module.exports = { AudioRingWriter };
+}
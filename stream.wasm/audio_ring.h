@@ -0,0 +1,55 @@
+#ifndef AUDIO_RING_H
+#define AUDIO_RING_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+//
+// Single-producer single-consumer ring of samples in the wasm heap
+//
+// The AudioWorklet writes the samples through typed-array views on the SharedArrayBuffer of the heap
+// and publishes them with Atomics.store on `write` (audio-ring.worklet.js); the worker reads them here.
+// `write` and `read` are free-running counters, so the writer never takes a lock and never waits: when
+// the ring is full it drops the new samples and counts them in `dropped`.
+//
+// The ring must be allocated before the heap grows past the views of the worklet: a grown shared memory
+// keeps its old SharedArrayBuffer valid, but only for the old length.
+//
+
+struct audio_ring {
+    static constexpr uint32_t CAPACITY = 1u << 19; // 32.8 s at 16 kHz, a power of two for the index mask
+
+    alignas(64) std::atomic<uint32_t> write{0};   // samples written, by the worklet
+    alignas(64) std::atomic<uint32_t> read{0};    // samples consumed, by the worker
+    alignas(64) std::atomic<uint32_t> dropped{0}; // samples the worklet dropped because the ring was full
+
+    alignas(64) float data[CAPACITY];
+
+    // samples written and not consumed yet
+    uint32_t available() const noexcept {
+        return write.load(std::memory_order_acquire) - read.load(std::memory_order_relaxed);
+    }
+
+    // append the next n <= available() samples to out and give their space back to the writer
+    void pop(std::vector<float>& out, uint32_t n) {
+        const uint32_t r = read.load(std::memory_order_relaxed);
+        const uint32_t i = r & (CAPACITY - 1);
+        const uint32_t n0 = std::min(n, CAPACITY - i);
+
+        out.insert(out.end(), data + i, data + i + n0);
+        out.insert(out.end(), data, data + (n - n0));
+
+        read.store(r + n, std::memory_order_release);
+    }
+
+    // consume n <= available() samples without reading them
+    void skip(uint32_t n) noexcept {
+        read.store(read.load(std::memory_order_relaxed) + n, std::memory_order_release);
+    }
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "the ring indices are shared with Atomics in JS");
+
+#endif
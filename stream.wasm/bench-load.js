@@ -0,0 +1,168 @@
+// Peak memory of the stream.wasm model load under node
+//
+// usage: node bench-load.js -m MODEL [-l libstream.js] [-o FNAME]
+//
+// loads the model into libstream.js along the two paths, each in a fresh process since a wasm heap never shrinks:
+//
+//   fs       the whole file in a JS buffer, copied into MEMFS with FS_createDataFile and read back by init(), like
+//            index.html before the streamed load
+//   stream   the file read in 1 MB chunks and pushed with load_push as they arrive, read straight into the tensors by
+//            the loader thread (model_stream.h) and taken by init_from_stream()
+//
+// and reports the peak malloc footprint of the wasm heap (heap_stats), the size of the wasm memory and the peak
+// resident set of the process, which also counts the copies held by JS. the results are printed as JSON, one line
+// per path
+
+'use strict';
+
+const fs   = require('fs');
+const path = require('path');
+const { spawnSync } = require('child_process');
+
+const kChunk = 1 << 20;
+const kPaths = [ 'fs', 'stream' ];
+
+// load_status
+const kLoadRunning = 1;
+const kLoadReady   = 2;
+
+function sleep(ms) {
+    return new Promise(resolve => setTimeout(resolve, ms));
+}
+
+async function loadFS(Module, fnameModel) {
+    const buf = fs.readFileSync(fnameModel);
+    Module.FS_createDataFile('/', 'whisper.bin', buf, true, true);
+
+    return { instance: Module.init('whisper.bin'), size: buf.length };
+}
+
+async function loadStream(Module, fnameModel) {
+    const fd = fs.openSync(fnameModel, 'r');
+    const chunk = Buffer.alloc(kChunk);
+
+    Module.load_begin();
+
+    let size = 0;
+    for (;;) {
+        const n = fs.readSync(fd, chunk, 0, kChunk, null);
+        if (n == 0) {
+            break;
+        }
+        size += n;
+
+        // load_push copies the chunk into the heap, so the buffer is reused
+        if (!Module.load_push(chunk.subarray(0, n))) {
+            while (!Module.load_room()) {
+                await sleep(1);
+            }
+        }
+    }
+    fs.closeSync(fd);
+
+    Module.load_end(true);
+    while (Module.load_status() == kLoadRunning) {
+        await sleep(5);
+    }
+
+    return { instance: Module.load_status() == kLoadReady ? Module.init_from_stream() : 0, size: size };
+}
+
+// one path in this process, the result is written to stdout
+function runChild(loadPath, fnameModel, fnameLib) {
+    // the module of node is its exports, the runtime is initialized after the asynchronous compilation
+    const Module = require(fnameLib);
+
+    Module.onRuntimeInitialized = async () => {
+        const t0 = Date.now();
+        const { instance, size } = await (loadPath == 'stream' ? loadStream : loadFS)(Module, fnameModel);
+        const loadMs = Date.now() - t0;
+
+        const heap = Module.heap_stats();
+        const res = {
+            path:          loadPath,
+            model_mb:      size/1e6,
+            ok:            instance > 0,
+            load_ms:       loadMs,
+            heap_peak_mb:  heap.peak/1e6,
+            heap_alloc_mb: heap.allocated/1e6,
+            wasm_mem_mb:   heap.heap_size/1e6,
+            max_rss_mb:    process.resourceUsage().maxRSS/1e3,
+        };
+
+        if (instance > 0) {
+            Module.free(instance);
+        }
+
+        process.stdout.write(JSON.stringify(res) + '\n', () => process.exit(0));
+    };
+}
+
+function main() {
+    let fnameModel = null;
+    let fnameLib   = path.join(__dirname, 'libstream.js');
+    let fnameOut   = null;
+    let child      = null;
+
+    const args = process.argv.slice(2);
+    for (let i = 0; i < args.length; ++i) {
+        if (args[i] == '-m' && i + 1 < args.length) {
+            fnameModel = args[++i];
+        } else if (args[i] == '-l' && i + 1 < args.length) {
+            fnameLib = path.resolve(args[++i]);
+        } else if (args[i] == '-o' && i + 1 < args.length) {
+            fnameOut = args[++i];
+        } else if (args[i] == '--child' && i + 1 < args.length) {
+            child = args[++i];
+        } else {
+            console.error('usage: node bench-load.js -m MODEL [-l libstream.js] [-o FNAME]');
+            process.exit(args[i] == '-h' || args[i] == '--help' ? 0 : 1);
+        }
+    }
+
+    if (!fnameModel) {
+        console.error('usage: node bench-load.js -m MODEL [-l libstream.js] [-o FNAME]');
+        process.exit(1);
+    }
+
+    if (child) {
+        runChild(child, fnameModel, fnameLib);
+        return;
+    }
+
+    const lines = [];
+    const results = {};
+
+    for (const loadPath of kPaths) {
+        const res = spawnSync(process.execPath,
+            [ ...process.execArgv, __filename, '--child', loadPath, '-m', fnameModel, '-l', fnameLib ],
+            { stdio: [ 'ignore', 'pipe', 'pipe' ], encoding: 'utf8', maxBuffer: 64 << 20 });
+
+        // libstream prints to stdout too
+        const line = res.stdout.split('\n').find(l => l.startsWith('{"path"'));
+        if (res.status != 0 || !line) {
+            console.error(res.stderr);
+            console.error(`${loadPath}: failed with status ${res.status}`);
+            process.exit(1);
+        }
+
+        results[loadPath] = JSON.parse(line);
+        lines.push(line);
+
+        const r = results[loadPath];
+        console.error(`${loadPath.padEnd(6)}: heap peak ${r.heap_peak_mb.toFixed(1)} MB, ` +
+                      `max rss ${r.max_rss_mb.toFixed(1)} MB for a ${r.model_mb.toFixed(1)} MB model, ` +
+                      `load ${r.load_ms} ms`);
+    }
+
+    console.error(`stream: heap peak -${(results.fs.heap_peak_mb - results.stream.heap_peak_mb).toFixed(1)} MB, ` +
+                  `max rss -${(results.fs.max_rss_mb - results.stream.max_rss_mb).toFixed(1)} MB`);
+
+    if (fnameOut) {
+        fs.writeFileSync(fnameOut, lines.join('\n') + '\n');
+    } else {
+        console.log(lines.join('\n'));
+    }
+}
+
+main();
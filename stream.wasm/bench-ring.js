@@ -0,0 +1,312 @@
+// Headless benchmark of the audio ingest of stream.wasm
+//
+// usage: node bench-ring.js [--minutes N] [-o FNAME]
+//
+// feeds the same synthetic microphone audio, 128-sample render quanta at 16 kHz, through the two ingest paths and
+// measures the time spent on the producer side and the copies made through JS, with a worker thread consuming the
+// audio like stream_main:
+//
+//   set_audio   the recording since the last restart is concatenated every 5 s and copied into the heap under the
+//               mutex of the worker, which copies the window out again (the MediaRecorder decoding is not counted)
+//   ring        every quantum is written into the SPSC ring of audio_ring.h with AudioRingWriter, the same code as
+//               the AudioWorklet, and the worker reads the new samples with Atomics
+//
+// the results are printed as JSON, one line per path. the audio is as fast as the producer, not real time
+
+'use strict';
+
+const { Worker, isMainThread, parentPort, workerData } = require('worker_threads');
+const { AudioRingWriter } = require('./audio-ring.worklet.js');
+
+const kSampleRate    = 16000;
+const kQuantum       = 128;
+const kInterval      = 5*kSampleRate;  // kIntervalAudio_ms of the MediaRecorder path
+const kRestart       = 60*kSampleRate; // kRestartRecording_s
+const kStep          = 3*kSampleRate;  // STEP_SAMPLES
+const kWindow        = 5*kSampleRate;  // WINDOW_SAMPLES
+const kMinAudio      = 1024;           // MIN_AUDIO_SAMPLES of the set_audio path
+const kRingCapacity  = 1 << 19;        // audio_ring::CAPACITY
+
+// heap layout of the set_audio path: mutex, size of pcmf32, done, then the samples
+const kHeapSamples   = 2*kRestart;
+
+// heap layout of the ring: write, read, dropped and done on their own 64-byte lines, then the samples
+const kRingWrite     = 0;
+const kRingRead      = 64;
+const kRingDropped   = 128;
+const kRingDone      = 192;
+const kRingData      = 256;
+
+function percentile(v, p) {
+    if (v.length == 0) {
+        return 0.0;
+    }
+    const s = Float64Array.from(v).sort();
+    const k = Math.ceil(p*s.length);
+    return s[Math.min(s.length - 1, Math.max(0, k - 1))];
+}
+
+function nowUs() {
+    return Number(process.hrtime.bigint())/1000;
+}
+
+//
+// consumers, in the worker thread
+//
+
+function consumeSetAudio(sab) {
+    const hdr  = new Int32Array(sab, 0, 4);
+    const pcm  = new Float32Array(sab, 16, kHeapSamples);
+    const win  = new Float32Array(kWindow);
+
+    let nWindows = 0;
+    let nCopied  = 0;
+    let tLockUs  = 0;
+
+    for (;;) {
+        const t0 = nowUs();
+        while (Atomics.compareExchange(hdr, 0, 0, 1) != 0) {
+            Atomics.wait(hdr, 0, 1, 1);
+        }
+        tLockUs += nowUs() - t0;
+
+        const size = hdr[1];
+        if (size >= kMinAudio) {
+            // the window is the newest audio, erased from pcmf32
+            const n = Math.min(size, kWindow);
+            win.set(pcm.subarray(size - n, size), 0);
+            hdr[1] = size - n;
+
+            nWindows++;
+            nCopied += n;
+        }
+
+        Atomics.store(hdr, 0, 0);
+        Atomics.notify(hdr, 0);
+
+        if (size < kMinAudio) {
+            if (Atomics.load(hdr, 2)) {
+                break;
+            }
+            Atomics.wait(hdr, 2, 0, 10);
+        }
+    }
+
+    return { windows: nWindows, consumer_copied: nCopied, consumer_lock_ms: tLockUs/1000 };
+}
+
+function consumeRing(sab) {
+    const write = new Uint32Array(sab, kRingWrite, 1);
+    const wait  = new Int32Array(sab, kRingWrite, 1);
+    const read  = new Uint32Array(sab, kRingRead, 1);
+    const done  = new Int32Array(sab, kRingDone, 1);
+    const data  = new Float32Array(sab, kRingData, kRingCapacity);
+    const win   = new Float32Array(kWindow);
+
+    let nWindows = 0;
+    let nCopied  = 0;
+
+    for (;;) {
+        const w = Atomics.load(write, 0);
+        const r = read[0];
+        const n = (w - r) >>> 0;
+
+        if (n < kStep) {
+            if (Atomics.load(done, 0)) {
+                break;
+            }
+            Atomics.wait(wait, 0, w | 0, 1);
+            continue;
+        }
+
+        // audio_ring::pop of the newest window
+        const m  = Math.min(n, kWindow);
+        const r0 = (r + n - m) >>> 0;
+        const i  = r0 & (kRingCapacity - 1);
+        const n0 = Math.min(m, kRingCapacity - i);
+
+        win.set(data.subarray(i, i + n0), 0);
+        if (m > n0) {
+            win.set(data.subarray(0, m - n0), n0);
+        }
+
+        Atomics.store(read, 0, (r + n) >>> 0);
+
+        nWindows++;
+        nCopied += m;
+    }
+
+    return { windows: nWindows, consumer_copied: nCopied, consumer_lock_ms: 0 };
+}
+
+//
+// producers, in the main thread
+//
+
+function makeQuanta(nSamples) {
+    // a 440 Hz tone with noise, the content does not matter for the copies
+    const audio = new Float32Array(nSamples);
+    for (let i = 0; i < nSamples; ++i) {
+        audio[i] = 0.1*Math.sin(2*Math.PI*440*i/kSampleRate) + 0.01*(Math.random() - 0.5);
+    }
+    return audio;
+}
+
+function produceSetAudio(sab, audio) {
+    const hdr = new Int32Array(sab, 0, 4);
+    const pcm = new Float32Array(sab, 16, kHeapSamples);
+
+    const tCall = [];
+    let nCopied = 0;
+
+    let audio0 = null;
+    let recStart = 0;
+
+    for (let pos = kInterval; pos <= audio.length; pos += kInterval) {
+        // the decoded recording since the last restart, made by the browser
+        const rec = audio.subarray(recStart, pos);
+
+        const t0 = nowUs();
+
+        const audioAll = new Float32Array(audio0 == null ? rec.length : audio0.length + rec.length);
+        if (audio0 != null) {
+            audioAll.set(audio0, 0);
+        }
+        audioAll.set(rec, audio0 == null ? 0 : audio0.length);
+
+        // Module.set_audio: resize and copy through a view, under the mutex
+        while (Atomics.compareExchange(hdr, 0, 0, 1) != 0) {
+            Atomics.wait(hdr, 0, 1);
+        }
+        pcm.set(audioAll.subarray(0, Math.min(audioAll.length, kHeapSamples)), 0);
+        hdr[1] = Math.min(audioAll.length, kHeapSamples);
+        Atomics.store(hdr, 0, 0);
+        Atomics.notify(hdr, 0);
+
+        tCall.push(nowUs() - t0);
+        nCopied += 2*audioAll.length;
+
+        if (rec.length > kRestart) {
+            audio0 = rec;
+            recStart = pos;
+        }
+    }
+
+    Atomics.store(hdr, 2, 1);
+    Atomics.notify(hdr, 2);
+
+    return { calls: tCall, producer_copied: nCopied, dropped: 0 };
+}
+
+function produceRing(sab, audio) {
+    const writer = new AudioRingWriter({
+        buffer:   sab,
+        write:    kRingWrite,
+        read:     kRingRead,
+        dropped:  kRingDropped,
+        data:     kRingData,
+        capacity: kRingCapacity,
+    });
+    const wake = new Int32Array(sab, kRingWrite, 1);
+    const done = new Int32Array(sab, kRingDone, 1);
+
+    const tCall = [];
+    let nCopied = 0;
+
+    for (let pos = 0; pos + kQuantum <= audio.length; pos += kQuantum) {
+        const quantum = audio.subarray(pos, pos + kQuantum);
+
+        // keep the reader within the capacity, the audio is faster than real time
+        while (((Atomics.load(writer.write, 0) - Atomics.load(writer.read, 0)) >>> 0) > kRingCapacity - kQuantum) {
+            Atomics.notify(wake, 0);
+        }
+
+        const t0 = nowUs();
+        writer.push(quantum);
+        tCall.push(nowUs() - t0);
+
+        nCopied += kQuantum;
+
+        if ((pos/kQuantum) % 64 == 0) {
+            Atomics.notify(wake, 0);
+        }
+    }
+
+    Atomics.store(done, 0, 1);
+    Atomics.notify(wake, 0);
+
+    return { calls: tCall, producer_copied: nCopied, dropped: Atomics.load(writer.dropped, 0) };
+}
+
+//
+// main
+//
+
+if (!isMainThread) {
+    const res = workerData.path == 'ring' ? consumeRing(workerData.sab) : consumeSetAudio(workerData.sab);
+    parentPort.postMessage(res);
+} else {
+    let minutes = 10;
+    let fnameOut = null;
+
+    const args = process.argv.slice(2);
+    for (let i = 0; i < args.length; ++i) {
+        if (args[i] == '--minutes' && i + 1 < args.length) {
+            minutes = Math.max(1, parseInt(args[++i]));
+        } else if (args[i] == '-o' && i + 1 < args.length) {
+            fnameOut = args[++i];
+        } else {
+            console.error('usage: node bench-ring.js [--minutes N] [-o FNAME]');
+            process.exit(args[i] == '-h' || args[i] == '--help' ? 0 : 1);
+        }
+    }
+
+    const audio = makeQuanta(minutes*60*kSampleRate);
+
+    const run = (path) => new Promise((resolve, reject) => {
+        const sab = new SharedArrayBuffer(path == 'ring' ? kRingData + 4*kRingCapacity : 16 + 4*kHeapSamples);
+
+        const worker = new Worker(__filename, { workerData: { path, sab } });
+        worker.on('error', reject);
+
+        const t0 = nowUs();
+        const prod = path == 'ring' ? produceRing(sab, audio) : produceSetAudio(sab, audio);
+        const tProducerUs = prod.calls.reduce((a, b) => a + b, 0);
+
+        worker.on('message', (cons) => {
+            resolve({
+                path:              path,
+                audio_s:           audio.length/kSampleRate,
+                calls:             prod.calls.length,
+                producer_ms:       tProducerUs/1000,
+                producer_ms_per_audio_min: tProducerUs/1000/minutes,
+                call_p50_us:       percentile(prod.calls, 0.50),
+                call_p99_us:       percentile(prod.calls, 0.99),
+                call_max_us:       percentile(prod.calls, 1.00),
+                producer_copied:   prod.producer_copied,
+                consumer_copied:   cons.consumer_copied,
+                consumer_lock_ms:  cons.consumer_lock_ms,
+                windows:           cons.windows,
+                dropped:           prod.dropped,
+                wall_ms:           (nowUs() - t0)/1000,
+            });
+        });
+    });
+
+    (async () => {
+        const lines = [];
+        for (const path of ['set_audio', 'ring']) {
+            const res = await run(path);
+            lines.push(JSON.stringify(res));
+            console.error(`${path}: ${res.producer_ms_per_audio_min.toFixed(3)} ms of producer time per audio minute, ` +
+                          `call p99 ${res.call_p99_us.toFixed(1)} us, max ${res.call_max_us.toFixed(1)} us, ` +
+                          `${(res.producer_copied/res.audio_s/kSampleRate).toFixed(2)} samples copied in JS per sample`);
+        }
+
+        if (fnameOut) {
+            require('fs').writeFileSync(fnameOut, lines.join('\n') + '\n');
+        } else {
+            console.log(lines.join('\n'));
+        }
+    })();
+}
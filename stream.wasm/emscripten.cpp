@@ -1,10 +1,16 @@
 #include "ggml.h"
 #include "whisper.h"
 #include "hyni_merge.h"
+#include "audio_ring.h"
+#include "model_stream.h"
 
 #include <emscripten.h>
 #include <emscripten/bind.h>
+#include <emscripten/heap.h>
 
+#include <malloc.h>
+
+#include <algorithm>
 #include <atomic>
 #include <cmath>
 #include <mutex>
@@ -13,34 +19,61 @@
 #include <vector>
 
 // Constants
-constexpr int N_THREAD = 8;
+constexpr int N_THREAD = 8;               // threads of all the streams together, PTHREAD_POOL_SIZE
 constexpr size_t MAX_CONTEXTS = 4;
-constexpr size_t MIN_AUDIO_SAMPLES = 1024;
+constexpr int64_t STEP_SAMPLES = 3*WHISPER_SAMPLE_RATE;   // new audio before the next window
 constexpr int64_t WINDOW_SAMPLES = 5*WHISPER_SAMPLE_RATE;
 constexpr int STATUS_UPDATE_INTERVAL_MS = 100;
 
-// Global state
-struct WhisperState {
-    std::vector<whisper_context*> contexts;
-    std::mutex mutex;
+// load_status
+constexpr int LOAD_IDLE = 0;
+constexpr int LOAD_RUNNING = 1;
+constexpr int LOAD_READY = 2;
+constexpr int LOAD_FAILED = -1;
+
+// One transcription stream: its own whisper_state on the shared weights, audio ring, worker, transcript
+// and share of the thread budget. The worker frees the state and clears in_use when it stops, the slot
+// is then reused by the next init.
+struct StreamContext {
+    whisper_state* state = nullptr;
     std::thread worker;
+    std::atomic<bool> in_use{false};
     std::atomic<bool> running{false};
+    std::atomic<int> n_threads{1};
+
+    std::mutex mutex; // status and transcript
     std::string status;
     std::string status_forced;
-    std::string transcribed;
-    std::vector<float> pcmf32;
-    std::string merged_transcription;
+    hyni::HyniIncrementalMerge merged_transcription;
+
+    // written by the AudioWorklet of the stream, read by its worker
+    audio_ring ring;
+};
+
+// Global state
+struct WhisperState {
+    // the weights, loaded once and shared by the streams
+    whisper_context* model = nullptr;
+
+    StreamContext streams[MAX_CONTEXTS];
+    std::mutex mutex_threads; // stream_balance_threads
 
-    WhisperState() : contexts(MAX_CONTEXTS, nullptr) {}
+    // the model streamed by load_push, until init_from_stream takes it
+    std::thread loader;
+    std::atomic<int> load_status{LOAD_IDLE};
+    whisper_context* model_loaded = nullptr;
 };
 
 static WhisperState g_state;
 
+// written by load_push, read by the loader thread
+static model_stream g_model_stream;
+
 // Helper function to initialize whisper parameters
 whisper_full_params get_whisper_params() {
     whisper_full_params wparams = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
 
-    wparams.n_threads = std::min(N_THREAD, (int)std::thread::hardware_concurrency());
+    wparams.n_threads = 1; // StreamContext::n_threads
     wparams.offset_ms = 0;
     wparams.translate = false;
     wparams.no_context = true;
@@ -61,47 +94,80 @@ whisper_full_params get_whisper_params() {
     return wparams;
 }
 
-void stream_set_status(const std::string& status) {
-    std::lock_guard<std::mutex> lock(g_state.mutex);
-    g_state.status = status;
+void stream_set_status(StreamContext& sc, const std::string& status) {
+    std::lock_guard<std::mutex> lock(sc.mutex);
+    sc.status = status;
+}
+
+// splits the thread budget evenly between the streams in use, so that the workers and their ggml and mel
+// threads together never need more than N_THREAD threads of the pool
+void stream_balance_threads() {
+    std::lock_guard<std::mutex> lock(g_state.mutex_threads);
+
+    const int n_budget = std::max(1, std::min(N_THREAD, (int) std::thread::hardware_concurrency()));
+
+    int n_streams = 0;
+    for (auto& sc : g_state.streams) {
+        n_streams += sc.in_use ? 1 : 0;
+    }
+
+    for (auto& sc : g_state.streams) {
+        sc.n_threads = std::max(1, n_budget/std::max(1, n_streams));
+    }
 }
 
 void stream_main(size_t index) {
+    auto& sc = g_state.streams[index];
     auto wparams = get_whisper_params();
-    printf("stream: using %d threads\n", wparams.n_threads);
 
-    auto& ctx = g_state.contexts[index];
     std::vector<float> pcmf32_window;
     pcmf32_window.reserve(WINDOW_SAMPLES);
 
     auto last_status_update = std::chrono::steady_clock::now();
 
-    while (g_state.running) {
+    while (sc.running) {
         // Throttle status updates
         auto now = std::chrono::steady_clock::now();
         if (std::chrono::duration_cast<std::chrono::milliseconds>(now - last_status_update).count() > STATUS_UPDATE_INTERVAL_MS) {
-            stream_set_status("waiting for audio ...");
+            stream_set_status(sc, "waiting for audio ...");
             last_status_update = now;
         }
 
         {
-            std::unique_lock<std::mutex> lock(g_state.mutex);
-            if (g_state.pcmf32.size() < MIN_AUDIO_SAMPLES) {
-                lock.unlock();
+            uint32_t n_new = sc.ring.available();
+            if (n_new < STEP_SAMPLES) {
                 std::this_thread::sleep_for(std::chrono::milliseconds(10));
                 continue;
             }
 
-            // Efficient window extraction
-            size_t copy_size = std::min((int64_t)g_state.pcmf32.size(), WINDOW_SAMPLES);
-            pcmf32_window.assign(g_state.pcmf32.end() - copy_size, g_state.pcmf32.end());
-            g_state.pcmf32.erase(g_state.pcmf32.end() - copy_size, g_state.pcmf32.end());
+            if (const uint32_t n_dropped = sc.ring.dropped.exchange(0, std::memory_order_relaxed)) {
+                printf("stream %zu: audio ring full, %u samples dropped\n", index + 1, n_dropped);
+            }
+
+            // fell behind: only the newest window is transcribed
+            if (n_new > WINDOW_SAMPLES) {
+                sc.ring.skip(n_new - WINDOW_SAMPLES);
+                n_new = WINDOW_SAMPLES;
+                pcmf32_window.clear();
+            }
+
+            // slide the window over the new audio
+            const size_t n_keep = std::min(pcmf32_window.size(), (size_t) (WINDOW_SAMPLES - n_new));
+            pcmf32_window.erase(pcmf32_window.begin(), pcmf32_window.end() - n_keep);
+            sc.ring.pop(pcmf32_window, n_new);
         }
 
         {
-            stream_set_status("running whisper ...");
+            stream_set_status(sc, "running whisper ...");
+
+            // the share changes when other streams start or stop
+            const int n_threads = sc.n_threads;
+            if (n_threads != wparams.n_threads) {
+                printf("stream %zu: using %d threads\n", index + 1, n_threads);
+                wparams.n_threads = n_threads;
+            }
 
-            int ret = whisper_full(ctx, wparams, pcmf32_window.data(), pcmf32_window.size());
+            int ret = whisper_full_with_state(g_state.model, sc.state, wparams, pcmf32_window.data(), pcmf32_window.size());
             if (ret != 0) {
                 printf("whisper_full() failed: %d\n", ret);
                 break;
@@ -110,89 +176,255 @@ void stream_main(size_t index) {
 
         {
             std::string current_segment;
-            const int n_segments = whisper_full_n_segments(ctx);
+            const int n_segments = whisper_full_n_segments_from_state(sc.state);
             if (n_segments > 0) {
-                current_segment = whisper_full_get_segment_text(ctx, n_segments - 1);
+                current_segment = whisper_full_get_segment_text_from_state(sc.state, n_segments - 1);
 
-                std::lock_guard<std::mutex> lock(g_state.mutex);
+                std::lock_guard<std::mutex> lock(sc.mutex);
                 // Merge with previous transcription
-                g_state.merged_transcription = hyni::HyniMerge::mergeStrings(
-                    g_state.merged_transcription,
-                    current_segment
-                );
+                sc.merged_transcription.append(current_segment);
 
-                printf("%s\n", g_state.merged_transcription.c_str());
+                printf("stream %zu: %s\n", index + 1, sc.merged_transcription.text().c_str());
             }
         }
     }
 
-    if (index < g_state.contexts.size() && g_state.contexts[index]) {
-        whisper_free(g_state.contexts[index]);
-        g_state.contexts[index] = nullptr;
+    whisper_free_state(sc.state);
+    sc.state = nullptr;
+    sc.running = false;
+    sc.in_use = false;
+
+    stream_balance_threads();
+}
+
+// starts a stream on the shared model in a free slot, returns the instance or 0
+size_t stream_open() {
+    for (size_t i = 0; i < MAX_CONTEXTS; ++i) {
+        auto& sc = g_state.streams[i];
+        if (sc.in_use) {
+            continue;
+        }
+
+        // the worker of the previous stream of the slot has cleared in_use as its last step
+        if (sc.worker.joinable()) {
+            sc.worker.join();
+        }
+
+        sc.state = whisper_init_state(g_state.model);
+        if (!sc.state) {
+            printf("stream: failed to initialize the whisper state\n");
+            return 0;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(sc.mutex);
+            sc.status.clear();
+            sc.status_forced.clear();
+            sc.merged_transcription.clear();
+        }
+
+        // audio left over from the previous stream of the slot
+        sc.ring.skip(sc.ring.available());
+        sc.ring.dropped = 0;
+
+        sc.in_use = true;
+        sc.running = true;
+        stream_balance_threads();
+
+        sc.worker = std::thread([i]() { stream_main(i); });
+        return i + 1;
+    }
+
+    return 0;
+}
+
+bool stream_any_in_use() {
+    return std::any_of(std::begin(g_state.streams), std::end(g_state.streams), [](const StreamContext& sc) { return sc.in_use.load(); });
+}
+
+// the stream of an instance returned by init, or nullptr
+StreamContext* stream_get(size_t index) {
+    --index;
+    if (index >= MAX_CONTEXTS || !g_state.streams[index].in_use) {
+        return nullptr;
+    }
+    return &g_state.streams[index];
+}
+
+void load_cancel() {
+    g_model_stream.cancel();
+    if (g_state.loader.joinable()) {
+        g_state.loader.join();
+    }
+    if (g_state.model_loaded) {
+        whisper_free(g_state.model_loaded);
+        g_state.model_loaded = nullptr;
     }
+    g_state.load_status = LOAD_IDLE;
 }
 
 EMSCRIPTEN_BINDINGS(stream) {
+    // a new stream, the first one loads the model from a file of the virtual FS (e.g. FS_createDataFile) and the
+    // next ones share it
     emscripten::function("init", emscripten::optional_override([](const std::string& path_model) {
-        for (size_t i = 0; i < g_state.contexts.size(); ++i) {
-            if (!g_state.contexts[i]) {
-                g_state.contexts[i] = whisper_init_from_file_with_params(path_model.c_str(), whisper_context_default_params());
-                if (g_state.contexts[i]) {
-                    g_state.running = true;
-                    if (g_state.worker.joinable()) {
-                        g_state.worker.join();
-                    }
-                    g_state.worker = std::thread([i]() { stream_main(i); });
-                    return i + 1;
-                }
+        if (!g_state.model) {
+            g_state.model = whisper_init_from_file_with_params_no_state(path_model.c_str(), whisper_context_default_params());
+            if (!g_state.model) {
+                return (size_t)0;
+            }
+        }
+
+        return stream_open();
+    }));
+
+    // a new stream on the model of load_begin/load_push/load_end, or on the model already loaded. a new model
+    // replaces the old one once no stream uses it
+    emscripten::function("init_from_stream", emscripten::optional_override([]() {
+        if (g_state.load_status == LOAD_READY) {
+            if (g_state.model && stream_any_in_use()) {
+                printf("stream: a new model cannot be used while streams run on the current one\n");
                 return (size_t)0;
             }
+
+            g_state.loader.join();
+            g_state.load_status = LOAD_IDLE;
+
+            if (g_state.model) {
+                whisper_free(g_state.model);
+            }
+            g_state.model = g_state.model_loaded;
+            g_state.model_loaded = nullptr;
+        }
+
+        return g_state.model ? stream_open() : (size_t)0;
+    }));
+
+    // streamed model load: the loader thread reads the pushed chunks straight into the tensors, so the heap holds
+    // at most model_stream::MAX_QUEUED bytes of the file besides the model
+    emscripten::function("load_begin", emscripten::optional_override([]() {
+        load_cancel();
+        g_model_stream.reset();
+
+        g_state.load_status = LOAD_RUNNING;
+        g_state.loader = std::thread([]() {
+            whisper_model_loader loader = g_model_stream.loader();
+            whisper_context* ctx = whisper_init_with_params_no_state(&loader, whisper_context_default_params());
+            if (!ctx) {
+                // drop the rest of the file, load_push keeps returning true
+                g_model_stream.cancel();
+            }
+
+            g_state.model_loaded = ctx;
+            g_state.load_status = ctx ? LOAD_READY : LOAD_FAILED;
+        });
+    }));
+
+    // copies the Uint8Array chunk into the heap, returns false when the caller should wait for load_room
+    emscripten::function("load_push", emscripten::optional_override([](const emscripten::val& chunk) {
+        const size_t n = chunk["length"].as<size_t>();
+
+        std::vector<uint8_t> buf(n);
+        emscripten::val(emscripten::typed_memory_view(n, buf.data())).call<void>("set", chunk);
+
+        g_model_stream.push(std::move(buf));
+        return g_model_stream.room();
+    }));
+
+    emscripten::function("load_room", emscripten::optional_override([]() {
+        return g_model_stream.room();
+    }));
+
+    // ok = false when the download failed or was cancelled
+    emscripten::function("load_end", emscripten::optional_override([](bool ok) {
+        if (ok) {
+            g_model_stream.finish();
+        } else {
+            load_cancel();
         }
-        return (size_t)0;
     }));
 
+    emscripten::function("load_status", emscripten::optional_override([]() {
+        return g_state.load_status.load();
+    }));
+
+    // bytes of the model file read by the loader
+    emscripten::function("load_consumed", emscripten::optional_override([]() {
+        return g_model_stream.consumed();
+    }));
+
+    // malloc footprint of the heap, now and at its peak, for bench-load.js
+    emscripten::function("heap_stats", emscripten::optional_override([]() {
+        const struct mallinfo mi = mallinfo();
+
+        emscripten::val stats = emscripten::val::object();
+        stats.set("allocated", (double) mi.uordblks);
+        stats.set("footprint", (double) mi.arena);
+        stats.set("peak",      (double) mi.usmblks);
+        stats.set("heap_size", (double) emscripten_get_heap_size());
+        return stats;
+    }));
+
+    // stops the stream, its worker frees the state after the current window
     emscripten::function("free", emscripten::optional_override([](size_t index) {
-        g_state.running = false;
+        if (StreamContext* sc = stream_get(index)) {
+            sc->running = false;
+        }
     }));
 
-    emscripten::function("set_audio", emscripten::optional_override([](size_t index, const emscripten::val& audio) {
-        --index;
-        if (index >= g_state.contexts.size() || !g_state.contexts[index]) {
-            return -1;
+    // addresses of the audio ring of the stream in the heap, posted to its AudioWorklet with the buffer of the heap
+    emscripten::function("get_audio_ring", emscripten::optional_override([](size_t index) {
+        StreamContext* sc = stream_get(index);
+        if (!sc) {
+            return emscripten::val::null();
         }
 
-        std::lock_guard<std::mutex> lock(g_state.mutex);
-        const int n = audio["length"].as<int>();
-        g_state.pcmf32.resize(n);
+        emscripten::val ring = emscripten::val::object();
+        ring.set("buffer",   emscripten::val::module_property("HEAPU8")["buffer"]);
+        ring.set("write",    reinterpret_cast<uintptr_t>(&sc->ring.write));
+        ring.set("read",     reinterpret_cast<uintptr_t>(&sc->ring.read));
+        ring.set("dropped",  reinterpret_cast<uintptr_t>(&sc->ring.dropped));
+        ring.set("data",     reinterpret_cast<uintptr_t>(sc->ring.data));
+        ring.set("capacity", audio_ring::CAPACITY);
+        return ring;
+    }));
 
-        emscripten::val heap = emscripten::val::module_property("HEAPU8");
-        emscripten::val memoryView = audio["constructor"].new_(
-            heap["buffer"],
-            reinterpret_cast<uintptr_t>(g_state.pcmf32.data()),
-                                                               n
-        );
-        memoryView.call<void>("set", audio);
-        return 0;
+    emscripten::function("get_transcribed", emscripten::optional_override([](size_t index) {
+        StreamContext* sc = stream_get(index);
+        if (!sc) {
+            return std::string();
+        }
+
+        std::lock_guard<std::mutex> lock(sc->mutex);
+        return sc->merged_transcription.text();
     }));
 
-    emscripten::function("get_transcribed", emscripten::optional_override([]() {
-        std::lock_guard<std::mutex> lock(g_state.mutex);
-        return g_state.merged_transcription;
+    emscripten::function("get_status", emscripten::optional_override([](size_t index) {
+        StreamContext* sc = stream_get(index);
+        if (!sc) {
+            return std::string("not running");
+        }
+
+        std::lock_guard<std::mutex> lock(sc->mutex);
+        return sc->status_forced.empty() ? sc->status : sc->status_forced;
     }));
 
-    emscripten::function("get_status", emscripten::optional_override([]() {
-        std::lock_guard<std::mutex> lock(g_state.mutex);
-        return g_state.status_forced.empty() ? g_state.status : g_state.status_forced;
+    emscripten::function("set_status", emscripten::optional_override([](size_t index, const std::string& status) {
+        if (StreamContext* sc = stream_get(index)) {
+            std::lock_guard<std::mutex> lock(sc->mutex);
+            sc->status_forced = status;
+        }
     }));
 
-    emscripten::function("set_status", emscripten::optional_override([](const std::string& status) {
-        std::lock_guard<std::mutex> lock(g_state.mutex);
-        g_state.status_forced = status;
+    emscripten::function("reset_transcription", emscripten::optional_override([](size_t index) {
+        if (StreamContext* sc = stream_get(index)) {
+            std::lock_guard<std::mutex> lock(sc->mutex);
+            sc->merged_transcription.clear();
+        }
     }));
 
-    emscripten::function("reset_transcription", emscripten::optional_override([]() {
-        std::lock_guard<std::mutex> lock(g_state.mutex);
-        g_state.merged_transcription.clear();
-        g_state.transcribed.clear();
+    // threads of the stream, its share of N_THREAD
+    emscripten::function("get_threads", emscripten::optional_override([](size_t index) {
+        StreamContext* sc = stream_get(index);
+        return sc ? sc->n_threads.load() : 0;
     }));
 }
@@ -27,7 +27,8 @@ async function clearCache() {
 }
 
 // fetch a remote file from remote URL using the Fetch API
-async function fetchRemote(url, cbProgress, cbPrint) {
+// - with cbChunk, every chunk is passed on as it arrives and the result is a Blob, which the browser may keep on disk
+async function fetchRemote(url, cbProgress, cbPrint, cbChunk) {
     cbPrint('fetchRemote: downloading with fetch()...');
 
     const response = await fetch(
@@ -57,6 +58,10 @@ async function fetchRemote(url, cbProgress, cbPrint) {
             break;
         }
 
+        if (cbChunk) {
+            await cbChunk(value);
+        }
+
         chunks.push(value);
         receivedLength += value.length;
 
@@ -71,6 +76,10 @@ async function fetchRemote(url, cbProgress, cbPrint) {
         }
     }
 
+    if (cbChunk) {
+        return new Blob(chunks);
+    }
+
     var position = 0;
     var chunksAll = new Uint8Array(receivedLength);
 
@@ -82,10 +91,30 @@ async function fetchRemote(url, cbProgress, cbPrint) {
     return chunksAll;
 }
 
+// pass the cached data on to cbChunk in pieces, a Blob is read without loading all of it
+async function streamData(data, cbChunk) {
+    if (data instanceof Blob) {
+        const reader = data.stream().getReader();
+        while (true) {
+            const { done, value } = await reader.read();
+            if (done) {
+                break;
+            }
+            await cbChunk(value);
+        }
+    } else {
+        const kChunk = 1 << 20;
+        for (var pos = 0; pos < data.length; pos += kChunk) {
+            await cbChunk(data.subarray(pos, Math.min(pos + kChunk, data.length)));
+        }
+    }
+}
+
 // load remote data
 // - check if the data is already in the IndexedDB
 // - if not, fetch it from the remote URL and store it in the IndexedDB
-function loadRemote(url, dst, size_mb, cbProgress, cbReady, cbCancel, cbPrint) {
+// - with cbChunk, the data is also streamed to cbChunk before cbReady is called
+function loadRemote(url, dst, size_mb, cbProgress, cbReady, cbCancel, cbPrint, cbChunk) {
     if (!navigator.storage || !navigator.storage.estimate) {
         cbPrint('loadRemote: navigator.storage.estimate() is not supported');
     } else {
@@ -121,7 +150,13 @@ function loadRemote(url, dst, size_mb, cbProgress, cbReady, cbCancel, cbPrint) {
         rq.onsuccess = function (event) {
             if (rq.result) {
                 cbPrint('loadRemote: "' + url + '" is already in the IndexedDB');
-                cbReady(dst, rq.result);
+                if (cbChunk) {
+                    streamData(rq.result, cbChunk).then(function () {
+                        cbReady(dst, rq.result);
+                    });
+                } else {
+                    cbReady(dst, rq.result);
+                }
             } else {
                 // data is not in the IndexedDB
                 cbPrint('loadRemote: "' + url + '" is not in the IndexedDB');
@@ -135,7 +170,7 @@ function loadRemote(url, dst, size_mb, cbProgress, cbReady, cbCancel, cbPrint) {
                     return;
                 }
 
-                fetchRemote(url, cbProgress, cbPrint).then(function (data) {
+                fetchRemote(url, cbProgress, cbPrint, cbChunk).then(function (data) {
                     if (data) {
                         // store the data in the IndexedDB
                         var rq = indexedDB.open(dbName, dbVersion);
@@ -144,12 +179,15 @@ function loadRemote(url, dst, size_mb, cbProgress, cbReady, cbCancel, cbPrint) {
                             var tx = db.transaction(['models'], 'readwrite');
                             var os = tx.objectStore('models');
 
+                            // a streamed download is complete even if it cannot be cached
+                            var cbNotStored = cbChunk ? function () { cbReady(dst, data); } : cbCancel;
+
                             var rq = null;
                             try {
                                 var rq = os.put(data, url);
                             } catch (e) {
                                 cbPrint('loadRemote: failed to store "' + url + '" in the IndexedDB: \n' + e);
-                                cbCancel();
+                                cbNotStored();
                                 return;
                             }
 
@@ -160,9 +198,11 @@ function loadRemote(url, dst, size_mb, cbProgress, cbReady, cbCancel, cbPrint) {
 
                             rq.onerror = function (event) {
                                 cbPrint('loadRemote: failed to store "' + url + '" in the IndexedDB');
-                                cbCancel();
+                                cbNotStored();
                             };
                         };
+                    } else {
+                        cbCancel();
                     }
                 });
             }
@@ -0,0 +1,150 @@
+#ifndef MODEL_STREAM_H
+#define MODEL_STREAM_H
+
+#include "whisper.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+//
+// Model bytes streamed from JS into the whisper_model_loader of a loading thread
+//
+// JS pushes the chunks of the download (or of the IndexedDB cache) as they arrive and the loader reads
+// them straight into the tensors, so the heap never holds the file next to the model, unlike a copy in
+// MEMFS or a buffer for whisper_init_from_buffer_with_params. At most MAX_QUEUED bytes wait in the
+// queue: JS stops pushing while room() is false, the loader blocks while the queue is empty.
+//
+// finish() marks the end of the file, cancel() drops the queue and makes the loader fail.
+//
+
+struct model_stream {
+    static constexpr size_t MAX_QUEUED = 16u*1024*1024;
+
+    void push(std::vector<uint8_t> && chunk) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (finished || chunk.empty()) {
+                return;
+            }
+            queued += chunk.size();
+            chunks.push_back(std::move(chunk));
+        }
+        cv.notify_all();
+    }
+
+    void finish() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            finished = true;
+        }
+        cv.notify_all();
+    }
+
+    void cancel() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            finished = true;
+            chunks.clear();
+            queued = 0;
+        }
+        cv.notify_all();
+    }
+
+    // start over for the next file
+    void reset() {
+        std::lock_guard<std::mutex> lock(mutex);
+        chunks.clear();
+        offset = 0;
+        queued = 0;
+        n_read = 0;
+        finished = false;
+    }
+
+    // the producer may push another chunk
+    bool room() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return queued < MAX_QUEUED;
+    }
+
+    // bytes read by the loader so far
+    size_t consumed() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return n_read;
+    }
+
+    whisper_model_loader loader() {
+        whisper_model_loader res = {};
+
+        res.context = this;
+
+        res.read = [](void * ctx, void * output, size_t read_size) {
+            return static_cast<model_stream *>(ctx)->read(static_cast<uint8_t *>(output), read_size);
+        };
+
+        res.eof = [](void * ctx) {
+            return static_cast<model_stream *>(ctx)->eof();
+        };
+
+        res.close = [](void * /*ctx*/) { };
+
+        return res;
+    }
+
+private:
+    // blocks until n bytes are queued or the stream ends, a short read is zero-filled like a truncated file
+    size_t read(uint8_t * dst, size_t n) {
+        size_t n_done = 0;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+
+            while (n_done < n) {
+                cv.wait(lock, [&] { return !chunks.empty() || finished; });
+                if (chunks.empty()) {
+                    break;
+                }
+
+                const std::vector<uint8_t> & chunk = chunks.front();
+                const size_t n_copy = std::min(n - n_done, chunk.size() - offset);
+
+                memcpy(dst + n_done, chunk.data() + offset, n_copy);
+                n_done += n_copy;
+                offset += n_copy;
+
+                if (offset == chunk.size()) {
+                    queued -= chunk.size();
+                    chunks.pop_front();
+                    offset = 0;
+                }
+            }
+
+            n_read += n_done;
+        }
+
+        memset(dst + n_done, 0, n - n_done);
+
+        return n_done;
+    }
+
+    bool eof() {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&] { return !chunks.empty() || finished; });
+        return chunks.empty();
+    }
+
+    std::mutex mutex;
+    std::condition_variable cv;
+
+    std::deque<std::vector<uint8_t>> chunks;
+    size_t offset   = 0; // into chunks.front()
+    size_t queued   = 0; // bytes in chunks
+    size_t n_read   = 0;
+    bool   finished = false;
+};
+
+#endif
@@ -1,7 +1,13 @@
 #include "common-sdl.h"
 
+#include <algorithm>
+#include <chrono>
 #include <cstdio>
 
+static int64_t audio_now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 audio_async::audio_async(int len_ms) {
     m_len_ms = len_ms;
 
@@ -9,11 +15,20 @@ audio_async::audio_async(int len_ms) {
 }
 
 audio_async::~audio_async() {
+    if (m_replay_thread.joinable()) {
+        m_replay_stop = true;
+        m_replay_thread.join();
+    }
+
     if (m_dev_id_in) {
         SDL_CloseAudioDevice(m_dev_id_in);
     }
 }
 
+bool audio_async::is_open() const {
+    return m_dev_id_in || m_replay;
+}
+
 bool audio_async::init(int capture_id, int sample_rate) {
     SDL_LogSetPriority(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_INFO);
 
@@ -78,8 +93,66 @@ bool audio_async::init(int capture_id, int sample_rate) {
     return true;
 }
 
+bool audio_async::init_replay(std::vector<float> pcmf32, int sample_rate, bool realtime) {
+    if (is_open()) {
+        fprintf(stderr, "%s: audio already initialized!\n", __func__);
+        return false;
+    }
+
+    fprintf(stderr, "%s: replaying %.1f s of audio %s\n", __func__, (float) pcmf32.size()/sample_rate,
+            realtime ? "in real time" : "as fast as it is consumed");
+
+    m_sample_rate = sample_rate;
+
+    m_audio.resize((m_sample_rate*m_len_ms)/1000);
+
+    m_replay          = true;
+    m_replay_realtime = realtime;
+    m_replay_pcmf32   = std::move(pcmf32);
+    m_replay_pos      = 0;
+    m_replay_done     = m_replay_pcmf32.empty();
+
+    if (m_replay_realtime) {
+        m_replay_thread = std::thread(&audio_async::replay, this);
+    }
+
+    return true;
+}
+
+bool audio_async::is_finished() const {
+    return m_replay && m_replay_done;
+}
+
+void audio_async::replay() {
+    // same chunk size as the SDL capture
+    const size_t n_chunk = 1024;
+
+    auto t_next = std::chrono::steady_clock::now();
+
+    while (!m_replay_stop && !m_replay_done) {
+        t_next += std::chrono::microseconds(n_chunk*1000000/m_sample_rate);
+        std::this_thread::sleep_until(t_next);
+
+        // paused: the replay waits instead of losing the audio
+        if (!m_running) {
+            continue;
+        }
+
+        const int64_t t_us = audio_now_us();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        const size_t n = std::min(n_chunk, m_replay_pcmf32.size() - m_replay_pos);
+
+        push(m_replay_pcmf32.data() + m_replay_pos, n, t_us - (int64_t) ((n - 1)*1000000/m_sample_rate), t_us);
+
+        m_replay_pos += n;
+        m_replay_done = m_replay_pos == m_replay_pcmf32.size();
+    }
+}
+
 bool audio_async::resume() {
-    if (!m_dev_id_in) {
+    if (!is_open()) {
         fprintf(stderr, "%s: no audio device to resume!\n", __func__);
         return false;
     }
@@ -89,7 +162,9 @@ bool audio_async::resume() {
         return false;
     }
 
-    SDL_PauseAudioDevice(m_dev_id_in, 0);
+    if (m_dev_id_in) {
+        SDL_PauseAudioDevice(m_dev_id_in, 0);
+    }
 
     m_running = true;
 
@@ -97,7 +172,7 @@ bool audio_async::resume() {
 }
 
 bool audio_async::pause() {
-    if (!m_dev_id_in) {
+    if (!is_open()) {
         fprintf(stderr, "%s: no audio device to pause!\n", __func__);
         return false;
     }
@@ -107,7 +182,9 @@ bool audio_async::pause() {
         return false;
     }
 
-    SDL_PauseAudioDevice(m_dev_id_in, 1);
+    if (m_dev_id_in) {
+        SDL_PauseAudioDevice(m_dev_id_in, 1);
+    }
 
     m_running = false;
 
@@ -115,7 +192,7 @@ bool audio_async::pause() {
 }
 
 bool audio_async::clear() {
-    if (!m_dev_id_in) {
+    if (!is_open()) {
         fprintf(stderr, "%s: no audio device to clear!\n", __func__);
         return false;
     }
@@ -141,34 +218,80 @@ void audio_async::callback(uint8_t * stream, int len) {
         return;
     }
 
+    // the chunk arrives when its last sample has just been captured
+    const int64_t t_us = audio_now_us();
+
     size_t n_samples = len / sizeof(float);
 
+    //fprintf(stderr, "%s: %zu samples, pos %zu, len %zu\n", __func__, n_samples, m_audio_pos, m_audio_len);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        push((const float *) stream, n_samples, t_us - (int64_t) ((n_samples - 1)*1000000/m_sample_rate), t_us);
+    }
+}
+
+void audio_async::push(const float * samples, size_t n_samples, int64_t t_first_us, int64_t t_last_us) {
+    if (n_samples == 0) {
+        return;
+    }
+
     if (n_samples > m_audio.size()) {
-        n_samples = m_audio.size();
+        const size_t n_skip = n_samples - m_audio.size();
 
-        stream += (len - (n_samples * sizeof(float)));
+        t_first_us += (t_last_us - t_first_us)*n_skip/(n_samples - 1);
+
+        samples   += n_skip;
+        n_samples -= n_skip;
     }
 
-    //fprintf(stderr, "%s: %zu samples, pos %zu, len %zu\n", __func__, n_samples, m_audio_pos, m_audio_len);
+    if (m_audio_pos + n_samples > m_audio.size()) {
+        const size_t n0 = m_audio.size() - m_audio_pos;
 
-    {
-        std::lock_guard<std::mutex> lock(m_mutex);
+        memcpy(&m_audio[m_audio_pos], samples, n0 * sizeof(float));
+        memcpy(&m_audio[0], samples + n0, (n_samples - n0) * sizeof(float));
+    } else {
+        memcpy(&m_audio[m_audio_pos], samples, n_samples * sizeof(float));
+    }
+    m_audio_pos = (m_audio_pos + n_samples) % m_audio.size();
+    m_audio_len = std::min(m_audio_len + n_samples, m_audio.size());
 
-        if (m_audio_pos + n_samples > m_audio.size()) {
-            const size_t n0 = m_audio.size() - m_audio_pos;
+    m_audio_total += n_samples;
+    m_chunk_times.push_back({ m_audio_total, n_samples, t_first_us, t_last_us });
 
-            memcpy(&m_audio[m_audio_pos], stream, n0 * sizeof(float));
-            memcpy(&m_audio[0], stream + n0 * sizeof(float), (n_samples - n0) * sizeof(float));
-        } else {
-            memcpy(&m_audio[m_audio_pos], stream, n_samples * sizeof(float));
-        }
-        m_audio_pos = (m_audio_pos + n_samples) % m_audio.size();
-        m_audio_len = std::min(m_audio_len + n_samples, m_audio.size());
+    // forget the chunks that have been overwritten
+    while (m_chunk_times.front().end + m_audio.size() <= m_audio_total) {
+        m_chunk_times.pop_front();
+    }
+}
+
+// capture time of the sample i, interpolated between the first and last samples of its chunk
+int64_t audio_async::capture_time(uint64_t i) const {
+    auto it = std::upper_bound(m_chunk_times.begin(), m_chunk_times.end(), i,
+            [](uint64_t s, const chunk_time & c) { return s < c.end; });
+    if (it == m_chunk_times.end()) {
+        return 0;
+    }
+
+    if (it->n < 2) {
+        return it->t_last_us;
     }
+
+    const uint64_t k = i - (it->end - it->n);
+
+    return it->t_first_us + (int64_t) ((it->t_last_us - it->t_first_us)*k/(it->n - 1));
 }
 
 void audio_async::get(int ms, std::vector<float> & result) {
-    if (!m_dev_id_in) {
+    audio_capture_span span;
+    get(ms, result, span);
+}
+
+void audio_async::get(int ms, std::vector<float> & result, audio_capture_span & span) {
+    span = {};
+
+    if (!is_open()) {
         fprintf(stderr, "%s: no audio device to get audio from!\n", __func__);
         return;
     }
@@ -188,6 +311,18 @@ void audio_async::get(int ms, std::vector<float> & result) {
         }
 
         size_t n_samples = (m_sample_rate * ms) / 1000;
+
+        if (m_replay && !m_replay_realtime && n_samples > m_audio_len) {
+            // pull the missing audio, all captured now
+            const size_t n = std::min({ n_samples - m_audio_len, m_audio.size(), m_replay_pcmf32.size() - m_replay_pos });
+            const int64_t t_us = audio_now_us();
+
+            push(m_replay_pcmf32.data() + m_replay_pos, n, t_us, t_us);
+
+            m_replay_pos += n;
+            m_replay_done = m_replay_pos == m_replay_pcmf32.size();
+        }
+
         if (n_samples > m_audio_len) {
             n_samples = m_audio_len;
         }
@@ -207,6 +342,13 @@ void audio_async::get(int ms, std::vector<float> & result) {
         } else {
             memcpy(result.data(), &m_audio[s0], n_samples * sizeof(float));
         }
+
+        span.end = m_audio_total;
+
+        if (n_samples > 0) {
+            span.t_first_us = capture_time(m_audio_total - n_samples);
+            span.t_last_us  = capture_time(m_audio_total - 1);
+        }
     }
 }
 
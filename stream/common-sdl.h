@@ -5,12 +5,24 @@
 
 #include <atomic>
 #include <cstdint>
+#include <deque>
+#include <thread>
 #include <vector>
 #include <mutex>
 
 //
 // SDL Audio capture
 //
+// The audio comes either from an SDL capture device or from the replay of samples decoded beforehand,
+// so that the streaming loop can run on a recording without any audio hardware.
+//
+
+// capture time of the audio returned by audio_async::get(), std::chrono::steady_clock in microseconds
+struct audio_capture_span {
+    int64_t  t_first_us = 0; // first sample
+    int64_t  t_last_us  = 0; // last sample
+    uint64_t end        = 0; // index of the sample after the last one since the start of the capture
+};
 
 class audio_async {
 public:
@@ -19,6 +31,15 @@ public:
 
     bool init(int capture_id, int sample_rate);
 
+    // replay pcmf32 instead of capturing from a device
+    // realtime: pushed in chunks at the pace of the audio from a thread, like a capture device
+    // otherwise get() pulls the samples it asks for, so the audio goes as fast as the caller consumes it
+    // and every sample is timestamped when it is pulled
+    bool init_replay(std::vector<float> pcmf32, int sample_rate, bool realtime);
+
+    // all the samples of the replay have been pushed - always false for a device
+    bool is_finished() const;
+
     // start capturing audio via the provided SDL callback
     // keep last len_ms seconds of audio in a circular buffer
     bool resume();
@@ -31,9 +52,14 @@ public:
     // get audio data from the circular buffer
     void get(int ms, std::vector<float> & audio);
 
+    // same, with the time its first and last samples were captured
+    void get(int ms, std::vector<float> & audio, audio_capture_span & span);
+
 private:
     SDL_AudioDeviceID m_dev_id_in = 0;
 
+    bool is_open() const;
+
     int m_len_ms = 0;
     int m_sample_rate = 0;
 
@@ -43,6 +69,34 @@ private:
     std::vector<float> m_audio;
     size_t             m_audio_pos = 0;
     size_t             m_audio_len = 0;
+
+    // every chunk is timestamped on arrival, with the capture times of its first and last samples
+    struct chunk_time {
+        uint64_t end; // index of the sample after the chunk since the start of the capture
+        uint64_t n;
+        int64_t  t_first_us;
+        int64_t  t_last_us;
+    };
+
+    uint64_t               m_audio_total = 0; // samples written since the start of the capture
+    std::deque<chunk_time> m_chunk_times;     // chunks still in the circular buffer
+
+    // replay
+    bool               m_replay          = false;
+    bool               m_replay_realtime = false;
+    std::vector<float> m_replay_pcmf32;
+    size_t             m_replay_pos      = 0; // guarded by m_mutex
+    std::atomic_bool   m_replay_done{false};
+    std::atomic_bool   m_replay_stop{false};
+    std::thread        m_replay_thread;
+
+    // write a chunk to the circular buffer, m_mutex must be held
+    void push(const float * samples, size_t n_samples, int64_t t_first_us, int64_t t_last_us);
+
+    // realtime replay thread
+    void replay();
+
+    int64_t capture_time(uint64_t i) const;
 };
 
 // Return false if need to quit
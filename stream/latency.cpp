@@ -0,0 +1,132 @@
+#include "latency.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+const char * latency_stage_name(int stage) {
+    switch (stage) {
+        case LATENCY_STAGE_BUFFER:   return "buffer";
+        case LATENCY_STAGE_ASSEMBLE: return "assemble";
+        case LATENCY_STAGE_INFER:    return "infer";
+        case LATENCY_STAGE_POST:     return "post";
+        case LATENCY_STAGE_SEND:     return "send";
+        case LATENCY_STAGE_TOTAL:    return "total";
+    }
+
+    return "unknown";
+}
+
+const char * latency_whisper_stage_name(int stage) {
+    switch (stage) {
+        case LATENCY_WHISPER_MEL:    return "mel";
+        case LATENCY_WHISPER_ENCODE: return "encode";
+        case LATENCY_WHISPER_DECODE: return "decode";
+        case LATENCY_WHISPER_SAMPLE: return "sample";
+    }
+
+    return "unknown";
+}
+
+const int64_t latency_bucket_le_us[LATENCY_BUCKETS] = {
+    1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000,
+    1000000, 2500000, 5000000, 10000000, 25000000, 60000000, INT64_MAX,
+};
+
+void latency_histogram::record(int64_t t_us) {
+    t_us = std::max<int64_t>(t_us, 0);
+
+    int i = 0;
+    while (t_us > latency_bucket_le_us[i]) {
+        ++i;
+    }
+
+    n[i].fetch_add(1, std::memory_order_relaxed);
+    sum_us.fetch_add(t_us, std::memory_order_relaxed);
+}
+
+void latency_histogram_sum::add(const latency_histogram & h) {
+    for (int i = 0; i < LATENCY_BUCKETS; ++i) {
+        n[i] += h.n[i].load(std::memory_order_relaxed);
+    }
+    sum_us += h.sum_us.load(std::memory_order_relaxed);
+}
+
+int64_t latency_now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int64_t latency_trace::stage_us(int stage) const {
+    switch (stage) {
+        case LATENCY_STAGE_BUFFER:   return t_ready_us     - t_capture_us;
+        case LATENCY_STAGE_ASSEMBLE: return t_assembled_us - t_ready_us;
+        case LATENCY_STAGE_INFER:    return t_inferred_us  - t_assembled_us;
+        case LATENCY_STAGE_POST:     return t_emit_us      - t_inferred_us;
+        case LATENCY_STAGE_SEND:     return t_sent_us      - t_emit_us;
+        case LATENCY_STAGE_TOTAL:    return t_sent_us      - t_capture_us;
+    }
+
+    return 0;
+}
+
+void latency_window::record(const latency_trace & trace) {
+    const uint64_t i = n.fetch_add(1, std::memory_order_relaxed) % LATENCY_WINDOW;
+
+    for (int stage = 0; stage < LATENCY_STAGE_COUNT; ++stage) {
+        const int64_t t = trace.stage_us(stage);
+        t_us[stage][i].store((uint32_t) std::clamp<int64_t>(t, 0, UINT32_MAX), std::memory_order_relaxed);
+        hist[stage].record(t);
+    }
+}
+
+latency_percentiles latency_window_percentiles(const std::vector<const latency_window *> & windows, int stage) {
+    latency_percentiles result;
+
+    std::vector<uint32_t> values;
+    values.reserve(windows.size()*LATENCY_WINDOW);
+
+    for (const latency_window * w : windows) {
+        const uint64_t n = std::min<uint64_t>(w->n.load(std::memory_order_relaxed), LATENCY_WINDOW);
+        for (uint64_t i = 0; i < n; ++i) {
+            values.push_back(w->t_us[stage][i].load(std::memory_order_relaxed));
+        }
+    }
+
+    if (values.empty()) {
+        return result;
+    }
+
+    std::sort(values.begin(), values.end());
+
+    // nearest rank
+    auto pct = [&](double p) {
+        const size_t k = (size_t) std::max(1.0, std::ceil(p*values.size())) - 1;
+        return 1e-3*values[std::min(k, values.size() - 1)];
+    };
+
+    result.n      = (int) values.size();
+    result.p50_ms = pct(0.50);
+    result.p95_ms = pct(0.95);
+    result.p99_ms = pct(0.99);
+
+    return result;
+}
+
+std::string latency_summary(const latency_percentiles * percentiles) {
+    std::string result;
+
+    char buf[128];
+
+    snprintf(buf, sizeof(buf), "latency p50/p95/p99 ms over %d messages:", percentiles[0].n);
+    result += buf;
+
+    for (int stage = 0; stage < LATENCY_STAGE_COUNT; ++stage) {
+        const latency_percentiles & p = percentiles[stage];
+
+        snprintf(buf, sizeof(buf), " %s %.1f/%.1f/%.1f", latency_stage_name(stage), p.p50_ms, p.p95_ms, p.p99_ms);
+        result += buf;
+    }
+
+    return result;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//
+// End-to-end latency tracing
+//
+// The audio is timestamped when it is captured (or received from a client) and every transcription
+// carries the time its window spent in each stage until it is sent.
+// The latencies of the last LATENCY_WINDOW messages are kept in rings of lock-free slots, so that they can
+// live in the shared memory of the pre-fork workers and be read without stopping the writers.
+//
+
+// messages kept per ring
+#define LATENCY_WINDOW 1024
+
+// buckets of the cumulative histograms, the last one is +Inf
+#define LATENCY_BUCKETS 16
+
+enum latency_stage {
+    LATENCY_STAGE_BUFFER,   // capture of the oldest sample of the step -> window ready
+    LATENCY_STAGE_ASSEMBLE, // window assembly
+    LATENCY_STAGE_INFER,    // whisper_full and segment text
+    LATENCY_STAGE_POST,     // similarity check and message
+    LATENCY_STAGE_SEND,     // websocket write, after the message has been built
+    LATENCY_STAGE_TOTAL,    // capture of the oldest sample of the step -> sent
+    LATENCY_STAGE_COUNT,
+};
+
+const char * latency_stage_name(int stage);
+
+// stages of whisper_full in one window, from the difference of whisper_get_counters() around it
+enum latency_whisper_stage {
+    LATENCY_WHISPER_MEL,
+    LATENCY_WHISPER_ENCODE,
+    LATENCY_WHISPER_DECODE, // text generation, batch decoding and prompt
+    LATENCY_WHISPER_SAMPLE,
+    LATENCY_WHISPER_COUNT,
+};
+
+const char * latency_whisper_stage_name(int stage);
+
+// std::chrono::steady_clock, also used for the capture timestamps of audio_async
+int64_t latency_now_us();
+
+// timestamps of one window, in latency_now_us()
+struct latency_trace {
+    int64_t t_capture_us      = 0; // oldest sample of the step
+    int64_t t_capture_last_us = 0; // newest sample of the step
+    int64_t t_ready_us        = 0; // step handed to the window assembly
+    int64_t t_assembled_us    = 0;
+    int64_t t_inferred_us     = 0;
+    int64_t t_emit_us         = 0; // message built, about to be sent
+    int64_t t_sent_us         = 0;
+
+    int64_t stage_us(int stage) const;
+};
+
+// upper bounds of the buckets in microseconds, INT64_MAX for the last one
+extern const int64_t latency_bucket_le_us[LATENCY_BUCKETS];
+
+// cumulative histogram since the start, for the Prometheus exposition
+// must be zero-initialized (value-initialization or anonymous mapping)
+struct latency_histogram {
+    std::atomic<uint64_t> n[LATENCY_BUCKETS]; // per bucket, not cumulative
+    std::atomic<uint64_t> sum_us;
+
+    void record(int64_t t_us);
+};
+
+// ring of the stage latencies of the last LATENCY_WINDOW messages, and their histograms since the start
+// must be zero-initialized, like latency_histogram
+struct latency_window {
+    std::atomic<uint64_t> n;                                         // messages recorded
+    std::atomic<uint32_t> t_us[LATENCY_STAGE_COUNT][LATENCY_WINDOW]; // latency_trace::stage_us() of each message
+
+    latency_histogram hist[LATENCY_STAGE_COUNT];
+
+    void record(const latency_trace & trace);
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "the latency slots must be lock-free");
+
+// plain copy of one or more histograms
+struct latency_histogram_sum {
+    uint64_t n[LATENCY_BUCKETS] = {};
+    uint64_t sum_us             = 0;
+
+    void add(const latency_histogram & h);
+};
+
+struct latency_percentiles {
+    int    n      = 0; // messages in the windows
+    double p50_ms = 0.0;
+    double p95_ms = 0.0;
+    double p99_ms = 0.0;
+};
+
+// percentiles of a stage over the messages of one or more windows
+latency_percentiles latency_window_percentiles(const std::vector<const latency_window *> & windows, int stage);
+
+// one line with the p50/p95/p99 of every stage for the periodic log, from LATENCY_STAGE_COUNT percentiles
+std::string latency_summary(const latency_percentiles * percentiles);
@@ -0,0 +1,104 @@
+#include "metrics.h"
+
+#include <cinttypes>
+#include <cstdarg>
+#include <cstdio>
+
+static void metrics_printf(std::string & out, const char * fmt, ...) {
+    char buf[256];
+
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+
+    out += buf;
+}
+
+static void metrics_header(std::string & out, const char * name, const char * type, const char * help) {
+    metrics_printf(out, "# HELP %s %s\n", name, help);
+    metrics_printf(out, "# TYPE %s %s\n", name, type);
+}
+
+static void metrics_counter(std::string & out, const char * name, const char * help, uint64_t value) {
+    metrics_header(out, name, "counter", help);
+    metrics_printf(out, "%s %" PRIu64 "\n", name, value);
+}
+
+static void metrics_gauge(std::string & out, const char * name, const char * help, double value) {
+    metrics_header(out, name, "gauge", help);
+    metrics_printf(out, "%s %.10g\n", name, value);
+}
+
+// one series of a histogram in seconds, with a stage label
+static void metrics_histogram(std::string & out, const char * name, const char * stage, const latency_histogram_sum & h) {
+    uint64_t n = 0;
+
+    for (int i = 0; i < LATENCY_BUCKETS; ++i) {
+        n += h.n[i];
+
+        if (i == LATENCY_BUCKETS - 1) {
+            metrics_printf(out, "%s_bucket{stage=\"%s\",le=\"+Inf\"} %" PRIu64 "\n", name, stage, n);
+        } else {
+            metrics_printf(out, "%s_bucket{stage=\"%s\",le=\"%g\"} %" PRIu64 "\n", name, stage, 1e-6*latency_bucket_le_us[i], n);
+        }
+    }
+
+    metrics_printf(out, "%s_sum{stage=\"%s\"} %.6f\n", name, stage, 1e-6*h.sum_us);
+    metrics_printf(out, "%s_count{stage=\"%s\"} %" PRIu64 "\n", name, stage, n);
+}
+
+std::string metrics_text(const prefork_stats_total & t) {
+    std::string out;
+
+    // 16 kHz mono
+    const double t_audio_s = t.n_samples/16000.0;
+    const double t_infer_s = 1e-6*t.t_infer_us;
+
+    metrics_gauge  (out, "wstream_workers",               "Worker processes alive",                         t.n_workers);
+    metrics_counter(out, "wstream_worker_restarts_total", "Workers restarted after a crash",                t.n_restarts);
+    metrics_gauge  (out, "wstream_clients",               "Connected WebSocket clients",                    t.n_sessions);
+    metrics_counter(out, "wstream_sessions_total",        "WebSocket sessions accepted",                    t.n_sessions_total);
+
+    metrics_counter(out, "wstream_windows_total",         "Windows transcribed",                            t.n_windows);
+    metrics_counter(out, "wstream_windows_silent_total",  "Windows without any text, skipped as silence",   t.n_windows_empty);
+    metrics_gauge  (out, "wstream_vad_skip_ratio",        "Fraction of the windows skipped as silence",
+            t.n_windows > 0 ? (double) t.n_windows_empty/t.n_windows : 0.0);
+    metrics_counter(out, "wstream_messages_total",        "Transcriptions sent",                            t.n_messages);
+
+    metrics_header(out, "wstream_audio_seconds_total", "counter", "Audio received or captured");
+    metrics_printf(out, "wstream_audio_seconds_total %.6f\n", t_audio_s);
+    metrics_header(out, "wstream_infer_seconds_total", "counter", "Time spent in whisper_full");
+    metrics_printf(out, "wstream_infer_seconds_total %.6f\n", t_infer_s);
+    metrics_gauge  (out, "wstream_real_time_factor",      "Inference time over audio time since the start",
+            t_audio_s > 0.0 ? t_infer_s/t_audio_s : 0.0);
+
+    metrics_counter(out, "wstream_dropped_audio_total",   "Times the audio was dropped because the transcription fell behind", t.n_dropped);
+    metrics_header(out, "wstream_dropped_audio_seconds_total", "counter", "Audio dropped because the transcription fell behind");
+    metrics_printf(out, "wstream_dropped_audio_seconds_total %.6f\n", t.n_samples_dropped/16000.0);
+    metrics_gauge  (out, "wstream_broadcast_queue_depth", "Messages being written to the clients",         t.n_writes_pending);
+
+    metrics_counter(out, "wstream_whisper_encode_total",  "Encoder calls (n_encode)",                       t.n_encode);
+    metrics_counter(out, "wstream_whisper_decode_total",  "Single token decoder calls (n_decode)",          t.n_decode);
+    metrics_counter(out, "wstream_whisper_batchd_total",  "Batch decoder calls (n_batchd)",                 t.n_batchd);
+    metrics_counter(out, "wstream_whisper_prompt_total",  "Prompt decoder calls (n_prompt)",                t.n_prompt);
+
+    metrics_header(out, "wstream_whisper_fallbacks_total", "counter", "Temperature fallbacks (n_fail_p, n_fail_h)");
+    metrics_printf(out, "wstream_whisper_fallbacks_total{reason=\"logprob\"} %" PRIu64 "\n", t.n_fail_p);
+    metrics_printf(out, "wstream_whisper_fallbacks_total{reason=\"entropy\"} %" PRIu64 "\n", t.n_fail_h);
+
+    metrics_header(out, "wstream_whisper_stage_seconds", "histogram", "Time of the whisper_full stages per window");
+    for (int stage = 0; stage < LATENCY_WHISPER_COUNT; ++stage) {
+        metrics_histogram(out, "wstream_whisper_stage_seconds", latency_whisper_stage_name(stage), t.whisper_hist[stage]);
+    }
+
+    metrics_header(out, "wstream_latency_seconds", "histogram", "Capture to send latency of the messages by stage");
+    for (int stage = 0; stage < LATENCY_STAGE_COUNT; ++stage) {
+        metrics_histogram(out, "wstream_latency_seconds", latency_stage_name(stage), t.latency_hist[stage]);
+    }
+
+    metrics_gauge  (out, "wstream_resident_memory_bytes",    "RSS of the workers",                          1024.0*t.rss_kb);
+    metrics_gauge  (out, "wstream_proportional_memory_bytes", "PSS of the workers, shared pages divided between them", 1024.0*t.pss_kb);
+
+    return out;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "prefork.h"
+
+#include <string>
+
+//
+// Prometheus exposition of the server counters, served on /metrics by the WebSocket listener
+//
+// The counters are the relaxed atomics of prefork_worker_stats, so a scrape only reads them
+// and never takes a lock that the transcription holds.
+//
+
+// text format 0.0.4
+std::string metrics_text(const prefork_stats_total & t);
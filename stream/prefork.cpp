@@ -0,0 +1,376 @@
+#include "prefork.h"
+
+#include "ggml-backend.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <string>
+#include <thread>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static prefork_worker_stats * g_stats     = nullptr;
+static int                    g_n_workers = 0;
+
+static volatile sig_atomic_t g_stop = 0;
+
+static void prefork_on_signal(int /*signum*/) {
+    g_stop = 1;
+}
+
+static std::vector<int> prefork_cpus_allowed() {
+    std::vector<int> cpus;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int i = 0; i < CPU_SETSIZE; ++i) {
+            if (CPU_ISSET(i, &set)) {
+                cpus.push_back(i);
+            }
+        }
+    }
+
+    if (cpus.empty()) {
+        const int n = std::max(1u, std::thread::hardware_concurrency());
+        for (int i = 0; i < n; ++i) {
+            cpus.push_back(i);
+        }
+    }
+
+    return cpus;
+}
+
+// contiguous share of the CPUs for worker i - workers share CPUs when there are more workers than CPUs
+static std::vector<int> prefork_worker_cpus(const std::vector<int> & cpus, int i, int n) {
+    const int n_cpus = (int) cpus.size();
+
+    if (n >= n_cpus) {
+        return { cpus[i % n_cpus] };
+    }
+
+    const int i0 = (i*n_cpus)/n;
+    const int i1 = ((i + 1)*n_cpus)/n;
+
+    return std::vector<int>(cpus.begin() + i0, cpus.begin() + i1);
+}
+
+static void prefork_read_mem(int64_t pid, uint64_t & rss_kb, uint64_t & pss_kb) {
+    const std::string path = "/proc/" + std::to_string(pid) + "/smaps_rollup";
+
+    FILE * f = fopen(path.c_str(), "r");
+    if (!f) {
+        return;
+    }
+
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long long kb = 0;
+        if (sscanf(line, "Rss: %llu kB", &kb) == 1) {
+            rss_kb += kb;
+        } else if (sscanf(line, "Pss: %llu kB", &kb) == 1) {
+            pss_kb += kb;
+        }
+    }
+
+    fclose(f);
+}
+
+prefork_stats_total prefork_stats_aggregate() {
+    return prefork_stats_aggregate(g_stats, g_n_workers);
+}
+
+prefork_stats_total prefork_stats_aggregate(const prefork_worker_stats * stats, int n) {
+    prefork_stats_total total;
+
+    std::vector<const latency_window *> latency;
+
+    for (int i = 0; i < n; ++i) {
+        const prefork_worker_stats & s = stats[i];
+
+        latency.push_back(&s.latency);
+
+        const int64_t pid = s.pid.load(std::memory_order_relaxed);
+        if (pid > 0) {
+            total.n_workers++;
+            prefork_read_mem(pid, total.rss_kb, total.pss_kb);
+        }
+
+        total.n_restarts       += s.n_restarts      .load(std::memory_order_relaxed);
+        total.n_sessions       += s.n_sessions      .load(std::memory_order_relaxed);
+        total.n_sessions_total += s.n_sessions_total.load(std::memory_order_relaxed);
+        total.n_windows        += s.n_windows       .load(std::memory_order_relaxed);
+        total.n_samples        += s.n_samples       .load(std::memory_order_relaxed);
+        total.n_messages       += s.n_messages      .load(std::memory_order_relaxed);
+        total.t_infer_us       += s.t_infer_us      .load(std::memory_order_relaxed);
+
+        total.n_windows_empty   += s.n_windows_empty  .load(std::memory_order_relaxed);
+        total.n_dropped         += s.n_dropped        .load(std::memory_order_relaxed);
+        total.n_samples_dropped += s.n_samples_dropped.load(std::memory_order_relaxed);
+        total.n_writes_pending  += s.n_writes_pending .load(std::memory_order_relaxed);
+
+        total.n_encode += s.n_encode.load(std::memory_order_relaxed);
+        total.n_decode += s.n_decode.load(std::memory_order_relaxed);
+        total.n_batchd += s.n_batchd.load(std::memory_order_relaxed);
+        total.n_prompt += s.n_prompt.load(std::memory_order_relaxed);
+        total.n_fail_p += s.n_fail_p.load(std::memory_order_relaxed);
+        total.n_fail_h += s.n_fail_h.load(std::memory_order_relaxed);
+
+        for (int stage = 0; stage < LATENCY_STAGE_COUNT; ++stage) {
+            total.latency_hist[stage].add(s.latency.hist[stage]);
+        }
+        for (int stage = 0; stage < LATENCY_WHISPER_COUNT; ++stage) {
+            total.whisper_hist[stage].add(s.whisper[stage]);
+        }
+    }
+
+    for (int stage = 0; stage < LATENCY_STAGE_COUNT; ++stage) {
+        total.latency[stage] = latency_window_percentiles(latency, stage);
+    }
+
+    return total;
+}
+
+static void prefork_print_stats() {
+    const prefork_stats_total t = prefork_stats_aggregate();
+
+    // 16 kHz mono
+    const double t_audio_s = t.n_samples/16000.0;
+    const double rtf       = t_audio_s > 0.0 ? 1e-6*t.t_infer_us/t_audio_s : 0.0;
+
+    fprintf(stderr, "%s: workers %d, restarts %llu, clients %lld (%llu total), windows %llu, audio %.1f s, "
+                    "rtf %.3f, messages %llu, rss %.1f MB, pss %.1f MB\n", __func__,
+            t.n_workers, (unsigned long long) t.n_restarts, (long long) t.n_sessions, (unsigned long long) t.n_sessions_total,
+            (unsigned long long) t.n_windows, t_audio_s, rtf, (unsigned long long) t.n_messages,
+            t.rss_kb/1024.0, t.pss_kb/1024.0);
+
+    fprintf(stderr, "%s: %s\n", __func__, latency_summary(t.latency).c_str());
+}
+
+// the per-op profiler of the CPU backend (GGML_CPU_PROFILE) writes its trace at exit, which a worker never reaches
+static void prefork_worker_flush() {
+    ggml_backend_reg_t reg = ggml_backend_reg_by_name("CPU");
+    if (reg) {
+        auto * flush_fn = (void (*)(void)) ggml_backend_reg_get_proc_address(reg, "ggml_cpu_profile_flush");
+        if (flush_fn) {
+            flush_fn();
+        }
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+}
+
+static pid_t prefork_spawn(int i, const std::vector<int> & cpus, const prefork_worker_fn & fn) {
+    const pid_t pid = fork();
+    if (pid != 0) {
+        if (pid > 0) {
+            g_stats[i].pid.store(pid, std::memory_order_relaxed);
+        }
+        return pid;
+    }
+
+    // child
+    signal(SIGINT,  SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+
+    // SIGINT and SIGTERM are taken by a thread that flushes the worker and then dies of the signal as before,
+    // the threads of the worker inherit the blocked mask
+    sigset_t stop_set;
+    sigemptyset(&stop_set);
+    sigaddset(&stop_set, SIGINT);
+    sigaddset(&stop_set, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop_set, nullptr);
+
+    std::thread([stop_set]() {
+        int signum = SIGTERM;
+        sigwait(&stop_set, &signum);
+
+        prefork_worker_flush();
+
+        pthread_sigmask(SIG_UNBLOCK, &stop_set, nullptr);
+        raise(signum);
+    }).detach();
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        CPU_SET(cpu, &set);
+    }
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        fprintf(stderr, "%s: worker %d: failed to set the CPU affinity: %s\n", __func__, i, strerror(errno));
+    }
+
+    const int ret = fn(i, g_stats[i], cpus);
+
+    prefork_worker_flush();
+
+    _exit(ret);
+}
+
+int prefork_run(const prefork_params & params, const prefork_worker_fn & fn) {
+    const int n_workers = std::max(1, params.n_workers);
+
+    void * addr = mmap(nullptr, n_workers*sizeof(prefork_worker_stats), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED) {
+        fprintf(stderr, "%s: failed to map the shared counters: %s\n", __func__, strerror(errno));
+        return 1;
+    }
+
+    g_stats     = static_cast<prefork_worker_stats *>(addr);
+    g_n_workers = n_workers;
+
+    for (int i = 0; i < n_workers; ++i) {
+        new (&g_stats[i]) prefork_worker_stats();
+        g_stats[i].pid = -1;
+    }
+
+    struct sigaction sa = {};
+    sa.sa_handler = prefork_on_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT,  &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+
+    const std::vector<int> cpus = prefork_cpus_allowed();
+
+    using clock = std::chrono::steady_clock;
+
+    std::vector<pid_t>             pids(n_workers, -1);
+    std::vector<clock::time_point> t_spawn(n_workers);
+    std::vector<clock::time_point> t_respawn(n_workers);
+
+    fprintf(stderr, "%s: starting %d workers on %d CPUs\n", __func__, n_workers, (int) cpus.size());
+
+    for (int i = 0; i < n_workers; ++i) {
+        const std::vector<int> wcpus = prefork_worker_cpus(cpus, i, n_workers);
+
+        pids[i]    = prefork_spawn(i, wcpus, fn);
+        t_spawn[i] = clock::now();
+
+        if (pids[i] < 0) {
+            fprintf(stderr, "%s: failed to fork worker %d: %s\n", __func__, i, strerror(errno));
+        } else {
+            fprintf(stderr, "%s: worker %d: pid %d, CPUs %d - %d\n", __func__, i, (int) pids[i], wcpus.front(), wcpus.back());
+        }
+    }
+
+    auto t_stats = clock::now();
+
+    int ret = 0;
+
+    while (!g_stop) {
+        int status = 0;
+        const pid_t pid = waitpid(-1, &status, WNOHANG);
+
+        if (pid > 0) {
+            int i = 0;
+            while (i < n_workers && pids[i] != pid) {
+                ++i;
+            }
+            if (i == n_workers) {
+                continue;
+            }
+
+            pids[i] = -1;
+
+            // the sessions of the worker are gone with it
+            g_stats[i].pid       .store(-1, std::memory_order_relaxed);
+            g_stats[i].n_sessions.store(0,  std::memory_order_relaxed);
+
+            if (WIFSIGNALED(status)) {
+                // back off when the worker crashes right after starting, e.g. on every request
+                const bool early = clock::now() - t_spawn[i] < std::chrono::seconds(1);
+
+                fprintf(stderr, "%s: worker %d (pid %d) killed by signal %d (%s), restarting%s\n", __func__,
+                        i, (int) pid, WTERMSIG(status), strsignal(WTERMSIG(status)), early ? " in 1 s" : "");
+
+                t_respawn[i] = clock::now() + (early ? std::chrono::seconds(1) : std::chrono::seconds(0));
+            } else {
+                fprintf(stderr, "%s: worker %d (pid %d) exited with status %d\n", __func__, i, (int) pid, WEXITSTATUS(status));
+            }
+        }
+
+        bool any_alive = false;
+
+        for (int i = 0; i < n_workers; ++i) {
+            if (pids[i] > 0) {
+                any_alive = true;
+                continue;
+            }
+
+            if (t_respawn[i] == clock::time_point() || clock::now() < t_respawn[i]) {
+                continue;
+            }
+
+            t_respawn[i] = clock::time_point();
+
+            pids[i]    = prefork_spawn(i, prefork_worker_cpus(cpus, i, n_workers), fn);
+            t_spawn[i] = clock::now();
+
+            if (pids[i] < 0) {
+                fprintf(stderr, "%s: failed to fork worker %d: %s\n", __func__, i, strerror(errno));
+                t_respawn[i] = clock::now() + std::chrono::seconds(1);
+                continue;
+            }
+
+            fprintf(stderr, "%s: worker %d: restarted as pid %d\n", __func__, i, (int) pids[i]);
+
+            g_stats[i].n_restarts.fetch_add(1, std::memory_order_relaxed);
+            any_alive = true;
+        }
+
+        if (!any_alive) {
+            bool pending = false;
+            for (int i = 0; i < n_workers; ++i) {
+                pending = pending || t_respawn[i] != clock::time_point();
+            }
+            if (!pending) {
+                fprintf(stderr, "%s: no workers left\n", __func__);
+                ret = 1;
+                break;
+            }
+        }
+
+        if (params.stats_interval_s > 0 && clock::now() - t_stats >= std::chrono::seconds(params.stats_interval_s)) {
+            prefork_print_stats();
+            t_stats = clock::now();
+        }
+
+        if (pid <= 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+
+    fprintf(stderr, "%s: stopping the workers\n", __func__);
+
+    for (int i = 0; i < n_workers; ++i) {
+        if (pids[i] > 0) {
+            kill(pids[i], SIGTERM);
+        }
+    }
+
+    for (int i = 0; i < n_workers; ++i) {
+        if (pids[i] > 0) {
+            waitpid(pids[i], nullptr, 0);
+            g_stats[i].pid = -1;
+        }
+    }
+
+    prefork_print_stats();
+
+    munmap(addr, n_workers*sizeof(prefork_worker_stats));
+
+    g_stats     = nullptr;
+    g_n_workers = 0;
+
+    return ret;
+}
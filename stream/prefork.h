@@ -0,0 +1,105 @@
+#pragma once
+
+#include "latency.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+//
+// Pre-fork supervisor
+//
+// The supervisor forks n_workers processes after the model has been loaded, so the weights
+// (mapped or copied) are shared copy-on-write between all workers and never written.
+// Each worker is pinned to an even share of the allowed CPUs and crashed workers are forked again.
+//
+
+// counters of one worker, kept in a shared anonymous mapping so the supervisor can aggregate them
+// the workers update them with relaxed atomics only
+struct prefork_worker_stats {
+    std::atomic<int64_t>  pid;
+    std::atomic<uint64_t> n_restarts;
+
+    std::atomic<int64_t>  n_sessions;       // currently connected clients
+    std::atomic<uint64_t> n_sessions_total;
+
+    std::atomic<uint64_t> n_windows;        // calls to whisper_full
+    std::atomic<uint64_t> n_samples;        // audio samples received
+    std::atomic<uint64_t> n_messages;       // transcriptions sent
+    std::atomic<uint64_t> t_infer_us;       // time spent in whisper_full
+    std::atomic<uint64_t> n_windows_empty;  // windows without any text, skipped as silence
+    std::atomic<uint64_t> n_dropped;        // audio dropped because the transcription fell behind
+    std::atomic<uint64_t> n_samples_dropped;
+    std::atomic<int64_t>  n_writes_pending; // messages being written to the clients
+
+    // whisper_counters of the windows
+    std::atomic<uint64_t> n_encode;
+    std::atomic<uint64_t> n_decode;
+    std::atomic<uint64_t> n_batchd;
+    std::atomic<uint64_t> n_prompt;
+    std::atomic<uint64_t> n_fail_p;
+    std::atomic<uint64_t> n_fail_h;
+
+    latency_window    latency;                       // stage latencies of the messages
+    latency_histogram whisper[LATENCY_WHISPER_COUNT]; // whisper_full stages of the windows
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "the shared counters must be lock-free");
+
+// sum over all the workers
+struct prefork_stats_total {
+    int n_workers = 0; // alive
+
+    uint64_t n_restarts        = 0;
+    int64_t  n_sessions        = 0;
+    uint64_t n_sessions_total  = 0;
+    uint64_t n_windows         = 0;
+    uint64_t n_samples         = 0;
+    uint64_t n_messages        = 0;
+    uint64_t t_infer_us        = 0;
+    uint64_t n_windows_empty   = 0;
+    uint64_t n_dropped         = 0;
+    uint64_t n_samples_dropped = 0;
+    int64_t  n_writes_pending  = 0;
+
+    uint64_t n_encode = 0;
+    uint64_t n_decode = 0;
+    uint64_t n_batchd = 0;
+    uint64_t n_prompt = 0;
+    uint64_t n_fail_p = 0;
+    uint64_t n_fail_h = 0;
+
+    // over the last messages of every worker
+    latency_percentiles latency[LATENCY_STAGE_COUNT];
+
+    // since the start
+    latency_histogram_sum latency_hist[LATENCY_STAGE_COUNT];
+    latency_histogram_sum whisper_hist[LATENCY_WHISPER_COUNT];
+
+    // memory of the workers from /proc/<pid>/smaps_rollup
+    // pss divides the shared pages between the processes that map them, so it shows what the weights really cost
+    uint64_t rss_kb = 0;
+    uint64_t pss_kb = 0;
+};
+
+struct prefork_params {
+    int n_workers        = 1;
+    int stats_interval_s = 10; // 0 disables the periodic log line
+};
+
+// entry point of a worker: index, its counters and the CPUs it has been pinned to
+// the return value becomes the exit status of the worker
+using prefork_worker_fn = std::function<int(int i_worker, prefork_worker_stats & stats, const std::vector<int> & cpus)>;
+
+// fork the workers and supervise them until SIGINT/SIGTERM, then stop them and return 0
+// a worker killed by a signal is restarted, a worker that exits is not
+// returns 1 if no worker is left running
+// must be called before the process has started any threads
+int prefork_run(const prefork_params & params, const prefork_worker_fn & fn);
+
+// aggregate the counters of all workers - can be called from the supervisor or from any worker
+prefork_stats_total prefork_stats_aggregate();
+
+// same for counters outside of the pre-fork mode - the memory is read for the entries with a pid
+prefork_stats_total prefork_stats_aggregate(const prefork_worker_stats * stats, int n);
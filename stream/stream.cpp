@@ -1,6 +1,14 @@
 #include "common.h"
+#include "common-whisper.h"
 #include "whisper.h"
 #include "common-sdl.h"
+#include "common-resample.h"
+#include "latency.h"
+#include "metrics.h"
+#include "prefork.h"
+#include <cstring>
+#include <deque>
+#include <functional>
 #include <iostream>
 #include <set>
 #include <termios.h>
@@ -10,6 +18,7 @@
 #include <unistd.h>
 #include <vector>
 #include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
 #include <boost/beast/websocket.hpp>
 #include <boost/asio/ip/tcp.hpp>
 #include <nlohmann/json.hpp>
@@ -34,14 +43,22 @@ class shared_state {
     std::mutex m_mutex;
 
 public:
+    // counters of the microphone mode, in the same layout as the pre-fork workers for /metrics
+    prefork_worker_stats stats{};
+
     void join(websocket::stream<tcp::socket>* ws) {
         std::lock_guard<std::mutex> lock(m_mutex);
         m_connections.insert(ws);
+
+        stats.n_sessions.fetch_add(1, std::memory_order_relaxed);
+        stats.n_sessions_total.fetch_add(1, std::memory_order_relaxed);
     }
 
     void leave(websocket::stream<tcp::socket>* ws) {
         std::lock_guard<std::mutex> lock(m_mutex);
-        m_connections.erase(ws);
+        if (m_connections.erase(ws) > 0) {
+            stats.n_sessions.fetch_sub(1, std::memory_order_relaxed);
+        }
     }
 
     bool is_client_connected() {
@@ -56,6 +73,8 @@ public:
             clients.assign(m_connections.begin(), m_connections.end());
         }
 
+        stats.n_writes_pending.fetch_add(clients.size(), std::memory_order_relaxed);
+
         for (auto ws : clients) {
             try {
                 ws->text(true);
@@ -63,15 +82,70 @@ public:
             } catch (const std::exception& e) {
                 std::cerr << "WebSocket Broadcast Error: " << e.what() << std::endl;
             }
+
+            stats.n_writes_pending.fetch_sub(1, std::memory_order_relaxed);
         }
     }
 };
 
+// Counts a message being written for the broadcast queue depth, until the write returns or throws
+struct pending_write {
+    std::atomic<int64_t>& n;
+
+    explicit pending_write(std::atomic<int64_t>& n) : n(n) {
+        n.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    ~pending_write() {
+        n.fetch_sub(1, std::memory_order_relaxed);
+    }
+};
+
+// Read the first request of a connection and accept it if it is a WebSocket upgrade
+// Otherwise answer it as plain HTTP - GET /metrics with the text of metrics(), 404 for anything else - and return false
+bool accept_or_serve(websocket::stream<tcp::socket>& ws, const std::function<std::string()>& metrics) {
+    beast::flat_buffer buffer;
+    http::request<http::string_body> req;
+    http::read(ws.next_layer(), buffer, req);
+
+    if (websocket::is_upgrade(req)) {
+        ws.accept(req);
+        return true;
+    }
+
+    http::response<http::string_body> res;
+    res.version(req.version());
+    res.keep_alive(false);
+
+    if (req.method() == http::verb::get && req.target() == "/metrics") {
+        res.result(http::status::ok);
+        res.set(http::field::content_type, "text/plain; version=0.0.4");
+        res.body() = metrics();
+    } else {
+        res.result(http::status::not_found);
+        res.set(http::field::content_type, "text/plain");
+        res.body() = "not found\n";
+    }
+
+    res.prepare_payload();
+    http::write(ws.next_layer(), res);
+
+    beast::error_code ec;
+    ws.next_layer().shutdown(tcp::socket::shutdown_send, ec);
+
+    return false;
+}
+
 // WebSocket session handler
 void do_session(tcp::socket socket, std::shared_ptr<shared_state> state) {
     websocket::stream<tcp::socket> ws{std::move(socket)};
     try {
-        ws.accept();
+        const bool is_websocket = accept_or_serve(ws, [&state]() {
+            return metrics_text(prefork_stats_aggregate(&state->stats, 1));
+        });
+        if (!is_websocket) {
+            return;
+        }
 
         state->join(&ws);
 
@@ -103,12 +177,12 @@ void do_session(tcp::socket socket, std::shared_ptr<shared_state> state) {
 }
 
 // WebSocket server
-void websocket_server(std::shared_ptr<shared_state> state) {
+void websocket_server(std::shared_ptr<shared_state> state, int port) {
     try {
         net::io_context ioc;
-        tcp::acceptor acceptor{ioc, {tcp::v4(), 8080}};
+        tcp::acceptor acceptor{ioc, {tcp::v4(), static_cast<unsigned short>(port)}};
 
-        std::cout << "WebSocket server is running on port 8080..." << std::endl;
+        std::cout << "WebSocket server is running on port " << port << "..." << std::endl;
 
         while (is_running) {
             tcp::socket socket{ioc};
@@ -202,73 +276,649 @@ float string_similarity(const std::string& s1, const std::string& s2) {
     return levenshtein_distance(s1, s2) / max_len;
 }
 
+// window parameters, set from the command line by set_window() before any audio is processed
+int step_ms = 3000;
+int length_ms = 5000;
+int keep_ms = 200;
+const int n_samples_30s  = (1e-3*30000.0)*WHISPER_SAMPLE_RATE;
+int n_samples_len  = (1e-3*length_ms)*WHISPER_SAMPLE_RATE;
+int n_samples_step = (1e-3*step_ms)*WHISPER_SAMPLE_RATE;
+int n_samples_keep = (1e-3*keep_ms)*WHISPER_SAMPLE_RATE;
+
+// the window is at least one step and keeps at most one step of the previous one
+void set_window(int step, int length, int keep) {
+    step_ms   = std::max(step, 100);
+    length_ms = std::max(length, step_ms);
+    keep_ms   = std::clamp(keep, 0, step_ms);
+
+    n_samples_len  = (1e-3*length_ms)*WHISPER_SAMPLE_RATE;
+    n_samples_step = (1e-3*step_ms)*WHISPER_SAMPLE_RATE;
+    n_samples_keep = (1e-3*keep_ms)*WHISPER_SAMPLE_RATE;
+}
+
+// Prepend up to length_ms of the previous window to the new audio
+template <typename T>
+void assemble_window(const std::vector<T>& pcm_old, const std::vector<T>& pcm_new, std::vector<T>& pcm) {
+    const int n_samples_new = pcm_new.size();
+    // take up to params.length_ms audio from previous iteration
+    const int n_samples_take = std::min((int) pcm_old.size(), std::max(0, n_samples_keep + n_samples_len - n_samples_new));
+
+    pcm.resize(n_samples_new + n_samples_take);
+
+    for (int i = 0; i < n_samples_take; i++) {
+        pcm[i] = pcm_old[pcm_old.size() - n_samples_take + i];
+    }
+
+    memcpy(pcm.data() + n_samples_take, pcm_new.data(), n_samples_new*sizeof(T));
+}
+
+// Collect the text of the segments of the last inference
+// Returns the number of segments and the cleaned up transcription
+static int collect_transcription(whisper_context* ctx, whisper_state* wstate, std::string& transcription) {
+    transcription.clear();
+
+    const int n_segments = wstate ? whisper_full_n_segments_from_state(wstate) : whisper_full_n_segments(ctx);
+    for (int i = 0; i < n_segments; ++i) {
+        const char* text = wstate ? whisper_full_get_segment_text_from_state(wstate, i) : whisper_full_get_segment_text(ctx, i);
+        if (text) {
+            transcription += text;
+        }
+    }
+
+    // Remove partial bracketed text (e.g., [inaudible], [ Background Conversations ])
+    remove_bracketed_text(transcription);
+
+    // Trim leading and trailing whitespace
+    lrtrim(transcription);
+
+    return n_segments;
+}
+
+// Stage latencies of a message, sent with it - the time of the write itself is only in the histograms
+static nlohmann::json latency_message(const latency_trace& trace) {
+    return {
+        {"buffer_us",   trace.stage_us(LATENCY_STAGE_BUFFER)},
+        {"assemble_us", trace.stage_us(LATENCY_STAGE_ASSEMBLE)},
+        {"infer_us",    trace.stage_us(LATENCY_STAGE_INFER)},
+        {"post_us",     trace.stage_us(LATENCY_STAGE_POST)},
+        {"total_us",    trace.t_emit_us - trace.t_capture_us},      // oldest new sample -> sent
+        {"newest_us",   trace.t_emit_us - trace.t_capture_last_us}, // newest sample -> sent
+    };
+}
+
+// Run inference on a window, using the context state when wstate is null
+// Returns the number of segments (-1 on failure) and the cleaned up transcription
+int transcribe_window(whisper_context* ctx, whisper_state* wstate, const whisper_full_params& wparams,
+                      const std::vector<float>& pcmf32, std::string& transcription) {
+    transcription.clear();
+
+    const int ret = wstate ? whisper_full_with_state(ctx, wstate, wparams, pcmf32.data(), pcmf32.size())
+                           : whisper_full(ctx, wparams, pcmf32.data(), pcmf32.size());
+    if (ret != 0) {
+        return -1;
+    }
+
+    return collect_transcription(ctx, wstate, transcription);
+}
+
+// Same for an int16 window: the samples are converted to float only inside the mel front end
+int transcribe_window(whisper_context* ctx, whisper_state* wstate, const whisper_full_params& wparams,
+                      const std::vector<int16_t>& pcm16, std::string& transcription) {
+    transcription.clear();
+
+    const int ret = wstate ? whisper_pcm16_to_mel_with_state(ctx, wstate, pcm16.data(), pcm16.size(), wparams.n_threads)
+                           : whisper_pcm16_to_mel(ctx, pcm16.data(), pcm16.size(), wparams.n_threads);
+    if (ret != 0) {
+        return -1;
+    }
+
+    // n_samples = 0 runs on the spectrogram computed above
+    if ((wstate ? whisper_full_with_state(ctx, wstate, wparams, nullptr, 0) : whisper_full(ctx, wparams, nullptr, 0)) != 0) {
+        return -1;
+    }
+
+    return collect_transcription(ctx, wstate, transcription);
+}
+
+// Add the whisper_full counters of a window to the stats, from the snapshots taken around it
+static void count_window(prefork_worker_stats& stats, const whisper_counters& c0, const whisper_counters& c1) {
+    stats.n_encode.fetch_add(std::max(0, c1.n_encode - c0.n_encode), std::memory_order_relaxed);
+    stats.n_decode.fetch_add(std::max(0, c1.n_decode - c0.n_decode), std::memory_order_relaxed);
+    stats.n_batchd.fetch_add(std::max(0, c1.n_batchd - c0.n_batchd), std::memory_order_relaxed);
+    stats.n_prompt.fetch_add(std::max(0, c1.n_prompt - c0.n_prompt), std::memory_order_relaxed);
+    stats.n_fail_p.fetch_add(std::max(0, c1.n_fail_p - c0.n_fail_p), std::memory_order_relaxed);
+    stats.n_fail_h.fetch_add(std::max(0, c1.n_fail_h - c0.n_fail_h), std::memory_order_relaxed);
+
+    stats.whisper[LATENCY_WHISPER_MEL   ].record(c1.t_mel_us    - c0.t_mel_us);
+    stats.whisper[LATENCY_WHISPER_ENCODE].record(c1.t_encode_us - c0.t_encode_us);
+    stats.whisper[LATENCY_WHISPER_DECODE].record((c1.t_decode_us + c1.t_batchd_us + c1.t_prompt_us) -
+                                                 (c0.t_decode_us + c0.t_batchd_us + c0.t_prompt_us));
+    stats.whisper[LATENCY_WHISPER_SAMPLE].record(c1.t_sample_us - c0.t_sample_us);
+}
+
+// Audio of an ingest session, kept in the sample format of the client until the mel front end
+template <typename T>
+struct ingest_audio {
+    std::vector<T> pcm;      // current window
+    std::vector<T> pcm_new;  // audio not processed yet
+    std::vector<T> pcm_old;  // end of the previous window
+    std::vector<T> pcm_step = std::vector<T>(n_samples_step);
+
+    // receive time of the audio in pcm_new: index of the sample after each message and when it arrived
+    std::deque<std::pair<uint64_t, int64_t>> t_received;
+    uint64_t n_received = 0; // samples appended to pcm_new
+    uint64_t n_taken    = 0; // samples moved out of pcm_new
+
+    void clear() {
+        pcm_new.clear();
+        pcm_old.clear();
+        t_received.clear();
+        n_received = 0;
+        n_taken    = 0;
+    }
+
+    void received(size_t n_samples, int64_t t_us) {
+        if (n_samples > 0) {
+            n_received += n_samples;
+            t_received.emplace_back(n_received, t_us);
+        }
+    }
+
+    int64_t received_time(uint64_t i) const {
+        for (const auto& r : t_received) {
+            if (i < r.first) {
+                return r.second;
+            }
+        }
+        return 0;
+    }
+
+    // move the next step of pcm_new to pcm_step, with the receive time of its first and last samples
+    void take_step(latency_trace& trace) {
+        trace.t_capture_us      = received_time(n_taken);
+        trace.t_capture_last_us = received_time(n_taken + n_samples_step - 1);
+
+        std::copy(pcm_new.begin(), pcm_new.begin() + n_samples_step, pcm_step.begin());
+        pcm_new.erase(pcm_new.begin(), pcm_new.begin() + n_samples_step);
+
+        n_taken += n_samples_step;
+        while (!t_received.empty() && t_received.front().first <= n_taken) {
+            t_received.pop_front();
+        }
+    }
+};
+
+// Ingest session: the client streams mono PCM in binary messages
+// and receives the transcriptions of its own audio, using the same windowing as the microphone loop
+// the audio is 16 kHz float32 unless the client sends {"type": "config", "sample_rate": N, "format": "s16"} first
+// s16 audio stays int16 through the session buffers and the window, at half the memory and bandwidth of float32
+// the latencies of the messages are counted from the arrival of the audio
+// a plain HTTP request for /metrics gets the counters of all the workers
+void do_ingest_session(tcp::socket socket, whisper_context* ctx, whisper_full_params wparams, prefork_worker_stats& stats) {
+    websocket::stream<tcp::socket> ws{std::move(socket)};
+    whisper_state* wstate = nullptr;
+
+    try {
+        if (!accept_or_serve(ws, []() { return metrics_text(prefork_stats_aggregate()); })) {
+            return;
+        }
+    } catch (std::exception const& e) {
+        std::cerr << "WebSocket Error: " << e.what() << std::endl;
+        return;
+    }
+
+    stats.n_sessions.fetch_add(1, std::memory_order_relaxed);
+    stats.n_sessions_total.fetch_add(1, std::memory_order_relaxed);
+
+    try {
+        wstate = whisper_init_state(ctx);
+        if (!wstate) {
+            throw std::runtime_error("failed to initialize the whisper state");
+        }
+
+        ingest_audio<float>   audio_f32;
+        ingest_audio<int16_t> audio_s16;
+
+        bool is_s16 = false;
+
+        // bytes of a sample split across two messages
+        std::vector<uint8_t> partial;
+
+        // converts the client's sample rate to WHISPER_SAMPLE_RATE, passthrough by default
+        pcm_resampler resampler;
+        resampler.init(WHISPER_SAMPLE_RATE, WHISPER_SAMPLE_RATE);
+
+        std::vector<float> pcmf32_in;
+        std::vector<float> pcmf32_out;
+
+        std::string last_session_transcription;
+        std::string current_transcription;
+
+        // a client sending faster than real time is processed one step at a time
+        auto process_steps = [&](auto& audio) {
+            while ((int) audio.pcm_new.size() >= n_samples_step) {
+                latency_trace trace;
+                audio.take_step(trace);
+
+                trace.t_ready_us = latency_now_us();
+
+                assemble_window(audio.pcm_old, audio.pcm_step, audio.pcm);
+
+                audio.pcm_old = audio.pcm;
+
+                trace.t_assembled_us = latency_now_us();
+
+                const whisper_counters counters = whisper_get_counters_from_state(wstate);
+
+                const int n_segments = transcribe_window(ctx, wstate, wparams, audio.pcm, current_transcription);
+
+                trace.t_inferred_us = latency_now_us();
+
+                stats.t_infer_us.fetch_add(trace.t_inferred_us - trace.t_assembled_us, std::memory_order_relaxed);
+                stats.n_windows.fetch_add(1, std::memory_order_relaxed);
+
+                if (n_segments < 0) {
+                    throw std::runtime_error("failed to process audio");
+                }
+
+                count_window(stats, counters, whisper_get_counters_from_state(wstate));
+
+                if (current_transcription.empty()) {
+                    stats.n_windows_empty.fetch_add(1, std::memory_order_relaxed);
+                }
+
+                if (n_segments > 0) {
+                    if (current_transcription.empty()) {
+                        continue;
+                    }
+
+                    if (last_session_transcription.empty() ||
+                        string_similarity(last_session_transcription, current_transcription) > 0.1f) {
+
+                        trace.t_emit_us = latency_now_us();
+
+                        // audio_ms: end of the step in the audio of the session, for the clients to match their audio
+                        nlohmann::json transcribe_message = {
+                            {"type", "transcribe"},
+                            {"content", current_transcription},
+                            {"latency", latency_message(trace)},
+                            {"audio_ms", audio.n_taken*1000/WHISPER_SAMPLE_RATE}
+                        };
+
+                        {
+                            pending_write pending(stats.n_writes_pending);
+
+                            ws.text(true);
+                            ws.write(net::buffer(transcribe_message.dump()));
+                        }
+
+                        trace.t_sent_us = latency_now_us();
+
+                        stats.latency.record(trace);
+                        stats.n_messages.fetch_add(1, std::memory_order_relaxed);
+
+                        last_session_transcription = current_transcription;
+                    }
+                }
+
+                audio.pcm_old.assign(audio.pcm.end() - n_samples_keep, audio.pcm.end());
+            }
+        };
+
+        while (is_running) {
+            beast::flat_buffer buffer;
+            ws.read(buffer);
+
+            const int64_t t_received_us = latency_now_us();
+
+            if (ws.got_text()) {
+                nlohmann::json json_message = nlohmann::json::parse(beast::buffers_to_string(buffer.data()));
+
+                if (json_message["type"] == "reset") {
+                    audio_f32.clear();
+                    audio_s16.clear();
+                    partial.clear();
+                    resampler.reset();
+                    last_session_transcription.clear();
+                } else if (json_message["type"] == "config") {
+                    const int sample_rate = json_message.value("sample_rate", WHISPER_SAMPLE_RATE);
+                    if (!resampler.init(sample_rate, WHISPER_SAMPLE_RATE)) {
+                        throw std::runtime_error("invalid sample rate " + std::to_string(sample_rate) + ", expected " +
+                                std::to_string(pcm_resampler::RATE_MIN) + " - " + std::to_string(pcm_resampler::RATE_MAX));
+                    }
+
+                    const std::string format = json_message.value("format", "f32");
+                    if (format != "f32" && format != "s16") {
+                        throw std::runtime_error("invalid sample format " + format);
+                    }
+
+                    is_s16 = format == "s16";
+
+                    audio_f32.clear();
+                    audio_s16.clear();
+                    partial.clear();
+                }
+                continue;
+            }
+
+            partial.resize(partial.size() + buffer.size());
+            net::buffer_copy(net::buffer(partial.data() + partial.size() - buffer.size(), buffer.size()), buffer.data());
+
+            const size_t sample_size = is_s16 ? sizeof(int16_t) : sizeof(float);
+            const size_t n_in        = partial.size()/sample_size;
+
+            size_t n_samples = 0;
+
+            if (is_s16 && resampler.rate_in() == WHISPER_SAMPLE_RATE) {
+                // straight into the int16 buffer
+                const size_t n_old = audio_s16.pcm_new.size();
+
+                audio_s16.pcm_new.resize(n_old + n_in);
+                memcpy(audio_s16.pcm_new.data() + n_old, partial.data(), n_in*sizeof(int16_t));
+
+                n_samples = n_in;
+            } else if (is_s16) {
+                // resampled in float and stored back as int16
+                const int16_t* pcm16 = reinterpret_cast<const int16_t*>(partial.data());
+
+                pcmf32_in.resize(n_in);
+                for (size_t i = 0; i < n_in; ++i) {
+                    pcmf32_in[i] = pcm16[i]/32768.0f;
+                }
+
+                pcmf32_out.clear();
+                n_samples = resampler.process(pcmf32_in.data(), n_in, pcmf32_out);
+
+                const size_t n_old = audio_s16.pcm_new.size();
+
+                audio_s16.pcm_new.resize(n_old + n_samples);
+                for (size_t i = 0; i < n_samples; ++i) {
+                    audio_s16.pcm_new[n_old + i] = (int16_t) std::clamp(std::lround(pcmf32_out[i]*32768.0f), -32768L, 32767L);
+                }
+            } else {
+                pcmf32_in.resize(n_in);
+                memcpy(pcmf32_in.data(), partial.data(), n_in*sizeof(float));
+
+                n_samples = resampler.process(pcmf32_in.data(), n_in, audio_f32.pcm_new);
+            }
+
+            partial.erase(partial.begin(), partial.begin() + n_in*sample_size);
+
+            stats.n_samples.fetch_add(n_samples, std::memory_order_relaxed);
+
+            if (is_s16) {
+                audio_s16.received(n_samples, t_received_us);
+                process_steps(audio_s16);
+            } else {
+                audio_f32.received(n_samples, t_received_us);
+                process_steps(audio_f32);
+            }
+        }
+    } catch (beast::system_error const& se) {
+        if (se.code() != websocket::error::closed) {
+            std::cerr << "WebSocket Error: " << se.code().message() << std::endl;
+        }
+    } catch (std::exception const& e) {
+        std::cerr << "WebSocket Error: " << e.what() << std::endl;
+    }
+
+    stats.n_sessions.fetch_sub(1, std::memory_order_relaxed);
+
+    if (wstate) {
+        whisper_free_state(wstate);
+    }
+}
+
+// Worker process of the pre-fork mode: every worker listens on the same port with SO_REUSEPORT
+// and the kernel spreads the incoming connections between them
+int ingest_worker(whisper_context* ctx, whisper_full_params wparams, int port, int i_worker, prefork_worker_stats& stats) {
+    {
+        whisper_state* wstate = whisper_init_state(ctx);
+        if (!wstate || whisper_warmup(ctx, wstate, wparams) != 0) {
+            std::cerr << "Worker " << i_worker << ": failed to warm up Whisper context.\n";
+            if (wstate) {
+                whisper_free_state(wstate);
+            }
+            return 1;
+        }
+        whisper_free_state(wstate);
+    }
+
+    try {
+        net::io_context ioc;
+
+        const tcp::endpoint endpoint{tcp::v4(), static_cast<unsigned short>(port)};
+
+        tcp::acceptor acceptor{ioc};
+        acceptor.open(endpoint.protocol());
+        acceptor.set_option(net::socket_base::reuse_address(true));
+        acceptor.set_option(net::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>(true));
+        acceptor.bind(endpoint);
+        acceptor.listen();
+
+        std::cout << "Worker " << i_worker << " (pid " << getpid() << ") is listening on port " << port
+                  << " with " << wparams.n_threads << " threads..." << std::endl;
+
+        while (is_running) {
+            tcp::socket socket{ioc};
+            acceptor.accept(socket);
+            std::thread{do_ingest_session, std::move(socket), ctx, wparams, std::ref(stats)}.detach();
+        }
+    } catch (std::exception const& e) {
+        std::cerr << "WebSocket Server Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+void print_usage(const char* argv0) {
+    std::cerr << "usage: " << argv0 << " [model] [options]\n"
+              << "\n"
+              << "options:\n"
+              << "  -p, --port N     WebSocket port (default: 8080)\n"
+              << "  -w, --workers N  pre-fork N worker processes that transcribe the audio streamed by the clients\n"
+              << "                   instead of the microphone (default: 0, microphone mode)\n"
+              << "  -t, --threads N  threads per transcription (default: min(CPUs/2, 10), or the CPUs of the worker)\n"
+              << "  --step N         audio step in ms (default: 3000)\n"
+              << "  --length N       window length in ms (default: 5000)\n"
+              << "  --keep N         audio of the previous window kept in ms (default: 200)\n"
+              << "  -f, --file FNAME replay an audio file instead of the microphone, as fast as it is transcribed,\n"
+              << "                   and print the messages as JSON lines\n"
+              << "  --realtime       replay the file at the pace of the audio\n"
+              << "  --save-audio FNAME  save the captured audio to a WAV file that can be replayed\n";
+}
+
 int main(int argc, char* argv[]) {
     // Initialize whisper context
     std::string model_path = "models/ggml-medium.en-q5_0.bin";
 
-    // Check if a custom path was provided
-    if (argc > 1) {
-        std::string user_path = argv[1];
+    int port = 8080;
+    int n_workers = 0;
+    int n_threads = 0;
+
+    int step = step_ms;
+    int length = length_ms;
+    int keep = keep_ms;
+
+    std::string replay_path;
+    bool replay_realtime = false;
+    std::string save_audio_path;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
 
-        // Validate the path
-        if (fs::exists(user_path)) {
-            model_path = user_path;
+        if ((arg == "-p" || arg == "--port") && i + 1 < argc) {
+            port = std::stoi(argv[++i]);
+        } else if ((arg == "-w" || arg == "--workers") && i + 1 < argc) {
+            n_workers = std::stoi(argv[++i]);
+        } else if ((arg == "-t" || arg == "--threads") && i + 1 < argc) {
+            n_threads = std::stoi(argv[++i]);
+        } else if (arg == "--step" && i + 1 < argc) {
+            step = std::stoi(argv[++i]);
+        } else if (arg == "--length" && i + 1 < argc) {
+            length = std::stoi(argv[++i]);
+        } else if (arg == "--keep" && i + 1 < argc) {
+            keep = std::stoi(argv[++i]);
+        } else if ((arg == "-f" || arg == "--file") && i + 1 < argc) {
+            replay_path = argv[++i];
+        } else if (arg == "--realtime") {
+            replay_realtime = true;
+        } else if (arg == "--save-audio" && i + 1 < argc) {
+            save_audio_path = argv[++i];
+        } else if (arg == "-h" || arg == "--help") {
+            print_usage(argv[0]);
+            return 0;
+        } else if (arg[0] == '-') {
+            std::cerr << "Unknown argument: " << arg << "\n";
+            print_usage(argv[0]);
+            return 1;
         } else {
-            std::cerr << "Warning: Provided model path '" << user_path << "' does not exist. Falling back to default.\n";
+            // Check if a custom path was provided
+            std::string user_path = arg;
+
+            // Validate the path
+            if (fs::exists(user_path)) {
+                model_path = user_path;
+            } else {
+                std::cerr << "Warning: Provided model path '" << user_path << "' does not exist. Falling back to default.\n";
+            }
         }
     }
 
+    set_window(step, length, keep);
+
     struct whisper_context_params cparams = whisper_context_default_params();
     cparams.use_gpu = true;
     cparams.flash_attn = false;
+    cparams.use_mmap = true;
+
+    if (n_workers > 0) {
+        // GPU contexts do not survive fork()
+        cparams.use_gpu = false;
+    }
 
-    struct whisper_context* ctx = whisper_init_from_file_with_params(model_path.c_str(), cparams);
+    // In the pre-fork mode the states are created by the workers, so that the supervisor
+    // only holds the weights and never runs a computation before forking
+    struct whisper_context* ctx = n_workers > 0
+        ? whisper_init_from_file_with_params_no_state(model_path.c_str(), cparams)
+        : whisper_init_from_file_with_params(model_path.c_str(), cparams);
     if (!ctx) {
         std::cerr << "Failed to initialize Whisper context.\n";
         return 1;
     }
 
-    const int step_ms = 3000;
-    const int length_ms = 5000;
-    const int keep_ms = 200;
-    const int n_samples_30s  = (1e-3*30000.0)*WHISPER_SAMPLE_RATE;
-    const int n_samples_len  = (1e-3*length_ms)*WHISPER_SAMPLE_RATE;
-    const int n_samples_step = (1e-3*step_ms)*WHISPER_SAMPLE_RATE;
-    const int n_samples_keep = (1e-3*keep_ms)*WHISPER_SAMPLE_RATE;
+    whisper_full_params wparams = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+    wparams.print_progress = false;
+    wparams.print_realtime = false;
+    wparams.no_context = true; // Disable context carryover
+    wparams.language = "en";
+    wparams.max_tokens = 32;
+    wparams.no_timestamps = true;
+    wparams.n_threads = n_threads > 0 ? n_threads : std::min(static_cast<int32_t>(std::thread::hardware_concurrency()/2), 10);
+    wparams.temperature = 0.0f;
+    wparams.greedy.best_of = 1;
+    wparams.single_segment = true;
+    wparams.audio_ctx = 0;
+    wparams.prompt_tokens = nullptr;
+    wparams.prompt_n_tokens = 0;
+
+    if (n_workers > 0) {
+        prefork_params pparams;
+        pparams.n_workers = n_workers;
+
+        const int ret = prefork_run(pparams, [&](int i_worker, prefork_worker_stats& stats, const std::vector<int>& cpus) {
+            whisper_full_params wparams_worker = wparams;
+            if (n_threads <= 0) {
+                wparams_worker.n_threads = std::min(static_cast<int32_t>(cpus.size()), 10);
+            }
+
+            return ingest_worker(ctx, wparams_worker, port, i_worker, stats);
+        });
+
+        whisper_free(ctx);
+
+        return ret;
+    }
+
+    // Run the model once with the serving parameters so the first window does not pay the cold-start cost
+    if (whisper_warmup(ctx, nullptr, wparams) != 0) {
+        std::cerr << "Failed to warm up Whisper context.\n";
+        whisper_free(ctx);
+        return 1;
+    }
+
     std::vector<float> pcmf32(n_samples_30s, 0.0f);
     std::vector<float> pcmf32_new(n_samples_30s, 0.0f);
     std::vector<float> pcmf32_old;
 
-    // Initialize audio capture
-    audio_async audio(10000);
+    // Initialize audio capture, or the replay of a recording
+    // the buffer holds more than the 2 steps after which the audio is dropped
+    audio_async audio(std::max(10000, 3*step_ms));
 
-    if (!audio.init(-1, WHISPER_SAMPLE_RATE)) {
+    const bool is_replay = !replay_path.empty();
+
+    if (is_replay) {
+        std::vector<float> pcmf32_replay;
+        std::vector<std::vector<float>> pcmf32s;
+
+        if (!read_audio_data(replay_path, pcmf32_replay, pcmf32s, false) ||
+            !audio.init_replay(std::move(pcmf32_replay), WHISPER_SAMPLE_RATE, replay_realtime)) {
+            std::cerr << "Failed to read audio file '" << replay_path << "'.\n";
+            return 1;
+        }
+    } else if (!audio.init(-1, WHISPER_SAMPLE_RATE)) {
         std::cerr << "Failed to initialize audio capture.\n";
         return 1;
     }
     audio.resume();
 
-    // Start the WebSocket server
+    wav_writer wav;
+    if (!save_audio_path.empty() && !wav.open(save_audio_path, WHISPER_SAMPLE_RATE, 16, 1)) {
+        std::cerr << "Failed to open '" << save_audio_path << "' to save the audio.\n";
+        return 1;
+    }
+
+    // Start the WebSocket server - the replay only prints the messages
     auto state = std::make_shared<shared_state>();
-    std::thread ws_thread(websocket_server, state);
+    std::thread ws_thread;
+    if (!is_replay) {
+        ws_thread = std::thread(websocket_server, state, port);
+    }
+
+    prefork_worker_stats& stats = state->stats;
+    stats.pid = getpid();
+
+    // latencies of the last messages, logged every latency_interval_s
+    const int latency_interval_s = 10;
+    int64_t t_latency_us = latency_now_us();
 
     while (is_running) {
-        is_running = sdl_poll_events();
+        is_running = is_replay || sdl_poll_events();
         if (!is_running) {
             break;
         }
 
+        latency_trace trace;
+        audio_capture_span capture;
+
         // Capture audio
         while (true) {
             // handle Ctrl + C
-            is_running = sdl_poll_events();
+            is_running = is_replay || sdl_poll_events();
             if (!is_running) {
                 break;
             }
-            audio.get(step_ms, pcmf32_new);
+
+            // checked before get() so that the audio of a finished replay is complete
+            const bool is_finished = audio.is_finished();
+
+            audio.get(step_ms, pcmf32_new, capture);
 
             if ((int) pcmf32_new.size() > 2*n_samples_step) {
                 fprintf(stderr, "\n\n%s: WARNING: cannot process audio fast enough, dropping audio ...\n\n", __func__);
+                stats.n_dropped.fetch_add(1, std::memory_order_relaxed);
+                stats.n_samples_dropped.fetch_add(pcmf32_new.size(), std::memory_order_relaxed);
                 audio.clear();
                 continue;
             }
@@ -278,63 +928,66 @@ int main(int argc, char* argv[]) {
                 break;
             }
 
+            // end of the replay: transcribe the last partial step, then stop
+            if (is_finished) {
+                audio.clear();
+                is_running = !pcmf32_new.empty();
+                break;
+            }
+
             std::this_thread::sleep_for(std::chrono::milliseconds(1));
         }
 
-        const int n_samples_new = pcmf32_new.size();
-        // take up to params.length_ms audio from previous iteration
-        const int n_samples_take = std::min((int) pcmf32_old.size(), std::max(0, n_samples_keep + n_samples_len - n_samples_new));
-
-        pcmf32.resize(n_samples_new + n_samples_take);
+        if (!is_running) {
+            break;
+        }
 
-        for (int i = 0; i < n_samples_take; i++) {
-            pcmf32[i] = pcmf32_old[pcmf32_old.size() - n_samples_take + i];
+        if (!save_audio_path.empty()) {
+            wav.write(pcmf32_new.data(), pcmf32_new.size());
         }
 
-        memcpy(pcmf32.data() + n_samples_take, pcmf32_new.data(), n_samples_new*sizeof(float));
+        trace.t_capture_us      = capture.t_first_us;
+        trace.t_capture_last_us = capture.t_last_us;
+        trace.t_ready_us        = latency_now_us();
+
+        assemble_window(pcmf32_old, pcmf32_new, pcmf32);
 
         pcmf32_old = pcmf32;
 
+        trace.t_assembled_us = latency_now_us();
+
         if (pcmf32.empty()) continue;
 
         // Run inference only if speech is detected
-        whisper_full_params wparams = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
-        wparams.print_progress = false;
-        wparams.print_realtime = false;
-        wparams.no_context = true; // Disable context carryover
-        wparams.language = "en";
-        wparams.max_tokens = 32;
-        wparams.no_timestamps = true;
-        wparams.n_threads = std::min(static_cast<int32_t>(std::thread::hardware_concurrency()/2), 10);
-        wparams.temperature = 0.0f;
-        wparams.greedy.best_of = 1;
-        wparams.single_segment = true;
-        wparams.audio_ctx = 0;
-        wparams.prompt_tokens = nullptr;
-        wparams.prompt_n_tokens = 0;
-
-        if (whisper_full(ctx, wparams, pcmf32.data(), pcmf32.size()) != 0) {
+        const whisper_counters counters = whisper_get_counters(ctx);
+
+        std::string current_transcription;
+        const int n_segments = transcribe_window(ctx, nullptr, wparams, pcmf32, current_transcription);
+
+        trace.t_inferred_us = latency_now_us();
+
+        if (n_segments < 0) {
             std::cerr << "Failed to process audio.\n";
             break;
         }
 
-        // Get the latest transcription
-        const int n_segments = whisper_full_n_segments(ctx);
-        if (n_segments > 0) {
-            std::string current_transcription;
-            for (int i = 0; i < n_segments; ++i) {
-                const char* text = whisper_full_get_segment_text(ctx, i);
-                if (text) {
-                    current_transcription += text;
-                }
-            }
+        stats.n_samples.fetch_add(pcmf32_new.size(), std::memory_order_relaxed);
+        stats.t_infer_us.fetch_add(trace.t_inferred_us - trace.t_assembled_us, std::memory_order_relaxed);
+        stats.n_windows.fetch_add(1, std::memory_order_relaxed);
 
-            // Remove partial bracketed text (e.g., [inaudible], [ Background Conversations ])
-            remove_bracketed_text(current_transcription);
+        count_window(stats, counters, whisper_get_counters(ctx));
 
-            // Trim leading and trailing whitespace
-            lrtrim(current_transcription);
+        if (current_transcription.empty()) {
+            stats.n_windows_empty.fetch_add(1, std::memory_order_relaxed);
+        }
 
+        if (trace.t_inferred_us - t_latency_us >= latency_interval_s*1000000LL) {
+            fprintf(stderr, "%s: %s\n", __func__, latency_summary(prefork_stats_aggregate(&stats, 1).latency).c_str());
+            t_latency_us = trace.t_inferred_us;
+        }
+
+        // Get the latest transcription
+        if (n_segments > 0) {
             // Skip if the transcription is empty after cleaning
             if (current_transcription.empty()) {
                 continue;
@@ -343,16 +996,32 @@ int main(int argc, char* argv[]) {
             if (last_transcription.empty() ||
                 string_similarity(last_transcription, current_transcription) > 0.1f) {
 
-                std::cout << current_transcription << std::endl; // Print the new content
+                if (!is_replay) {
+                    std::cout << current_transcription << std::endl; // Print the new content
+                }
+
+                trace.t_emit_us = latency_now_us();
 
                 nlohmann::json transcribe_message = {
                     {"type", "transcribe"},
-                    {"content", current_transcription}
+                    {"content", current_transcription},
+                    {"latency", latency_message(trace)}
                 };
 
                 // Broadcast the new content to WebSocket clients
                 state->broadcast(transcribe_message.dump());
 
+                trace.t_sent_us = latency_now_us();
+
+                stats.latency.record(trace);
+                stats.n_messages.fetch_add(1, std::memory_order_relaxed);
+
+                // the replay prints the messages as JSON lines, with the position of the step in the recording
+                if (is_replay) {
+                    transcribe_message["audio_ms"] = capture.end*1000/WHISPER_SAMPLE_RATE;
+                    std::cout << transcribe_message.dump() << std::endl;
+                }
+
                 last_transcription = current_transcription;
             }
         }
@@ -361,6 +1030,22 @@ int main(int argc, char* argv[]) {
         pcmf32_old = std::vector<float>(pcmf32.end() - n_samples_keep, pcmf32.end());
     }
 
+    if (is_replay) {
+        const prefork_stats_total t = prefork_stats_aggregate(&stats, 1);
+
+        const double t_audio_s = t.n_samples/(double) WHISPER_SAMPLE_RATE;
+
+        fprintf(stderr, "%s: replayed %.1f s in %llu windows, rtf %.3f, messages %llu\n", __func__, t_audio_s,
+                (unsigned long long) t.n_windows, t_audio_s > 0.0 ? 1e-6*t.t_infer_us/t_audio_s : 0.0,
+                (unsigned long long) t.n_messages);
+        fprintf(stderr, "%s: %s\n", __func__, latency_summary(t.latency).c_str());
+
+        audio.pause();
+        whisper_free(ctx);
+
+        return 0;
+    }
+
     std::cout << "CTRL-C again to exit..." << std::endl;
     audio.pause();
     SDL_Quit();
@@ -68,21 +68,13 @@ public:
         if (base.empty()) return B;
         if (tail.empty()) return A;
 
-        // Optimized hash function with better mixing
-        auto computeTrigramHash = [](const std::string& a, const std::string& b, const std::string& c) noexcept {
-            size_t h1 = std::hash<std::string>{}(a);
-            size_t h2 = std::hash<std::string>{}(b);
-            size_t h3 = std::hash<std::string>{}(c);
-            return ((h1 * 0xFEA5B) ^ (h2 * 0x8DA6B) ^ (h3 * 0x7A97C)) * 0x9E3779B9;
-        };
-
         // Build trigram index with view-based optimization
         std::unordered_map<uint64_t, std::vector<int>> trigramIndex;
         trigramIndex.reserve(std::max(0, static_cast<int>(base.size()) - 2));
 
         for (size_t i = 0; i + 2 < base.size(); ++i) {
             if (!base[i].empty() && !base[i + 1].empty() && !base[i + 2].empty()) {
-                trigramIndex[computeTrigramHash(base[i], base[i + 1], base[i + 2])].push_back(i);
+                trigramIndex[trigramHash(base[i], base[i + 1], base[i + 2])].push_back(i);
             }
         }
 
@@ -160,12 +152,21 @@ public:
         text.resize(write_pos);
     }
 
-private:
     [[nodiscard]] static constexpr bool isFilteredChar(char ch) noexcept {
         const unsigned char uc = static_cast<unsigned char>(ch);
         return (uc == ' ') | (uc == ',') | (uc == '.') | (uc == ';') | (uc == '-');
     }
 
+    // Optimized hash function with better mixing
+    [[nodiscard]] static uint64_t trigramHash(const std::string& a, const std::string& b, const std::string& c) noexcept {
+        size_t h1 = std::hash<std::string>{}(a);
+        size_t h2 = std::hash<std::string>{}(b);
+        size_t h3 = std::hash<std::string>{}(c);
+        return ((h1 * 0xFEA5B) ^ (h2 * 0x8DA6B) ^ (h3 * 0x7A97C)) * 0x9E3779B9;
+    }
+
+private:
+
     [[nodiscard]] static int findBestMatch(
         const std::vector<std::string>& tail,
         const std::vector<std::string>& base,
@@ -178,15 +179,7 @@ private:
                 continue;
             }
 
-            // Optimized hash function with better mixing
-            auto computeTrigramHash = [](const std::string& a, const std::string& b, const std::string& c) noexcept {
-                size_t h1 = std::hash<std::string>{}(a);
-                size_t h2 = std::hash<std::string>{}(b);
-                size_t h3 = std::hash<std::string>{}(c);
-                return ((h1 * 0xFEA5B) ^ (h2 * 0x8DA6B) ^ (h3 * 0x7A97C)) * 0x9E3779B9;
-            };
-
-            const uint64_t tailHash = computeTrigramHash(tail[i], tail[i + 1], tail[i + 2]);
+            const uint64_t tailHash = trigramHash(tail[i], tail[i + 1], tail[i + 2]);
 
             if (const auto it = trigramIndex.find(tailHash); it != trigramIndex.end()) {
                 for (int baseIndex : it->second) {
@@ -219,6 +212,181 @@ private:
     }
 };
 
+// Incremental form of mergeStrings for a transcript that only grows at its end.
+//
+// Keeps the words of the transcript with their position in the text, and a trigram index over only
+// the last `window` words, so appending a segment costs O(words of the segment) amortised instead of
+// re-splitting and re-indexing the whole transcript. The overlap is searched in that window only:
+// a repetition of the same three words further back is not taken as the overlap. While the
+// transcript is shorter than the window, the words are the same as with mergeStrings; the text
+// before the overlap keeps its punctuation instead of being re-joined from the normalized words.
+class [[nodiscard]] HyniIncrementalMerge final {
+public:
+    explicit HyniIncrementalMerge(size_t window = 256) noexcept : m_window(std::max<size_t>(window, 3)) {}
+
+    void append(const std::string& segment) {
+        if (segment.empty()) return;
+
+        std::vector<Word> tail;
+        tokenize(segment, 0, tail);
+        if (tail.empty()) return;
+
+        if (m_words.empty()) {
+            reset(segment, tail);
+            return;
+        }
+
+        const int match = findMatch(tail);
+
+        if (match == 0) {
+            reset(segment, tail);
+            return;
+        }
+
+        if (match > 0) {
+            truncate(static_cast<size_t>(match));
+            m_text.resize(m_words.back().end);
+            m_text += ' ';
+        } else if (m_text.back() != ' ') {
+            m_text += ' ';
+        }
+
+        const size_t offset = m_text.size();
+        m_text += segment;
+
+        for (auto& word : tail) {
+            word.begin += offset;
+            word.end   += offset;
+            m_words.emplace_back(std::move(word));
+        }
+
+        index();
+    }
+
+    void clear() noexcept {
+        m_text.clear();
+        m_words.clear();
+        m_hashes.clear();
+        m_index.clear();
+        m_first = 0;
+    }
+
+    [[nodiscard]] const std::string& text() const noexcept { return m_text; }
+
+    // words of the whole transcript
+    [[nodiscard]] size_t size() const noexcept { return m_words.size(); }
+
+    [[nodiscard]] const std::string& word(size_t i) const noexcept { return m_words[i].text; }
+
+private:
+    struct Word {
+        std::string text;  // normalized, as splitAndNormalize
+        size_t begin;      // bytes of the word in m_text
+        size_t end;
+    };
+
+    // splitAndNormalize with the position of the words
+    static void tokenize(const std::string& text, size_t offset, std::vector<Word>& out) {
+        size_t begin = 0;
+        for (size_t i = 0; i <= text.size(); ++i) {
+            if (i == text.size() || HyniMerge::isFilteredChar(text[i])) {
+                if (i > begin) {
+                    out.push_back({ text.substr(begin, i - begin), offset + begin, offset + i });
+                }
+                begin = i + 1;
+            }
+        }
+    }
+
+    void reset(const std::string& segment, std::vector<Word>& tail) {
+        clear();
+        m_text = segment;
+        m_words = std::move(tail);
+        index();
+    }
+
+    // the first trigram of the tail found in the window, at its earliest position there, like findBestMatch
+    [[nodiscard]] int findMatch(const std::vector<Word>& tail) const noexcept {
+        if (tail.size() < 3) return -1;
+
+        for (size_t i = 0; i + 2 < tail.size(); ++i) {
+            const uint64_t hash = HyniMerge::trigramHash(tail[i].text, tail[i + 1].text, tail[i + 2].text);
+
+            const auto it = m_index.find(hash);
+            if (it == m_index.end()) continue;
+
+            for (const size_t pos : it->second) {
+                if (tail[i].text     == m_words[pos].text &&
+                    tail[i + 1].text == m_words[pos + 1].text &&
+                    tail[i + 2].text == m_words[pos + 2].text) {
+                    return static_cast<int>(pos);
+                }
+            }
+        }
+
+        return -1;
+    }
+
+    // keep the first n words, n > 0; the positions of each hash are ascending, so the removed ones are at the back
+    void truncate(size_t n) {
+        const size_t n_trigrams = n >= 2 ? n - 2 : 0;
+
+        while (m_hashes.size() > n_trigrams) {
+            const size_t pos = m_hashes.size() - 1;
+            if (pos >= m_first) {
+                unindex(m_hashes[pos], pos);
+            }
+            m_hashes.pop_back();
+        }
+
+        m_words.resize(n);
+    }
+
+    // index the new trigrams and evict those that left the window; the evicted ones are at the front
+    void index() {
+        for (size_t pos = m_hashes.size(); pos + 2 < m_words.size(); ++pos) {
+            m_hashes.push_back(HyniMerge::trigramHash(m_words[pos].text, m_words[pos + 1].text, m_words[pos + 2].text));
+            if (pos >= m_first) {
+                m_index[m_hashes[pos]].push_back(pos);
+            }
+        }
+
+        while (m_first + m_window < m_words.size()) {
+            if (m_first < m_hashes.size()) {
+                unindex(m_hashes[m_first], m_first);
+            }
+            m_first++;
+        }
+    }
+
+    void unindex(uint64_t hash, size_t pos) {
+        const auto it = m_index.find(hash);
+        if (unlikely(it == m_index.end())) return;
+
+        auto& positions = it->second;
+        if (!positions.empty() && positions.back() == pos) {
+            positions.pop_back();
+        } else if (!positions.empty() && positions.front() == pos) {
+            positions.erase(positions.begin());
+        }
+
+        if (positions.empty()) {
+            m_index.erase(it);
+        }
+    }
+
+    size_t m_window;
+
+    std::string m_text;
+    std::vector<Word> m_words;
+
+    // hash of the trigram at each word, and the positions of the ones in the window by hash
+    std::vector<uint64_t> m_hashes;
+    std::unordered_map<uint64_t, std::vector<size_t>> m_index;
+
+    size_t m_first = 0; // first word of the window
+};
+
 } // hyni
 
 #endif
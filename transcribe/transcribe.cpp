@@ -0,0 +1,322 @@
+// Transcribe a long audio file or stdin with bounded memory
+//
+// usage: wstream-transcribe [options] -m model.gguf -f audio.wav
+//
+// the input is decoded incrementally on a separate thread and cut at the quietest point of each window into
+// chunks that are queued for the inference thread. the segments of each chunk are printed as soon as it is done,
+// so the memory use does not depend on the length of the input and the first segment is out after one chunk
+//
+//   ffmpeg -i talk.mp3 -f wav - | wstream-transcribe -m model.gguf -f -
+//
+#include "common-whisper.h"
+
+#include "whisper.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+
+struct transcribe_params {
+    std::string model;
+    std::string fname_inp;
+    std::string language = "en";
+
+    int n_threads = std::min(4, (int) std::thread::hardware_concurrency());
+    int chunk_ms  = 30000;
+    int n_queue   = 2;
+
+    bool no_timestamps = false;
+};
+
+static void print_usage(const char * argv0) {
+    fprintf(stderr, "usage: %s [options] -m model.gguf -f audio.wav\n", argv0);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "options:\n");
+    fprintf(stderr, "  -m FNAME          model path\n");
+    fprintf(stderr, "  -f FNAME          input audio, \"-\" reads from stdin\n");
+    fprintf(stderr, "  -l LANG           spoken language (default: en)\n");
+    fprintf(stderr, "  -t N              number of threads (default: %d)\n", transcribe_params().n_threads);
+    fprintf(stderr, "  --chunk-ms N      maximum length of a chunk, cut at the quietest point of its second half (default: 30000)\n");
+    fprintf(stderr, "  --queue N         number of decoded chunks waiting for inference (default: 2)\n");
+    fprintf(stderr, "  -nt               do not print the timestamps\n");
+}
+
+struct audio_chunk {
+    int64_t offset = 0; // first sample in the input
+
+    std::vector<float> pcmf32;
+};
+
+// bounded queue between the decoder and the inference thread
+class chunk_queue {
+public:
+    explicit chunk_queue(size_t capacity) : m_capacity(capacity) {}
+
+    // returns false if the consumer has given up
+    bool push(audio_chunk && chunk) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [&] { return m_chunks.size() < m_capacity || m_abort; });
+        if (m_abort) {
+            return false;
+        }
+        m_chunks.push_back(std::move(chunk));
+        m_cv.notify_all();
+        return true;
+    }
+
+    // returns false at the end of the input
+    bool pop(audio_chunk & chunk) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [&] { return !m_chunks.empty() || m_done || m_abort; });
+        if (m_chunks.empty() || m_abort) {
+            return false;
+        }
+        chunk = std::move(m_chunks.front());
+        m_chunks.pop_front();
+        m_cv.notify_all();
+        return true;
+    }
+
+    void finish() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_done = true;
+        m_cv.notify_all();
+    }
+
+    void abort() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_abort = true;
+        m_cv.notify_all();
+    }
+
+private:
+    size_t m_capacity;
+
+    std::mutex              m_mutex;
+    std::condition_variable m_cv;
+
+    std::deque<audio_chunk> m_chunks;
+
+    bool m_done  = false;
+    bool m_abort = false;
+};
+
+// position of the quietest 100 ms in the second half of pcmf32[0, n)
+static size_t find_cut(const std::vector<float> & pcmf32, size_t n) {
+    const size_t n_win = WHISPER_SAMPLE_RATE/10;
+    const size_t n_hop = WHISPER_SAMPLE_RATE/100;
+
+    size_t cut   = n;
+    double e_min = std::numeric_limits<double>::max();
+
+    for (size_t i = n/2; i + n_win <= n; i += n_hop) {
+        double e = 0.0;
+        for (size_t j = i; j < i + n_win; ++j) {
+            e += pcmf32[j]*pcmf32[j];
+        }
+        if (e < e_min) {
+            e_min = e;
+            cut   = i + n_win/2;
+        }
+    }
+
+    return cut;
+}
+
+static void decode_thread(audio_stream * stream, const transcribe_params & params, chunk_queue & queue, bool & failed) {
+    const size_t n_chunk = (size_t) WHISPER_SAMPLE_RATE*params.chunk_ms/1000;
+    const size_t n_block = WHISPER_SAMPLE_RATE; // 1 s per read
+
+    std::vector<float> pending;
+    pending.reserve(n_chunk + n_block);
+
+    int64_t offset = 0;
+
+    while (true) {
+        const size_t n_cur = pending.size();
+        pending.resize(n_cur + n_block);
+
+        const int64_t n_read = audio_stream_read(stream, pending.data() + n_cur, n_block);
+        if (n_read < 0) {
+            failed = true;
+            break;
+        }
+
+        pending.resize(n_cur + n_read);
+
+        if (pending.size() >= n_chunk || (n_read == 0 && !pending.empty())) {
+            const size_t cut = n_read == 0 && pending.size() <= n_chunk ? pending.size() : find_cut(pending, std::min(pending.size(), n_chunk));
+
+            audio_chunk chunk;
+            chunk.offset = offset;
+            chunk.pcmf32.assign(pending.begin(), pending.begin() + cut);
+
+            pending.erase(pending.begin(), pending.begin() + cut);
+            offset += cut;
+
+            if (!queue.push(std::move(chunk))) {
+                break;
+            }
+        }
+
+        if (n_read == 0 && pending.empty()) {
+            break;
+        }
+    }
+
+    queue.finish();
+}
+
+int main(int argc, char ** argv) {
+    transcribe_params params;
+
+    // std::stoi throws on values that are not numbers
+    int i = 1;
+    try {
+        for (; i < argc; ++i) {
+            const std::string arg = argv[i];
+
+            if (arg == "-m" && i + 1 < argc) {
+                params.model = argv[++i];
+            } else if (arg == "-f" && i + 1 < argc) {
+                params.fname_inp = argv[++i];
+            } else if (arg == "-l" && i + 1 < argc) {
+                params.language = argv[++i];
+            } else if (arg == "-t" && i + 1 < argc) {
+                params.n_threads = std::stoi(argv[++i]);
+            } else if (arg == "--chunk-ms" && i + 1 < argc) {
+                params.chunk_ms = std::max(1000, std::stoi(argv[++i]));
+            } else if (arg == "--queue" && i + 1 < argc) {
+                params.n_queue = std::max(1, std::stoi(argv[++i]));
+            } else if (arg == "-nt") {
+                params.no_timestamps = true;
+            } else if (arg == "-h" || arg == "--help") {
+                print_usage(argv[0]);
+                return 0;
+            } else {
+                fprintf(stderr, "%s: unknown argument '%s'\n", __func__, arg.c_str());
+                print_usage(argv[0]);
+                return 1;
+            }
+        }
+    } catch (const std::exception &) {
+        fprintf(stderr, "%s: invalid value '%s' for '%s'\n", __func__, argv[i], argv[i - 1]);
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    if (params.model.empty() || params.fname_inp.empty()) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    ggml_time_init();
+
+    const int64_t t_start_us = ggml_time_us();
+
+    whisper_context_params cparams = whisper_context_default_params();
+
+    whisper_context * ctx = whisper_init_from_file_with_params(params.model.c_str(), cparams);
+    if (!ctx) {
+        fprintf(stderr, "%s: failed to load '%s'\n", __func__, params.model.c_str());
+        return 2;
+    }
+
+    audio_stream * stream = audio_stream_open(params.fname_inp);
+    if (!stream) {
+        whisper_free(ctx);
+        return 3;
+    }
+
+    const int64_t t_ready_us = ggml_time_us();
+
+    whisper_full_params wparams = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+    wparams.n_threads      = params.n_threads;
+    wparams.language       = params.language.c_str();
+    wparams.print_progress = false;
+
+    // the chunks are consecutive, carry the decoded text over as the prompt of the next one
+    wparams.no_context     = false;
+
+    chunk_queue queue(params.n_queue);
+
+    bool failed = false;
+
+    std::thread decoder(decode_thread, stream, std::cref(params), std::ref(queue), std::ref(failed));
+
+    int64_t t_first_us = 0;
+    int64_t n_samples  = 0;
+    int     n_chunks   = 0;
+
+    int ret = 0;
+
+    audio_chunk chunk;
+    while (queue.pop(chunk)) {
+        if (whisper_full(ctx, wparams, chunk.pcmf32.data(), chunk.pcmf32.size()) != 0) {
+            fprintf(stderr, "%s: failed to process the chunk at %s\n", __func__,
+                    to_timestamp(100*chunk.offset/WHISPER_SAMPLE_RATE).c_str());
+            queue.abort();
+            ret = 4;
+            break;
+        }
+
+        const int64_t offset_t = 100*chunk.offset/WHISPER_SAMPLE_RATE;
+
+        const int n_segments = whisper_full_n_segments(ctx);
+        for (int i = 0; i < n_segments; ++i) {
+            const char * text = whisper_full_get_segment_text(ctx, i);
+
+            if (params.no_timestamps) {
+                printf("%s\n", text);
+            } else {
+                const int64_t t0 = offset_t + whisper_full_get_segment_t0(ctx, i);
+                const int64_t t1 = offset_t + whisper_full_get_segment_t1(ctx, i);
+
+                printf("[%s --> %s]  %s\n", to_timestamp(t0).c_str(), to_timestamp(t1).c_str(), text);
+            }
+        }
+        fflush(stdout);
+
+        if (t_first_us == 0 && n_segments > 0) {
+            t_first_us = ggml_time_us();
+        }
+
+        n_samples += chunk.pcmf32.size();
+        n_chunks++;
+    }
+
+    decoder.join();
+
+    audio_stream_close(stream);
+
+    if (failed) {
+        ret = 3;
+    }
+
+    const int64_t t_end_us = ggml_time_us();
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    const double t_audio_s = (double) n_samples/WHISPER_SAMPLE_RATE;
+    const double t_proc_s  = (t_end_us - t_ready_us)/1e6;
+
+    fprintf(stderr, "\n");
+    fprintf(stderr, "%s: audio %.1f s in %d chunks, processed in %.1f s (rtf %.3f)\n", __func__,
+            t_audio_s, n_chunks, t_proc_s, t_audio_s > 0.0 ? t_proc_s/t_audio_s : 0.0);
+    fprintf(stderr, "%s: load %.1f ms, first segment after %.1f ms, peak rss %.1f MB\n", __func__,
+            (t_ready_us - t_start_us)/1000.0, t_first_us ? (t_first_us - t_ready_us)/1000.0 : 0.0, usage.ru_maxrss/1024.0);
+
+    whisper_free(ctx);
+
+    return ret;
+}